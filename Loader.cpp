@@ -116,6 +116,38 @@ void Loader::loadFileFromURL(std::string URL, std::function<void (char, bool)> C
     }
 }
 
+void Loader::streamFileFromURL(std::string URL, std::function<bool (const char *, DWORD)> CB)
+{
+    bool IsOnlineInetFile = std::regex_match(URL, Loader::FileProtocolMatch);
+
+    if (!IsOnlineInetFile || Loader::InetAccessPoint == NULL || URL == "")
+        return;
+
+    HINTERNET InetFileOpenAddress = InternetOpenUrl(Loader::InetAccessPoint, URL.c_str(), NULL, 0, INTERNET_FLAG_PRAGMA_NOCACHE | INTERNET_FLAG_KEEP_CONNECTION, 0);
+
+    if (!InetFileOpenAddress)
+    {
+        DWORD ErrorNum = GetLastError();
+        std::cout << "Failed to open URL \nError no: " << ErrorNum;
+        return;
+    }
+
+    char DataReceived[4096];
+    DWORD NumberOfBytesRead = 0;
+    while (InternetReadFile(InetFileOpenAddress, DataReceived, 4096, &NumberOfBytesRead) && NumberOfBytesRead)
+    {
+        // Closing the handle early drops the connection with the rest
+        if (!CB(DataReceived, NumberOfBytesRead))
+            break;
+    }
+
+    if (InternetCloseHandle(InetFileOpenAddress) != TRUE)
+    {
+        DWORD ErrorNum = GetLastError();
+        std::cout << "Failed to close handle \nError no: " << ErrorNum;
+    }
+}
+
 void Loader::close()
 {
     Loader::ReadyToUse = false;
@@ -14,6 +14,9 @@ namespace Loader
     void configure(std::string ApplicationAgentName);
     std::string loadFileFromURL(std::string URL);
     void loadFileFromURL(std::string URL, std::function<void (char, bool)> CB);
+    // Hands the data over in pieces as they arrive. As soon as CB returns
+    // false the transfer is cancelled, the rest is never downloaded.
+    void streamFileFromURL(std::string URL, std::function<bool (const char *, DWORD)> CB);
     void close();
 }
 
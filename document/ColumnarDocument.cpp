@@ -0,0 +1,247 @@
+#include "ColumnarDocument.hpp"
+
+const ColumnarDocument::node_index ColumnarDocument::no_node;
+
+ColumnarDocument::ColumnarDocument()
+{
+    attribute_starts.push_back(0);
+}
+
+ColumnarDocument::ColumnarDocument(const Document &document) : ColumnarDocument()
+{
+    node_index previous_root = no_node;
+
+    for (const std::shared_ptr<HTMLElement> &root : document.get_elements())
+    {
+        node_index root_index = kinds.size();
+        add_tree(*root);
+
+        if (previous_root != no_node)
+            next_siblings[previous_root] = root_index;
+        previous_root = root_index;
+    }
+}
+
+ColumnarDocument::ColumnarDocument(const HTMLElement &root) : ColumnarDocument()
+{
+    add_tree(root);
+}
+
+void ColumnarDocument::add_tree(const HTMLElement &root)
+{
+    // Walked with the links rather than get_children(), so no handles are
+    // made, and without recursion as trees can be deep
+    std::vector<node_index> ancestors;
+    const HTMLElement *element = &root;
+    node_index current = add_node(root, no_node);
+
+    for (;;)
+    {
+        if (element->get_first_child() != nullptr)
+        {
+            ancestors.push_back(current);
+            element = element->get_first_child();
+            current = add_node(*element, current);
+            continue;
+        }
+
+        subtree_ends[current] = kinds.size();
+
+        for (;;)
+        {
+            // Back at the root
+            if (ancestors.empty())
+                return;
+
+            if (element->get_next_sibling() != nullptr)
+                break;
+
+            current = ancestors.back();
+            ancestors.pop_back();
+            subtree_ends[current] = kinds.size();
+            element = element->get_parent();
+        }
+
+        element = element->get_next_sibling();
+        next_siblings[current] = kinds.size();
+        current = add_node(*element, parents[current]);
+    }
+}
+
+ColumnarDocument::node_index ColumnarDocument::add_node(const HTMLElement &element,
+        node_index parent)
+{
+    node_index node = kinds.size();
+
+    parents.push_back(parent);
+    next_siblings.push_back(no_node);
+    subtree_ends.push_back(node + 1);
+
+    if (element.is_text_node())
+    {
+        string_span text = add_string(element.get_text());
+
+        kinds.push_back(text_node);
+        tags.push_back(tag_unknown);
+        text_starts.push_back(text.start);
+        text_lengths.push_back(text.length);
+        attribute_starts.push_back(attributes.size());
+        return node;
+    }
+
+    kinds.push_back(element_node);
+    text_starts.push_back(characters.size());
+    text_lengths.push_back(0);
+
+    const std::wstring &title = element.get_title();
+    HTMLTagId tag_id = element.get_tag_id();
+
+    if (tag_id != tag_unknown || title.empty())
+        tags.push_back(tag_id);
+    else
+    {
+        std::unordered_map<std::wstring, uint32_t>::const_iterator it =
+            unknown_title_indices.emplace(title, unknown_titles.size()).first;
+
+        if (it->second == unknown_titles.size())
+            unknown_titles.push_back(title);
+
+        tags.push_back(tag_count + it->second);
+    }
+
+    for (size_t attribute = 0; attribute < element.get_attribute_count(); attribute++)
+    {
+        attribute_span span;
+        span.name = add_string(element.get_attribute_name(attribute));
+        span.value = add_string(element.get_attribute_value(attribute));
+        attributes.push_back(span);
+    }
+
+    attribute_starts.push_back(attributes.size());
+    return node;
+}
+
+ColumnarDocument::string_span ColumnarDocument::add_string(const DOMStringView &string)
+{
+    string_span span;
+    span.start = characters.size();
+
+    string.append_to(characters);
+    span.length = characters.size() - span.start;
+    return span;
+}
+
+bool ColumnarDocument::span_equals(const string_span &span, const std::wstring &string) const
+{
+    return span.length == string.size() &&
+        characters.compare(span.start, span.length, string) == 0;
+}
+
+HTMLTagId ColumnarDocument::get_tag_id(node_index node) const
+{
+    return tags[node] < tag_count ? static_cast<HTMLTagId>(tags[node]) : tag_unknown;
+}
+
+const std::wstring &ColumnarDocument::get_title(node_index node) const
+{
+    static const std::wstring no_title;
+
+    if (tags[node] >= tag_count)
+        return unknown_titles[tags[node] - tag_count];
+
+    if (kinds[node] == text_node || tags[node] == tag_unknown)
+        return no_title;
+
+    return HTMLTagRegistry::name(static_cast<HTMLTagId>(tags[node]));
+}
+
+ColumnarDocument::node_index ColumnarDocument::get_first_child(node_index node) const
+{
+    // Children come right after their parent
+    return subtree_ends[node] > node + 1 ? node + 1 : no_node;
+}
+
+const wchar_t *ColumnarDocument::get_text_data(node_index node) const
+{
+    return characters.data() + text_starts[node];
+}
+
+std::wstring ColumnarDocument::get_text(node_index node) const
+{
+    return characters.substr(text_starts[node], text_lengths[node]);
+}
+
+size_t ColumnarDocument::get_attribute_count(node_index node) const
+{
+    return attribute_starts[node + 1] - attribute_starts[node];
+}
+
+std::wstring ColumnarDocument::get_attribute_name(node_index node, size_t attribute) const
+{
+    const string_span &name = attributes[attribute_starts[node] + attribute].name;
+    return characters.substr(name.start, name.length);
+}
+
+std::wstring ColumnarDocument::get_attribute_value(node_index node, size_t attribute) const
+{
+    const string_span &value = attributes[attribute_starts[node] + attribute].value;
+    return characters.substr(value.start, value.length);
+}
+
+size_t ColumnarDocument::find_attribute(node_index node, const std::wstring &attribute_name) const
+{
+    size_t count = get_attribute_count(node);
+
+    for (size_t attribute = 0; attribute < count; attribute++)
+    {
+        if (span_equals(attributes[attribute_starts[node] + attribute].name, attribute_name))
+            return attribute;
+    }
+
+    return count;
+}
+
+bool ColumnarDocument::has_attribute(node_index node, const std::wstring &attribute_name) const
+{
+    return find_attribute(node, attribute_name) < get_attribute_count(node);
+}
+
+std::wstring ColumnarDocument::get_attribute(node_index node,
+        const std::wstring &attribute_name) const
+{
+    size_t attribute = find_attribute(node, attribute_name);
+
+    if (attribute == get_attribute_count(node))
+        return L"";
+    return get_attribute_value(node, attribute);
+}
+
+ColumnarElement ColumnarDocument::get_element(node_index node) const
+{
+    if (node == no_node || node >= kinds.size())
+        return ColumnarElement();
+
+    return ColumnarElement(this, node);
+}
+
+ColumnarElement ColumnarDocument::get_root() const
+{
+    return get_element(0);
+}
+
+size_t ColumnarDocument::get_memory_usage() const
+{
+    size_t bytes = kinds.capacity() * sizeof(node_kind) +
+        tags.capacity() * sizeof(uint32_t) +
+        (parents.capacity() + next_siblings.capacity() + subtree_ends.capacity()) *
+            sizeof(node_index) +
+        (text_starts.capacity() + text_lengths.capacity() +
+            attribute_starts.capacity()) * sizeof(uint32_t) +
+        attributes.capacity() * sizeof(attribute_span) +
+        characters.capacity() * sizeof(wchar_t);
+
+    for (const std::wstring &title : unknown_titles)
+        bytes += sizeof(title) + title.capacity() * sizeof(wchar_t);
+
+    return bytes;
+}
@@ -0,0 +1,111 @@
+#ifndef COLUMNARDOCUMENT_HPP
+#define COLUMNARDOCUMENT_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Document.hpp"
+#include "ColumnarElement.hpp"
+#include "../elements/HTML/HTMLTagRegistry.hpp"
+
+// A read-only copy of a document for passes that look at every node. Each
+// node is an index into parallel arrays, one per property, so a pass that
+// only needs tags reads only the tags. Nodes are numbered in document
+// order: the children of a node come right after it, and its subtree is
+// the range [node, get_subtree_end(node)), so a subtree scan is a sweep
+// over that range. ColumnarElement gives the HTMLElement-style view.
+//
+// Deferred contents (see HTMLParser::set_deferred_parsing) aren't built for
+// the copy, such elements are copied without children.
+class ColumnarDocument
+{
+    public:
+        typedef uint32_t node_index;
+        static const node_index no_node = UINT32_MAX;
+
+        enum node_kind : uint8_t
+        {
+            element_node,
+            text_node
+        };
+
+        ColumnarDocument();
+        explicit ColumnarDocument(const Document &document);
+        // Only the subtree of root
+        explicit ColumnarDocument(const HTMLElement &root);
+
+        size_t get_node_count() const { return kinds.size(); }
+
+        node_kind get_kind(node_index node) const { return kinds[node]; }
+        // tag_unknown for text and for elements not in HTMLTags.def
+        HTMLTagId get_tag_id(node_index node) const;
+        const std::wstring &get_title(node_index node) const;
+
+        node_index get_parent(node_index node) const { return parents[node]; }
+        node_index get_first_child(node_index node) const;
+        node_index get_next_sibling(node_index node) const { return next_siblings[node]; }
+        // One past the last node of the subtree
+        node_index get_subtree_end(node_index node) const { return subtree_ends[node]; }
+
+        // Empty for elements. The length is in wchar_t, not in UTF-16 units
+        // like HTMLElement::get_text_length.
+        const wchar_t *get_text_data(node_index node) const;
+        size_t get_text_length(node_index node) const { return text_lengths[node]; }
+        std::wstring get_text(node_index node) const;
+
+        size_t get_attribute_count(node_index node) const;
+        std::wstring get_attribute_name(node_index node, size_t attribute) const;
+        std::wstring get_attribute_value(node_index node, size_t attribute) const;
+        bool has_attribute(node_index node, const std::wstring &attribute_name) const;
+        std::wstring get_attribute(node_index node, const std::wstring &attribute_name) const;
+
+        ColumnarElement get_element(node_index node) const;
+        // The first top level node, the html element of a document
+        ColumnarElement get_root() const;
+
+        // What the columns and strings take
+        size_t get_memory_usage() const;
+
+    private:
+        struct string_span
+        {
+            uint32_t start;
+            uint32_t length;
+        };
+
+        struct attribute_span
+        {
+            string_span name;
+            string_span value;
+        };
+
+        void add_tree(const HTMLElement &root);
+        node_index add_node(const HTMLElement &element, node_index parent);
+        string_span add_string(const DOMStringView &string);
+        bool span_equals(const string_span &span, const std::wstring &string) const;
+        // Index of the attribute, or get_attribute_count() without one
+        size_t find_attribute(node_index node, const std::wstring &attribute_name) const;
+
+        // The columns
+        std::vector<node_kind> kinds;
+        // HTMLTagId, or tag_count plus the index in unknown_titles
+        std::vector<uint32_t> tags;
+        std::vector<node_index> parents;
+        std::vector<node_index> next_siblings;
+        std::vector<node_index> subtree_ends;
+        std::vector<uint32_t> text_starts;
+        std::vector<uint32_t> text_lengths;
+        // The attributes of node n are [attribute_starts[n],
+        // attribute_starts[n + 1]), there's one more than there are nodes
+        std::vector<uint32_t> attribute_starts;
+
+        std::vector<attribute_span> attributes;
+        // Text and attributes, one after the other
+        std::wstring characters;
+        std::vector<std::wstring> unknown_titles;
+        std::unordered_map<std::wstring, uint32_t> unknown_title_indices;
+};
+
+#endif // COLUMNARDOCUMENT_HPP
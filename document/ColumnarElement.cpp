@@ -0,0 +1,116 @@
+#include "ColumnarElement.hpp"
+#include "ColumnarDocument.hpp"
+
+ColumnarElement::ColumnarElement()
+{
+    document = nullptr;
+    node = ColumnarDocument::no_node;
+}
+
+ColumnarElement::ColumnarElement(const ColumnarDocument *document, uint32_t node)
+{
+    this->document = document;
+    this->node = node;
+}
+
+bool ColumnarElement::is_null() const
+{
+    return document == nullptr;
+}
+
+uint32_t ColumnarElement::get_index() const
+{
+    return node;
+}
+
+bool ColumnarElement::operator==(const ColumnarElement &element) const
+{
+    return document == element.document && node == element.node;
+}
+
+bool ColumnarElement::operator!=(const ColumnarElement &element) const
+{
+    return !(*this == element);
+}
+
+std::wstring ColumnarElement::get_id() const
+{
+    return document->get_attribute(node, L"id");
+}
+
+const std::wstring &ColumnarElement::get_title() const
+{
+    return document->get_title(node);
+}
+
+std::vector<ColumnarElement> ColumnarElement::get_children() const
+{
+    std::vector<ColumnarElement> children;
+
+    for (uint32_t child = document->get_first_child(node);
+            child != ColumnarDocument::no_node; child = document->get_next_sibling(child))
+        children.push_back(ColumnarElement(document, child));
+
+    return children;
+}
+
+ColumnarElement ColumnarElement::get_parent() const
+{
+    return document->get_element(document->get_parent(node));
+}
+
+ColumnarElement ColumnarElement::get_first_child() const
+{
+    return document->get_element(document->get_first_child(node));
+}
+
+ColumnarElement ColumnarElement::get_next_sibling() const
+{
+    return document->get_element(document->get_next_sibling(node));
+}
+
+std::map<std::wstring, std::wstring> ColumnarElement::get_attributes() const
+{
+    std::map<std::wstring, std::wstring> attributes;
+    size_t count = document->get_attribute_count(node);
+
+    for (size_t attribute = 0; attribute < count; attribute++)
+    {
+        attributes[document->get_attribute_name(node, attribute)] =
+            document->get_attribute_value(node, attribute);
+    }
+
+    return attributes;
+}
+
+bool ColumnarElement::has_attribute(const std::wstring &attribute_name) const
+{
+    return document->has_attribute(node, attribute_name);
+}
+
+std::wstring ColumnarElement::get_attribute(const std::wstring &attribute_name) const
+{
+    return document->get_attribute(node, attribute_name);
+}
+
+bool ColumnarElement::is_text_node() const
+{
+    return document->get_kind(node) == ColumnarDocument::text_node;
+}
+
+std::wstring ColumnarElement::get_text() const
+{
+    return document->get_text(node);
+}
+
+size_t ColumnarElement::get_text_length() const
+{
+    // In UTF-16 units like HTMLElement counts, the copy keeps wchar_t
+    return DOMStringView::utf16_length(std::wstring_view(
+                document->get_text_data(node), document->get_text_length(node)));
+}
+
+bool ColumnarElement::is_paragraph_node() const
+{
+    return document->get_tag_id(node) == tag_p;
+}
@@ -0,0 +1,52 @@
+#ifndef COLUMNARELEMENT_HPP
+#define COLUMNARELEMENT_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+class ColumnarDocument;
+
+// A node of a ColumnarDocument with the read side of the HTMLElement
+// functions, for code written against elements. It's only a document and
+// an index, cheap to copy, and valid as long as the document is. A null
+// element stands for "none", like nullptr does for HTMLElement.
+class ColumnarElement
+{
+    public:
+        ColumnarElement();
+        ColumnarElement(const ColumnarDocument *document, uint32_t node);
+
+        bool is_null() const;
+        uint32_t get_index() const;
+        bool operator==(const ColumnarElement &element) const;
+        bool operator!=(const ColumnarElement &element) const;
+
+        std::wstring get_id() const;
+        const std::wstring &get_title() const;
+        std::vector<ColumnarElement> get_children() const;
+
+        ColumnarElement get_parent() const;
+        ColumnarElement get_first_child() const;
+        ColumnarElement get_next_sibling() const;
+
+        // Attribute functions
+        std::map<std::wstring, std::wstring> get_attributes() const;
+        bool has_attribute(const std::wstring &attribute_name) const;
+        std::wstring get_attribute(const std::wstring &attribute_name) const;
+
+        // Text Node functions
+        bool is_text_node() const;
+        std::wstring get_text() const;
+        size_t get_text_length() const;
+
+        // Paragraph Node functions
+        bool is_paragraph_node() const;
+
+    private:
+        const ColumnarDocument *document;
+        uint32_t node;
+};
+
+#endif // COLUMNARELEMENT_HPP
@@ -0,0 +1,119 @@
+#include <algorithm>
+
+#include "DOMArena.hpp"
+
+// Small documents and fragments take one small block, big ones go up to
+// blocks of a few hundred KB
+static const size_t first_block_size = 4 * 1024;
+static const size_t max_block_size = 256 * 1024;
+// The same for text
+static const size_t first_text_block_size = 2 * 1024;
+static const size_t max_text_block_size = 128 * 1024;
+
+DOMArena::DOMArena() : id_index(this)
+{
+    block_size = 0;
+    block_used = 0;
+    allocated_bytes = 0;
+    text_block_size = 0;
+    text_block_used = 0;
+}
+
+DOMArena::~DOMArena()
+{
+    // An element only lets go of what it holds in other arenas, so the
+    // elements don't have to be destroyed in tree order
+    for (HTMLElement *element : elements)
+        element->~HTMLElement();
+
+    // The ones taken in may still be held from outside, they are left
+    // empty and on their own
+    for (const std::shared_ptr<HTMLElement> &element : taken_in)
+        element->leave_arena();
+
+    taken_in.clear();
+}
+
+void *DOMArena::allocate(size_t size, size_t alignment)
+{
+    size_t offset = (block_used + alignment - 1) & ~(alignment - 1);
+
+    if (blocks.empty() || offset + size > block_size)
+    {
+        block_size = blocks.empty() ? first_block_size :
+            std::min(2 * block_size, max_block_size);
+
+        if (block_size < size)
+            block_size = size;
+
+        // new[] aligns for any type, the elements don't need more
+        blocks.emplace_back(new char[block_size]);
+        allocated_bytes += block_size;
+        offset = 0;
+    }
+
+    block_used = offset + size;
+    return blocks.back().get() + offset;
+}
+
+char *DOMArena::allocate_text(size_t size, size_t alignment)
+{
+    size_t offset = (text_block_used + alignment - 1) & ~(alignment - 1);
+
+    if (text_blocks.empty() || offset + size > text_block_size)
+    {
+        text_block_size = text_blocks.empty() ? first_text_block_size :
+            std::min(2 * text_block_size, max_text_block_size);
+
+        if (text_block_size < size)
+            text_block_size = size;
+
+        text_blocks.emplace_back(new char[text_block_size]);
+        allocated_bytes += text_block_size;
+        offset = 0;
+    }
+
+    text_block_used = offset + size;
+    return text_blocks.back().get() + offset;
+}
+
+bool DOMArena::extend_text(const char *text, size_t size, size_t new_size)
+{
+    if (text_blocks.empty() ||
+            text + size != text_blocks.back().get() + text_block_used ||
+            text_block_used - size + new_size > text_block_size)
+        return false;
+
+    text_block_used += new_size - size;
+    return true;
+}
+
+std::shared_ptr<HTMLElement> DOMArena::get_handle(HTMLElement *element)
+{
+    return std::shared_ptr<HTMLElement>(shared_from_this(), element);
+}
+
+void DOMArena::take_in(const std::shared_ptr<HTMLElement> &element)
+{
+    taken_in.push_back(element);
+}
+
+const std::wstring &DOMArena::intern(const std::wstring &name)
+{
+    return *names.insert(name).first;
+}
+
+DOMIdIndex &DOMArena::get_id_index()
+{
+    return id_index;
+}
+
+size_t DOMArena::get_element_count() const
+{
+    return elements.size();
+}
+
+size_t DOMArena::get_allocated_bytes() const
+{
+    return allocated_bytes;
+}
@@ -0,0 +1,95 @@
+#ifndef DOMARENA_HPP
+#define DOMARENA_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+
+#include "../elements/HTML/HTMLElement.hpp"
+#include "DOMIdIndex.hpp"
+
+// Where the elements of a document live. They are carved out of a few big
+// blocks instead of allocated one by one, and all go at once when the
+// arena does. The shared_ptrs handed out for them are handles: they share
+// ownership of the whole arena rather than of the one element, so holding
+// on to any element keeps its document alive.
+class DOMArena : public std::enable_shared_from_this<DOMArena>
+{
+    public:
+        DOMArena();
+        ~DOMArena();
+
+        template <class Element>
+        std::shared_ptr<Element> make_element();
+
+        // In arena when there is one, on its own through std::make_shared
+        // otherwise
+        template <class Element>
+        static std::shared_ptr<Element> make_element(DOMArena *arena);
+
+        // A handle for an element of this arena
+        std::shared_ptr<HTMLElement> get_handle(HTMLElement *element);
+
+        // Holds an element made on its own from the time it's added to an
+        // element of this arena, see HTMLElement::add_child
+        void take_in(const std::shared_ptr<HTMLElement> &element);
+
+        // Room for the text of text nodes, in bytes as text is kept one or
+        // two bytes a character (see HTMLTextElement). Text goes after the
+        // text before it in chunks that never move, so the text of a
+        // document reads as a few runs of memory. extend_text grows the last
+        // text handed out in place, when there's room left for it in its
+        // chunk.
+        char *allocate_text(size_t size, size_t alignment);
+        bool extend_text(const char *text, size_t size, size_t new_size);
+
+        // Tag names that aren't in HTMLTags.def, kept once per document
+        const std::wstring &intern(const std::wstring &name);
+
+        // The elements of this arena by id, kept up to date by the elements
+        DOMIdIndex &get_id_index();
+
+        size_t get_element_count() const;
+        size_t get_allocated_bytes() const;
+
+    private:
+        DOMArena(const DOMArena &) = delete;
+        DOMArena &operator=(const DOMArena &) = delete;
+
+        void *allocate(size_t size, size_t alignment);
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t block_size;
+        size_t block_used;
+        size_t allocated_bytes;
+        std::vector<std::unique_ptr<char[]>> text_blocks;
+        size_t text_block_size;
+        size_t text_block_used;
+        // Destroyed with the arena, in no particular order
+        std::vector<HTMLElement *> elements;
+        std::vector<std::shared_ptr<HTMLElement>> taken_in;
+        std::unordered_set<std::wstring> names;
+        DOMIdIndex id_index;
+};
+
+template <class Element>
+std::shared_ptr<Element> DOMArena::make_element()
+{
+    Element *element = new (allocate(sizeof(Element), alignof(Element))) Element();
+    element->arena = this;
+    elements.push_back(element);
+
+    return std::shared_ptr<Element>(shared_from_this(), element);
+}
+
+template <class Element>
+std::shared_ptr<Element> DOMArena::make_element(DOMArena *arena)
+{
+    if (arena == nullptr)
+        return std::make_shared<Element>();
+
+    return arena->make_element<Element>();
+}
+
+#endif // DOMARENA_HPP
@@ -0,0 +1,184 @@
+#include <algorithm>
+
+#include "DOMIdIndex.hpp"
+#include "../elements/HTML/HTMLElement.hpp"
+
+DOMIdIndex::DOMIdIndex(const DOMArena *owner)
+{
+    arena = owner;
+    moves = 0;
+}
+
+size_t DOMIdIndex::id_hash::operator()(const DOMString &id) const
+{
+    // FNV-1a over the UTF-16 units, the same however the id is stored
+    const DOMStringView view = id.view();
+    size_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < view.size(); i++)
+    {
+        hash ^= view[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+void DOMIdIndex::add_root(HTMLElement *root)
+{
+    roots.push_back(root);
+    connect(root);
+}
+
+void DOMIdIndex::connect(HTMLElement *root)
+{
+    // Elements of other arenas are in the index of theirs, and so is
+    // whatever is under them
+    if (root->arena != arena || root->connected)
+        return;
+
+    for (HTMLElement *node : root->preorder())
+    {
+        if (node->arena != arena || (node != root && !node->parent->connected))
+            continue;
+
+        node->connected = true;
+        add(node->get_id(), node);
+    }
+}
+
+void DOMIdIndex::disconnect(HTMLElement *root)
+{
+    if (!root->connected)
+        return;
+
+    for (HTMLElement *node : root->preorder())
+    {
+        if (!node->connected)
+            continue;
+
+        remove(node->get_id(), node);
+        node->connected = false;
+    }
+}
+
+void DOMIdIndex::reorder()
+{
+    // Most ids are on one element, those never need looking at again
+    moves++;
+}
+
+void DOMIdIndex::add(const DOMStringView &id, HTMLElement *element)
+{
+    // An empty id never matches
+    if (id.empty())
+        return;
+
+    // Ids are nearly always unique, then there's nothing to compare
+    entry &id_entry = ids[DOMString(id)];
+    id_entry.elements.push_back(element);
+    id_entry.first = id_entry.elements.size() == 1 ? element : nullptr;
+}
+
+void DOMIdIndex::remove(const DOMStringView &id, HTMLElement *element)
+{
+    if (id.empty())
+        return;
+
+    std::unordered_map<DOMString, entry, id_hash>::iterator found = ids.find(DOMString(id));
+
+    if (found == ids.end())
+        return;
+
+    entry &id_entry = found->second;
+    std::vector<HTMLElement *> &elements = id_entry.elements;
+    elements.erase(std::remove(elements.begin(), elements.end(), element), elements.end());
+
+    if (elements.empty())
+        ids.erase(found);
+    else if (elements.size() == 1)
+        id_entry.first = elements.front();
+    else if (id_entry.first == element)
+        id_entry.first = nullptr;
+}
+
+HTMLElement *DOMIdIndex::find(std::wstring_view id)
+{
+    if (id.empty())
+        return nullptr;
+
+    std::unordered_map<DOMString, entry, id_hash>::iterator found = ids.find(DOMString(id));
+
+    if (found == ids.end())
+        return nullptr;
+
+    entry &id_entry = found->second;
+
+    if (id_entry.first == nullptr ||
+            (id_entry.elements.size() > 1 && id_entry.moves_seen != moves))
+    {
+        id_entry.first = id_entry.elements.front();
+        id_entry.moves_seen = moves;
+
+        for (HTMLElement *element : id_entry.elements)
+        {
+            if (precedes(element, id_entry.first))
+                id_entry.first = element;
+        }
+    }
+
+    return id_entry.first;
+}
+
+bool DOMIdIndex::precedes(const HTMLElement *element, const HTMLElement *other) const
+{
+    size_t depth = 0;
+    size_t other_depth = 0;
+
+    for (const HTMLElement *node = element->get_parent(); node != nullptr; node = node->get_parent())
+        depth++;
+    for (const HTMLElement *node = other->get_parent(); node != nullptr; node = node->get_parent())
+        other_depth++;
+
+    // Up to the same depth, where an ancestor meets its descendant
+    const bool shallower = depth < other_depth;
+
+    for (; depth > other_depth; depth--)
+        element = element->get_parent();
+    for (; other_depth > depth; other_depth--)
+        other = other->get_parent();
+
+    if (element == other)
+        return shallower;
+
+    // Then up to the children of the same parent, or to the roots
+    while (element->get_parent() != other->get_parent())
+    {
+        element = element->get_parent();
+        other = other->get_parent();
+    }
+
+    if (element->get_parent() == nullptr)
+        return std::find(roots.cbegin(), roots.cend(), element) <
+            std::find(roots.cbegin(), roots.cend(), other);
+
+    // Looking both ways from one of them, so long runs of siblings are only
+    // walked as far as the two are apart
+    const HTMLElement *after = element->get_next_sibling();
+    const HTMLElement *before = element->get_previous_sibling();
+
+    while (after != nullptr || before != nullptr)
+    {
+        if (after == other)
+            return true;
+        if (before == other)
+            return false;
+
+        if (after != nullptr)
+            after = after->get_next_sibling();
+        if (before != nullptr)
+            before = before->get_previous_sibling();
+    }
+
+    return false;
+}
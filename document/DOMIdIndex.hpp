@@ -0,0 +1,68 @@
+#ifndef DOMIDINDEX_HPP
+#define DOMIDINDEX_HPP
+
+#include <vector>
+#include <unordered_map>
+
+#include "DOMString.hpp"
+
+class HTMLElement;
+class DOMArena;
+
+// The elements of a document by their id, for Document::get_element_by_id.
+// Kept by the DOMArena, and only holds the elements of that arena that are
+// in the tree of the document. Elements get in as their subtree is added
+// under one that's in the tree and out as it's taken away again, so a
+// detached element is never looked at. Moving one around inside the tree
+// leaves the index alone. With the same id on several the
+// first one in tree order counts. Which one that is gets worked out at the
+// first lookup after one of them came or went, for that id alone.
+class DOMIdIndex
+{
+    public:
+        explicit DOMIdIndex(const DOMArena *owner);
+
+        // The tops of the trees of the document, see Document::add_element
+        void add_root(HTMLElement *root);
+        // root was just linked under an element in the tree, or is about
+        // to be unlinked from one. Everything under it comes or goes too.
+        void connect(HTMLElement *root);
+        void disconnect(HTMLElement *root);
+        // Something in the tree moved to another place in it. What's in
+        // the index stays, but which of the elements with the same id comes
+        // first has to be worked out again.
+        void reorder();
+        // The id of an element in the tree changes
+        void add(const DOMStringView &id, HTMLElement *element);
+        void remove(const DOMStringView &id, HTMLElement *element);
+
+        HTMLElement *find(std::wstring_view id);
+
+    private:
+        struct id_hash
+        {
+            size_t operator()(const DOMString &id) const;
+        };
+
+        struct entry
+        {
+            // In the tree, in the order they got there
+            std::vector<HTMLElement *> elements;
+            // nullptr until worked out
+            HTMLElement *first;
+            // The value of moves when first was worked out
+            size_t moves_seen;
+        };
+
+        // Tree order, both in the tree
+        bool precedes(const HTMLElement *element, const HTMLElement *other) const;
+
+        const DOMArena *arena;
+        std::unordered_map<DOMString, entry, id_hash> ids;
+        std::vector<const HTMLElement *> roots;
+        // Counts reorder(), a first worked out before the last move may
+        // not be first anymore
+        size_t moves;
+};
+
+#endif // DOMIDINDEX_HPP
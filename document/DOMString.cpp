@@ -0,0 +1,174 @@
+#include <cstring>
+
+#include "DOMString.hpp"
+
+const size_t DOMString::inline_bytes;
+
+DOMString::DOMString()
+{
+    length = 0;
+    wide = false;
+    on_heap = false;
+}
+
+DOMString::DOMString(std::wstring_view string) : DOMString()
+{
+    if (DOMStringView::fits_latin1(string))
+    {
+        char *characters = static_cast<char *>(allocate(string.size(), false));
+
+        for (size_t i = 0; i < string.size(); i++)
+            characters[i] = static_cast<char>(string[i]);
+    }
+    else
+    {
+        DOMStringView::encode_utf16(string, static_cast<char16_t *>(
+            allocate(DOMStringView::utf16_length(string), true)));
+    }
+}
+
+DOMString::DOMString(const std::wstring &string) : DOMString(std::wstring_view(string))
+{
+}
+
+DOMString::DOMString(const wchar_t *string) : DOMString(std::wstring_view(string))
+{
+}
+
+DOMString::DOMString(const DOMStringView &string) : DOMString()
+{
+    const void *characters = string.is_wide() ?
+        static_cast<const void *>(string.utf16_data()) :
+        static_cast<const void *>(string.latin1_data());
+    void *copy = allocate(string.size(), string.is_wide());
+
+    std::memcpy(copy, characters, string.size() * (string.is_wide() ? 2 : 1));
+}
+
+DOMString::DOMString(const DOMString &string) : DOMString(string.view())
+{
+}
+
+DOMString::DOMString(DOMString &&string) noexcept : DOMString()
+{
+    *this = std::move(string);
+}
+
+DOMString::~DOMString()
+{
+    release();
+}
+
+DOMString &DOMString::operator=(const DOMString &string)
+{
+    if (this != &string)
+        *this = DOMString(string.view());
+
+    return *this;
+}
+
+DOMString &DOMString::operator=(DOMString &&string) noexcept
+{
+    if (this == &string)
+        return *this;
+
+    release();
+
+    // The inline bytes are copied whether they're a pointer or characters
+    std::memcpy(inline_data, string.inline_data, inline_bytes);
+    length = string.length;
+    wide = string.wide;
+    on_heap = string.on_heap;
+
+    string.length = 0;
+    string.wide = false;
+    string.on_heap = false;
+    return *this;
+}
+
+void *DOMString::allocate(size_t units, bool wide_units)
+{
+    release();
+
+    size_t bytes = units * (wide_units ? sizeof(char16_t) : 1);
+
+    length = units;
+    wide = wide_units;
+
+    if (bytes <= inline_bytes)
+        return inline_data;
+
+    // new[] aligns for char16_t as well
+    heap.data = new char[bytes];
+    heap.capacity = bytes;
+    on_heap = true;
+    return heap.data;
+}
+
+void DOMString::release()
+{
+    if (on_heap)
+        delete[] static_cast<char *>(heap.data);
+
+    on_heap = false;
+    length = 0;
+}
+
+DOMStringView DOMString::view() const
+{
+    const void *characters = on_heap ? heap.data : inline_data;
+
+    if (wide)
+        return DOMStringView(static_cast<const char16_t *>(characters), length);
+    return DOMStringView(static_cast<const char *>(characters), length);
+}
+
+DOMString::operator DOMStringView() const
+{
+    return view();
+}
+
+size_t DOMString::size() const
+{
+    return length;
+}
+
+bool DOMString::empty() const
+{
+    return length == 0;
+}
+
+bool DOMString::is_wide() const
+{
+    return wide;
+}
+
+std::wstring DOMString::to_wstring() const
+{
+    return view().to_wstring();
+}
+
+std::string DOMString::to_utf8() const
+{
+    return view().to_utf8();
+}
+
+bool DOMString::operator==(const DOMString &string) const
+{
+    return view() == string.view();
+}
+
+bool DOMString::operator!=(const DOMString &string) const
+{
+    return view() != string.view();
+}
+
+bool DOMString::operator<(const DOMString &string) const
+{
+    return view().compare(string.view()) < 0;
+}
+
+size_t DOMString::get_heap_bytes() const
+{
+    return on_heap ? heap.capacity : 0;
+}
@@ -0,0 +1,68 @@
+#ifndef DOMSTRING_HPP
+#define DOMSTRING_HPP
+
+#include <string>
+#include <string_view>
+
+#include "DOMStringView.hpp"
+
+// The strings the DOM keeps, attribute names and values and the like. One
+// byte per character when they all fit in Latin-1, which is nearly always,
+// and UTF-16 only for the strings that need it, like JavaScript engines
+// store theirs. Short strings are kept inline without an allocation.
+//
+// The other functions are those of DOMStringView, see view().
+class DOMString
+{
+    public:
+        DOMString();
+        DOMString(std::wstring_view string);
+        DOMString(const std::wstring &string);
+        DOMString(const wchar_t *string);
+        DOMString(const DOMStringView &string);
+        DOMString(const DOMString &string);
+        DOMString(DOMString &&string) noexcept;
+        ~DOMString();
+
+        DOMString &operator=(const DOMString &string);
+        DOMString &operator=(DOMString &&string) noexcept;
+
+        DOMStringView view() const;
+        operator DOMStringView() const;
+
+        size_t size() const;
+        bool empty() const;
+        bool is_wide() const;
+        std::wstring to_wstring() const;
+        std::string to_utf8() const;
+        bool operator==(const DOMString &string) const;
+        bool operator!=(const DOMString &string) const;
+        bool operator<(const DOMString &string) const;
+
+        // What it takes besides itself
+        size_t get_heap_bytes() const;
+
+    private:
+        // As many bytes as the pointer and a capacity would take
+        static const size_t inline_bytes = 16;
+
+        // Makes room for length units, and drops what was there
+        void *allocate(size_t units, bool wide_units);
+        void release();
+
+        union
+        {
+            struct
+            {
+                void *data;
+                size_t capacity;
+            } heap;
+            alignas(char16_t) char inline_data[inline_bytes];
+        };
+        // In units, as long as a std::wstring can be
+        size_t length;
+        bool wide;
+        bool on_heap;
+};
+
+#endif // DOMSTRING_HPP
@@ -0,0 +1,304 @@
+#include "DOMStringView.hpp"
+
+DOMStringView::DOMStringView()
+{
+    data = "";
+    length = 0;
+    wide = false;
+}
+
+DOMStringView::DOMStringView(const char *latin1_data, size_t length)
+{
+    data = latin1_data;
+    this->length = length;
+    wide = false;
+}
+
+DOMStringView::DOMStringView(const char16_t *utf16_data, size_t length)
+{
+    data = utf16_data;
+    this->length = length;
+    wide = true;
+}
+
+size_t DOMStringView::size() const
+{
+    return length;
+}
+
+bool DOMStringView::empty() const
+{
+    return length == 0;
+}
+
+bool DOMStringView::is_wide() const
+{
+    return wide;
+}
+
+char16_t DOMStringView::operator[](size_t index) const
+{
+    if (wide)
+        return utf16_data()[index];
+
+    return static_cast<unsigned char>(latin1_data()[index]);
+}
+
+const char *DOMStringView::latin1_data() const
+{
+    return static_cast<const char *>(data);
+}
+
+const char16_t *DOMStringView::utf16_data() const
+{
+    return static_cast<const char16_t *>(data);
+}
+
+std::wstring DOMStringView::to_wstring() const
+{
+    std::wstring output;
+    append_to(output);
+    return output;
+}
+
+void DOMStringView::append_to(std::wstring &output) const
+{
+    output.reserve(output.size() + length);
+
+    if (!wide)
+    {
+        const unsigned char *characters = reinterpret_cast<const unsigned char *>(data);
+        output.append(characters, characters + length);
+        return;
+    }
+
+    const char16_t *units = utf16_data();
+
+    for (size_t i = 0; i < length; i++)
+    {
+        // Where wchar_t is UTF-16 already the pairs stay as they are
+        if (sizeof(wchar_t) > 2 && units[i] >= 0xD800 && units[i] < 0xDC00 &&
+                i + 1 < length && units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000)
+        {
+            output.push_back(static_cast<wchar_t>(0x10000 +
+                ((units[i] - 0xD800) << 10) + (units[i + 1] - 0xDC00)));
+            i++;
+        }
+        else
+            output.push_back(static_cast<wchar_t>(units[i]));
+    }
+}
+
+std::string DOMStringView::to_utf8() const
+{
+    std::string output;
+    append_utf8(output);
+    return output;
+}
+
+void DOMStringView::append_utf8(std::string &output) const
+{
+    if (!wide)
+    {
+        // ASCII, most of it, is copied in runs
+        const char *characters = latin1_data();
+        size_t run_start = 0;
+
+        output.reserve(output.size() + length);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            unsigned char character = static_cast<unsigned char>(characters[i]);
+
+            if (character < 0x80)
+                continue;
+
+            output.append(characters + run_start, i - run_start);
+            output.push_back(static_cast<char>(0xC0 | (character >> 6)));
+            output.push_back(static_cast<char>(0x80 | (character & 0x3F)));
+            run_start = i + 1;
+        }
+
+        output.append(characters + run_start, length - run_start);
+        return;
+    }
+
+    const char16_t *units = utf16_data();
+
+    for (size_t i = 0; i < length; i++)
+    {
+        char32_t code_point = units[i];
+
+        if (code_point >= 0xD800 && code_point < 0xDC00 && i + 1 < length &&
+                units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000)
+        {
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (units[i + 1] - 0xDC00);
+            i++;
+        }
+        // A surrogate without its other half has no UTF-8 form
+        else if (code_point >= 0xD800 && code_point < 0xE000)
+            code_point = 0xFFFD;
+
+        if (code_point < 0x80)
+            output.push_back(static_cast<char>(code_point));
+        else if (code_point < 0x800)
+        {
+            output.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+        else if (code_point < 0x10000)
+        {
+            output.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+        else
+        {
+            output.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+}
+
+bool DOMStringView::operator==(const DOMStringView &string) const
+{
+    return compare(string) == 0;
+}
+
+bool DOMStringView::operator!=(const DOMStringView &string) const
+{
+    return compare(string) != 0;
+}
+
+bool DOMStringView::equals(std::wstring_view string) const
+{
+    if (!wide)
+    {
+        if (string.size() != length)
+            return false;
+
+        const unsigned char *characters = reinterpret_cast<const unsigned char *>(data);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            if (static_cast<wchar_t>(characters[i]) != string[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    const char16_t *units = utf16_data();
+    size_t unit = 0;
+
+    for (wchar_t character : string)
+    {
+        char16_t encoded[2];
+        size_t count = encode_utf16(std::wstring_view(&character, 1), encoded);
+
+        if (unit + count > length)
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (units[unit++] != encoded[i])
+                return false;
+        }
+    }
+
+    return unit == length;
+}
+
+int DOMStringView::compare(const DOMStringView &string) const
+{
+    size_t common = length < string.length ? length : string.length;
+
+    for (size_t i = 0; i < common; i++)
+    {
+        char16_t first = (*this)[i];
+        char16_t second = string[i];
+
+        if (first != second)
+            return first < second ? -1 : 1;
+    }
+
+    if (length == string.length)
+        return 0;
+    return length < string.length ? -1 : 1;
+}
+
+bool DOMStringView::fits_latin1(std::wstring_view string)
+{
+    for (wchar_t character : string)
+    {
+        if (static_cast<unsigned long>(character) > 0xFF)
+            return false;
+    }
+
+    return true;
+}
+
+size_t DOMStringView::utf16_length(std::wstring_view string)
+{
+    size_t units = string.size();
+
+    if (sizeof(wchar_t) > 2)
+    {
+        for (wchar_t character : string)
+        {
+            unsigned long code_point = static_cast<unsigned long>(character);
+
+            if (code_point > 0xFFFF && code_point <= 0x10FFFF)
+                units++;
+        }
+    }
+
+    return units;
+}
+
+size_t DOMStringView::encode_utf16(std::wstring_view string, char16_t *output)
+{
+    char16_t *start = output;
+
+    for (wchar_t character : string)
+    {
+        unsigned long code_point = static_cast<unsigned long>(character);
+
+        // Past the last code point, where wchar_t can go that far
+        if (code_point > 0x10FFFF)
+            code_point = 0xFFFD;
+
+        if (code_point > 0xFFFF)
+        {
+            code_point -= 0x10000;
+            *output++ = static_cast<char16_t>(0xD800 + (code_point >> 10));
+            *output++ = static_cast<char16_t>(0xDC00 + (code_point & 0x3FF));
+        }
+        else
+            *output++ = static_cast<char16_t>(code_point);
+    }
+
+    return output - start;
+}
+
+bool operator==(const DOMStringView &string, std::wstring_view other)
+{
+    return string.equals(other);
+}
+
+bool operator==(std::wstring_view string, const DOMStringView &other)
+{
+    return other.equals(string);
+}
+
+bool operator!=(const DOMStringView &string, std::wstring_view other)
+{
+    return !string.equals(other);
+}
+
+bool operator!=(std::wstring_view string, const DOMStringView &other)
+{
+    return !other.equals(string);
+}
@@ -0,0 +1,57 @@
+#ifndef DOMSTRINGVIEW_HPP
+#define DOMSTRINGVIEW_HPP
+
+#include <string>
+#include <string_view>
+
+// A look at the characters of a DOM string, stored either one byte per
+// character when they all fit in Latin-1, or as UTF-16. Lengths and
+// indexes are in those units, like the DOM counts them. Only valid as long
+// as what it looks at, see DOMString.
+class DOMStringView
+{
+    public:
+        DOMStringView();
+        DOMStringView(const char *latin1_data, size_t length);
+        DOMStringView(const char16_t *utf16_data, size_t length);
+
+        size_t size() const;
+        bool empty() const;
+        bool is_wide() const;
+        char16_t operator[](size_t index) const;
+
+        // Only the one of the two that matches is_wide()
+        const char *latin1_data() const;
+        const char16_t *utf16_data() const;
+
+        std::wstring to_wstring() const;
+        void append_to(std::wstring &output) const;
+        std::string to_utf8() const;
+        void append_utf8(std::string &output) const;
+
+        // Same characters, however they are stored
+        bool operator==(const DOMStringView &string) const;
+        bool operator!=(const DOMStringView &string) const;
+        bool equals(std::wstring_view string) const;
+        // Ordered by UTF-16 code unit
+        int compare(const DOMStringView &string) const;
+
+        // Whether every character of string fits in Latin-1, and how many
+        // UTF-16 units it takes when it doesn't
+        static bool fits_latin1(std::wstring_view string);
+        static size_t utf16_length(std::wstring_view string);
+        // Writes string out as UTF-16, returns the units written
+        static size_t encode_utf16(std::wstring_view string, char16_t *output);
+
+    private:
+        const void *data;
+        size_t length;
+        bool wide;
+};
+
+bool operator==(const DOMStringView &string, std::wstring_view other);
+bool operator==(std::wstring_view string, const DOMStringView &other);
+bool operator!=(const DOMStringView &string, std::wstring_view other);
+bool operator!=(std::wstring_view string, const DOMStringView &other);
+
+#endif // DOMSTRINGVIEW_HPP
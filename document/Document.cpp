@@ -1,4 +1,5 @@
 #include "Document.hpp"
+#include "../parsers/HTML/HTMLParserStatistics.hpp"
 
 Document::Document() : doc_type(L"")
 {
@@ -8,6 +9,7 @@ Document::Document() : doc_type(L"")
 void Document::add_element(const std::shared_ptr<HTMLElement> &element)
 {
     elements.push_back(element);
+    get_arena()->get_id_index().add_root(element.get());
 }
 
 DocumentType Document::get_document_type() const
@@ -15,11 +17,21 @@ DocumentType Document::get_document_type() const
     return doc_type;
 }
 
-std::list<std::shared_ptr<HTMLElement>> Document::get_elements() const
+const std::list<std::shared_ptr<HTMLElement>> &Document::get_elements() const
 {
     return elements;
 }
 
+std::shared_ptr<HTMLElement> Document::get_element_by_id(const std::wstring &id) const
+{
+    if (arena == nullptr)
+        return nullptr;
+
+    HTMLElement *element = arena->get_id_index().find(id);
+
+    return element != nullptr ? element->get_handle() : nullptr;
+}
+
 void Document::set_quirks_mode(bool quirks)
 {
     quirks_mode = quirks;
@@ -29,3 +41,22 @@ void Document::set_document_type(const std::wstring &type)
 {
     doc_type.set_name(type);
 }
+
+DOMArena *Document::get_arena()
+{
+    // Only made once something goes in, many documents stay empty
+    if (arena == nullptr)
+        arena = std::make_shared<DOMArena>();
+
+    return arena.get();
+}
+
+const HTMLParserStatistics *Document::get_parser_statistics() const
+{
+    return parser_statistics.get();
+}
+
+void Document::set_parser_statistics(const HTMLParserStatistics &statistics)
+{
+    parser_statistics = std::make_shared<HTMLParserStatistics>(statistics);
+}
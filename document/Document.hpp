@@ -6,22 +6,40 @@
 
 #include "DocumentType.hpp"
 #include "../elements/HTML/HTMLElement.hpp"
+#include "DOMArena.hpp"
+
+struct HTMLParserStatistics;
 
 class Document
 {
     public:
         Document();
         void add_element(const std::shared_ptr<HTMLElement> &element);
-        std::list<std::shared_ptr<HTMLElement>> get_elements() const;
+        const std::list<std::shared_ptr<HTMLElement>> &get_elements() const;
+        // The first element in tree order with that id, nullptr without
+        // one. Only finds the elements made by this document, not the ones
+        // added to it from another one.
+        std::shared_ptr<HTMLElement> get_element_by_id(const std::wstring &id) const;
         DocumentType get_document_type() const;
         void set_quirks_mode(bool quirks);
         bool requires_quirks_mode();
         void set_document_type(const std::wstring &type);
 
+        // The elements of the document are made here, and stay alive as
+        // long as the document or a handle to one of them is around
+        DOMArena *get_arena();
+
+        // What the tree builder counted while it made the document, nullptr
+        // unless the parser was compiled with PARSER_STATISTICS
+        const HTMLParserStatistics *get_parser_statistics() const;
+        void set_parser_statistics(const HTMLParserStatistics &statistics);
+
     protected:
         std::list<std::shared_ptr<HTMLElement>> elements;
+        std::shared_ptr<DOMArena> arena;
         DocumentType doc_type;
         bool quirks_mode;
+        std::shared_ptr<const HTMLParserStatistics> parser_statistics;
 };
 
 #endif // DOCUMENT_HPP
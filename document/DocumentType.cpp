@@ -7,7 +7,7 @@ DocumentType::DocumentType(const std::wstring &type_name)
 
 std::wstring DocumentType::get_name() const
 {
-    return name;
+    return name.to_wstring();
 }
 
 void DocumentType::set_name(const std::wstring &type_name)
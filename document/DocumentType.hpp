@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "DOMString.hpp"
+
 class DocumentType
 {
     public:
@@ -11,7 +13,7 @@ class DocumentType
         void set_name(const std::wstring &type_name);
 
     protected:
-        std::wstring name;
+        DOMString name;
 };
 
 #endif // DOCUMENTTYPE_HPP
@@ -0,0 +1,22 @@
+#include "NodeFilter.hpp"
+
+NodeFilter::NodeFilter(unsigned what_to_show, filter_callback callback)
+{
+    this->what_to_show = what_to_show;
+    this->callback = callback;
+}
+
+NodeFilter::filter_result NodeFilter::accept(const HTMLElement &node) const
+{
+    const unsigned kind = node.is_text_node() ? show_text : show_element;
+
+    if ((what_to_show & kind) == 0)
+        return filter_skip;
+
+    return callback != nullptr ? callback(node) : filter_accept;
+}
+
+unsigned NodeFilter::get_what_to_show() const
+{
+    return what_to_show;
+}
@@ -0,0 +1,41 @@
+#ifndef NODEFILTER_HPP
+#define NODEFILTER_HPP
+
+#include <functional>
+
+#include "../elements/HTML/HTMLElement.hpp"
+
+// What TreeWalker and NodeIterator stop at, like the DOM's whatToShow and
+// NodeFilter: the kinds of node to show, and a callback that can skip a
+// node, or with TreeWalker reject it with everything under it.
+class NodeFilter
+{
+    public:
+        // The values of the DOM's SHOW_* constants
+        enum show_flag : unsigned
+        {
+            show_element = 0x1,
+            show_text = 0x4,
+            show_all = 0xFFFFFFFF
+        };
+
+        enum filter_result
+        {
+            filter_accept = 1,
+            filter_reject = 2,
+            filter_skip = 3
+        };
+
+        typedef std::function<filter_result (const HTMLElement &node)> filter_callback;
+
+        NodeFilter(unsigned what_to_show = show_all, filter_callback callback = nullptr);
+
+        filter_result accept(const HTMLElement &node) const;
+        unsigned get_what_to_show() const;
+
+    private:
+        unsigned what_to_show;
+        filter_callback callback;
+};
+
+#endif // NODEFILTER_HPP
@@ -0,0 +1,81 @@
+#include "NodeIterator.hpp"
+
+NodeIterator::NodeIterator(HTMLElement *root, const NodeFilter &filter) : filter(filter)
+{
+    this->root = root;
+    reference_node = root;
+    pointer_before_reference_node = true;
+}
+
+HTMLElement *NodeIterator::get_root() const
+{
+    return root;
+}
+
+const NodeFilter &NodeIterator::get_filter() const
+{
+    return filter;
+}
+
+HTMLElement *NodeIterator::get_reference_node() const
+{
+    return reference_node;
+}
+
+bool NodeIterator::get_pointer_before_reference_node() const
+{
+    return pointer_before_reference_node;
+}
+
+HTMLElement *NodeIterator::next_node()
+{
+    return traverse(true);
+}
+
+HTMLElement *NodeIterator::previous_node()
+{
+    return traverse(false);
+}
+
+HTMLElement *NodeIterator::traverse(bool next)
+{
+    HTMLElement *node = reference_node;
+    bool before_node = pointer_before_reference_node;
+
+    while (true)
+    {
+        // Turning around gives back the reference node first
+        if (next)
+        {
+            if (!before_node)
+            {
+                node = HTMLElement::next_in_preorder(node, root);
+
+                if (node == nullptr)
+                    return nullptr;
+            }
+            else
+                before_node = false;
+        }
+        else
+        {
+            if (before_node)
+            {
+                node = HTMLElement::previous_in_preorder(node, root);
+
+                if (node == nullptr)
+                    return nullptr;
+            }
+            else
+                before_node = true;
+        }
+
+        if (filter.accept(*node) == NodeFilter::filter_accept)
+            break;
+    }
+
+    reference_node = node;
+    pointer_before_reference_node = before_node;
+
+    return node;
+}
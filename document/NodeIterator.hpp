@@ -0,0 +1,35 @@
+#ifndef NODEITERATOR_HPP
+#define NODEITERATOR_HPP
+
+#include "NodeFilter.hpp"
+
+// The DOM's NodeIterator: the nodes under root the filter accepts, in
+// document order, from either direction. Rejecting a node only skips it
+// here, unlike with TreeWalker. Steps are HTMLElement::next_in_preorder()
+// and previous_in_preorder(), so nothing is copied or counted and root has
+// to outlive it. There are no removal steps, the reference node has to
+// stay in the tree.
+class NodeIterator
+{
+    public:
+        NodeIterator(HTMLElement *root, const NodeFilter &filter = NodeFilter());
+
+        HTMLElement *get_root() const;
+        const NodeFilter &get_filter() const;
+        HTMLElement *get_reference_node() const;
+        bool get_pointer_before_reference_node() const;
+
+        // nullptr once there's nothing further that way
+        HTMLElement *next_node();
+        HTMLElement *previous_node();
+
+    private:
+        HTMLElement *traverse(bool next);
+
+        HTMLElement *root;
+        HTMLElement *reference_node;
+        bool pointer_before_reference_node;
+        NodeFilter filter;
+};
+
+#endif // NODEITERATOR_HPP
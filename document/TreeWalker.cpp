@@ -0,0 +1,247 @@
+#include "TreeWalker.hpp"
+
+TreeWalker::TreeWalker(HTMLElement *root, const NodeFilter &filter) : filter(filter)
+{
+    this->root = root;
+    current_node = root;
+}
+
+HTMLElement *TreeWalker::get_root() const
+{
+    return root;
+}
+
+const NodeFilter &TreeWalker::get_filter() const
+{
+    return filter;
+}
+
+HTMLElement *TreeWalker::get_current_node() const
+{
+    return current_node;
+}
+
+void TreeWalker::set_current_node(HTMLElement *node)
+{
+    current_node = node;
+}
+
+HTMLElement *TreeWalker::parent_node()
+{
+    HTMLElement *node = current_node;
+
+    while (node != nullptr && node != root)
+    {
+        node = node->get_parent();
+
+        if (node != nullptr && filter.accept(*node) == NodeFilter::filter_accept)
+        {
+            current_node = node;
+            return node;
+        }
+    }
+
+    return nullptr;
+}
+
+HTMLElement *TreeWalker::first_child()
+{
+    return traverse_children(true);
+}
+
+HTMLElement *TreeWalker::last_child()
+{
+    return traverse_children(false);
+}
+
+HTMLElement *TreeWalker::previous_sibling()
+{
+    return traverse_siblings(false);
+}
+
+HTMLElement *TreeWalker::next_sibling()
+{
+    return traverse_siblings(true);
+}
+
+HTMLElement *TreeWalker::traverse_children(bool first)
+{
+    HTMLElement *node = first ? current_node->get_first_child() : current_node->get_last_child();
+
+    while (node != nullptr)
+    {
+        NodeFilter::filter_result result = filter.accept(*node);
+
+        if (result == NodeFilter::filter_accept)
+        {
+            current_node = node;
+            return node;
+        }
+
+        // Skipped nodes still show what's under them
+        if (result == NodeFilter::filter_skip)
+        {
+            HTMLElement *child = first ? node->get_first_child() : node->get_last_child();
+
+            if (child != nullptr)
+            {
+                node = child;
+                continue;
+            }
+        }
+
+        // Otherwise on to the next sibling, climbing out of skipped nodes
+        // until one has it
+        while (node != nullptr)
+        {
+            HTMLElement *sibling = first ? node->get_next_sibling() : node->get_previous_sibling();
+
+            if (sibling != nullptr)
+            {
+                node = sibling;
+                break;
+            }
+
+            HTMLElement *parent = node->get_parent();
+
+            if (parent == nullptr || parent == root || parent == current_node)
+                return nullptr;
+
+            node = parent;
+        }
+    }
+
+    return nullptr;
+}
+
+HTMLElement *TreeWalker::traverse_siblings(bool next)
+{
+    HTMLElement *node = current_node;
+
+    if (node == root)
+        return nullptr;
+
+    while (true)
+    {
+        HTMLElement *sibling = next ? node->get_next_sibling() : node->get_previous_sibling();
+
+        while (sibling != nullptr)
+        {
+            node = sibling;
+            NodeFilter::filter_result result = filter.accept(*node);
+
+            if (result == NodeFilter::filter_accept)
+            {
+                current_node = node;
+                return node;
+            }
+
+            // Into a skipped node, from its end that faces this way
+            sibling = next ? node->get_first_child() : node->get_last_child();
+
+            if (result == NodeFilter::filter_reject || sibling == nullptr)
+                sibling = next ? node->get_next_sibling() : node->get_previous_sibling();
+        }
+
+        // Out of a skipped parent, but not past one that's shown
+        node = node->get_parent();
+
+        if (node == nullptr || node == root)
+            return nullptr;
+
+        if (filter.accept(*node) == NodeFilter::filter_accept)
+            return nullptr;
+    }
+}
+
+HTMLElement *TreeWalker::previous_node()
+{
+    HTMLElement *node = current_node;
+
+    while (node != root)
+    {
+        HTMLElement *sibling = node->get_previous_sibling();
+
+        while (sibling != nullptr)
+        {
+            // The last shown node under the previous sibling
+            node = sibling;
+            NodeFilter::filter_result result = filter.accept(*node);
+
+            while (result != NodeFilter::filter_reject && node->get_last_child() != nullptr)
+            {
+                node = node->get_last_child();
+                result = filter.accept(*node);
+            }
+
+            if (result == NodeFilter::filter_accept)
+            {
+                current_node = node;
+                return node;
+            }
+
+            sibling = node->get_previous_sibling();
+        }
+
+        if (node == root || node->get_parent() == nullptr)
+            return nullptr;
+
+        node = node->get_parent();
+
+        if (filter.accept(*node) == NodeFilter::filter_accept)
+        {
+            current_node = node;
+            return node;
+        }
+    }
+
+    return nullptr;
+}
+
+HTMLElement *TreeWalker::next_node()
+{
+    HTMLElement *node = current_node;
+    NodeFilter::filter_result result = NodeFilter::filter_accept;
+
+    while (true)
+    {
+        // Down, unless what's below was rejected
+        while (result != NodeFilter::filter_reject && node->get_first_child() != nullptr)
+        {
+            node = node->get_first_child();
+            result = filter.accept(*node);
+
+            if (result == NodeFilter::filter_accept)
+            {
+                current_node = node;
+                return node;
+            }
+        }
+
+        // Then along, or up and along, without leaving root
+        HTMLElement *sibling = nullptr;
+
+        for (HTMLElement *ancestor = node; ancestor != nullptr; ancestor = ancestor->get_parent())
+        {
+            if (ancestor == root)
+                return nullptr;
+
+            sibling = ancestor->get_next_sibling();
+
+            if (sibling != nullptr)
+                break;
+        }
+
+        if (sibling == nullptr)
+            return nullptr;
+
+        node = sibling;
+        result = filter.accept(*node);
+
+        if (result == NodeFilter::filter_accept)
+        {
+            current_node = node;
+            return node;
+        }
+    }
+}
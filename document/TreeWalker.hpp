@@ -0,0 +1,39 @@
+#ifndef TREEWALKER_HPP
+#define TREEWALKER_HPP
+
+#include "NodeFilter.hpp"
+
+// The DOM's TreeWalker over the elements and text under root, moving one
+// current node around the tree and seeing only what the filter accepts.
+// It steps over the links of the tree like HTMLElement::preorder() does,
+// so nothing is copied or counted, and root has to outlive it. The tree
+// may change between steps as long as the current node stays in it.
+class TreeWalker
+{
+    public:
+        TreeWalker(HTMLElement *root, const NodeFilter &filter = NodeFilter());
+
+        HTMLElement *get_root() const;
+        const NodeFilter &get_filter() const;
+        HTMLElement *get_current_node() const;
+        void set_current_node(HTMLElement *node);
+
+        // Each returns the node it moved to, or nullptr and stays put
+        HTMLElement *parent_node();
+        HTMLElement *first_child();
+        HTMLElement *last_child();
+        HTMLElement *previous_sibling();
+        HTMLElement *next_sibling();
+        HTMLElement *previous_node();
+        HTMLElement *next_node();
+
+    private:
+        HTMLElement *traverse_children(bool first);
+        HTMLElement *traverse_siblings(bool next);
+
+        HTMLElement *root;
+        HTMLElement *current_node;
+        NodeFilter filter;
+};
+
+#endif // TREEWALKER_HPP
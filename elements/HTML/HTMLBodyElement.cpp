@@ -2,5 +2,5 @@
 
 HTMLBodyElement::HTMLBodyElement()
 {
-    title = L"body";
+    set_title(L"body");
 }
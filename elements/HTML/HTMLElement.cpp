@@ -1,53 +1,601 @@
+#include <algorithm>
+
 #include "HTMLElement.hpp"
+#include "HTMLTagRegistry.hpp"
+#include "../../document/DOMArena.hpp"
+
+struct HTMLElement::rare_data
+{
+    rare_data()
+    {
+        source = source_range{false, 0, 0, 0, false, false};
+    }
+
+    source_range source;
+    std::shared_ptr<const deferred_content> deferred;
+    // The links don't keep a child alive, the arena does. Children from
+    // another arena, and all children of an element made on its own, are
+    // held on to here instead.
+    std::vector<std::shared_ptr<HTMLElement>> adopted_children;
+    // What an element made on its own is held by once it's been added to
+    // another, see get_handle
+    std::weak_ptr<HTMLElement> self;
+    // A title that's neither in HTMLTags.def nor in an arena
+    std::wstring own_title;
+};
+
+static const std::wstring empty_string;
 
 HTMLElement::HTMLElement()
 {
-    child_nodes = {};
-    id = L"";
-    title = L"";
+    title = &empty_string;
+    tag_id = tag_unknown;
+    connected = false;
+    parent = nullptr;
+    first_child = nullptr;
+    last_child = nullptr;
+    next_sibling = nullptr;
+    previous_sibling = nullptr;
+    arena = nullptr;
 }
 
 HTMLElement::~HTMLElement()
 {
-    //dtor
+    release_children();
+}
+
+void HTMLElement::release_children()
+{
+    // Children from the same arena go with it and aren't touched. The
+    // others lose their parent, and the ones nobody else holds are taken
+    // apart here, as letting the shared_ptrs go one level at a time would
+    // recurse as deep as the tree is.
+    first_child = nullptr;
+    last_child = nullptr;
+
+    if (rare == nullptr || rare->adopted_children.empty())
+        return;
+
+    std::vector<std::shared_ptr<HTMLElement>> pending;
+    pending.swap(rare->adopted_children);
+
+    while (!pending.empty())
+    {
+        std::shared_ptr<HTMLElement> child = std::move(pending.back());
+        pending.pop_back();
+
+        child->parent = nullptr;
+        child->next_sibling = nullptr;
+        child->previous_sibling = nullptr;
+
+        if (child.use_count() > 1 || child->rare == nullptr)
+            continue;
+
+        for (std::shared_ptr<HTMLElement> &grandchild : child->rare->adopted_children)
+        {
+            if (grandchild->parent == child.get())
+                pending.push_back(std::move(grandchild));
+        }
+
+        child->rare->adopted_children.clear();
+        child->first_child = nullptr;
+        child->last_child = nullptr;
+    }
+}
+
+void HTMLElement::move_into_arena(const std::shared_ptr<HTMLElement> &element)
+{
+    // Were they to keep holding the children from this arena, the arena
+    // would hold itself and never go
+    std::vector<std::shared_ptr<HTMLElement>> pending(1, element);
+
+    while (!pending.empty())
+    {
+        std::shared_ptr<HTMLElement> current = std::move(pending.back());
+        pending.pop_back();
+
+        current->arena = arena;
+        arena->take_in(current);
+
+        if (current->rare == nullptr)
+            continue;
+
+        std::vector<std::shared_ptr<HTMLElement>> &held = current->rare->adopted_children;
+        size_t kept = 0;
+
+        for (std::shared_ptr<HTMLElement> &child : held)
+        {
+            if (child->arena == nullptr)
+                pending.push_back(std::move(child));
+            else if (child->arena != arena)
+                held[kept++] = std::move(child);
+        }
+
+        held.resize(kept);
+    }
+}
+
+void HTMLElement::leave_arena()
+{
+    // The rest of the tree is gone already, what's left is an empty
+    // element of its own
+    release_children();
+    parent = nullptr;
+    next_sibling = nullptr;
+    previous_sibling = nullptr;
+
+    // The title may be one the arena kept
+    arena = nullptr;
+    connected = false;
+    set_title(std::wstring(*title));
 }
 
-HTMLElement::HTMLElement(const HTMLElement &element)
+HTMLElement::HTMLElement(const HTMLElement &element) : HTMLElement()
 {
-    child_nodes = element.child_nodes;
-    id = element.id;
-    title = element.title;
+    // The copy stands on its own, without the children and without a
+    // place in the source
+    set_title(element.get_title());
+
+    if (element.attributes != nullptr)
+        attributes.reset(new std::vector<attribute>(*element.attributes));
+
+    if (element.rare != nullptr && element.rare->deferred != nullptr)
+        get_rare_data().deferred = element.rare->deferred;
 }
 
-std::wstring HTMLElement::get_title() const
+HTMLElement::rare_data &HTMLElement::get_rare_data()
 {
-    return title;
+    if (rare == nullptr)
+        rare.reset(new rare_data());
+
+    return *rare;
 }
 
-std::wstring HTMLElement::get_id() const
+const std::wstring &HTMLElement::get_title() const
 {
-    return id;
+    return *title;
+}
+
+HTMLTagId HTMLElement::get_tag_id() const
+{
+    return tag_id;
+}
+
+DOMStringView HTMLElement::get_id() const
+{
+    size_t index = find_attribute(L"id");
+
+    return index < get_attribute_count() ? get_attribute_value(index) : DOMStringView();
 }
 
 void HTMLElement::add_child(const std::shared_ptr<HTMLElement> child_node)
 {
-    child_nodes.push_back(std::move(child_node));
+    HTMLElement *child = child_node.get();
+
+    // Moved from one place in the tree of the document to another, it stays
+    // in the index and only the order of what's in there changes
+    const bool moved_in_tree = connected && child->connected &&
+        child->parent != nullptr && child->arena == arena;
+
+    // A node can only have one parent, so take it away from the old one
+    if (moved_in_tree)
+        child->parent->unlink_child(child);
+    else if (child->parent != nullptr)
+        child->parent->remove_child(child);
+
+    child->parent = this;
+    child->previous_sibling = last_child;
+    child->next_sibling = nullptr;
+
+    if (last_child != nullptr)
+        last_child->next_sibling = child;
+    else
+        first_child = child;
+
+    last_child = child;
+
+    if (arena != nullptr && child->arena == nullptr)
+        move_into_arena(child_node);
+    else if (arena == nullptr || child->arena != arena)
+    {
+        if (child->arena == nullptr)
+            child->get_rare_data().self = child_node;
+
+        get_rare_data().adopted_children.push_back(std::move(child_node));
+    }
+
+    if (moved_in_tree)
+        arena->get_id_index().reorder();
+    else if (connected)
+        arena->get_id_index().connect(child);
+}
+
+void HTMLElement::unlink_child(HTMLElement *child_node)
+{
+    if (child_node->previous_sibling != nullptr)
+        child_node->previous_sibling->next_sibling = child_node->next_sibling;
+    else
+        first_child = child_node->next_sibling;
+
+    if (child_node->next_sibling != nullptr)
+        child_node->next_sibling->previous_sibling = child_node->previous_sibling;
+    else
+        last_child = child_node->previous_sibling;
+
+    child_node->parent = nullptr;
+    child_node->next_sibling = nullptr;
+    child_node->previous_sibling = nullptr;
+}
+
+void HTMLElement::remove_child(const HTMLElement *child_node)
+{
+    if (child_node->parent != this)
+        return;
+
+    HTMLElement *child = const_cast<HTMLElement *>(child_node);
+
+    if (child->connected)
+        child->arena->get_id_index().disconnect(child);
+
+    unlink_child(child);
+
+    if (arena != nullptr && child->arena == arena)
+        return;
+
+    // Last, this may be what kept the child alive
+    std::vector<std::shared_ptr<HTMLElement>> &adopted = rare->adopted_children;
+
+    for (std::vector<std::shared_ptr<HTMLElement>>::iterator it =
+            adopted.begin(); it != adopted.end(); it++)
+    {
+        if (it->get() == child)
+        {
+            adopted.erase(it);
+            return;
+        }
+    }
+}
+
+void HTMLElement::move_children_to(const std::shared_ptr<HTMLElement> &new_parent)
+{
+    while (first_child != nullptr)
+        new_parent->add_child(first_child->get_handle());
+}
+
+std::vector<std::shared_ptr<HTMLElement>> HTMLElement::take_children()
+{
+    std::vector<std::shared_ptr<HTMLElement>> children = get_children();
+
+    for (const std::shared_ptr<HTMLElement> &child : children)
+    {
+        if (child->connected)
+            child->arena->get_id_index().disconnect(child.get());
+
+        child->parent = nullptr;
+        child->next_sibling = nullptr;
+        child->previous_sibling = nullptr;
+    }
+
+    first_child = nullptr;
+    last_child = nullptr;
+
+    if (rare != nullptr)
+        rare->adopted_children.clear();
+
+    return children;
 }
 
 std::vector<std::shared_ptr<HTMLElement>> HTMLElement::get_children() const
 {
-    return child_nodes;
+    std::vector<std::shared_ptr<HTMLElement>> children;
+
+    for (HTMLElement *child = first_child; child != nullptr; child = child->next_sibling)
+        children.push_back(child->get_handle());
+
+    return children;
+}
+
+std::shared_ptr<HTMLElement> HTMLElement::get_handle() const
+{
+    HTMLElement *element = const_cast<HTMLElement *>(this);
+
+    if (arena != nullptr)
+        return arena->get_handle(element);
+
+    // On its own, the parent it was added to shares it
+    return rare != nullptr ? rare->self.lock() : nullptr;
+}
+
+HTMLElement *HTMLElement::get_parent() const
+{
+    return parent;
+}
+
+HTMLElement *HTMLElement::get_first_child() const
+{
+    return first_child;
+}
+
+HTMLElement *HTMLElement::get_last_child() const
+{
+    return last_child;
+}
+
+HTMLElement *HTMLElement::get_next_sibling() const
+{
+    return next_sibling;
+}
+
+HTMLElement *HTMLElement::get_previous_sibling() const
+{
+    return previous_sibling;
+}
+
+HTMLElement::walk_iterator &HTMLElement::walk_iterator::operator++()
+{
+    if (order == child_order)
+        node = node->next_sibling;
+    else if (order == preorder_walk)
+        node = next_in_preorder(node, root);
+    else
+        node = next_in_postorder(node, root);
+
+    return *this;
+}
+
+HTMLElement::walk_range HTMLElement::children() const
+{
+    return walk_range(first_child, this, child_order);
+}
+
+HTMLElement::walk_range HTMLElement::preorder() const
+{
+    return walk_range(const_cast<HTMLElement *>(this), this, preorder_walk);
+}
+
+HTMLElement::walk_range HTMLElement::postorder() const
+{
+    return walk_range(first_in_postorder(this), this, postorder_walk);
+}
+
+HTMLElement *HTMLElement::next_in_preorder(const HTMLElement *node, const HTMLElement *root)
+{
+    if (node->first_child != nullptr)
+        return node->first_child;
+
+    // Up to the first ancestor with a sibling after it, within root
+    while (node != root)
+    {
+        if (node->next_sibling != nullptr)
+            return node->next_sibling;
+
+        node = node->parent;
+    }
+
+    return nullptr;
+}
+
+HTMLElement *HTMLElement::previous_in_preorder(const HTMLElement *node, const HTMLElement *root)
+{
+    if (node == root)
+        return nullptr;
+
+    // The last node under the previous sibling, or the parent
+    HTMLElement *previous = node->previous_sibling;
+
+    if (previous == nullptr)
+        return node->parent;
+
+    while (previous->last_child != nullptr)
+        previous = previous->last_child;
+
+    return previous;
+}
+
+HTMLElement *HTMLElement::first_in_postorder(const HTMLElement *root)
+{
+    HTMLElement *node = const_cast<HTMLElement *>(root);
+
+    while (node->first_child != nullptr)
+        node = node->first_child;
+
+    return node;
+}
+
+HTMLElement *HTMLElement::next_in_postorder(const HTMLElement *node, const HTMLElement *root)
+{
+    if (node == root)
+        return nullptr;
+
+    if (node->next_sibling != nullptr)
+        return first_in_postorder(node->next_sibling);
+
+    return node->parent;
+}
+
+HTMLElement::source_range &HTMLElement::get_source_range()
+{
+    return get_rare_data().source;
+}
+
+const HTMLElement::source_range &HTMLElement::get_source_range() const
+{
+    static const source_range untracked = {false, 0, 0, 0, false, false};
+
+    return rare != nullptr ? rare->source : untracked;
+}
+
+bool HTMLElement::is_source_tracked() const
+{
+    return rare != nullptr && rare->source.tracked;
+}
+
+bool HTMLElement::has_deferred_content() const
+{
+    return rare != nullptr && rare->deferred != nullptr;
+}
+
+void HTMLElement::set_deferred_content(const std::shared_ptr<const deferred_content> &content)
+{
+    get_rare_data().deferred = content;
+}
+
+std::vector<std::shared_ptr<HTMLElement>> HTMLElement::get_content()
+{
+    if (has_deferred_content())
+    {
+        std::shared_ptr<const deferred_content> content = std::move(rare->deferred);
+        rare->deferred = nullptr;
+
+        for (const std::shared_ptr<HTMLElement> &child : content->build(*this))
+            add_child(child);
+    }
+
+    return get_children();
 }
 
 void HTMLElement::set_title(const std::wstring &element_title)
 {
-    title = element_title;
+    // Known tags share the name in the tag table, the others are kept once
+    // per document
+    tag_id = HTMLTagRegistry::lookup(element_title);
+
+    if (tag_id != tag_unknown)
+        title = &HTMLTagRegistry::name(tag_id);
+
+    else if (element_title.empty())
+        title = &empty_string;
+
+    else if (arena != nullptr)
+        title = &arena->intern(element_title);
+
+    else
+    {
+        get_rare_data().own_title = element_title;
+        title = &rare->own_title;
+    }
 }
 
 void HTMLElement::add_text(std::shared_ptr<HTMLElement> text_node)
 {
-    if (child_nodes.size() > 0 && child_nodes.back()->is_text_node())
-        child_nodes.back()->add_char(text_node->get_text());
+    if (last_child != nullptr && last_child->is_text_node())
+        last_child->add_char(text_node->get_text());
     else
         add_child(text_node);
 }
+
+std::map<std::wstring, std::wstring> HTMLElement::get_attributes() const
+{
+    std::map<std::wstring, std::wstring> attribute_map;
+
+    for (size_t index = 0; index < get_attribute_count(); index++)
+    {
+        attribute_map.emplace(get_attribute_name(index).to_wstring(),
+            get_attribute_value(index).to_wstring());
+    }
+
+    return attribute_map;
+}
+
+size_t HTMLElement::get_attribute_count() const
+{
+    return attributes != nullptr ? attributes->size() : 0;
+}
+
+DOMStringView HTMLElement::get_attribute_name(size_t index) const
+{
+    return (*attributes)[index].name;
+}
+
+DOMStringView HTMLElement::get_attribute_value(size_t index) const
+{
+    return (*attributes)[index].value;
+}
+
+bool HTMLElement::has_same_attributes(const HTMLElement &element) const
+{
+    if (get_attribute_count() != element.get_attribute_count())
+        return false;
+
+    // Both are in order of their names
+    for (size_t index = 0; index < get_attribute_count(); index++)
+    {
+        if ((*attributes)[index].name != (*element.attributes)[index].name ||
+                (*attributes)[index].value != (*element.attributes)[index].value)
+            return false;
+    }
+
+    return true;
+}
+
+size_t HTMLElement::find_attribute(std::wstring_view attribute_name) const
+{
+    size_t count = get_attribute_count();
+
+    if (count == 0)
+        return 0;
+
+    size_t index = find_attribute_position(DOMString(attribute_name));
+
+    if (index < count && (*attributes)[index].name.view() == attribute_name)
+        return index;
+    return count;
+}
+
+size_t HTMLElement::find_attribute_position(const DOMString &attribute_name) const
+{
+    // Where an attribute of that name is, or would go
+    std::vector<attribute>::const_iterator position = std::lower_bound(
+        attributes->begin(), attributes->end(), attribute_name,
+        [](const attribute &existing, const DOMString &name)
+        {
+            return existing.name < name;
+        });
+
+    return position - attributes->begin();
+}
+
+bool HTMLElement::has_attribute(const std::wstring &attribute_name) const
+{
+    return find_attribute(attribute_name) < get_attribute_count();
+}
+
+std::wstring HTMLElement::get_attribute(const std::wstring &attribute_name) const
+{
+    size_t index = find_attribute(attribute_name);
+
+    if (index == get_attribute_count())
+        return L"";
+    return get_attribute_value(index).to_wstring();
+}
+
+void HTMLElement::set_attribute(const std::wstring &attribute_name,
+        const std::wstring &attribute_value)
+{
+    // The document finds the element by its id, see DOMIdIndex
+    const bool indexed = connected && attribute_name == L"id";
+
+    if (indexed)
+        arena->get_id_index().remove(get_id(), this);
+
+    if (attributes == nullptr)
+        attributes.reset(new std::vector<attribute>());
+
+    DOMString name(attribute_name);
+    size_t index = find_attribute_position(name);
+
+    if (index < attributes->size() && (*attributes)[index].name == name)
+        (*attributes)[index].value = attribute_value;
+    else
+    {
+        attribute new_attribute;
+        new_attribute.name = std::move(name);
+        new_attribute.value = attribute_value;
+
+        // The parser sets them in order, so this is nearly always the end
+        attributes->insert(attributes->begin() + index, std::move(new_attribute));
+    }
+
+    if (indexed)
+        arena->get_id_index().add(get_id(), this);
+}
@@ -2,36 +2,210 @@
 #define HTMLELEMENT_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
 #include <memory>
 
+#include "HTMLTagId.hpp"
+#include "../../document/DOMString.hpp"
+
+class DOMArena;
+
+// Elements are linked to their parent and siblings directly, and are owned
+// by the DOMArena of their document. The shared_ptrs to them are handles
+// that keep that whole arena alive, see DOMArena. Elements made on their
+// own with std::make_shared work too, they hold on to their children
+// until they are added to an element of a document, which takes them in.
 class HTMLElement
 {
     public:
         HTMLElement();
         HTMLElement(const HTMLElement &element);
         virtual ~HTMLElement();
-        std::wstring get_id() const;
-        std::wstring get_title() const;
+        DOMStringView get_id() const;
+        const std::wstring &get_title() const;
+        // The row of HTMLTags.def the title is in, tag_unknown if it's not
+        HTMLTagId get_tag_id() const;
         void set_title(const std::wstring &element_title);
         void add_child(const std::shared_ptr<HTMLElement> child_node);
+        void remove_child(const HTMLElement *child_node);
+        void move_children_to(const std::shared_ptr<HTMLElement> &new_parent);
+        std::vector<std::shared_ptr<HTMLElement>> take_children();
+        // Handles to the children, children() below only walks them
         std::vector<std::shared_ptr<HTMLElement>> get_children() const;
         void add_text(const std::shared_ptr<HTMLElement> text_node);
 
+        // Walking the tree without making handles. The pointers stay valid
+        // as long as the document does.
+        HTMLElement *get_parent() const;
+        HTMLElement *get_first_child() const;
+        HTMLElement *get_last_child() const;
+        HTMLElement *get_next_sibling() const;
+        HTMLElement *get_previous_sibling() const;
+
+        // The same in range-for loops, with no copies, no reference counts,
+        // no recursion and nothing allocated. The tree must not change
+        // while a walk is on.
+        enum walk_order
+        {
+            child_order,
+            // This element and everything under it, parents first...
+            preorder_walk,
+            // ...or children first
+            postorder_walk
+        };
+
+        class walk_iterator
+        {
+            public:
+                walk_iterator(HTMLElement *node, const HTMLElement *root, walk_order order) :
+                    node(node), root(root), order(order) {}
+
+                HTMLElement *operator*() const { return node; }
+                bool operator!=(const walk_iterator &other) const { return node != other.node; }
+                bool operator==(const walk_iterator &other) const { return node == other.node; }
+                walk_iterator &operator++();
+
+            private:
+                HTMLElement *node;
+                const HTMLElement *root;
+                walk_order order;
+        };
+
+        class walk_range
+        {
+            public:
+                walk_range(HTMLElement *first, const HTMLElement *root, walk_order order) :
+                    first(first), root(root), order(order) {}
+
+                walk_iterator begin() const { return walk_iterator(first, root, order); }
+                walk_iterator end() const { return walk_iterator(nullptr, root, order); }
+
+            private:
+                HTMLElement *first;
+                const HTMLElement *root;
+                walk_order order;
+        };
+
+        walk_range children() const;
+        walk_range preorder() const;
+        walk_range postorder() const;
+
+        // The steps the walks take, nullptr once they'd leave root
+        static HTMLElement *next_in_preorder(const HTMLElement *node, const HTMLElement *root);
+        static HTMLElement *previous_in_preorder(const HTMLElement *node, const HTMLElement *root);
+        static HTMLElement *first_in_postorder(const HTMLElement *root);
+        static HTMLElement *next_in_postorder(const HTMLElement *node, const HTMLElement *root);
+
+        // nullptr for an element made on its own that was never added to
+        // another, there's no handle to share then
+        std::shared_ptr<HTMLElement> get_handle() const;
+
+        // Attribute functions. They are kept in order of their names,
+        // get_attributes() copies them out for code that wants a map.
+        std::map<std::wstring, std::wstring> get_attributes() const;
+        size_t get_attribute_count() const;
+        DOMStringView get_attribute_name(size_t index) const;
+        DOMStringView get_attribute_value(size_t index) const;
+        bool has_same_attributes(const HTMLElement &element) const;
+        bool has_attribute(const std::wstring &attribute_name) const;
+        std::wstring get_attribute(const std::wstring &attribute_name) const;
+        void set_attribute(const std::wstring &attribute_name,
+                const std::wstring &attribute_value);
+
+        // Where the element came from in the source, only filled in when
+        // the parser tracks source positions (see HTMLParser::reparse)
+        struct source_range
+        {
+            bool tracked;
+            // Relative to the start of the parent, absolute without one
+            long long start;
+            // Both relative to start and only valid when reparsable
+            size_t content_start;
+            size_t content_length;
+            // Opened in a context that lets its contents parse on their own
+            bool clean_start;
+            // ...and closed by its own end tag without leaving anything behind
+            bool reparsable;
+        };
+
+        // The first makes room for a source range if there's none yet
+        source_range &get_source_range();
+        const source_range &get_source_range() const;
+        bool is_source_tracked() const;
+
+        // Contents left to build on first access, see
+        // HTMLParser::set_deferred_parsing. Whoever deferred them knows how
+        // to build them, get_content() asks the first time and returns the
+        // children whether they were deferred or not.
+        class deferred_content
+        {
+            public:
+                virtual ~deferred_content() {}
+                // The children of element
+                virtual std::vector<std::shared_ptr<HTMLElement>>
+                    build(const HTMLElement &element) const = 0;
+        };
+
+        bool has_deferred_content() const;
+        void set_deferred_content(const std::shared_ptr<const deferred_content> &content);
+        std::vector<std::shared_ptr<HTMLElement>> get_content();
+
         // Text Node functions
         virtual bool is_text_node() const { return false; };
         virtual void add_char(const wchar_t &next_char) {};
-        virtual void add_char(const std::wstring &next_char) {};
+        virtual void add_char(std::wstring_view next_chars) {};
+        virtual void add_char(const DOMStringView &next_chars) {};
         virtual wchar_t get_char() const { return L'\0'; };
-        virtual std::wstring get_text() const { return L""; };
+        // Valid until the text node changes or its document goes
+        virtual DOMStringView get_text() const { return DOMStringView(); };
+        virtual size_t get_text_length() const { return 0; };
 
         // Paragraph Node functions
         virtual bool is_paragraph_node() const { return false; };
 
     protected:
-        std::wstring id;
-        std::wstring title;
-        std::vector<std::shared_ptr<HTMLElement>> child_nodes;
+        friend class DOMArena;
+        friend class DOMIdIndex;
+        friend class HTMLTagRegistry;
+
+        // What most elements never need, kept out of the way
+        struct rare_data;
+        rare_data &get_rare_data();
+        void unlink_child(HTMLElement *child_node);
+        // The index of the attribute, or get_attribute_count() without it
+        size_t find_attribute(std::wstring_view attribute_name) const;
+        size_t find_attribute_position(const DOMString &attribute_name) const;
+        // Hands an element made on its own, and those made on their own
+        // under it, over to the arena of this one
+        void move_into_arena(const std::shared_ptr<HTMLElement> &element);
+        // Lets go of the children held here, without a parent afterwards
+        void release_children();
+        // For the elements taken in, when their arena goes before them
+        virtual void leave_arena();
+
+        // Shared by all elements of the same name, see set_title
+        const std::wstring *title;
+        HTMLTagId tag_id;
+        // In the tree of the document of its arena, see DOMIdIndex
+        bool connected;
+        struct attribute
+        {
+            DOMString name;
+            DOMString value;
+        };
+
+        // Only there once the element has attributes
+        std::unique_ptr<std::vector<attribute>> attributes;
+        HTMLElement *parent;
+        HTMLElement *first_child;
+        HTMLElement *last_child;
+        HTMLElement *next_sibling;
+        HTMLElement *previous_sibling;
+        // nullptr when made on its own
+        DOMArena *arena;
+        std::unique_ptr<rare_data> rare;
 };
 
 #endif // HTMLELEMENT_HPP
@@ -2,5 +2,5 @@
 
 HTMLHeadElement::HTMLHeadElement()
 {
-    title = L"head";
+    set_title(L"head");
 }
@@ -2,7 +2,7 @@
 
 HTMLParagraphElement::HTMLParagraphElement()
 {
-    title = L"p";
+    set_title(L"p");
 }
 
 bool HTMLParagraphElement::is_paragraph_node() const
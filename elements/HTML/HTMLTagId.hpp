@@ -0,0 +1,25 @@
+#ifndef HTMLTAGID_HPP
+#define HTMLTAGID_HPP
+
+// One ID per row of HTMLTags.def, tag_unknown for everything else. Elements
+// and tokens carry theirs, so the parser compares and indexes by them
+// instead of by name (see HTMLTagRegistry).
+enum HTMLTagId : unsigned short
+{
+    tag_unknown,
+#define HTML_TAG(identifier, tag_name, interface_name, element_class, flags, text) \
+    tag_##identifier,
+#include "HTMLTags.def"
+    tag_count
+};
+
+// One ID per row of HTMLInterfaces.def
+enum HTMLInterfaceId : unsigned short
+{
+#define HTML_INTERFACE(interface_name) \
+    interface_##interface_name,
+#include "HTMLInterfaces.def"
+    interface_count
+};
+
+#endif // HTMLTAGID_HPP
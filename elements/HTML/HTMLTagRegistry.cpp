@@ -0,0 +1,94 @@
+#include <unordered_map>
+#include <vector>
+
+#include "HTMLBodyElement.hpp"
+#include "HTMLHeadElement.hpp"
+#include "HTMLParagraphElement.hpp"
+#include "HTMLTagRegistry.hpp"
+#include "../../document/DOMArena.hpp"
+
+template <class Element>
+static std::shared_ptr<HTMLElement> make_element(DOMArena *arena)
+{
+    return DOMArena::make_element<Element>(arena);
+}
+
+const HTMLTagRegistry::tag_info HTMLTagRegistry::tags[tag_count] = {
+    {L"", interface_HTMLUnknownElement, 0, normal_text},
+#define HTML_TAG(identifier, tag_name, interface_name, element_class, flags, text) \
+    {tag_name, interface_##interface_name, flags, text},
+#include "HTMLTags.def"
+};
+
+const HTMLTagRegistry::element_factory HTMLTagRegistry::factories[tag_count] = {
+    make_element<HTMLElement>,
+#define HTML_TAG(identifier, tag_name, interface_name, element_class, flags, text) \
+    make_element<element_class>,
+#include "HTMLTags.def"
+};
+
+HTMLTagId HTMLTagRegistry::lookup(const std::wstring &tag_name)
+{
+    static const std::unordered_map<std::wstring, HTMLTagId> tag_ids = []()
+    {
+        std::unordered_map<std::wstring, HTMLTagId> ids;
+
+        for (int i = tag_unknown + 1; i < tag_count; i++)
+            ids.emplace(tags[i].tag_name, static_cast<HTMLTagId>(i));
+
+        return ids;
+    }();
+
+    std::unordered_map<std::wstring, HTMLTagId>::const_iterator found =
+        tag_ids.find(tag_name);
+
+    return found != tag_ids.cend() ? found->second : tag_unknown;
+}
+
+const std::wstring &HTMLTagRegistry::name(HTMLTagId tag_id)
+{
+    static const std::vector<std::wstring> names = []()
+    {
+        std::vector<std::wstring> tag_names;
+
+        for (int i = tag_unknown; i < tag_count; i++)
+            tag_names.emplace_back(tags[i].tag_name);
+
+        return tag_names;
+    }();
+
+    return names[tag_id];
+}
+
+const char *HTMLTagRegistry::interface_name(HTMLInterfaceId interface_id)
+{
+    static const char *const names[interface_count] = {
+#define HTML_INTERFACE(interface_name) \
+        #interface_name,
+#include "HTMLInterfaces.def"
+    };
+
+    return names[interface_id];
+}
+
+std::shared_ptr<HTMLElement> HTMLTagRegistry::create_element(DOMArena *arena,
+        HTMLTagId tag_id, const std::wstring &tag_name)
+{
+    std::shared_ptr<HTMLElement> element = factories[tag_id](arena);
+    set_tag(*element, tag_id, tag_name);
+
+    return element;
+}
+
+void HTMLTagRegistry::set_tag(HTMLElement &element, HTMLTagId tag_id,
+        const std::wstring &tag_name)
+{
+    if (tag_id == tag_unknown)
+        element.set_title(tag_name);
+
+    else
+    {
+        element.title = &name(tag_id);
+        element.tag_id = tag_id;
+    }
+}
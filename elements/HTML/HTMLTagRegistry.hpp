@@ -0,0 +1,81 @@
+#ifndef HTMLTAGREGISTRY_HPP
+#define HTMLTAGREGISTRY_HPP
+
+#include <string>
+#include <memory>
+
+#include "HTMLTagId.hpp"
+#include "HTMLElement.hpp"
+
+class DOMArena;
+
+// What the parser knows about each HTML element, generated from
+// HTMLTags.def. Looking a tag name up is one hash lookup, everything after
+// that (groups, interface, text kind, creating the element) is indexed by
+// the ID.
+class HTMLTagRegistry
+{
+    public:
+        enum tag_flag
+        {
+            formatting_tag = 1 << 0,
+            special_tag = 1 << 1,
+            void_tag = 1 << 2,
+            closes_p = 1 << 3,
+            implied_end = 1 << 4,
+            scope_boundary = 1 << 5,
+            heading_tag = 1 << 6
+        };
+
+        // How the tokenizer reads the contents of the element
+        enum text_kind
+        {
+            normal_text,
+            rcdata_text,
+            rawtext_text,
+            script_text,
+            plaintext_text
+        };
+
+        struct tag_info
+        {
+            const wchar_t *tag_name;
+            HTMLInterfaceId interface_id;
+            unsigned flags;
+            text_kind text;
+        };
+
+        static HTMLTagId lookup(const std::wstring &tag_name);
+        static const tag_info &info(HTMLTagId tag_id);
+        // The tag name as a string every element of the kind can share
+        static const std::wstring &name(HTMLTagId tag_id);
+        static const char *interface_name(HTMLInterfaceId interface_id);
+        // Whether the tag has any of the tag_flag bits in flags
+        static bool has_flag(HTMLTagId tag_id, unsigned flags);
+
+        // tag_name is only used for tag_unknown, known tags get theirs from
+        // the table. Made in arena, or on its own without one.
+        static std::shared_ptr<HTMLElement> create_element(DOMArena *arena,
+                HTMLTagId tag_id, const std::wstring &tag_name);
+        // Gives an element made before another tag, the same way
+        static void set_tag(HTMLElement &element, HTMLTagId tag_id,
+                const std::wstring &tag_name);
+
+    private:
+        typedef std::shared_ptr<HTMLElement> (*element_factory)(DOMArena *arena);
+
+        static const tag_info tags[tag_count];
+        static const element_factory factories[tag_count];
+};
+
+inline const HTMLTagRegistry::tag_info &HTMLTagRegistry::info(HTMLTagId tag_id)
+{
+    return tags[tag_id];
+}
+
+inline bool HTMLTagRegistry::has_flag(HTMLTagId tag_id, unsigned flags)
+{
+    return (tags[tag_id].flags & flags) != 0;
+}
+
+#endif // HTMLTAGREGISTRY_HPP
@@ -1,9 +1,32 @@
+#include <algorithm>
+#include <cstring>
+
 #include "HTMLTextElement.hpp"
+#include "../../document/DOMArena.hpp"
 
 HTMLTextElement::HTMLTextElement()
 {
-    title = L"";
-    text = L"";
+    text = nullptr;
+    text_length = 0;
+    text_capacity = 0;
+    wide = false;
+    owns_text = false;
+}
+
+HTMLTextElement::HTMLTextElement(const HTMLTextElement &element) : HTMLElement(element)
+{
+    text = nullptr;
+    text_length = 0;
+    text_capacity = 0;
+    wide = false;
+    owns_text = false;
+    add_char(element.get_text());
+}
+
+HTMLTextElement::~HTMLTextElement()
+{
+    if (owns_text)
+        delete[] text;
 }
 
 bool HTMLTextElement::is_text_node() const
@@ -11,17 +34,134 @@ bool HTMLTextElement::is_text_node() const
     return true;
 }
 
-std::wstring HTMLTextElement::get_text() const
+DOMStringView HTMLTextElement::get_text() const
+{
+    if (text == nullptr)
+        return DOMStringView();
+
+    if (wide)
+        return DOMStringView(reinterpret_cast<const char16_t *>(text), text_length);
+    return DOMStringView(text, text_length);
+}
+
+size_t HTMLTextElement::get_text_length() const
 {
-    return text;
+    return text_length;
+}
+
+char *HTMLTextElement::make_room(size_t added, bool needs_wide)
+{
+    const size_t unit_size = needs_wide ? sizeof(char16_t) : 1;
+    const size_t length = text_length + added;
+
+    if (needs_wide == wide && length <= text_capacity)
+        return nullptr;
+
+    // Grown in place, as the last text of the arena
+    if (needs_wide == wide && arena != nullptr && !owns_text &&
+            arena->extend_text(text, text_capacity * unit_size, length * unit_size))
+    {
+        text_capacity = length;
+        return nullptr;
+    }
+
+    // Moved, with room to grow again if it did already
+    size_t capacity = text_capacity == 0 ? length : std::max(length, 2 * text_capacity);
+    char *old_text = text;
+    char *moved_text;
+
+    if (arena != nullptr)
+        moved_text = arena->allocate_text(capacity * unit_size, unit_size);
+    else
+        moved_text = new char[capacity * unit_size];
+
+    if (needs_wide && !wide)
+    {
+        char16_t *units = reinterpret_cast<char16_t *>(moved_text);
+
+        for (size_t i = 0; i < text_length; i++)
+            units[i] = static_cast<unsigned char>(old_text[i]);
+    }
+    else if (text_length != 0)
+        std::memcpy(moved_text, old_text, text_length * unit_size);
+
+    const bool owned_old_text = owns_text;
+
+    text = moved_text;
+    text_capacity = capacity;
+    wide = needs_wide;
+    owns_text = arena == nullptr;
+
+    return owned_old_text ? old_text : nullptr;
 }
 
 void HTMLTextElement::add_char(const wchar_t &next_char)
 {
-    text.push_back(next_char);
+    add_char(std::wstring_view(&next_char, 1));
+}
+
+void HTMLTextElement::add_char(std::wstring_view next_chars)
+{
+    if (next_chars.empty())
+        return;
+
+    const bool needs_wide = wide || !DOMStringView::fits_latin1(next_chars);
+    const size_t added = needs_wide ?
+        DOMStringView::utf16_length(next_chars) : next_chars.size();
+    char *old_text = make_room(added, needs_wide);
+
+    if (wide)
+        DOMStringView::encode_utf16(next_chars,
+            reinterpret_cast<char16_t *>(text) + text_length);
+    else
+    {
+        for (size_t i = 0; i < next_chars.size(); i++)
+            text[text_length + i] = static_cast<char>(next_chars[i]);
+    }
+
+    text_length += added;
+    delete[] old_text;
+}
+
+void HTMLTextElement::add_char(const DOMStringView &next_chars)
+{
+    if (next_chars.empty())
+        return;
+
+    // next_chars may be this node's own text, so the old buffer goes last
+    char *old_text = make_room(next_chars.size(), wide || next_chars.is_wide());
+
+    if (!wide)
+        std::memcpy(text + text_length, next_chars.latin1_data(), next_chars.size());
+
+    else if (next_chars.is_wide())
+        std::memcpy(reinterpret_cast<char16_t *>(text) + text_length,
+            next_chars.utf16_data(), next_chars.size() * sizeof(char16_t));
+
+    else
+    {
+        char16_t *units = reinterpret_cast<char16_t *>(text) + text_length;
+
+        for (size_t i = 0; i < next_chars.size(); i++)
+            units[i] = next_chars[i];
+    }
+
+    text_length += next_chars.size();
+    delete[] old_text;
 }
 
-void HTMLTextElement::add_char(const std::wstring &next_char)
+void HTMLTextElement::leave_arena()
 {
-    text += next_char;
+    if (!owns_text && text_length != 0)
+    {
+        const size_t size = text_length * (wide ? sizeof(char16_t) : 1);
+        char *own_text = new char[size];
+        std::memcpy(own_text, text, size);
+
+        text = own_text;
+        text_capacity = text_length;
+        owns_text = true;
+    }
+
+    HTMLElement::leave_arena();
 }
@@ -8,13 +8,34 @@ class HTMLTextElement : public HTMLElement
 {
     public:
         HTMLTextElement();
+        HTMLTextElement(const HTMLTextElement &element);
+        ~HTMLTextElement();
         bool is_text_node() const;
         void add_char(const wchar_t &next_char);
-        void add_char(const std::wstring &next_char);
-        std::wstring get_text() const;
+        void add_char(std::wstring_view next_chars);
+        void add_char(const DOMStringView &next_chars);
+        DOMStringView get_text() const;
+        size_t get_text_length() const;
 
     protected:
-        std::wstring text;
+        HTMLTextElement &operator=(const HTMLTextElement &) = delete;
+
+        // The text has to move out before the arena goes
+        void leave_arena();
+        // Makes room for added more units, in UTF-16 from now on when
+        // needs_wide. Returns the old buffer if the text moved and it's for
+        // this node to free, once what's added has been copied.
+        char *make_room(size_t added, bool needs_wide);
+
+        // In the text of the arena, or a buffer of its own for a node made
+        // on its own. Latin-1 until a character that doesn't fit comes, then
+        // UTF-16, see DOMString.
+        char *text;
+        // In units of that
+        size_t text_length;
+        size_t text_capacity;
+        bool wide;
+        bool owns_text;
 };
 
 #endif // HTMLTEXTELEMENT_HPP
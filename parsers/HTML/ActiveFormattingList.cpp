@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <functional>
+
+#include "ActiveFormattingList.hpp"
+
+ActiveFormattingList::ActiveFormattingList()
+    : used_slots(0), marker_count(0)
+{
+    // Deeply misnested pages rarely need more than this
+    entries.reserve(16);
+    signature_counts.assign(64, {0, 0, false});
+}
+
+void ActiveFormattingList::push(const std::shared_ptr<HTMLElement> &element,
+        const std::shared_ptr<HTMLToken> &token)
+{
+    entry new_entry = {element, token, compute_signature(*token, marker_count),
+        marker_count};
+
+    // Noah's Ark clause: at most three identical elements after the
+    // last marker, the earliest one goes if a fourth one shows up
+    if (find_count(new_entry.signature) >= 3)
+    {
+        size_t matches = 0;
+        size_t earliest = npos;
+
+        for (size_t i = entries.size(); i > 0 && matches < 3; i--)
+        {
+            const entry &current = entries[i - 1];
+
+            if (current.element == nullptr)
+                break;
+
+            if (current.signature == new_entry.signature &&
+                    same_element_kind(current, new_entry))
+            {
+                matches++;
+                earliest = i - 1;
+            }
+        }
+
+        if (matches >= 3)
+        {
+            count_entry(entries[earliest], -1);
+            entries.erase(entries.begin() + earliest);
+        }
+    }
+
+    count_entry(new_entry, 1);
+    entries.push_back(std::move(new_entry));
+}
+
+void ActiveFormattingList::insert_marker()
+{
+    marker_count++;
+    entries.push_back({nullptr, nullptr, 0, marker_count});
+}
+
+void ActiveFormattingList::clear_to_last_marker()
+{
+    while (!entries.empty())
+    {
+        const entry &last = entries.back();
+
+        if (last.element == nullptr)
+        {
+            entries.pop_back();
+            marker_count--;
+            break;
+        }
+
+        count_entry(last, -1);
+        entries.pop_back();
+    }
+}
+
+void ActiveFormattingList::clear()
+{
+    // Keeps the capacity for the next document
+    entries.clear();
+    std::fill(signature_counts.begin(), signature_counts.end(), signature_slot{0, 0, false});
+    used_slots = 0;
+    marker_count = 0;
+}
+
+bool ActiveFormattingList::empty() const
+{
+    return entries.empty();
+}
+
+size_t ActiveFormattingList::size() const
+{
+    return entries.size();
+}
+
+bool ActiveFormattingList::is_marker(size_t index) const
+{
+    return entries[index].element == nullptr;
+}
+
+const std::shared_ptr<HTMLElement> &ActiveFormattingList::element_at(size_t index) const
+{
+    return entries[index].element;
+}
+
+const std::shared_ptr<HTMLToken> &ActiveFormattingList::token_at(size_t index) const
+{
+    return entries[index].token;
+}
+
+size_t ActiveFormattingList::index_of(const HTMLElement *element) const
+{
+    for (size_t i = entries.size(); i > 0; i--)
+    {
+        if (entries[i - 1].element.get() == element)
+            return i - 1;
+    }
+
+    return npos;
+}
+
+size_t ActiveFormattingList::find_after_last_marker(HTMLTagId tag_id) const
+{
+    if (!has_after_last_marker(tag_id))
+        return npos;
+
+    for (size_t i = entries.size(); i > 0; i--)
+    {
+        const entry &current = entries[i - 1];
+
+        if (current.element == nullptr)
+            return npos;
+
+        if (current.element->get_tag_id() == tag_id)
+            return i - 1;
+    }
+
+    return npos;
+}
+
+bool ActiveFormattingList::has_after_last_marker(HTMLTagId tag_id) const
+{
+    return find_count(tag_key(tag_id, marker_count)) > 0;
+}
+
+void ActiveFormattingList::insert_at(size_t index,
+        const std::shared_ptr<HTMLElement> &element,
+        const std::shared_ptr<HTMLToken> &token)
+{
+    const unsigned int depth = index > 0 ? entries[index - 1].depth : 0;
+    entry new_entry = {element, token, compute_signature(*token, depth), depth};
+
+    count_entry(new_entry, 1);
+    entries.insert(entries.begin() + index, std::move(new_entry));
+}
+
+void ActiveFormattingList::replace_at(size_t index,
+        const std::shared_ptr<HTMLElement> &element)
+{
+    // Replacements are clones of the old element, so the signature holds
+    entries[index].element = element;
+}
+
+void ActiveFormattingList::remove_at(size_t index)
+{
+    // Only ever an element, removing a marker would change the signatures
+    // of the entries after it
+    count_entry(entries[index], -1);
+    entries.erase(entries.begin() + index);
+}
+
+size_t ActiveFormattingList::tag_key(HTMLTagId tag_id, unsigned int depth)
+{
+    // Apart from the signatures of elements without attributes by the
+    // extra bit. Should one with attributes hash to the same, a count is
+    // too high, which only costs a look at the entries.
+    return tag_id | 0x8000 | static_cast<size_t>(depth) << 16;
+}
+
+void ActiveFormattingList::count_entry(const entry &counted, int change)
+{
+    count_of(counted.signature) += change;
+    count_of(tag_key(counted.element->get_tag_id(), counted.depth)) += change;
+}
+
+unsigned int &ActiveFormattingList::count_of(size_t signature)
+{
+    // Linear probing, the table size is a power of two and at most three
+    // quarters of it are in use
+    const size_t mask = signature_counts.size() - 1;
+    size_t index = signature & mask;
+
+    while (signature_counts[index].used)
+    {
+        if (signature_counts[index].signature == signature)
+            return signature_counts[index].count;
+
+        index = (index + 1) & mask;
+    }
+
+    if ((used_slots + 1) * 4 > signature_counts.size() * 3)
+    {
+        grow_signature_counts();
+        return count_of(signature);
+    }
+
+    used_slots++;
+    signature_counts[index] = {signature, 0, true};
+
+    return signature_counts[index].count;
+}
+
+unsigned int ActiveFormattingList::find_count(size_t signature) const
+{
+    const size_t mask = signature_counts.size() - 1;
+    size_t index = signature & mask;
+
+    while (signature_counts[index].used)
+    {
+        if (signature_counts[index].signature == signature)
+            return signature_counts[index].count;
+
+        index = (index + 1) & mask;
+    }
+
+    return 0;
+}
+
+void ActiveFormattingList::grow_signature_counts()
+{
+    // Slots that went back to 0 are dropped, so the table only grows when
+    // that many different elements are actually in the list
+    std::vector<signature_slot> old_slots;
+    old_slots.swap(signature_counts);
+
+    size_t live_slots = 0;
+
+    for (const signature_slot &slot : old_slots)
+    {
+        if (slot.count > 0)
+            live_slots++;
+    }
+
+    size_t new_size = old_slots.size();
+
+    while (live_slots * 2 >= new_size)
+        new_size *= 2;
+
+    signature_counts.assign(new_size, {0, 0, false});
+    used_slots = 0;
+
+    for (const signature_slot &slot : old_slots)
+    {
+        if (slot.count > 0)
+            count_of(slot.signature) = slot.count;
+    }
+}
+
+size_t ActiveFormattingList::compute_signature(const HTMLToken &token,
+        unsigned int depth)
+{
+    // Only formatting elements go in, so the tag ID tells them apart. The
+    // markers before the entry keep identical elements on both sides of a
+    // marker apart.
+    size_t signature = token.get_tag_id() | static_cast<size_t>(depth) << 16;
+    std::hash<std::wstring> hasher;
+
+    // The map is sorted, so equal attribute sets hash equally
+    for (const std::pair<const std::wstring, std::wstring> &attribute :
+            token.get_attributes())
+    {
+        signature ^= hasher(attribute.first) + 0x9e3779b9 +
+            (signature << 6) + (signature >> 2);
+        signature ^= hasher(attribute.second) + 0x9e3779b9 +
+            (signature << 6) + (signature >> 2);
+    }
+
+    return signature;
+}
+
+bool ActiveFormattingList::same_element_kind(const entry &first, const entry &second)
+{
+    // Only reached on a signature match, so hash collisions cost nothing
+    return first.element->get_tag_id() == second.element->get_tag_id() &&
+        first.token->get_attributes() == second.token->get_attributes();
+}
@@ -0,0 +1,88 @@
+#ifndef ACTIVEFORMATTINGLIST_HPP
+#define ACTIVEFORMATTINGLIST_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "tokens/HTMLToken.hpp"
+#include "../../elements/HTML/HTMLElement.hpp"
+
+/*
+ * The list of active formatting elements, see
+ * https://html.spec.whatwg.org/multipage/parsing.html#the-list-of-active-formatting-elements
+ *
+ * Entries live in one contiguous vector, markers are entries without an
+ * element. Every entry keeps the token its element was created from (needed
+ * to recreate the element) and a hash of its tag, the attributes of the
+ * token and the number of markers before it, so the Noah's Ark clause
+ * compares integers instead of attribute maps. The elements themselves
+ * don't need their attributes for it, the ones an event sink gets don't
+ * have any. The entries per hash are counted in a flat table that
+ * keeps its slots from one document to the next, which keeps pushing O(1)
+ * unless a fourth identical element is actually possible. With the marker
+ * count in the hash, markers never have to clear or recount the table.
+ * The same table counts the entries per tag, so asking for a tag that has
+ * no entry after the last marker (the <a> check of every <a>) is O(1) too.
+ */
+class ActiveFormattingList
+{
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        ActiveFormattingList();
+        void push(const std::shared_ptr<HTMLElement> &element,
+                const std::shared_ptr<HTMLToken> &token);
+        void insert_marker();
+        void clear_to_last_marker();
+        void clear();
+
+        bool empty() const;
+        size_t size() const;
+        bool is_marker(size_t index) const;
+        const std::shared_ptr<HTMLElement> &element_at(size_t index) const;
+        const std::shared_ptr<HTMLToken> &token_at(size_t index) const;
+        size_t index_of(const HTMLElement *element) const;
+        size_t find_after_last_marker(HTMLTagId tag_id) const;
+        bool has_after_last_marker(HTMLTagId tag_id) const;
+
+        void insert_at(size_t index, const std::shared_ptr<HTMLElement> &element,
+                const std::shared_ptr<HTMLToken> &token);
+        void replace_at(size_t index, const std::shared_ptr<HTMLElement> &element);
+        void remove_at(size_t index);
+
+    private:
+        struct entry
+        {
+            std::shared_ptr<HTMLElement> element;
+            std::shared_ptr<HTMLToken> token;
+            size_t signature;
+            // Markers at or before the entry
+            unsigned int depth;
+        };
+
+        // A slot that once held a signature keeps it at count 0, so lookups
+        // only stop at slots that were never used
+        struct signature_slot
+        {
+            size_t signature;
+            unsigned int count;
+            bool used;
+        };
+
+        static size_t compute_signature(const HTMLToken &token, unsigned int depth);
+        static size_t tag_key(HTMLTagId tag_id, unsigned int depth);
+        static bool same_element_kind(const entry &first, const entry &second);
+        void count_entry(const entry &counted, int change);
+        unsigned int &count_of(size_t signature);
+        unsigned int find_count(size_t signature) const;
+        void grow_signature_counts();
+
+        std::vector<entry> entries;
+        std::vector<signature_slot> signature_counts;
+        size_t used_slots;
+        unsigned int marker_count;
+};
+
+#endif // ACTIVEFORMATTINGLIST_HPP
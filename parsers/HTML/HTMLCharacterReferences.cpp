@@ -0,0 +1,143 @@
+#include <unordered_map>
+
+#include "HTMLCharacterReferences.hpp"
+
+// U+00A0 to U+00FF in order
+static const wchar_t *const latin1_names[] = {
+    L"nbsp", L"iexcl", L"cent", L"pound", L"curren", L"yen", L"brvbar",
+    L"sect", L"uml", L"copy", L"ordf", L"laquo", L"not", L"shy", L"reg",
+    L"macr", L"deg", L"plusmn", L"sup2", L"sup3", L"acute", L"micro",
+    L"para", L"middot", L"cedil", L"sup1", L"ordm", L"raquo", L"frac14",
+    L"frac12", L"frac34", L"iquest", L"Agrave", L"Aacute", L"Acirc",
+    L"Atilde", L"Auml", L"Aring", L"AElig", L"Ccedil", L"Egrave", L"Eacute",
+    L"Ecirc", L"Euml", L"Igrave", L"Iacute", L"Icirc", L"Iuml", L"ETH",
+    L"Ntilde", L"Ograve", L"Oacute", L"Ocirc", L"Otilde", L"Ouml", L"times",
+    L"Oslash", L"Ugrave", L"Uacute", L"Ucirc", L"Uuml", L"Yacute", L"THORN",
+    L"szlig", L"agrave", L"aacute", L"acirc", L"atilde", L"auml", L"aring",
+    L"aelig", L"ccedil", L"egrave", L"eacute", L"ecirc", L"euml", L"igrave",
+    L"iacute", L"icirc", L"iuml", L"eth", L"ntilde", L"ograve", L"oacute",
+    L"ocirc", L"otilde", L"ouml", L"divide", L"oslash", L"ugrave", L"uacute",
+    L"ucirc", L"uuml", L"yacute", L"thorn", L"yuml"
+};
+
+// Also allowed without ';', besides the Latin-1 block
+static const std::unordered_map<std::wstring, char32_t> legacy_references = {
+    {L"amp", 0x26}, {L"lt", 0x3C}, {L"gt", 0x3E}, {L"quot", 0x22},
+    {L"AMP", 0x26}, {L"LT", 0x3C}, {L"GT", 0x3E}, {L"QUOT", 0x22},
+    {L"COPY", 0xA9}, {L"REG", 0xAE}
+};
+
+static const std::unordered_map<std::wstring, char32_t> other_references = {
+    {L"apos", 0x27},
+
+    {L"OElig", 0x152}, {L"oelig", 0x153}, {L"Scaron", 0x160},
+    {L"scaron", 0x161}, {L"Yuml", 0x178}, {L"fnof", 0x192},
+    {L"circ", 0x2C6}, {L"tilde", 0x2DC},
+
+    {L"Alpha", 0x391}, {L"Beta", 0x392}, {L"Gamma", 0x393},
+    {L"Delta", 0x394}, {L"Epsilon", 0x395}, {L"Zeta", 0x396},
+    {L"Eta", 0x397}, {L"Theta", 0x398}, {L"Iota", 0x399},
+    {L"Kappa", 0x39A}, {L"Lambda", 0x39B}, {L"Mu", 0x39C}, {L"Nu", 0x39D},
+    {L"Xi", 0x39E}, {L"Omicron", 0x39F}, {L"Pi", 0x3A0}, {L"Rho", 0x3A1},
+    {L"Sigma", 0x3A3}, {L"Tau", 0x3A4}, {L"Upsilon", 0x3A5},
+    {L"Phi", 0x3A6}, {L"Chi", 0x3A7}, {L"Psi", 0x3A8}, {L"Omega", 0x3A9},
+    {L"alpha", 0x3B1}, {L"beta", 0x3B2}, {L"gamma", 0x3B3},
+    {L"delta", 0x3B4}, {L"epsilon", 0x3B5}, {L"zeta", 0x3B6},
+    {L"eta", 0x3B7}, {L"theta", 0x3B8}, {L"iota", 0x3B9},
+    {L"kappa", 0x3BA}, {L"lambda", 0x3BB}, {L"mu", 0x3BC}, {L"nu", 0x3BD},
+    {L"xi", 0x3BE}, {L"omicron", 0x3BF}, {L"pi", 0x3C0}, {L"rho", 0x3C1},
+    {L"sigmaf", 0x3C2}, {L"sigma", 0x3C3}, {L"tau", 0x3C4},
+    {L"upsilon", 0x3C5}, {L"phi", 0x3C6}, {L"chi", 0x3C7}, {L"psi", 0x3C8},
+    {L"omega", 0x3C9}, {L"thetasym", 0x3D1}, {L"upsih", 0x3D2},
+    {L"piv", 0x3D6},
+
+    {L"ensp", 0x2002}, {L"emsp", 0x2003}, {L"thinsp", 0x2009},
+    {L"zwnj", 0x200C}, {L"zwj", 0x200D}, {L"lrm", 0x200E},
+    {L"rlm", 0x200F}, {L"ndash", 0x2013}, {L"mdash", 0x2014},
+    {L"lsquo", 0x2018}, {L"rsquo", 0x2019}, {L"sbquo", 0x201A},
+    {L"ldquo", 0x201C}, {L"rdquo", 0x201D}, {L"bdquo", 0x201E},
+    {L"dagger", 0x2020}, {L"Dagger", 0x2021}, {L"bull", 0x2022},
+    {L"hellip", 0x2026}, {L"permil", 0x2030}, {L"prime", 0x2032},
+    {L"Prime", 0x2033}, {L"lsaquo", 0x2039}, {L"rsaquo", 0x203A},
+    {L"oline", 0x203E}, {L"frasl", 0x2044}, {L"euro", 0x20AC},
+    {L"image", 0x2111}, {L"weierp", 0x2118}, {L"real", 0x211C},
+    {L"trade", 0x2122}, {L"alefsym", 0x2135},
+
+    {L"larr", 0x2190}, {L"uarr", 0x2191}, {L"rarr", 0x2192},
+    {L"darr", 0x2193}, {L"harr", 0x2194}, {L"crarr", 0x21B5},
+    {L"lArr", 0x21D0}, {L"uArr", 0x21D1}, {L"rArr", 0x21D2},
+    {L"dArr", 0x21D3}, {L"hArr", 0x21D4},
+
+    {L"forall", 0x2200}, {L"part", 0x2202}, {L"exist", 0x2203},
+    {L"empty", 0x2205}, {L"nabla", 0x2207}, {L"isin", 0x2208},
+    {L"notin", 0x2209}, {L"ni", 0x220B}, {L"prod", 0x220F},
+    {L"sum", 0x2211}, {L"minus", 0x2212}, {L"lowast", 0x2217},
+    {L"radic", 0x221A}, {L"prop", 0x221D}, {L"infin", 0x221E},
+    {L"ang", 0x2220}, {L"and", 0x2227}, {L"or", 0x2228}, {L"cap", 0x2229},
+    {L"cup", 0x222A}, {L"int", 0x222B}, {L"there4", 0x2234},
+    {L"sim", 0x223C}, {L"cong", 0x2245}, {L"asymp", 0x2248},
+    {L"ne", 0x2260}, {L"equiv", 0x2261}, {L"le", 0x2264}, {L"ge", 0x2265},
+    {L"sub", 0x2282}, {L"sup", 0x2283}, {L"nsub", 0x2284},
+    {L"sube", 0x2286}, {L"supe", 0x2287}, {L"oplus", 0x2295},
+    {L"otimes", 0x2297}, {L"perp", 0x22A5}, {L"sdot", 0x22C5},
+    {L"lceil", 0x2308}, {L"rceil", 0x2309}, {L"lfloor", 0x230A},
+    {L"rfloor", 0x230B}, {L"lang", 0x27E8}, {L"rang", 0x27E9},
+    {L"loz", 0x25CA}, {L"spades", 0x2660}, {L"clubs", 0x2663},
+    {L"hearts", 0x2665}, {L"diams", 0x2666}
+};
+
+// https://html.spec.whatwg.org/multipage/parsing.html#numeric-character-reference-end-state
+static const char32_t windows_1252_c1[32] = {
+    0x20AC, 0x81, 0x201A, 0x192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x2C6, 0x2030, 0x160, 0x2039, 0x152, 0x8D, 0x17D, 0x8F,
+    0x90, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x2DC, 0x2122, 0x161, 0x203A, 0x153, 0x9D, 0x17E, 0x178
+};
+
+static const std::unordered_map<std::wstring, char32_t> &latin1_references()
+{
+    static const std::unordered_map<std::wstring, char32_t> references = []()
+    {
+        std::unordered_map<std::wstring, char32_t> names;
+
+        for (size_t i = 0; i < sizeof(latin1_names) / sizeof(latin1_names[0]); i++)
+            names.insert({latin1_names[i], static_cast<char32_t>(0xA0 + i)});
+
+        return names;
+    }();
+
+    return references;
+}
+
+char32_t HTMLCharacterReferences::find(const std::wstring &name)
+{
+    for (const std::unordered_map<std::wstring, char32_t> *references :
+            {&latin1_references(), &legacy_references, &other_references})
+    {
+        std::unordered_map<std::wstring, char32_t>::const_iterator found =
+            references->find(name);
+
+        if (found != references->cend())
+            return found->second;
+    }
+
+    return 0;
+}
+
+bool HTMLCharacterReferences::allows_missing_semicolon(const std::wstring &name)
+{
+    return latin1_references().count(name) != 0 ||
+        legacy_references.count(name) != 0;
+}
+
+char32_t HTMLCharacterReferences::fix_numeric_reference(char32_t code_point)
+{
+    if (code_point == 0 || code_point > 0x10FFFF ||
+            (code_point >= 0xD800 && code_point <= 0xDFFF))
+        return 0xFFFD;
+
+    if (code_point >= 0x80 && code_point <= 0x9F)
+        return windows_1252_c1[code_point - 0x80];
+
+    return code_point;
+}
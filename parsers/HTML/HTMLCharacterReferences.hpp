@@ -0,0 +1,26 @@
+#ifndef HTMLCHARACTERREFERENCES_HPP
+#define HTMLCHARACTERREFERENCES_HPP
+
+#include <string>
+
+// Named character references, the HTML 4 set that covers nearly all of
+// them found in practice. The full list is at
+// https://html.spec.whatwg.org/multipage/named-characters.html
+class HTMLCharacterReferences
+{
+    public:
+        // name without the '&' and ';', 0 if it isn't known
+        static char32_t find(const std::wstring &name);
+
+        // The Latin-1 ones and a few others are also recognized without
+        // their ';', since old pages leave it out
+        static bool allows_missing_semicolon(const std::wstring &name);
+
+        // For numeric references, handles the C1 control range (read as
+        // windows-1252 like browsers do), surrogates and out of range values
+        static char32_t fix_numeric_reference(char32_t code_point);
+
+        static const size_t longest_name = 8;
+};
+
+#endif // HTMLCHARACTERREFERENCES_HPP
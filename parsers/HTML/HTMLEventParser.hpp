@@ -0,0 +1,148 @@
+#ifndef HTMLEVENTPARSER_HPP
+#define HTMLEVENTPARSER_HPP
+
+#include <string>
+#include <map>
+#include <chrono>
+
+#include "HTMLParser.hpp"
+#include "HTMLEventSink.hpp"
+
+// Does nothing with any event. Handlers can derive from it and only define
+// the events they care about, HTMLEventParser calls them directly.
+struct HTMLEventHandler
+{
+    void doctype(const std::wstring &name) {}
+    void start_tag(const std::wstring &tag_name,
+            const std::map<std::wstring, std::wstring> &attributes) {}
+    void end_tag(const std::wstring &tag_name) {}
+    void text(const std::wstring &data) {}
+    void comment(const std::wstring &data) {}
+    void end_document() {}
+};
+
+// Parses without building a DOM. It's HTMLParser with an event sink, so the
+// handler gets what the tree builder would have made of the document as
+// balanced start and end tags, the implied ones (html, head, body, closed
+// paragraphs and list items, reopened formatting elements...) filled in.
+// Memory use depends on how deep the document nests, not on how long it is.
+// See HTMLEventSink for the one place the events differ from the tree.
+//
+// The parser reaches this through the one virtual call per event of
+// HTMLEventSink, from there on it's the handler's own functions. Names and
+// attributes are the ones of the token, text comes in runs rather than
+// characters, and elements the parser opens for the tree construction rules
+// are reused once they're closed, so there's no element or attribute map
+// made for every tag.
+template <typename Handler>
+class HTMLEventParser : private HTMLEventSink
+{
+    public:
+        explicit HTMLEventParser(Handler &event_handler);
+        HTMLEventParser(const HTMLEventParser &) = delete;
+        HTMLEventParser &operator=(const HTMLEventParser &) = delete;
+
+        void parse(const std::wstring &html);
+
+        // Streaming input, events are sent as soon as their tokens are
+        // complete. finish() closes whatever is still open.
+        void feed(const std::wstring &html);
+        void finish();
+        void reset();
+
+        // Longer runs of text are sent as several text events
+        using HTMLEventSink::max_text_length;
+
+    private:
+        void doctype(const std::wstring &name) override;
+        void start_tag(const std::wstring &tag_name,
+                const attribute_map &attributes) override;
+        void end_tag(const std::wstring &tag_name) override;
+        void text(const std::wstring &data) override;
+        void comment(const std::wstring &data) override;
+
+        void run_parser();
+
+        Handler &handler;
+        HTMLParser parser;
+};
+
+template <typename Handler>
+HTMLEventParser<Handler>::HTMLEventParser(Handler &event_handler)
+    : handler(event_handler)
+{
+    parser.set_event_sink(this);
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::reset()
+{
+    // Text the parser was in the middle of goes with the rest
+    parser.reset();
+    HTMLEventSink::reset_text();
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::parse(const std::wstring &html)
+{
+    reset();
+    feed(html);
+    finish();
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::feed(const std::wstring &html)
+{
+    parser.feed(html);
+    run_parser();
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::finish()
+{
+    parser.finish();
+    run_parser();
+
+    handler.end_document();
+    reset();
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::run_parser()
+{
+    // No budget, whatever the input holds is parsed now
+    parser.run({0, std::chrono::microseconds(0)});
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::doctype(const std::wstring &name)
+{
+    handler.doctype(name);
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::start_tag(const std::wstring &tag_name,
+        const attribute_map &attributes)
+{
+    handler.start_tag(tag_name, attributes);
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::end_tag(const std::wstring &tag_name)
+{
+    handler.end_tag(tag_name);
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::text(const std::wstring &data)
+{
+    handler.text(data);
+}
+
+template <typename Handler>
+void HTMLEventParser<Handler>::comment(const std::wstring &data)
+{
+    handler.comment(data);
+}
+
+#endif // HTMLEVENTPARSER_HPP
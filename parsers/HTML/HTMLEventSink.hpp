@@ -0,0 +1,68 @@
+#ifndef HTMLEVENTSINK_HPP
+#define HTMLEVENTSINK_HPP
+
+#include <string>
+#include <map>
+
+// What HTMLParser sends instead of building a DOM (see
+// HTMLParser::set_event_sink). Every element it opens comes as a start tag
+// and every one it closes as an end tag, so the tags are balanced and the
+// implied ones are there. The names and attributes come straight from the
+// tokens, the implied tags have none.
+//
+// Events can't be taken back. Where the tree builder would move elements
+// that are open already (the adoption agency with a block inside a
+// misnested formatting element), the elements above the formatting element
+// are closed together with it, and the formatting ones among them are
+// reopened after it.
+class HTMLEventSink
+{
+    public:
+        typedef std::map<std::wstring, std::wstring> attribute_map;
+
+        virtual ~HTMLEventSink() {}
+
+        virtual void doctype(const std::wstring &name) = 0;
+        virtual void start_tag(const std::wstring &tag_name,
+                const attribute_map &attributes) = 0;
+        virtual void end_tag(const std::wstring &tag_name) = 0;
+        virtual void text(const std::wstring &data) = 0;
+        virtual void comment(const std::wstring &data) = 0;
+
+        // The parser hands text over a character at a time, it goes out as
+        // one text event before the next event of any other kind, or in
+        // pieces of max_text_length
+        void add_char(wchar_t next_char);
+        void flush_text();
+        // Drops it, for a document given up halfway
+        void reset_text();
+
+        static const size_t max_text_length = 4096;
+
+    private:
+        std::wstring pending_text;
+};
+
+inline void HTMLEventSink::add_char(wchar_t next_char)
+{
+    pending_text.push_back(next_char);
+
+    if (pending_text.size() >= max_text_length)
+        flush_text();
+}
+
+inline void HTMLEventSink::flush_text()
+{
+    if (pending_text.empty())
+        return;
+
+    text(pending_text);
+    pending_text.clear();
+}
+
+inline void HTMLEventSink::reset_text()
+{
+    pending_text.clear();
+}
+
+#endif // HTMLEVENTSINK_HPP
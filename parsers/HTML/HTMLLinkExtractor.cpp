@@ -0,0 +1,204 @@
+#include <algorithm>
+
+#include "HTMLLinkExtractor.hpp"
+#include "../URL/URL.hpp"
+
+static bool is_space(wchar_t next_char)
+{
+    return next_char == L' ' || next_char == L'\t' || next_char == L'\n' ||
+        next_char == L'\r' || next_char == L'\f';
+}
+
+HTMLLinkExtractor::HTMLLinkExtractor()
+{
+    base_found = false;
+}
+
+const std::vector<std::wstring> &HTMLLinkExtractor::extract(
+        const std::wstring &html, const std::wstring &document_url)
+{
+    tokenizer.reset();
+    references.clear();
+    seen_references.clear();
+    base_href.clear();
+    base_found = false;
+
+    std::wstring::const_iterator it = html.cbegin();
+
+    while (it != html.cend())
+    {
+        // Text is of no interest, only tags are tokenized
+        if (tokenizer.get_state() == HTMLTokenizer::data_state)
+        {
+            it = std::find(it, html.cend(), L'<');
+
+            if (it == html.cend())
+                break;
+        }
+
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(html, it);
+
+        if (!token->is_start_token())
+            continue;
+
+        collect_references(token);
+
+        // Switch states like the tree builder would, so that markup inside
+        // scripts and the like isn't taken for tags
+        HTMLTokenizer::tokenizer_state text_state =
+            HTMLTokenizer::state_for_start_tag(token->get_tag_name());
+
+        // Nothing but text follows
+        if (text_state == HTMLTokenizer::plaintext_state)
+            break;
+
+        if (text_state != HTMLTokenizer::data_state)
+        {
+            tokenizer.switch_to(text_state);
+            tokenizer.skip_text_content();
+        }
+    }
+
+    resolve_references(document_url);
+    return links;
+}
+
+void HTMLLinkExtractor::collect_references(const std::shared_ptr<HTMLToken> &token)
+{
+    const std::wstring &tag_name = token->get_tag_name();
+    const std::map<std::wstring, std::wstring> &attributes = token->get_attributes();
+    const wchar_t *attribute_name = nullptr;
+
+    if (tag_name == L"a" || tag_name == L"area" || tag_name == L"link")
+        attribute_name = L"href";
+
+    else if (tag_name == L"img" || tag_name == L"iframe" || tag_name == L"frame")
+        attribute_name = L"src";
+
+    else if (tag_name == L"form")
+        attribute_name = L"action";
+
+    else if (tag_name == L"base")
+    {
+        // Only the first base with an href counts
+        std::map<std::wstring, std::wstring>::const_iterator href =
+            attributes.find(L"href");
+
+        if (!base_found && href != attributes.cend())
+        {
+            base_href = href->second;
+            base_found = true;
+        }
+
+        return;
+    }
+
+    if (attribute_name != nullptr)
+    {
+        std::map<std::wstring, std::wstring>::const_iterator found =
+            attributes.find(attribute_name);
+
+        if (found != attributes.cend())
+            add_reference(found->second);
+    }
+
+    if (tag_name == L"img" || tag_name == L"source")
+    {
+        std::map<std::wstring, std::wstring>::const_iterator srcset =
+            attributes.find(L"srcset");
+
+        if (srcset != attributes.cend())
+            collect_srcset_references(srcset->second);
+    }
+}
+
+void HTMLLinkExtractor::add_reference(const std::wstring &reference)
+{
+    // The same few links tend to come up over and over (navigation, icons),
+    // each is only resolved once
+    if (seen_references.insert(reference).second)
+        references.push_back(reference);
+}
+
+void HTMLLinkExtractor::collect_srcset_references(const std::wstring &srcset)
+{
+    // https://html.spec.whatwg.org/multipage/images.html#parse-a-srcset-attribute
+    // without looking at the descriptors
+    size_t position = 0;
+
+    while (position < srcset.size())
+    {
+        while (position < srcset.size() &&
+                (is_space(srcset[position]) || srcset[position] == L','))
+            position++;
+
+        size_t url_start = position;
+        while (position < srcset.size() && !is_space(srcset[position]))
+            position++;
+
+        // "a.png,b.png" are two candidates without descriptors
+        size_t url_end = position;
+        bool candidate_ended = false;
+        while (url_end > url_start && srcset[url_end - 1] == L',')
+        {
+            url_end--;
+            candidate_ended = true;
+        }
+
+        if (url_end > url_start)
+            add_reference(srcset.substr(url_start, url_end - url_start));
+
+        if (candidate_ended)
+            continue;
+
+        // Descriptors run up to the next comma outside parentheses
+        bool in_parens = false;
+        while (position < srcset.size() &&
+                (in_parens || srcset[position] != L','))
+        {
+            if (srcset[position] == L'(')
+                in_parens = true;
+            else if (srcset[position] == L')')
+                in_parens = false;
+
+            position++;
+        }
+    }
+}
+
+void HTMLLinkExtractor::resolve_references(const std::wstring &document_url)
+{
+    seen_links.clear();
+    links.clear();
+
+    // An unusable base falls back to the document URL
+    URL base(document_url);
+    if (base_found)
+    {
+        URL base_element_url(base_href, base);
+
+        if (base_element_url.is_valid())
+            base = base_element_url;
+    }
+
+    for (const std::wstring &reference : references)
+    {
+        // Links within the document itself
+        std::wstring::const_iterator first = std::find_if_not(
+                reference.cbegin(), reference.cend(), is_space);
+        if (first == reference.cend() || *first == L'#')
+            continue;
+
+        URL link(reference, base);
+
+        if (!link.is_valid() || link.get_scheme() == L"javascript" ||
+                link.get_scheme() == L"data")
+            continue;
+
+        link.clear_fragment();
+
+        std::wstring link_string = link.to_string();
+        if (seen_links.insert(link_string).second)
+            links.push_back(std::move(link_string));
+    }
+}
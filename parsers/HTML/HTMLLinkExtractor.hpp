@@ -0,0 +1,44 @@
+#ifndef HTMLLINKEXTRACTOR_HPP
+#define HTMLLINKEXTRACTOR_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+
+#include "HTMLTokenizer.hpp"
+#include "tokens/HTMLToken.hpp"
+
+// Collects the outgoing links of a document for crawling, straight from the
+// tokenizer without a tree builder or DOM. Picked up are a, area and link
+// hrefs, img, iframe and frame srcs, the candidates of srcset and form
+// actions, resolved against the first <base href> and the document URL.
+// Fragments are dropped, and each URL is listed once, in document order.
+//
+// Keep the extractor around between documents, its buffers are reused.
+class HTMLLinkExtractor
+{
+    public:
+        HTMLLinkExtractor();
+
+        // The result stays valid until the next call
+        const std::vector<std::wstring> &extract(const std::wstring &html,
+                const std::wstring &document_url);
+
+    private:
+        void collect_references(const std::shared_ptr<HTMLToken> &token);
+        void add_reference(const std::wstring &reference);
+        void collect_srcset_references(const std::wstring &srcset);
+        void resolve_references(const std::wstring &document_url);
+
+        HTMLTokenizer tokenizer;
+        std::unordered_set<std::wstring> seen_references;
+        std::vector<std::wstring> references;
+        std::wstring base_href;
+        bool base_found;
+
+        std::unordered_set<std::wstring> seen_links;
+        std::vector<std::wstring> links;
+};
+
+#endif // HTMLLINKEXTRACTOR_HPP
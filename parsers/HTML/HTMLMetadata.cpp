@@ -0,0 +1,50 @@
+#include "HTMLMetadata.hpp"
+
+static void collect_head_element(HTMLMetadata &metadata, const HTMLElement *element)
+{
+    const std::wstring &title = element->get_title();
+
+    if (title == L"title" && metadata.title.empty())
+    {
+        for (const HTMLElement *child : element->children())
+            child->get_text().append_to(metadata.title);
+    }
+
+    else if (title == L"meta")
+        metadata.meta.push_back(element->get_attributes());
+
+    else if (title == L"link")
+        metadata.links.push_back(element->get_attributes());
+
+    else if (title == L"base" && metadata.base_href.empty())
+        metadata.base_href = element->get_attribute(L"href");
+
+    // <noscript> and friends can hold some more
+    for (const HTMLElement *child : element->children())
+    {
+        if (!child->is_text_node())
+            collect_head_element(metadata, child);
+    }
+}
+
+HTMLMetadata::HTMLMetadata()
+{
+    head_complete = false;
+}
+
+HTMLMetadata HTMLMetadata::from_document(const Document &document)
+{
+    HTMLMetadata metadata;
+    metadata.doctype = document.get_document_type().get_name();
+
+    for (const std::shared_ptr<HTMLElement> &root : document.get_elements())
+    {
+        for (const HTMLElement *child : root->children())
+        {
+            if (child->get_title() == L"head")
+                collect_head_element(metadata, child);
+        }
+    }
+
+    return metadata;
+}
@@ -0,0 +1,30 @@
+#ifndef HTMLMETADATA_HPP
+#define HTMLMETADATA_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "../../document/Document.hpp"
+
+// What link previews and indexing need from a page, taken from its head.
+// See HTMLParser::parse_metadata.
+struct HTMLMetadata
+{
+    typedef std::map<std::wstring, std::wstring> attribute_map;
+
+    HTMLMetadata();
+    static HTMLMetadata from_document(const Document &document);
+
+    std::wstring doctype;
+    std::wstring title;
+    // href of the first <base> that has one
+    std::wstring base_href;
+    // Attributes of every <meta> and <link>, in document order
+    std::vector<attribute_map> meta;
+    std::vector<attribute_map> links;
+    // False if the input ended before the head did
+    bool head_complete;
+};
+
+#endif // HTMLMETADATA_HPP
@@ -0,0 +1,532 @@
+#include <set>
+#include <algorithm>
+
+#include "HTMLMinifier.hpp"
+#include "HTMLParser.hpp"
+
+// Whitespace next to these is insignificant, their boxes start on a line
+// of their own or aren't rendered at all
+static const std::set<std::wstring> block_tags = {
+    L"address", L"article", L"aside", L"base", L"blockquote", L"body",
+    L"br", L"caption", L"center", L"col", L"colgroup", L"dd", L"details",
+    L"dialog", L"dir", L"div", L"dl", L"dt", L"fieldset", L"figcaption",
+    L"figure", L"footer", L"form", L"frame", L"frameset", L"h1", L"h2",
+    L"h3", L"h4", L"h5", L"h6", L"head", L"header", L"hgroup", L"hr",
+    L"html", L"legend", L"li", L"link", L"listing", L"main", L"menu",
+    L"meta", L"nav", L"ol", L"optgroup", L"option", L"p", L"pre",
+    L"search", L"section", L"summary", L"table", L"tbody", L"td",
+    L"tfoot", L"th", L"thead", L"title", L"tr", L"ul"
+};
+
+// Neither add nor remove whitespace around these
+static const std::set<std::wstring> transparent_tags = {
+    L"script", L"style", L"template", L"noscript"
+};
+
+static const std::set<std::wstring> boolean_attributes = {
+    L"allowfullscreen", L"async", L"autofocus", L"autoplay", L"checked",
+    L"controls", L"default", L"defer", L"disabled", L"formnovalidate",
+    L"hidden", L"inert", L"ismap", L"itemscope", L"loop", L"multiple",
+    L"muted", L"nomodule", L"novalidate", L"open", L"playsinline",
+    L"readonly", L"required", L"reversed", L"selected"
+};
+
+// https://html.spec.whatwg.org/multipage/syntax.html#optional-tags
+static const std::set<std::wstring> optional_end_tags = {
+    L"body", L"dd", L"dt", L"head", L"html", L"li", L"optgroup",
+    L"option", L"p", L"rp", L"rt", L"tbody", L"td", L"tfoot", L"th",
+    L"thead", L"tr"
+};
+
+static const std::set<std::wstring> p_ending_tags = {
+    L"address", L"article", L"aside", L"blockquote", L"details", L"dialog",
+    L"div", L"dl", L"fieldset", L"figcaption", L"figure", L"footer",
+    L"form", L"h1", L"h2", L"h3", L"h4", L"h5", L"h6", L"header",
+    L"hgroup", L"hr", L"main", L"menu", L"nav", L"ol", L"p", L"pre",
+    L"search", L"section", L"table", L"ul"
+};
+
+static bool is_space(wchar_t next_char)
+{
+    return next_char == L' ' || next_char == L'\t' || next_char == L'\n' ||
+        next_char == L'\r' || next_char == L'\f';
+}
+
+HTMLMinifier::HTMLMinifier(const output_sink &output_function)
+    : sink(output_function)
+{
+    position = 0;
+    preserve_depth = 0;
+    in_plaintext = false;
+    pending_space = false;
+    after_block = true;
+    ends_with_space = false;
+}
+
+void HTMLMinifier::write(const std::wstring &html)
+{
+    // Drop what's been minified once it's most of the buffer
+    if (position > 4096 && position * 2 > input.size())
+    {
+        input.erase(0, position);
+        position = 0;
+    }
+
+    input += html;
+    run(false);
+    flush();
+}
+
+void HTMLMinifier::end()
+{
+    run(true);
+
+    // Whatever is still open is closed by the end of the input
+    if (!pending_end_tag.empty() && !can_omit_end_tag(L"",
+                open_elements.empty() ? L"" : open_elements.back().tag_name))
+        flush_end_tag();
+
+    flush();
+
+    tokenizer.reset();
+    input.clear();
+    position = 0;
+    open_elements.clear();
+    preserve_depth = 0;
+    raw_text_tag.clear();
+    in_plaintext = false;
+    pending_space = false;
+    after_block = true;
+    ends_with_space = false;
+    pending_end_tag.clear();
+}
+
+void HTMLMinifier::run(bool complete)
+{
+    while (true)
+    {
+        // Text is handled without the tokenizer, up to the next tag
+        if (in_plaintext)
+        {
+            put_input(position, input.size());
+            position = input.size();
+            return;
+        }
+
+        if (!raw_text_tag.empty())
+        {
+            bool found = false;
+            size_t text_end = HTMLTokenizer::find_raw_text_end(input, position,
+                    raw_text_tag, complete, found);
+
+            put_input(position, text_end);
+            position = text_end;
+
+            if (!found)
+                return;
+
+            raw_text_tag.clear();
+        }
+
+        else
+        {
+            size_t less_than = input.find(L'<', position);
+            if (less_than == std::wstring::npos)
+                less_than = input.size();
+
+            minify_text(position, less_than);
+            position = less_than;
+
+            if (position == input.size())
+                return;
+        }
+
+        const size_t token_start = position;
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(input,
+                position, complete);
+
+        if (token == nullptr)
+            return;
+
+        if (token->is_start_token())
+            process_start_tag(token);
+
+        else if (token->is_end_token())
+            process_end_tag(token);
+
+        // A '<' that doesn't start a tag
+        else if (token->is_char_token())
+            minify_text(token_start, position);
+
+        else if (token->is_comment_token())
+            process_comment(token_start);
+
+        else if (token->is_doctype_token())
+        {
+            put_input(token_start, position);
+            after_block = true;
+        }
+
+        // An unfinished tag at the end of the input, the parser drops it
+        else if (position == token_start)
+            position = input.size();
+    }
+}
+
+void HTMLMinifier::process_start_tag(const std::shared_ptr<HTMLToken> &token)
+{
+    const std::wstring &tag_name = token->get_tag_name();
+
+    if (!pending_end_tag.empty())
+    {
+        if (can_omit_end_tag(tag_name, L""))
+            pending_end_tag.clear();
+        else
+            flush_end_tag();
+    }
+
+    // Start tags like these close an element of the same kind, keep the
+    // stack from growing with every list item whose end tag was left out
+    if (!open_elements.empty() && open_elements.back().tag_name == tag_name &&
+            (tag_name == L"li" || tag_name == L"p" || tag_name == L"dd" ||
+             tag_name == L"dt" || tag_name == L"option" || tag_name == L"tr" ||
+             tag_name == L"td" || tag_name == L"th"))
+        pop_element();
+
+    const bool foreign = tag_name == L"svg" || tag_name == L"math" ||
+        (!open_elements.empty() && open_elements.back().foreign);
+
+    collapse_space_before_tag(tag_name);
+    serialize_start_tag(token, foreign);
+
+    if (foreign ? token->is_self_closing() : HTMLParser::is_void_tag(tag_name))
+        return;
+
+    open_elements.push_back({tag_name, foreign});
+
+    if (foreign)
+        return;
+
+    if (tag_name == L"pre" || tag_name == L"listing")
+        preserve_depth++;
+
+    switch (HTMLTokenizer::state_for_start_tag(tag_name))
+    {
+        case HTMLTokenizer::rcdata_state:
+        case HTMLTokenizer::rawtext_state:
+        case HTMLTokenizer::script_data_state:
+            raw_text_tag = tag_name;
+            break;
+        case HTMLTokenizer::plaintext_state:
+            in_plaintext = true;
+            break;
+        default:
+            break;
+    }
+}
+
+void HTMLMinifier::process_end_tag(const std::shared_ptr<HTMLToken> &token)
+{
+    const std::wstring &tag_name = token->get_tag_name();
+
+    if (!pending_end_tag.empty())
+    {
+        // Only the end of the parent element implies the end tag
+        if (!open_elements.empty() && open_elements.back().tag_name == tag_name &&
+                can_omit_end_tag(L"", tag_name))
+            pending_end_tag.clear();
+        else
+            flush_end_tag();
+    }
+
+    size_t index = open_elements.size();
+    while (index > 0 && open_elements[index - 1].tag_name != tag_name)
+        index--;
+
+    // Stray end tags are ignored by the parser
+    if (index == 0)
+        return;
+
+    while (open_elements.size() >= index)
+        pop_element();
+
+    collapse_space_before_tag(tag_name);
+
+    if (optional_end_tags.count(tag_name) != 0)
+        pending_end_tag = tag_name;
+    else
+        put(L"</" + tag_name + L">");
+}
+
+void HTMLMinifier::process_comment(size_t token_start)
+{
+    // Conditional comments still mean something to old browsers
+    static const std::wstring endif = L"[endif]";
+
+    const bool conditional = input.compare(token_start, 7, L"<!--[if") == 0 ||
+        std::search(input.cbegin() + token_start, input.cbegin() + position,
+                endif.cbegin(), endif.cend()) != input.cbegin() + position;
+
+    if (conditional)
+        put_input(token_start, position);
+}
+
+void HTMLMinifier::minify_text(size_t start, size_t end)
+{
+    if (start == end)
+        return;
+
+    if (preserve_depth > 0)
+    {
+        put_input(start, end);
+        after_block = false;
+        ends_with_space = is_space(input[end - 1]);
+        return;
+    }
+
+    for (size_t i = start; i < end; i++)
+    {
+        const wchar_t next_char = input[i];
+
+        if (is_space(next_char))
+        {
+            pending_space = true;
+            continue;
+        }
+
+        if (pending_space && !after_block && !ends_with_space)
+            put(L' ');
+
+        // Copy the run up to the next space in one go
+        size_t run_end = i + 1;
+        while (run_end < end && !is_space(input[run_end]))
+            run_end++;
+
+        put_input(i, run_end);
+        i = run_end - 1;
+
+        pending_space = false;
+        after_block = false;
+        ends_with_space = false;
+    }
+}
+
+void HTMLMinifier::pop_element()
+{
+    const open_element &element = open_elements.back();
+
+    if (!element.foreign && (element.tag_name == L"pre" || element.tag_name == L"listing"))
+        preserve_depth--;
+
+    open_elements.pop_back();
+}
+
+void HTMLMinifier::collapse_space_before_tag(const std::wstring &tag_name)
+{
+    if (transparent_tags.count(tag_name) != 0)
+        return;
+
+    if (block_tags.count(tag_name) != 0)
+    {
+        pending_space = false;
+        after_block = true;
+        ends_with_space = false;
+        return;
+    }
+
+    // Inline content, one space between it and the text before
+    if (pending_space && !after_block && !ends_with_space)
+    {
+        put(L' ');
+        ends_with_space = true;
+    }
+
+    pending_space = false;
+}
+
+bool HTMLMinifier::can_omit_end_tag(const std::wstring &next_start_tag,
+        const std::wstring &parent_tag) const
+{
+    // next_start_tag is empty at the end of the parent element, whose tag
+    // is parent_tag then
+    const std::wstring &tag_name = pending_end_tag;
+    const bool parent_ends = next_start_tag.empty();
+
+    if (tag_name == L"li")
+        return parent_ends || next_start_tag == L"li";
+
+    if (tag_name == L"dt")
+        return next_start_tag == L"dt" || next_start_tag == L"dd";
+
+    if (tag_name == L"dd")
+        return parent_ends || next_start_tag == L"dd" || next_start_tag == L"dt";
+
+    if (tag_name == L"rt" || tag_name == L"rp")
+        return parent_ends || next_start_tag == L"rt" || next_start_tag == L"rp";
+
+    if (tag_name == L"optgroup")
+        return parent_ends || next_start_tag == L"optgroup";
+
+    if (tag_name == L"option")
+        return parent_ends || next_start_tag == L"option" ||
+            next_start_tag == L"optgroup";
+
+    if (tag_name == L"p")
+    {
+        // Formatting elements would be reopened inside the next block
+        if (parent_ends)
+            return parent_tag != L"audio" && parent_tag != L"del" &&
+                parent_tag != L"ins" && parent_tag != L"map" &&
+                parent_tag != L"noscript" && parent_tag != L"video" &&
+                !HTMLParser::is_formatting_tag(parent_tag);
+
+        return p_ending_tags.count(next_start_tag) != 0;
+    }
+
+    if (tag_name == L"thead")
+        return next_start_tag == L"tbody" || next_start_tag == L"tfoot";
+
+    if (tag_name == L"tbody")
+        return parent_ends || next_start_tag == L"tbody" || next_start_tag == L"tfoot";
+
+    if (tag_name == L"tfoot")
+        return parent_ends;
+
+    if (tag_name == L"tr")
+        return parent_ends || next_start_tag == L"tr";
+
+    if (tag_name == L"td" || tag_name == L"th")
+        return parent_ends || next_start_tag == L"td" || next_start_tag == L"th";
+
+    // Comments and whitespace right after these would move, but comments
+    // are dropped and whitespace next to them doesn't matter
+    if (tag_name == L"head")
+        return true;
+
+    if (tag_name == L"body" || tag_name == L"html")
+        return parent_ends;
+
+    return false;
+}
+
+void HTMLMinifier::flush_end_tag()
+{
+    std::wstring end_tag = L"</" + pending_end_tag + L">";
+
+    pending_end_tag.clear();
+    put(end_tag);
+}
+
+void HTMLMinifier::put(wchar_t next_char)
+{
+    if (!pending_end_tag.empty())
+        flush_end_tag();
+
+    output += next_char;
+}
+
+void HTMLMinifier::put(const std::wstring &text)
+{
+    if (!pending_end_tag.empty())
+        flush_end_tag();
+
+    output += text;
+}
+
+void HTMLMinifier::put_input(size_t start, size_t end)
+{
+    if (start == end)
+        return;
+
+    if (!pending_end_tag.empty())
+        flush_end_tag();
+
+    output.append(input, start, end - start);
+}
+
+void HTMLMinifier::serialize_start_tag(const std::shared_ptr<HTMLToken> &token,
+        bool foreign)
+{
+    std::wstring &tag = output;
+    bool last_unquoted = false;
+
+    if (!pending_end_tag.empty())
+        flush_end_tag();
+
+    tag += L'<';
+    tag += token->get_tag_name();
+
+    for (const std::pair<const std::wstring, std::wstring> &attribute :
+            token->get_attributes())
+    {
+        const std::wstring &value = attribute.second;
+
+        tag += L' ';
+        tag += attribute.first;
+        last_unquoted = false;
+
+        // checked="checked" and friends, and empty values
+        if (value.empty() || (!foreign && boolean_attributes.count(attribute.first) != 0))
+            continue;
+
+        bool needs_quotes = false;
+        bool has_double_quote = false;
+        bool has_single_quote = false;
+
+        for (wchar_t next_char : value)
+        {
+            if (is_space(next_char) || next_char == L'=' || next_char == L'<' ||
+                    next_char == L'>' || next_char == L'`')
+                needs_quotes = true;
+            else if (next_char == L'"')
+                has_double_quote = true;
+            else if (next_char == L'\'')
+                has_single_quote = true;
+        }
+
+        needs_quotes = needs_quotes || has_double_quote || has_single_quote;
+
+        // Quote with whichever character the value doesn't contain
+        wchar_t quote = has_double_quote && !has_single_quote ? L'\'' : L'"';
+
+        tag += L'=';
+        if (needs_quotes)
+            tag += quote;
+
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            const wchar_t next_char = value[i];
+            const wchar_t following = i + 1 < value.size() ? value[i + 1] : L'\0';
+
+            // Only where it could be read as the start of a reference
+            if (next_char == L'&' && ((following >= L'a' && following <= L'z') ||
+                        (following >= L'A' && following <= L'Z') ||
+                        (following >= L'0' && following <= L'9') || following == L'#'))
+                tag += L"&amp;";
+            else if (next_char == quote && needs_quotes)
+                tag += L"&quot;";
+            else
+                tag += next_char;
+        }
+
+        if (needs_quotes)
+            tag += quote;
+        else
+            last_unquoted = true;
+    }
+
+    // The slash only means something in svg and math
+    if (foreign && token->is_self_closing())
+        tag += last_unquoted ? L" />" : L"/>";
+    else
+        tag += L'>';
+}
+
+void HTMLMinifier::flush()
+{
+    if (output.empty())
+        return;
+
+    sink(output);
+    output.clear();
+}
@@ -0,0 +1,82 @@
+#ifndef HTMLMINIFIER_HPP
+#define HTMLMINIFIER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "HTMLTokenizer.hpp"
+#include "tokens/HTMLToken.hpp"
+
+// Minifies HTML as it streams through, for generated pages on their way
+// out. Whitespace is collapsed to a single space, or dropped next to
+// block level elements, except inside pre, textarea, listing and raw text
+// elements. Comments go, apart from conditional ones. Start tags are
+// written without the quotes, values and slashes they don't need, and end
+// tags the parser implies anyway (</p>, </li>, </td>...) are left out.
+//
+// Only the tags are tokenized, scripts and styles are copied as they are.
+// Attributes come out in name order, the tokenizer doesn't keep the
+// original order.
+class HTMLMinifier
+{
+    public:
+        typedef std::function<void (const std::wstring &chunk)> output_sink;
+
+        explicit HTMLMinifier(const output_sink &output_function);
+
+        // Output is handed to the sink at the end of every write()
+        void write(const std::wstring &html);
+        // Flushes what's left and gets ready for the next document
+        void end();
+
+    private:
+        struct open_element
+        {
+            std::wstring tag_name;
+            bool foreign;
+        };
+
+        void run(bool complete);
+        void process_start_tag(const std::shared_ptr<HTMLToken> &token);
+        void process_end_tag(const std::shared_ptr<HTMLToken> &token);
+        void process_comment(size_t token_start);
+        void minify_text(size_t start, size_t end);
+        void pop_element();
+
+        void collapse_space_before_tag(const std::wstring &tag_name);
+        bool can_omit_end_tag(const std::wstring &next_start_tag,
+                const std::wstring &parent_tag) const;
+        void flush_end_tag();
+        void put(wchar_t next_char);
+        void put(const std::wstring &text);
+        void put_input(size_t start, size_t end);
+        void serialize_start_tag(const std::shared_ptr<HTMLToken> &token,
+                bool foreign);
+        void flush();
+
+        output_sink sink;
+        HTMLTokenizer tokenizer;
+        std::wstring input;
+        size_t position;
+        std::wstring output;
+
+        std::vector<open_element> open_elements;
+        // Open pre and listing elements
+        size_t preserve_depth;
+        std::wstring raw_text_tag;
+        bool in_plaintext;
+
+        // A space seen but not written yet, it's only needed between two
+        // pieces of inline content
+        bool pending_space;
+        bool after_block;
+        bool ends_with_space;
+
+        // An optional end tag, written or dropped once the next tag shows
+        // whether the parser would imply it
+        std::wstring pending_end_tag;
+};
+
+#endif // HTMLMINIFIER_HPP
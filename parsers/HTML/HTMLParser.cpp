@@ -2,323 +2,2669 @@
 #include <iostream>
 #endif // CONSOLE
 
+#include <map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "SPSCRing.hpp"
 #include "../../elements/HTML/HTMLBodyElement.hpp"
 #include "../../elements/HTML/HTMLTextElement.hpp"
 #include "../../elements/HTML/HTMLParagraphElement.hpp"
+#include "../../elements/HTML/HTMLTagRegistry.hpp"
+#include "../../document/DOMArena.hpp"
 #include "HTMLParser.hpp"
 
-HTMLParser::HTMLParser()
+// Compiled with PARSER_STATISTICS the tree builder counts what it does into
+// an HTMLParserStatistics that ends up on the Document. Without it these
+// expand to nothing.
+#ifdef PARSER_STATISTICS
+#define COUNT_PARSE_ERROR(type) \
+    (statistics.parse_errors[HTMLParserStatistics::type]++)
+#define COUNT_TOKEN_IN_MODE(mode) (statistics.tokens_per_mode[mode]++)
+#define NOTE_OPEN_ELEMENTS() \
+    (statistics.max_open_elements = \
+     std::max(statistics.max_open_elements, open_elements.size()))
+#define NOTE_FORMATTING_ELEMENTS() \
+    (statistics.max_formatting_elements = \
+     std::max(statistics.max_formatting_elements, active_formatting_elements.size()))
+#else
+#define COUNT_PARSE_ERROR(type) ((void) 0)
+#define COUNT_TOKEN_IN_MODE(mode) ((void) 0)
+#define NOTE_OPEN_ELEMENTS() ((void) 0)
+#define NOTE_FORMATTING_ELEMENTS() ((void) 0)
+#endif // PARSER_STATISTICS
+
+// Tags the fast path knows how to handle without the insertion mode
+// machinery. Anything else (tables, forms, foreign content, raw text
+// elements...) goes through the full algorithm.
+enum fast_tag_kind
+{
+    fast_none,
+    fast_plain,
+    fast_formatting,
+    fast_void,
+    fast_rule,
+    fast_block,
+    fast_heading,
+    fast_list_item
+};
+
+static fast_tag_kind fast_kind_of(HTMLTagId tag_id)
+{
+    switch (tag_id)
+    {
+        case tag_abbr: case tag_bdi: case tag_bdo: case tag_cite:
+        case tag_data: case tag_del: case tag_dfn: case tag_ins:
+        case tag_kbd: case tag_label: case tag_mark: case tag_q:
+        case tag_samp: case tag_span: case tag_sub: case tag_sup:
+        case tag_time: case tag_var:
+            return fast_plain;
+
+        case tag_a: case tag_b: case tag_big: case tag_code:
+        case tag_em: case tag_font: case tag_i: case tag_s:
+        case tag_small: case tag_strike: case tag_strong: case tag_tt:
+        case tag_u:
+            return fast_formatting;
+
+        case tag_br: case tag_img: case tag_wbr:
+            return fast_void;
+
+        case tag_hr:
+            return fast_rule;
+
+        case tag_address: case tag_article: case tag_aside:
+        case tag_blockquote: case tag_center: case tag_details:
+        case tag_dialog: case tag_dir: case tag_div: case tag_dl:
+        case tag_figcaption: case tag_figure: case tag_footer:
+        case tag_header: case tag_hgroup: case tag_main: case tag_menu:
+        case tag_nav: case tag_ol: case tag_p: case tag_search:
+        case tag_section: case tag_summary: case tag_ul:
+            return fast_block;
+
+        case tag_h1: case tag_h2: case tag_h3:
+        case tag_h4: case tag_h5: case tag_h6:
+            return fast_heading;
+
+        case tag_li: case tag_dd: case tag_dt:
+            return fast_list_item;
+
+        default:
+            return fast_none;
+    }
+}
+
+HTMLParser::HTMLParser()
+{
+    tokenizer = HTMLTokenizer();
+    head_element_pointer = nullptr;
+    state = initial;
+    original_state = initial;
+    fragment_context = nullptr;
+    pending_position = 0;
+    input_finished = false;
+    resumable_in_progress = false;
+    head_only = false;
+    pipelined = false;
+    pipeline_running = false;
+    pipeline_failed = false;
+    predicted_tokenizer_state = HTMLTokenizer::data_state;
+    track_source = false;
+    token_start = 0;
+    token_end = 0;
+    tracked_stack_size = 0;
+    tracked_current = nullptr;
+    tracked_parent = nullptr;
+    pruned_root = nullptr;
+    pruned_depth = 0;
+    limits_enabled = false;
+    limits_hit = 0;
+    node_count = 0;
+    dom_bytes = 0;
+    input_cut_off = false;
+    pending_text_parent = nullptr;
+    arena = nullptr;
+    deferral = 0;
+    deferred_element = nullptr;
+    events = nullptr;
+}
+
+bool HTMLParser::is_formatting_tag(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::formatting_tag);
+}
+
+bool HTMLParser::is_special_tag(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::special_tag);
+}
+
+bool HTMLParser::is_void_tag(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::void_tag);
+}
+
+bool HTMLParser::is_heading_tag(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::heading_tag);
+}
+
+bool HTMLParser::closes_p_element(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::closes_p);
+}
+
+bool HTMLParser::is_implied_end_tag(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::implied_end);
+}
+
+bool HTMLParser::is_scope_boundary_tag(HTMLTagId tag_id)
+{
+    return HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::scope_boundary);
+}
+
+bool HTMLParser::is_formatting_tag(const std::wstring &tag_name)
+{
+    return is_formatting_tag(HTMLTagRegistry::lookup(tag_name));
+}
+
+bool HTMLParser::is_special_tag(const std::wstring &tag_name)
+{
+    return is_special_tag(HTMLTagRegistry::lookup(tag_name));
+}
+
+bool HTMLParser::is_void_tag(const std::wstring &tag_name)
+{
+    return is_void_tag(HTMLTagRegistry::lookup(tag_name));
+}
+
+bool HTMLParser::is_heading_tag(const std::wstring &tag_name)
+{
+    return is_heading_tag(HTMLTagRegistry::lookup(tag_name));
+}
+
+bool HTMLParser::closes_p_element(const std::wstring &tag_name)
+{
+    return closes_p_element(HTMLTagRegistry::lookup(tag_name));
+}
+
+bool HTMLParser::is_implied_end_tag(const std::wstring &tag_name)
+{
+    return is_implied_end_tag(HTMLTagRegistry::lookup(tag_name));
+}
+
+bool HTMLParser::is_scope_boundary_tag(const std::wstring &tag_name)
+{
+    return is_scope_boundary_tag(HTMLTagRegistry::lookup(tag_name));
+}
+
+void HTMLParser::reconstruct_active_formatting_elements()
+{
+    // https://html.spec.whatwg.org/multipage/parsing.html#reconstruct-the-active-formatting-elements
+    if (active_formatting_elements.empty())
+        return;
+
+    size_t index = active_formatting_elements.size() - 1;
+
+    if (active_formatting_elements.is_marker(index) ||
+            index_in_open_elements(active_formatting_elements.element_at(index).get())
+            != ActiveFormattingList::npos)
+        return;
+
+    // Rewind to the first entry that still has to be reopened
+    while (index > 0)
+    {
+        index--;
+
+        if (active_formatting_elements.is_marker(index) ||
+                index_in_open_elements(active_formatting_elements.element_at(index).get())
+                != ActiveFormattingList::npos)
+        {
+            index++;
+            break;
+        }
+    }
+
+    // Advance and create, through the element filter like the original
+    for (; index < active_formatting_elements.size(); index++)
+    {
+        std::shared_ptr<HTMLElement> element = insert_html_element_for_token(
+                active_formatting_elements.token_at(index));
+
+        active_formatting_elements.replace_at(index, element);
+    }
+}
+
+void HTMLParser::add_element_to_formatting_list(const std::shared_ptr<HTMLElement> &element,
+        const std::shared_ptr<HTMLToken> &token)
+{
+    active_formatting_elements.push(element, token);
+    NOTE_FORMATTING_ELEMENTS();
+}
+
+bool HTMLParser::is_element_in_scope(HTMLTagId tag_id)
+{
+    return is_element_in_specific_scope(tag_id, nullptr, false, false);
+}
+
+bool HTMLParser::is_element_in_scope(const HTMLElement *element)
+{
+    return is_element_in_specific_scope(element->get_tag_id(), element, false, false);
+}
+
+bool HTMLParser::is_element_in_button_scope(HTMLTagId tag_id)
+{
+    return is_element_in_specific_scope(tag_id, nullptr, true, false);
+}
+
+bool HTMLParser::is_element_in_list_item_scope(HTMLTagId tag_id)
+{
+    return is_element_in_specific_scope(tag_id, nullptr, false, true);
+}
+
+bool HTMLParser::is_element_in_specific_scope(HTMLTagId tag_id,
+        const HTMLElement *element, bool button_scope, bool list_item_scope)
+{
+    // https://html.spec.whatwg.org/multipage/parsing.html#has-an-element-in-the-specific-scope
+    // Most of the time nothing with the tag is open at all
+    if (open_elements.count_of(tag_id) == 0)
+        return false;
+
+    for (size_t i = open_elements.size(); i > 0; i--)
+    {
+        const HTMLElement *node = open_elements[i - 1].get();
+        const HTMLTagId node_tag = node->get_tag_id();
+
+        if (element != nullptr ? node == element : node_tag == tag_id)
+            return true;
+
+        if (is_scope_boundary_tag(node_tag) ||
+                (button_scope && node_tag == tag_button) ||
+                (list_item_scope && (node_tag == tag_ol || node_tag == tag_ul)))
+            return false;
+    }
+
+    return false;
+}
+
+void HTMLParser::insert_html_element(const std::shared_ptr<HTMLElement> &element,
+        const HTMLToken *token)
+{
+    // A character token can make the parser insert an implied element, the
+    // text before it goes in first
+    flush_text();
+
+    if (track_source && !element->is_source_tracked())
+        track_source_start(element.get());
+
+    // Below a pruned element the parent is detached already, so attaching
+    // to it is harmless even when is_pruning() lost track of the root
+    if (!is_pruning() && events == nullptr)
+        open_elements.back()->add_child(element);
+
+    // Most of the tree construction rules look through the open elements,
+    // so nesting too deep ends the document rather than the DOM only
+    if (limits.max_depth != 0 && open_elements.size() >= limits.max_depth)
+    {
+        limits_hit |= HTMLParserLimits::depth_limited;
+        input_cut_off = true;
+    }
+
+    open_elements.push_back(element, token);
+    NOTE_OPEN_ELEMENTS();
+}
+
+std::shared_ptr<HTMLElement> HTMLParser::insert_html_element_for_token(const std::shared_ptr<HTMLToken> &token)
+{
+    std::shared_ptr<HTMLElement> element = construct_element_from_token(token);
+
+    if (!is_pruning() && is_pruned_by_filter(token))
+    {
+        // Open as usual so the tree construction rules see it, but never
+        // attach it to its parent
+        open_elements.push_back(element, token.get());
+        NOTE_OPEN_ELEMENTS();
+        pruned_root = element.get();
+        pruned_depth = open_elements.size();
+
+        return element;
+    }
+
+    insert_html_element(element, token.get());
+
+    // The tokenizer on the other thread is ahead already, the source
+    // positions would be off, and an event sink never asks for the content
+    if (deferral != 0 && state == in_body && !pipeline_running && !track_source &&
+            events == nullptr && is_deferrable(token))
+    {
+        tokenizer.skip_subtree_content();
+        deferred_element = element.get();
+    }
+
+    return element;
+}
+
+bool HTMLParser::is_pruned_by_filter(const std::shared_ptr<HTMLToken> &token)
+{
+    return filter && filter(token->get_tag_name(), token->get_attributes()) == prune_element;
+}
+
+bool HTMLParser::is_pruning()
+{
+    if (pruned_root == nullptr)
+        return false;
+
+    if (open_elements.size() >= pruned_depth &&
+            open_elements[pruned_depth - 1].get() == pruned_root)
+        return true;
+
+    pruned_root = nullptr;
+    return false;
+}
+
+void HTMLParser::set_element_filter(const element_filter &element_filter)
+{
+    filter = element_filter;
+}
+
+void HTMLParser::set_deferred_parsing(unsigned deferral_flags)
+{
+    deferral = deferral_flags;
+}
+
+bool HTMLParser::is_deferrable(const std::shared_ptr<HTMLToken> &token) const
+{
+    const HTMLTagId tag_id = token->get_tag_id();
+
+    if (tag_id == tag_template)
+        return (deferral & defer_templates) != 0;
+
+    if (tag_id == tag_noscript)
+        return (deferral & defer_noscript) != 0;
+
+    if ((deferral & defer_hidden) == 0 ||
+            token->get_attributes().count(L"hidden") == 0)
+        return false;
+
+    // Elements that something else than their own end tag can close would
+    // end somewhere else than the skipped source does
+    const HTMLTagRegistry::tag_info &info = HTMLTagRegistry::info(tag_id);
+
+    return (info.flags & (HTMLTagRegistry::formatting_tag |
+                HTMLTagRegistry::void_tag | HTMLTagRegistry::implied_end |
+                HTMLTagRegistry::scope_boundary | HTMLTagRegistry::heading_tag)) == 0 &&
+        info.text == HTMLTagRegistry::normal_text;
+}
+
+// The source of the contents and how the parser that skipped them was set
+// up. They're parsed like innerHTML, so nothing they leave open gets past
+// the element.
+struct deferred_fragment : public HTMLElement::deferred_content
+{
+    std::wstring source;
+    unsigned deferral_flags;
+    HTMLParserLimits limits;
+
+    std::vector<std::shared_ptr<HTMLElement>> build(const HTMLElement &element) const override
+    {
+        HTMLParser parser;
+        parser.set_deferred_parsing(deferral_flags);
+        parser.set_limits(limits);
+
+        return parser.parse_fragment(source, element);
+    }
+};
+
+void HTMLParser::take_deferred_content()
+{
+    // The token after the start tag is here, so the tokenizer either
+    // skipped the contents or found no end to them
+    std::shared_ptr<deferred_fragment> content = std::make_shared<deferred_fragment>();
+
+    if (tokenizer.take_skipped_subtree(content->source))
+    {
+        content->deferral_flags = deferral;
+        content->limits = limits;
+        deferred_element->set_deferred_content(content);
+
+        if (limits_enabled)
+            account_for(0, content->source.size() * sizeof(wchar_t));
+    }
+
+    deferred_element = nullptr;
+}
+
+size_t HTMLParser::index_in_open_elements(const HTMLElement *element) const
+{
+    // Searched from the top, the element we look for is usually close to it
+    if (open_elements.count_of(element->get_tag_id()) == 0)
+        return ActiveFormattingList::npos;
+
+    for (size_t i = open_elements.size(); i > 0; i--)
+    {
+        if (open_elements[i - 1].get() == element)
+            return i - 1;
+    }
+
+    return ActiveFormattingList::npos;
+}
+
+void HTMLParser::pop_open_elements_until(HTMLTagId tag_id)
+{
+    while (!open_elements.empty())
+    {
+        bool found = open_elements.back()->get_tag_id() == tag_id;
+        open_elements.pop_back();
+
+        if (found)
+            return;
+    }
+}
+
+void HTMLParser::generate_implied_end_tags(HTMLTagId exception)
+{
+    // No element of an unknown tag is ever implied, so tag_unknown leaves
+    // no exception
+    while (!open_elements.empty())
+    {
+        const HTMLTagId tag_id = open_elements.back()->get_tag_id();
+
+        if (tag_id == exception || !is_implied_end_tag(tag_id))
+            return;
+
+        open_elements.pop_back();
+    }
+}
+
+void HTMLParser::close_p_element()
+{
+    generate_implied_end_tags(tag_p);
+
+    #ifdef PARSER_STATISTICS
+    if (!open_elements.empty() && open_elements.back()->get_tag_id() != tag_p)
+        COUNT_PARSE_ERROR(end_tag_not_current_node);
+    #endif // PARSER_STATISTICS
+
+    pop_open_elements_until(tag_p);
+}
+
+bool HTMLParser::run_adoption_agency(const std::shared_ptr<HTMLToken> &token)
+{
+    // https://html.spec.whatwg.org/multipage/parsing.html#adoption-agency-algorithm
+    // Returns false if the token has to be handled as "any other end tag".
+    // Both loops are bounded and everything is moved around by index, so the
+    // only allocations are the element clones the algorithm asks for.
+    flush_text();
+
+    const HTMLTagId subject = token->get_tag_id();
+
+    if (open_elements.back()->get_tag_id() == subject &&
+            active_formatting_elements.index_of(open_elements.back().get()) ==
+            ActiveFormattingList::npos)
+    {
+        open_elements.pop_back();
+        return true;
+    }
+
+    for (int outer_loop = 0; outer_loop < 8; outer_loop++)
+    {
+        size_t formatting_index =
+            active_formatting_elements.find_after_last_marker(subject);
+
+        if (formatting_index == ActiveFormattingList::npos)
+            return false;
+
+        std::shared_ptr<HTMLElement> formatting_element =
+            active_formatting_elements.element_at(formatting_index);
+        size_t formatting_stack_index =
+            index_in_open_elements(formatting_element.get());
+
+        if (formatting_stack_index == ActiveFormattingList::npos)
+        {
+            COUNT_PARSE_ERROR(misnested_formatting_element);
+            active_formatting_elements.remove_at(formatting_index);
+            return true;
+        }
+
+        if (!is_element_in_scope(formatting_element.get()))
+        {
+            COUNT_PARSE_ERROR(misnested_formatting_element);
+            return true;
+        }
+
+        // If the formatting element is not the current node,
+        // this is a parse error, but we go on
+        #ifdef PARSER_STATISTICS
+        if (formatting_element != open_elements.back())
+            COUNT_PARSE_ERROR(misnested_formatting_element);
+        #endif // PARSER_STATISTICS
+
+        // Events can't move an element that is open already, the sink sees
+        // everything above the formatting element closed with it
+        size_t furthest_block_index = ActiveFormattingList::npos;
+
+        for (size_t i = formatting_stack_index + 1;
+                events == nullptr && i < open_elements.size(); i++)
+        {
+            if (is_special_tag(open_elements[i]->get_tag_id()))
+            {
+                furthest_block_index = i;
+                break;
+            }
+        }
+
+        if (furthest_block_index == ActiveFormattingList::npos)
+        {
+            // Off the list first, so the stack of an event sink gets the
+            // element back to reuse
+            active_formatting_elements.remove_at(formatting_index);
+            formatting_element.reset();
+            open_elements.resize(formatting_stack_index);
+            return true;
+        }
+
+        std::shared_ptr<HTMLElement> common_ancestor =
+            open_elements[formatting_stack_index - 1];
+        std::shared_ptr<HTMLElement> furthest_block =
+            open_elements[furthest_block_index];
+        std::shared_ptr<HTMLElement> last_node = furthest_block;
+        size_t bookmark = formatting_index;
+        size_t node_index = furthest_block_index;
+
+        // Everything from pruned_index up the stack is pruned, and stays so
+        // wherever the algorithm moves it: what was opened inside a pruned
+        // element never comes out. Nothing there gets attached, and the
+        // index follows the elements as they're removed and inserted below.
+        size_t pruned_index = is_pruning() ? pruned_depth - 1 : ActiveFormattingList::npos;
+
+        for (int inner_loop = 1; ; inner_loop++)
+        {
+            // Removing a node never moves the ones above it,
+            // so the node above is always at the next lower index
+            node_index--;
+            const std::shared_ptr<HTMLElement> &node = open_elements[node_index];
+
+            if (node == formatting_element)
+                break;
+
+            size_t node_list_index = active_formatting_elements.index_of(node.get());
+
+            if (inner_loop > 3 && node_list_index != ActiveFormattingList::npos)
+            {
+                active_formatting_elements.remove_at(node_list_index);
+
+                if (node_list_index < bookmark)
+                    bookmark--;
+
+                node_list_index = ActiveFormattingList::npos;
+            }
+
+            if (node_list_index == ActiveFormattingList::npos)
+            {
+                open_elements.remove_at(node_index);
+
+                if (node_index < pruned_index && pruned_index != ActiveFormattingList::npos)
+                    pruned_index--;
+
+                continue;
+            }
+
+            const std::shared_ptr<HTMLToken> &node_token =
+                active_formatting_elements.token_at(node_list_index);
+            std::shared_ptr<HTMLElement> replacement =
+                construct_element_from_token(node_token);
+
+            // The clone goes through the filter like any element inserted
+            // outside a pruned one, and takes everything above it along
+            if (node_index < pruned_index && is_pruned_by_filter(node_token))
+                pruned_index = node_index;
+
+            active_formatting_elements.replace_at(node_list_index, replacement);
+            open_elements.replace_at(node_index, replacement);
+
+            if (last_node == furthest_block)
+                bookmark = node_list_index + 1;
+
+            last_node = replacement;
+        }
+
+        // What's left between the formatting element and the furthest block
+        // goes in as a chain, each under the one below it on the stack. No
+        // foster parenting yet, so the appropriate place is always inside
+        // the common ancestor. Linked from the top down, the furthest block
+        // moves within the tree and the document doesn't walk it.
+        HTMLElement *parent = common_ancestor.get();
+
+        for (size_t i = formatting_stack_index + 1; i < pruned_index; i++)
+        {
+            parent->add_child(open_elements[i]);
+
+            if (open_elements[i] == furthest_block)
+                break;
+
+            parent = open_elements[i].get();
+        }
+
+        formatting_index = active_formatting_elements.index_of(formatting_element.get());
+        std::shared_ptr<HTMLToken> formatting_token =
+            active_formatting_elements.token_at(formatting_index);
+        std::shared_ptr<HTMLElement> new_element =
+            construct_element_from_token(formatting_token);
+
+        active_formatting_elements.remove_at(formatting_index);
+
+        if (formatting_index < bookmark)
+            bookmark--;
+
+        active_formatting_elements.insert_at(bookmark, new_element, formatting_token);
+
+        open_elements.remove_at(formatting_stack_index);
+
+        if (formatting_stack_index < pruned_index && pruned_index != ActiveFormattingList::npos)
+            pruned_index--;
+
+        furthest_block_index = index_in_open_elements(furthest_block.get());
+        open_elements.insert_at(furthest_block_index + 1, new_element);
+
+        if (furthest_block_index >= pruned_index)
+        {
+            // The furthest block has no children to give, and the clone
+            // goes into a pruned element
+        }
+        else if (is_pruned_by_filter(formatting_token))
+        {
+            furthest_block->move_children_to(new_element);
+            pruned_index = furthest_block_index + 1;
+        }
+        else
+        {
+            // In first, so the children stay in the tree on their way
+            furthest_block->add_child(new_element);
+
+            while (furthest_block->get_first_child() != new_element.get())
+                new_element->add_child(furthest_block->get_first_child()->get_handle());
+
+            if (pruned_index != ActiveFormattingList::npos)
+                pruned_index++;
+        }
+
+        if (pruned_index != ActiveFormattingList::npos)
+        {
+            pruned_root = open_elements[pruned_index].get();
+            pruned_depth = pruned_index + 1;
+        }
+    }
+
+    return true;
+}
+
+void HTMLParser::process_any_other_end_tag(const std::shared_ptr<HTMLToken> &token)
+{
+    const HTMLTagId tag_id = token->get_tag_id();
+
+    // The walk would end on <html> or another special element anyway
+    if (open_elements.count_of(tag_id) == 0)
+    {
+        COUNT_PARSE_ERROR(unexpected_end_tag);
+        return;
+    }
+
+    for (size_t i = open_elements.size(); i > 0; i--)
+    {
+        const HTMLElement *node = open_elements[i - 1].get();
+
+        // Unknown tags are told apart by name
+        if (node->get_tag_id() == tag_id &&
+                (tag_id != tag_unknown || node->get_title() == token->get_tag_name()))
+        {
+            generate_implied_end_tags(tag_id);
+
+            #ifdef PARSER_STATISTICS
+            if (open_elements.size() != i)
+                COUNT_PARSE_ERROR(end_tag_not_current_node);
+            #endif // PARSER_STATISTICS
+
+            open_elements.resize(i - 1);
+            return;
+        }
+
+        if (is_special_tag(node->get_tag_id()))
+        {
+            // Ignore the token
+            COUNT_PARSE_ERROR(unexpected_end_tag);
+            return;
+        }
+    }
+}
+
+void HTMLParser::close_list_item_for(HTMLTagId tag_id)
+{
+    // An <li> closes the open <li>, <dd> and <dt> close each other
+    if (tag_id == tag_li ? open_elements.count_of(tag_li) == 0 :
+            open_elements.count_of(tag_dd) + open_elements.count_of(tag_dt) == 0)
+        return;
+
+    for (size_t i = open_elements.size(); i > 0; i--)
+    {
+        const HTMLTagId node_tag = open_elements[i - 1]->get_tag_id();
+
+        if ((tag_id == tag_li && node_tag == tag_li) ||
+                (tag_id != tag_li && (node_tag == tag_dd || node_tag == tag_dt)))
+        {
+            generate_implied_end_tags(node_tag);
+            pop_open_elements_until(node_tag);
+            return;
+        }
+
+        if (is_special_tag(node_tag) && node_tag != tag_address &&
+                node_tag != tag_div && node_tag != tag_p)
+            return;
+    }
+}
+
+void HTMLParser::process_start_tag_in_body(const std::shared_ptr<HTMLToken> &token)
+{
+    const HTMLTagId tag_id = token->get_tag_id();
+
+    if (closes_p_element(tag_id))
+    {
+        if (is_element_in_button_scope(tag_p))
+            close_p_element();
+
+        insert_html_element_for_token(token);
+    }
+
+    else if (is_heading_tag(tag_id))
+    {
+        if (is_element_in_button_scope(tag_p))
+            close_p_element();
+
+        if (is_heading_tag(open_elements.back()->get_tag_id()))
+        {
+            COUNT_PARSE_ERROR(nested_heading);
+            open_elements.pop_back();
+        }
+
+        insert_html_element_for_token(token);
+    }
+
+    else if (tag_id == tag_li || tag_id == tag_dd || tag_id == tag_dt)
+    {
+        close_list_item_for(tag_id);
+
+        if (is_element_in_button_scope(tag_p))
+            close_p_element();
+
+        insert_html_element_for_token(token);
+    }
+
+    else if (tag_id == tag_a)
+    {
+        size_t index = active_formatting_elements.find_after_last_marker(tag_a);
+
+        if (index != ActiveFormattingList::npos)
+        {
+            COUNT_PARSE_ERROR(misnested_formatting_element);
+            std::shared_ptr<HTMLElement> old_anchor =
+                active_formatting_elements.element_at(index);
+
+            run_adoption_agency(token);
+
+            index = active_formatting_elements.index_of(old_anchor.get());
+            if (index != ActiveFormattingList::npos)
+                active_formatting_elements.remove_at(index);
+
+            // Not with events, where the anchor was closed unless it wasn't
+            // in scope, and then it has to stay open
+            index = index_in_open_elements(old_anchor.get());
+            if (index != ActiveFormattingList::npos && events == nullptr)
+                open_elements.remove_at(index);
+        }
+
+        reconstruct_active_formatting_elements();
+        add_element_to_formatting_list(insert_html_element_for_token(token), token);
+    }
+
+    else if (tag_id == tag_nobr)
+    {
+        reconstruct_active_formatting_elements();
+
+        if (is_element_in_scope(tag_nobr))
+        {
+            COUNT_PARSE_ERROR(misnested_formatting_element);
+            run_adoption_agency(token);
+            reconstruct_active_formatting_elements();
+        }
+
+        add_element_to_formatting_list(insert_html_element_for_token(token), token);
+    }
+
+    else if (is_formatting_tag(tag_id))
+    {
+        reconstruct_active_formatting_elements();
+        add_element_to_formatting_list(insert_html_element_for_token(token), token);
+    }
+
+    else if (tag_id == tag_applet || tag_id == tag_marquee || tag_id == tag_object)
+    {
+        reconstruct_active_formatting_elements();
+        insert_html_element_for_token(token);
+        active_formatting_elements.insert_marker();
+    }
+
+    else if (is_void_tag(tag_id))
+    {
+        if (tag_id == tag_hr && is_element_in_button_scope(tag_p))
+            close_p_element();
+        else if (tag_id != tag_hr)
+            reconstruct_active_formatting_elements();
+
+        insert_html_element_for_token(token);
+        open_elements.pop_back();
+    }
+
+    else
+    {
+        reconstruct_active_formatting_elements();
+        insert_html_element_for_token(token);
+    }
+
+    // Many more cases to implement
+}
+
+void HTMLParser::process_end_tag_in_body(const std::shared_ptr<HTMLToken> &token)
+{
+    const HTMLTagId tag_id = token->get_tag_id();
+
+    if (closes_p_element(tag_id))
+    {
+        if (!is_element_in_scope(tag_id))
+        {
+            // Ignore the token
+            COUNT_PARSE_ERROR(unexpected_end_tag);
+            return;
+        }
+
+        generate_implied_end_tags();
+        pop_open_elements_until(tag_id);
+    }
+
+    else if (tag_id == tag_li)
+    {
+        if (!is_element_in_list_item_scope(tag_li))
+            return;
+
+        generate_implied_end_tags(tag_li);
+        pop_open_elements_until(tag_li);
+    }
+
+    else if (tag_id == tag_dd || tag_id == tag_dt)
+    {
+        if (!is_element_in_scope(tag_id))
+            return;
+
+        generate_implied_end_tags(tag_id);
+        pop_open_elements_until(tag_id);
+    }
+
+    else if (is_heading_tag(tag_id))
+    {
+        if (!(is_element_in_scope(tag_h1) || is_element_in_scope(tag_h2) ||
+                is_element_in_scope(tag_h3) || is_element_in_scope(tag_h4) ||
+                is_element_in_scope(tag_h5) || is_element_in_scope(tag_h6)))
+            return;
+
+        generate_implied_end_tags();
+
+        while (!open_elements.empty())
+        {
+            bool found = is_heading_tag(open_elements.back()->get_tag_id());
+            open_elements.pop_back();
+
+            if (found)
+                break;
+        }
+    }
+
+    else if (is_formatting_tag(tag_id))
+    {
+        if (!run_adoption_agency(token))
+            process_any_other_end_tag(token);
+    }
+
+    else if (tag_id == tag_applet || tag_id == tag_marquee || tag_id == tag_object)
+    {
+        if (!is_element_in_scope(tag_id))
+            return;
+
+        generate_implied_end_tags();
+        pop_open_elements_until(tag_id);
+        active_formatting_elements.clear_to_last_marker();
+    }
+
+    else
+        process_any_other_end_tag(token);
+}
+
+void HTMLParser::reset_insertion_mode()
+{
+    // https://html.spec.whatwg.org/multipage/parsing.html#reset-the-insertion-mode-appropriately
+    for (size_t i = open_elements.size(); i > 0; i--)
+    {
+        const bool last = i == 1;
+        const HTMLElement *node = open_elements[i - 1].get();
+
+        if (last && fragment_context != nullptr)
+            node = fragment_context;
+
+        const HTMLTagId tag_id = node->get_tag_id();
+
+        // The table, select and template modes aren't implemented yet, their
+        // contents end up in body for now
+
+        if (tag_id == tag_head && !last)
+        {
+            state = in_head;
+            return;
+        }
+
+        if (tag_id == tag_body)
+        {
+            state = in_body;
+            return;
+        }
+
+        if (tag_id == tag_frameset)
+        {
+            state = in_frameset;
+            return;
+        }
+
+        if (tag_id == tag_html)
+        {
+            state = head_element_pointer == nullptr ? before_head : after_head;
+            return;
+        }
+
+        if (last)
+        {
+            state = in_body;
+            return;
+        }
+    }
+
+    state = in_body;
+}
+
+bool HTMLParser::process_token_fast(const std::shared_ptr<HTMLToken> &token)
+{
+    // Does the same as the in body insertion mode for the tokens it accepts,
+    // and leaves the open elements and the active formatting elements just
+    // as the full algorithm would. Whether it accepts a token is decided
+    // from the token, its tag ID and the current node before anything
+    // changes, so a token it turns down (returning false) costs the full
+    // algorithm nothing twice. The next token can come back here as long as
+    // the insertion mode is in body.
+    if (token->is_char_token())
+    {
+        if (is_pruning())
+            return true;
+
+        reconstruct_active_formatting_elements();
+        insert_character(token);
+        return true;
+    }
+
+    if (token->is_doctype_token())
+    {
+        COUNT_PARSE_ERROR(unexpected_doctype);
+        return true;
+    }
+
+    if (token->is_comment_token())
+        // Comments aren't kept yet
+        return true;
+
+    const bool start_tag = token->is_start_token();
+
+    if (!start_tag && !token->is_end_token())
+        return false;
+
+    const HTMLTagId tag_id = token->get_tag_id();
+    const fast_tag_kind kind = fast_kind_of(tag_id);
+
+    if (kind == fast_none)
+        return false;
+
+    if (!start_tag)
+    {
+        // End tags are only easy when they close the current node, everything
+        // else involves scopes, implied end tags or the adoption agency. A
+        // formatting element also has to be the last one in the list.
+        if (kind == fast_void || kind == fast_rule || open_elements.size() < 2 ||
+                open_elements.back()->get_tag_id() != tag_id)
+            return false;
+
+        if (kind == fast_formatting)
+        {
+            if (active_formatting_elements.empty() ||
+                    active_formatting_elements.element_at(
+                        active_formatting_elements.size() - 1) != open_elements.back())
+                return false;
+
+            active_formatting_elements.remove_at(active_formatting_elements.size() - 1);
+        }
+
+        open_elements.pop_back();
+        return true;
+    }
+
+    // A second <a> runs the adoption agency
+    if (tag_id == tag_a && active_formatting_elements.has_after_last_marker(tag_a))
+        return false;
+
+    switch (kind)
+    {
+        case fast_plain:
+            reconstruct_active_formatting_elements();
+            insert_html_element_for_token(token);
+            break;
+
+        case fast_formatting:
+            reconstruct_active_formatting_elements();
+            add_element_to_formatting_list(insert_html_element_for_token(token), token);
+            break;
+
+        case fast_void:
+            reconstruct_active_formatting_elements();
+            insert_html_element_for_token(token);
+            open_elements.pop_back();
+            break;
+
+        case fast_rule:
+            if (is_element_in_button_scope(tag_p))
+                close_p_element();
+
+            insert_html_element_for_token(token);
+            open_elements.pop_back();
+            break;
+
+        case fast_block:
+            if (is_element_in_button_scope(tag_p))
+                close_p_element();
+
+            insert_html_element_for_token(token);
+            break;
+
+        case fast_heading:
+            if (is_element_in_button_scope(tag_p))
+                close_p_element();
+
+            if (is_heading_tag(open_elements.back()->get_tag_id()))
+            {
+                COUNT_PARSE_ERROR(nested_heading);
+                open_elements.pop_back();
+            }
+
+            insert_html_element_for_token(token);
+            break;
+
+        case fast_list_item:
+            close_list_item_for(tag_id);
+
+            if (is_element_in_button_scope(tag_p))
+                close_p_element();
+
+            insert_html_element_for_token(token);
+            break;
+
+        case fast_none:
+            break;
+    }
+
+    return true;
+}
+
+Document HTMLParser::construct_document_from_string(std::wstring &html)
+{
+    #ifdef CONSOLE
+    if (!tokenizer.is_valid_html_string(html))
+        std::cerr << "ERROR: HTML string is not valid! "
+            "Bad things may happen." << std::endl;
+    #endif // CONSOLE
+    Document document = Document();
+    arena = document.get_arena();
+
+    // With a single core the two threads would just take turns
+    // The tokenizer thread doesn't report source positions
+    if (pipelined && !track_source && html.size() >= pipeline_minimum_length &&
+            std::thread::hardware_concurrency() > 1)
+    {
+        if (construct_document_pipelined(html, document))
+            return finalize_document(document);
+
+        // The tokenizer guessed a state switch wrong, start over serially
+        document = Document();
+        arena = document.get_arena();
+    }
+
+    reset_tree_construction();
+    tokenizer.reset();
+
+    std::wstring::const_iterator it = html.cbegin();
+
+    while (it != html.cend() && !input_cut_off)
+    {
+        const size_t start = it - html.cbegin();
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(html, it);
+
+        if (track_source)
+            begin_tracked_token(start, it - html.cbegin());
+
+        while (process_token(token, document))
+            ; // reprocess the token in the new insertion mode
+
+        if (track_source)
+            end_tracked_token(token);
+    }
+
+    if (track_source)
+    {
+        for (const std::shared_ptr<HTMLElement> &element : document.get_elements())
+            make_source_offsets_relative(element.get(),
+                    element->get_source_range().start);
+    }
+
+    return finalize_document(document);
+}
+
+class HTMLParser::tokenizer_pipeline
+{
+    public:
+        tokenizer_pipeline(HTMLParser &tree_builder, const std::wstring &html);
+        ~tokenizer_pipeline();
+
+        // nullptr once the tokenizer is done
+        std::shared_ptr<HTMLToken> next_token();
+        // The tokenizer stops after the token it's on
+        void cancel();
+
+    private:
+        void tokenize(const std::wstring &html);
+
+        HTMLParser &parser;
+        std::unique_ptr<SPSCRing<std::shared_ptr<HTMLToken>, 1024>> ring;
+        std::atomic<bool> cancelled;
+        bool drained;
+        // Last, so it starts once everything else is there
+        std::thread thread;
+};
+
+HTMLParser::tokenizer_pipeline::tokenizer_pipeline(HTMLParser &tree_builder,
+        const std::wstring &html) :
+    parser(tree_builder), ring(new SPSCRing<std::shared_ptr<HTMLToken>, 1024>()),
+    cancelled(false), drained(false)
+{
+    parser.pipeline_running = true;
+    parser.pipeline_failed = false;
+
+    // Tokens are dropped on this thread while the other one makes new ones
+    parser.tokenizer.set_token_recycling(false);
+
+    thread = std::thread(&tokenizer_pipeline::tokenize, this, std::cref(html));
+}
+
+HTMLParser::tokenizer_pipeline::~tokenizer_pipeline()
+{
+    // Also when processing a token threw. The tokenizer may be waiting for
+    // room in the ring, so it's emptied until the end of the tokens shows.
+    cancel();
+
+    while (!drained)
+        next_token();
+
+    thread.join();
+    parser.pipeline_running = false;
+    parser.tokenizer.set_token_recycling(true);
+}
+
+std::shared_ptr<HTMLToken> HTMLParser::tokenizer_pipeline::next_token()
+{
+    std::shared_ptr<HTMLToken> token = ring->pop();
+
+    if (token == nullptr)
+        drained = true;
+
+    return token;
+}
+
+void HTMLParser::tokenizer_pipeline::cancel()
+{
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+void HTMLParser::tokenizer_pipeline::tokenize(const std::wstring &html)
+{
+    HTMLTokenizer &tokenizer = parser.tokenizer;
+    std::wstring::const_iterator it = html.cbegin();
+
+    while (it != html.cend() && !cancelled.load(std::memory_order_relaxed))
+    {
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(html, it);
+
+        if (token->is_start_token())
+        {
+            HTMLTokenizer::tokenizer_state predicted =
+                HTMLTokenizer::state_for_start_tag(token->get_tag_id());
+
+            if (predicted != HTMLTokenizer::data_state)
+                tokenizer.switch_to(predicted);
+        }
+
+        ring->push(std::move(token));
+    }
+
+    // nullptr marks the end of the token stream
+    ring->push(nullptr);
+}
+
+bool HTMLParser::construct_document_pipelined(const std::wstring &html, Document &document)
+{
+    // The tokenizer runs on its own thread and can't wait for the tree
+    // builder to switch its state after <title>, <script> and friends. It
+    // switches on its own using HTMLTokenizer::state_for_start_tag, and the
+    // tree builder checks every switch it makes against that guess. On a
+    // mismatch everything is thrown away and the caller parses serially.
+    reset_tree_construction();
+    tokenizer.reset();
+
+    tokenizer_pipeline pipeline(*this, html);
+
+    while (std::shared_ptr<HTMLToken> token = pipeline.next_token())
+    {
+        predicted_tokenizer_state = token->is_start_token() ?
+            HTMLTokenizer::state_for_start_tag(token->get_tag_id()) :
+            HTMLTokenizer::data_state;
+
+        while (process_token(token, document))
+            ; // reprocess the token in the new insertion mode
+
+        // The tokenizer switched, but the tree builder didn't
+        if (predicted_tokenizer_state != HTMLTokenizer::data_state)
+            pipeline_failed = true;
+
+        // The pipeline stops the tokenizer on the way out
+        if (pipeline_failed || input_cut_off)
+            break;
+    }
+
+    return !pipeline_failed;
+}
+
+std::vector<std::shared_ptr<HTMLElement>> HTMLParser::parse_fragment(
+        const std::wstring &html, const std::shared_ptr<HTMLElement> &context)
+{
+    return parse_fragment(html, *context);
+}
+
+std::vector<std::shared_ptr<HTMLElement>> HTMLParser::parse_fragment(
+        const std::wstring &html, const HTMLElement &context)
+{
+    // https://html.spec.whatwg.org/multipage/parsing.html#parsing-html-fragments
+    Document document = Document();
+    arena = document.get_arena();
+
+    reset_tree_construction();
+
+    // No start tag has been seen, so nothing closes a raw text context
+    tokenizer.reset();
+    tokenizer.switch_to(HTMLTokenizer::state_for_start_tag(context.get_tag_id()));
+
+    std::shared_ptr<HTMLElement> root = construct_html_element();
+    document.add_element(root);
+    open_elements.push_back(root);
+
+    fragment_context = &context;
+    reset_insertion_mode();
+
+    std::wstring::const_iterator it = html.cbegin();
+
+    while (it != html.cend() && !input_cut_off)
+    {
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(html, it);
+
+        while (process_token(token, document))
+            ; // reprocess the token in the new insertion mode
+    }
+
+    flush_text();
+
+    const unsigned fragment_limits_hit = limits_hit;
+    fragment_context = nullptr;
+    arena = nullptr;
+    reset_tree_construction();
+    limits_hit = fragment_limits_hit;
+
+    return root->take_children();
+}
+
+void HTMLParser::set_source_tracking(bool tracking)
+{
+    track_source = tracking;
+}
+
+void HTMLParser::track_source_start(HTMLElement *element)
+{
+    // Absolute for now, construct_document_from_string makes it relative
+    HTMLElement::source_range &source = element->get_source_range();
+    source.tracked = true;
+    source.start = token_start;
+}
+
+void HTMLParser::begin_tracked_token(size_t start, size_t end)
+{
+    token_start = start;
+    token_end = end;
+    tracked_stack_size = open_elements.size();
+    tracked_current = open_elements.empty() ? nullptr : open_elements.back().get();
+    tracked_parent = open_elements.size() < 2 ? nullptr :
+        open_elements[open_elements.size() - 2].get();
+}
+
+void HTMLParser::end_tracked_token(const std::shared_ptr<HTMLToken> &token)
+{
+    if (token->is_start_token())
+    {
+        if (open_elements.empty() || open_elements.back().get() == tracked_current)
+            return;
+
+        HTMLElement::source_range &source = open_elements.back()->get_source_range();
+
+        // Elements reopened for the token start at the same place
+        if (open_elements.back()->get_tag_id() != token->get_tag_id() ||
+                open_elements.back()->get_title() != token->get_tag_name() ||
+                source.start != static_cast<long long>(token_start))
+            return;
+
+        source.content_start = token_end - token_start;
+        source.clean_start = opens_cleanly();
+    }
+
+    else if (token->is_end_token() && tracked_current != nullptr)
+    {
+        HTMLElement::source_range &source = tracked_current->get_source_range();
+
+        if (!source.clean_start || tracked_current->get_title() != token->get_tag_name())
+            return;
+
+        // Its own end tag has to close it and nothing else
+        if (open_elements.size() + 1 != tracked_stack_size ||
+                open_elements.empty() || open_elements.back().get() != tracked_parent ||
+                state != in_body || !formatting_list_settled())
+            return;
+
+        source.content_length = token_start - (source.start + source.content_start);
+        source.reparsable = true;
+    }
+}
+
+bool HTMLParser::formatting_list_settled() const
+{
+    return active_formatting_elements.empty() ||
+        active_formatting_elements.is_marker(active_formatting_elements.size() - 1);
+}
+
+bool HTMLParser::opens_cleanly() const
+{
+    // Whether the contents of the element that was just opened come out
+    // the same when parsed on their own: nothing they contain may reopen,
+    // close or adopt anything outside of the element
+    if (state != in_body || tokenizer.get_state() != HTMLTokenizer::data_state ||
+            !formatting_list_settled())
+        return false;
+
+    const HTMLTagId tag_id = open_elements.back()->get_tag_id();
+    const fast_tag_kind kind = fast_kind_of(tag_id);
+
+    if (kind == fast_none || kind == fast_formatting || kind == fast_void ||
+            kind == fast_rule)
+        return false;
+
+    // Blocks inside would close a <p> in button scope further down. While
+    // reparsing, the context stands in for the root and everything below it
+    // is known to be fine.
+    for (size_t i = open_elements.size() - 1; i > 0; i--)
+    {
+        const HTMLTagId below = i == 1 && fragment_context != nullptr ?
+            fragment_context->get_tag_id() : open_elements[i - 1]->get_tag_id();
+
+        if (below == tag_p)
+            return false;
+
+        if (is_scope_boundary_tag(below) || below == tag_button)
+            break;
+    }
+
+    // And list items inside would close the ones close_list_item_for reaches
+    if (is_special_tag(tag_id) && tag_id != tag_address && tag_id != tag_div &&
+            tag_id != tag_p)
+        return true;
+
+    for (size_t i = open_elements.size() - 1; i > 0; i--)
+    {
+        const HTMLTagId below = i == 1 && fragment_context != nullptr ?
+            fragment_context->get_tag_id() : open_elements[i - 1]->get_tag_id();
+
+        if (below == tag_li || below == tag_dd || below == tag_dt)
+            return false;
+
+        if (is_special_tag(below) && below != tag_address && below != tag_div &&
+                below != tag_p)
+            break;
+    }
+
+    return true;
+}
+
+static bool start_tag_closes_context(HTMLTagId context_tag, HTMLTagId tag_id)
+{
+    const fast_tag_kind kind = fast_kind_of(tag_id);
+
+    if (context_tag == tag_p)
+        return kind == fast_block || kind == fast_rule ||
+            kind == fast_heading || kind == fast_list_item;
+
+    if (context_tag == tag_li)
+        return tag_id == tag_li;
+
+    if (context_tag == tag_dd || context_tag == tag_dt)
+        return tag_id == tag_dd || tag_id == tag_dt;
+
+    return kind == fast_heading && HTMLParser::is_heading_tag(context_tag);
+}
+
+bool HTMLParser::parse_clean_fragment(const std::wstring &html, size_t base_offset,
+        const HTMLElement *context, const std::shared_ptr<HTMLElement> &root)
+{
+    // Parses html into root as the contents of context, but only as far as
+    // the fragment fast path gets, which also keeps the result independent
+    // of anything around context. Returns false if it didn't get to the end
+    // or the contents would have closed context in the document.
+    reset_tree_construction();
+    tokenizer.reset();
+    open_elements.push_back(root);
+    state = in_body;
+    fragment_context = context;
+
+    size_t position = 0;
+    bool clean = true;
+
+    // Cut off by a limit it's no use, the caller parses everything again
+    while (clean && !input_cut_off)
+    {
+        const size_t start = position;
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(html, position, false);
+
+        // No more tokens, or the last one runs into the end tag of context
+        if (token == nullptr)
+            break;
+
+        if (token->is_start_token() &&
+                start_tag_closes_context(context->get_tag_id(), token->get_tag_id()))
+            clean = false;
+
+        if (clean)
+        {
+            if (!token->is_char_token())
+                flush_text();
+
+            begin_tracked_token(base_offset + start, base_offset + position);
+            clean = process_token_fast(token);
+
+            if (clean)
+                end_tracked_token(token);
+        }
+    }
+
+    flush_text();
+
+    clean = clean && !input_cut_off && position == html.size() &&
+        open_elements.size() == 1 && active_formatting_elements.empty() &&
+        tokenizer.get_state() == HTMLTokenizer::data_state;
+
+    const unsigned fragment_limits_hit = limits_hit;
+    fragment_context = nullptr;
+    reset_tree_construction();
+    limits_hit = fragment_limits_hit;
+
+    return clean;
+}
+
+// One step of find_reparse_context(): candidates come in source order, the
+// last tracked one starting at or before the edit is the one to go into.
+// False once they start past it.
+static bool consider_reparse_candidate(HTMLElement *candidate, long long parent_start,
+        long long edit_start, HTMLElement *&next, long long &next_start)
+{
+    if (!candidate->is_source_tracked())
+        return true;
+
+    const long long candidate_start = parent_start + candidate->get_source_range().start;
+
+    if (candidate_start > edit_start)
+        return false;
+
+    next = candidate;
+    next_start = candidate_start;
+
+    return true;
+}
+
+std::shared_ptr<HTMLElement> HTMLParser::find_reparse_context(const Document &document,
+        const text_edit &edit, long long &content_start) const
+{
+    // The innermost reparsable element with the whole edit in its contents.
+    // Only the children along the path are looked at, through the links, so
+    // the one found is the only handle made.
+    const long long edit_start = edit.offset;
+    const long long edit_end = edit_start + edit.deleted_length;
+
+    HTMLElement *context = nullptr;
+    HTMLElement *parent = nullptr;
+    long long parent_start = 0;
+
+    while (true)
+    {
+        HTMLElement *next = nullptr;
+        long long next_start = 0;
+
+        if (parent == nullptr)
+        {
+            for (const std::shared_ptr<HTMLElement> &root : document.get_elements())
+            {
+                if (!consider_reparse_candidate(root.get(), parent_start, edit_start,
+                        next, next_start))
+                    break;
+            }
+        }
+        else
+        {
+            for (HTMLElement *child : parent->children())
+            {
+                if (!consider_reparse_candidate(child, parent_start, edit_start,
+                        next, next_start))
+                    break;
+            }
+        }
+
+        if (next == nullptr)
+            return context != nullptr ? context->get_handle() : nullptr;
+
+        const HTMLElement::source_range &source = next->get_source_range();
+        const long long next_content_start = next_start + source.content_start;
+
+        if (source.reparsable && edit_start >= next_content_start &&
+                edit_end <= next_content_start +
+                static_cast<long long>(source.content_length))
+        {
+            context = next;
+            content_start = next_content_start;
+        }
+
+        parent = next;
+        parent_start = next_start;
+    }
+}
+
+void HTMLParser::make_source_offsets_relative(HTMLElement *root, long long root_start)
+{
+    // While parsing the offsets are absolute. Relative to the parent an edit
+    // only has to touch the elements on the path to it and their siblings.
+    std::vector<std::pair<HTMLElement *, long long>> pending = {{root, root_start}};
+
+    while (!pending.empty())
+    {
+        HTMLElement *element = pending.back().first;
+        const long long start = pending.back().second;
+        pending.pop_back();
+
+        for (HTMLElement *child = element->get_first_child(); child != nullptr;
+                child = child->get_next_sibling())
+        {
+            // Text nodes aren't tracked
+            if (!child->is_source_tracked())
+                continue;
+
+            HTMLElement::source_range &source = child->get_source_range();
+            const long long child_start = source.start;
+            source.start = child_start - start;
+            pending.emplace_back(child, child_start);
+        }
+    }
+}
+
+Document HTMLParser::reparse(const std::wstring &html, Document &document,
+        const text_edit &edit)
+{
+    if (edit.offset > html.size())
+    {
+        #ifdef CONSOLE
+        std::cerr << "ERROR: Edit starts past the end of the source!" << std::endl;
+        #endif // CONSOLE
+        return document;
+    }
+
+    // Whatever comes out of here can be reparsed again. The setting goes
+    // back to what it was for the parses after this one.
+    const bool was_tracking = track_source;
+    track_source = true;
+
+    const size_t deleted_length = std::min(edit.deleted_length, html.size() - edit.offset);
+    long long content_start = 0;
+    std::shared_ptr<HTMLElement> context =
+        find_reparse_context(document, edit, content_start);
+
+    if (context != nullptr)
+    {
+        HTMLElement::source_range &source = context->get_source_range();
+        std::wstring contents = html.substr(content_start, source.content_length);
+        contents.replace(edit.offset - content_start, deleted_length,
+                edit.inserted_text);
+
+        // Straight into the arena of the document the result goes into
+        arena = document.get_arena();
+        std::shared_ptr<HTMLElement> root = construct_html_element();
+        const bool clean = parse_clean_fragment(contents, content_start,
+                context.get(), root);
+        arena = nullptr;
+
+        if (clean)
+        {
+            const long long context_start = content_start - source.content_start;
+            const long long edit_end = edit.offset + deleted_length;
+            const long long delta = static_cast<long long>(edit.inserted_text.size()) -
+                static_cast<long long>(deleted_length);
+
+            context->take_children();
+
+            for (const std::shared_ptr<HTMLElement> &child : root->take_children())
+                context->add_child(child);
+
+            make_source_offsets_relative(context.get(), context_start);
+            source.content_length += delta;
+
+            // Everything after the edit moved, but relative to their parents
+            // only the following siblings along the path did
+            HTMLElement *node = context.get();
+            long long node_start = context_start;
+
+            while (node->get_parent() != nullptr)
+            {
+                HTMLElement *parent = node->get_parent();
+                const long long parent_start = node_start - node->get_source_range().start;
+
+                for (HTMLElement *sibling = parent->get_first_child(); sibling != nullptr;
+                        sibling = sibling->get_next_sibling())
+                {
+                    if (sibling == node || !sibling->is_source_tracked())
+                        continue;
+
+                    HTMLElement::source_range &sibling_source = sibling->get_source_range();
+
+                    if (parent_start + sibling_source.start >= edit_end)
+                        sibling_source.start += delta;
+                }
+
+                if (parent->get_source_range().reparsable)
+                    parent->get_source_range().content_length += delta;
+
+                node = parent;
+                node_start = parent_start;
+            }
+
+            track_source = was_tracking;
+            return document;
+        }
+    }
+
+    // Not safe to do in place, parse everything again
+    std::wstring edited_html = html;
+    edited_html.replace(edit.offset, deleted_length, edit.inserted_text);
+
+    Document reparsed = construct_document_from_string(edited_html);
+    track_source = was_tracking;
+
+    return reparsed;
+}
+
+void HTMLParser::begin_resumable_document()
+{
+    reset_tree_construction();
+    tokenizer.reset();
+    resumable_document = Document();
+    // Elements the event sink is done with go away one by one
+    arena = events == nullptr ? resumable_document.get_arena() : nullptr;
+    pending_input.clear();
+    pending_position = 0;
+    input_finished = false;
+    resumable_in_progress = true;
+}
+
+void HTMLParser::feed(const std::wstring &html)
+{
+    if (!resumable_in_progress)
+        begin_resumable_document();
+
+    // Drop what the tokenizer is done with once it's most of the buffer
+    if (pending_position > 4096 && pending_position * 2 > pending_input.size())
+    {
+        pending_input.erase(0, pending_position);
+        pending_position = 0;
+    }
+
+    pending_input += html;
+}
+
+void HTMLParser::finish()
+{
+    if (!resumable_in_progress)
+        begin_resumable_document();
+
+    input_finished = true;
+}
+
+HTMLParser::run_status HTMLParser::run(const run_budget &budget)
+{
+    if (!resumable_in_progress)
+        return finished;
+
+    const bool timed = budget.max_time.count() > 0;
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + budget.max_time;
+    size_t processed = 0;
+
+    while (true)
+    {
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(pending_input,
+                pending_position, input_finished);
+
+        if (token == nullptr)
+        {
+            if (!input_finished)
+                return needs_input;
+
+            resumable_document = finalize_document(resumable_document);
+            resumable_in_progress = false;
+            return finished;
+        }
+
+        while (process_token(token, resumable_document))
+            ; // reprocess the token in the new insertion mode
+
+        if (input_cut_off || (head_only && is_past_head()))
+        {
+            resumable_document = finalize_document(resumable_document);
+            resumable_in_progress = false;
+            return finished;
+        }
+
+        processed++;
+
+        if (budget.max_tokens != 0 && processed >= budget.max_tokens)
+            return yielded;
+
+        // Reading the clock for every token would cost more than most tokens
+        if (timed && processed % 32 == 0 &&
+                std::chrono::steady_clock::now() >= deadline)
+            return yielded;
+    }
+}
+
+Document HTMLParser::take_document()
+{
+    flush_text();
+
+    Document document = std::move(resumable_document);
+    resumable_document = Document();
+    arena = nullptr;
+
+    return document;
+}
+
+void HTMLParser::set_head_only(bool head_only_mode)
+{
+    head_only = head_only_mode;
+}
+
+void HTMLParser::set_event_sink(HTMLEventSink *sink)
+{
+    events = sink;
+    open_elements.set_event_sink(sink);
+}
+
+HTMLMetadata HTMLParser::take_metadata()
+{
+    HTMLMetadata metadata = HTMLMetadata::from_document(take_document());
+    metadata.head_complete = is_past_head();
+
+    return metadata;
+}
+
+void HTMLParser::set_limits(const HTMLParserLimits &parser_limits)
+{
+    limits = parser_limits;
+    limits_enabled = limits.max_depth != 0 || limits.max_nodes != 0 ||
+        limits.max_attributes != 0 || limits.max_text_length != 0 ||
+        limits.max_comment_length != 0 || limits.max_dom_bytes != 0;
+    tokenizer.set_limits(limits);
+}
+
+unsigned HTMLParser::get_limits_hit() const
+{
+    return limits_hit;
+}
+
+HTMLMetadata HTMLParser::parse_metadata(const std::wstring &html)
+{
+    reset_tree_construction();
+    tokenizer.reset();
+
+    Document document = Document();
+    arena = document.get_arena();
+    std::wstring::const_iterator it = html.cbegin();
+
+    while (it != html.cend() && !is_past_head() && !input_cut_off)
+    {
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(html, it);
+
+        while (process_token(token, document))
+            ; // reprocess the token in the new insertion mode
+    }
+
+    HTMLMetadata metadata = HTMLMetadata::from_document(finalize_document(document));
+    metadata.head_complete = is_past_head();
+
+    return metadata;
+}
+
+bool HTMLParser::is_past_head() const
 {
-    tokenizer = HTMLTokenizer();
+    // The text of a <title> or <script> in the head still belongs to it
+    const insertion_mode mode = state == text ? original_state : state;
+
+    return mode > after_head;
+}
+
+void HTMLParser::reset()
+{
+    // Everything goes back to how the constructor left it, except for the
+    // settings and the capacity of the buffers
+    reset_tree_construction();
+    tokenizer.reset();
+    pending_input.clear();
+    pending_position = 0;
+    input_finished = false;
+    resumable_in_progress = false;
+    resumable_document = Document();
+    arena = nullptr;
+    fragment_context = nullptr;
+    pipeline_running = false;
+    pipeline_failed = false;
+    predicted_tokenizer_state = HTMLTokenizer::data_state;
+    token_start = 0;
+    token_end = 0;
+    tracked_stack_size = 0;
+    tracked_current = nullptr;
+    tracked_parent = nullptr;
+}
+
+void HTMLParser::set_pipelined(bool pipelined_mode)
+{
+    pipelined = pipelined_mode;
+}
+
+void HTMLParser::switch_tokenizer_state(HTMLTokenizer::tokenizer_state new_state)
+{
+    if (!pipeline_running)
+    {
+        tokenizer.switch_to(new_state);
+        return;
+    }
+
+    // The tokenizer thread already switched, it just has to agree with us
+    if (new_state == predicted_tokenizer_state)
+        predicted_tokenizer_state = HTMLTokenizer::data_state;
+    else
+        pipeline_failed = true;
+}
+
+void HTMLParser::reset_tree_construction()
+{
+    statistics = HTMLParserStatistics();
+
+    state = initial;
+    original_state = initial;
+    open_elements.clear();
+    active_formatting_elements.clear();
     head_element_pointer = nullptr;
-    active_formatting_elements = {};
+    pruned_root = nullptr;
+    pruned_depth = 0;
+    limits_hit = 0;
+    node_count = 0;
+    dom_bytes = 0;
+    input_cut_off = false;
+    pending_text.clear();
+    pending_text_parent = nullptr;
+    deferred_element = nullptr;
 }
 
-void HTMLParser::reconstruct_active_formatting_elements()
+void HTMLParser::insert_character(const std::shared_ptr<HTMLToken> &token)
 {
+    // Characters collect in pending_text until the next token that isn't
+    // one, or one that goes somewhere else, and reach the DOM in one piece
+    if (events != nullptr)
+    {
+        events->add_char(token->get_char());
+        return;
+    }
+
+    HTMLElement *parent = open_elements.back().get();
 
+    if (parent != pending_text_parent)
+    {
+        flush_text();
+        pending_text_parent = parent;
+    }
+
+    if (limits_enabled)
+    {
+        const HTMLElement *last_child = parent->get_last_child();
+        const bool follows_text = last_child != nullptr && last_child->is_text_node();
+
+        // Goes into a new text node unless it follows one. Text takes one
+        // or two bytes a character, the estimate takes two.
+        if (!follows_text && pending_text.empty())
+            account_for(1, sizeof(HTMLTextElement) + sizeof(char16_t));
+
+        else if (limits.max_text_length != 0 && pending_text.size() +
+                (follows_text ? last_child->get_text_length() : 0) >=
+                limits.max_text_length)
+        {
+            limits_hit |= HTMLParserLimits::text_limited;
+            return;
+        }
+
+        else
+            account_for(0, sizeof(char16_t));
+    }
+
+    pending_text.push_back(token->get_char());
 }
 
-void HTMLParser::add_element_to_formatting_list(const std::shared_ptr<HTMLElement> &element)
+void HTMLParser::flush_text()
 {
+    if (pending_text.empty())
+        return;
+
+    HTMLElement *last_child = pending_text_parent->get_last_child();
+
+    if (last_child != nullptr && last_child->is_text_node())
+        last_child->add_char(pending_text);
+
+    else
+    {
+        // Sized to fit, pending_text keeps its capacity for the next run
+        std::shared_ptr<HTMLTextElement> text =
+            DOMArena::make_element<HTMLTextElement>(arena);
+        text->add_char(pending_text);
+        pending_text_parent->add_child(text);
+    }
 
+    pending_text.clear();
 }
 
-bool HTMLParser::is_element_in_scope(const std::wstring &element_title)
+void HTMLParser::account_for(size_t nodes, size_t bytes)
 {
-    return true;
+    // The input stops at the next token, the one that went over the limit
+    // is still finished
+    node_count += nodes;
+    dom_bytes += bytes;
+
+    if (limits.max_nodes != 0 && node_count >= limits.max_nodes)
+    {
+        limits_hit |= HTMLParserLimits::nodes_limited;
+        input_cut_off = true;
+    }
+
+    if (limits.max_dom_bytes != 0 && dom_bytes >= limits.max_dom_bytes)
+    {
+        limits_hit |= HTMLParserLimits::dom_bytes_limited;
+        input_cut_off = true;
+    }
 }
 
-void HTMLParser::insert_html_element(const std::shared_ptr<HTMLElement> &element)
+void HTMLParser::parse_generic_text_element(const std::shared_ptr<HTMLToken> &token,
+        HTMLTokenizer::tokenizer_state tokenizer_state)
 {
-    open_elements.back()->add_child(element);
-    open_elements.push_back(element);
+    // https://html.spec.whatwg.org/multipage/parsing.html#generic-raw-text-element-parsing-algorithm
+    insert_html_element_for_token(token);
+    switch_tokenizer_state(tokenizer_state);
+    original_state = state;
+    state = text;
+
+    // Nobody will see the text, don't even tokenize it. The pipelined
+    // tokenizer is on another thread and keeps going on its own.
+    if (is_pruning() && !pipeline_running)
+        tokenizer.skip_text_content();
 }
 
-Document HTMLParser::construct_document_from_string(std::wstring &html)
+bool HTMLParser::is_space_token(const std::shared_ptr<HTMLToken> &token)
 {
-    #ifdef CONSOLE
-    if (!tokenizer.is_valid_html_string(html))
-        std::cerr << "ERROR: HTML string is not valid! "
-            "Bad things may happen." << std::endl;
-    #endif // CONSOLE
-    Document document = Document();
+    if (!token->is_char_token())
+        return false;
 
-    std::vector<std::shared_ptr<HTMLToken>> tokens =
-        tokenizer.tokenize_string(html);
+    wchar_t token_char = token->get_char();
+    return token_char == L'\t' || token_char == L'\n' || token_char == L'\f' ||
+        token_char == L'\r' || token_char == L' ';
+}
 
-    state = initial;
+bool HTMLParser::process_token(const std::shared_ptr<HTMLToken> &token, Document &document)
+{
+    if (deferred_element != nullptr)
+        take_deferred_content();
+
+    if (!token->is_char_token())
+        flush_text();
+
+    if (limits_enabled && token->is_truncated())
+        limits_hit |= token->is_comment_token() ?
+            HTMLParserLimits::comment_limited : HTMLParserLimits::attributes_limited;
+
+    // Comments aren't kept in the DOM yet, and no insertion mode changes
+    // for one. The tokenizer makes none in raw text.
+    if (token->is_comment_token())
+    {
+        if (events != nullptr)
+        {
+            events->flush_text();
+            events->comment(token->get_data());
+        }
 
-    std::shared_ptr<HTMLElement> current_node;
+        return false;
+    }
 
-    for (std::vector<std::shared_ptr<HTMLToken>>::iterator it = tokens.begin();
-            it != tokens.end(); it++)
+    // The body of most pages is text with inline markup, paragraphs, lists
+    // and headings. Those tokens skip the insertion mode machinery.
+    if (state == in_body && process_token_fast(token))
     {
-        const std::shared_ptr<HTMLToken> &token = *it;
+        COUNT_TOKEN_IN_MODE(in_body);
+        return false;
+    }
+
+    #ifdef PARSER_STATISTICS
+    const insertion_mode mode = state;
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    const bool reprocess = process_token_in_mode(state, token, document);
+
+    statistics.time_per_mode[mode] += std::chrono::steady_clock::now() - start;
+
+    if (reprocess)
+        statistics.reprocessed_tokens++;
+
+    return reprocess;
+    #else
+    return process_token_in_mode(state, token, document);
+    #endif // PARSER_STATISTICS
+}
+
+bool HTMLParser::process_token_in_mode(insertion_mode mode,
+        const std::shared_ptr<HTMLToken> &token, Document &document)
+{
+    // Returns true if the token has to be reprocessed
+    COUNT_TOKEN_IN_MODE(mode);
 
-        switch (state)
+    switch (mode)
+    {
+        case initial:
         {
-            case initial:
-            {
-                if (token->is_doctype_token())
-                {
-                    document.set_document_type(token->get_tag_name());
+            if (is_space_token(token) || token->is_comment_token())
+                return false;
 
-                    // Other conditions (public/system identifiers)
-                    if (token->quirks_required())
-                        document.set_quirks_mode(true);
+            if (token->is_doctype_token())
+            {
+                document.set_document_type(token->get_tag_name());
 
-                    // More to do here
-                    state = before_html;
+                if (events != nullptr)
+                {
+                    events->flush_text();
+                    events->doctype(token->get_tag_name());
                 }
 
-                // space, comment: handle
+                // Other conditions (public/system identifiers)
+                if (token->quirks_required())
+                    document.set_quirks_mode(true);
+
+                // More to do here
                 state = before_html;
-                break;
+                return false;
             }
 
-            case before_html:
+            state = before_html;
+            return true;
+        }
+
+        case before_html:
+        {
+            if (token->is_doctype_token())
             {
-                // DOCTYPE token: parse error
-                // Comment, space: handle correctly
+                COUNT_PARSE_ERROR(unexpected_doctype);
+                return false;
+            }
 
-                if (token->is_start_token())
-                {
-                    if (token->get_tag_name() == L"html")
-                    {
-                        current_node = construct_element_from_token(token);
-                        open_elements.push_back(current_node);
-                        document.add_element(current_node);
+            if (is_space_token(token) || token->is_comment_token())
+                return false;
 
-                        state = before_head;
+            if (token->is_start_token() && token->get_tag_id() == tag_html)
+            {
+                std::shared_ptr<HTMLElement> html =
+                    construct_element_from_token(token);
+                open_elements.push_back(html, token.get());
+                document.add_element(html);
 
-                        break;
-                    }
-                }
+                if (track_source)
+                    track_source_start(html.get());
 
-                // handle head, body, html, br end tokens
+                state = before_head;
+                return false;
+            }
 
-                else if (token->is_end_token() &&
-                        !(token->get_tag_name() == L"head" ||
-                            token->get_tag_name() == L"body" ||
-                            token->get_tag_name() == L"html" ||
-                            token->get_tag_name() == L"br"))
-                    // parse error
-                    break;
+            else if (token->is_end_token() &&
+                    !(token->get_tag_id() == tag_head ||
+                        token->get_tag_id() == tag_body ||
+                        token->get_tag_id() == tag_html ||
+                        token->get_tag_id() == tag_br))
+            {
+                COUNT_PARSE_ERROR(unexpected_end_tag);
+                return false;
+            }
 
+            std::shared_ptr<HTMLElement> html = construct_html_element();
 
-                std::shared_ptr<HTMLElement> html = construct_html_element();
+            open_elements.push_back(html);
+            document.add_element(html);
 
-                open_elements.push_back(html);
-                document.add_element(html);
+            if (track_source)
+                track_source_start(html.get());
 
-                current_node = construct_element_from_token(token);
-                state = before_head;
-                it--;
+            state = before_head;
+            return true;
+        }
 
-                break;
+        case before_head:
+        {
+            if (token->is_doctype_token())
+            {
+                COUNT_PARSE_ERROR(unexpected_doctype);
+                return false;
+            }
+
+            // Comment: handle correctly
+            if (is_space_token(token))
+                return false;
+
+            if (token->is_start_token() &&
+                    token->get_tag_id() == tag_head)
+            {
+                std::shared_ptr<HTMLHeadElement> head =
+                    construct_head_from_token(token);
+                insert_html_element(head);
+                head_element_pointer = head;
+                state = in_head;
+                return false;
+            }
+
+            else if (token->is_end_token() &&
+                    !(token->get_tag_id() == tag_head ||
+                        token->get_tag_id() == tag_body ||
+                        token->get_tag_id() == tag_html ||
+                        token->get_tag_id() == tag_br))
+                return false;
+
+            std::shared_ptr<HTMLHeadElement> head = construct_head_element();
+            insert_html_element(head);
+            head_element_pointer = head;
+            state = in_head;
+            return true;
+        }
+
+        case in_head:
+        {
+            if (is_space_token(token))
+            {
+                insert_character(token);
+                return false;
+            }
+
+            // Comment: handle correctly
+            if (token->is_doctype_token())
+            {
+                COUNT_PARSE_ERROR(unexpected_doctype);
+                return false;
             }
 
-            case before_head:
+            if (token->is_start_token())
             {
-                // Comment, space: handle correctly
-                // HTML, Doctype: handle correctly
-                if (token->is_start_token() &&
-                        token->get_tag_name() == L"head")
+                const HTMLTagId tag_id = token->get_tag_id();
+
+                if (tag_id == tag_base || tag_id == tag_basefont ||
+                        tag_id == tag_bgsound || tag_id == tag_link ||
+                        tag_id == tag_meta)
                 {
-                    std::shared_ptr<HTMLHeadElement> head =
-                        construct_head_from_token(token);
-                    open_elements.push_back(head);
-                    head_element_pointer = head;
+                    insert_html_element_for_token(token);
+                    open_elements.pop_back();
+                    return false;
                 }
 
-                else if (token->is_end_token() &&
-                        !(token->get_tag_name() == L"head" ||
-                            token->get_tag_name() == L"body" ||
-                            token->get_tag_name() == L"html" ||
-                            token->get_tag_name() == L"br"))
-                    break;
-
-                else
+                if (tag_id == tag_title || tag_id == tag_style ||
+                        tag_id == tag_noframes || tag_id == tag_script)
                 {
-                    std::shared_ptr<HTMLHeadElement> head = construct_head_element();
-                    open_elements.push_back(head);
-                    head_element_pointer = head;
-                    it--;
+                    parse_generic_text_element(token,
+                            HTMLTokenizer::state_for_start_tag(tag_id));
+                    return false;
                 }
 
-                state = in_head;
+                if (tag_id == tag_head)
+                {
+                    COUNT_PARSE_ERROR(unexpected_start_tag);
+                    return false;
+                }
             }
 
-            case in_head:
+            else if (token->is_end_token())
             {
-                if (token->is_end_token() && token->get_tag_name() == L"head")
+                if (token->get_tag_id() == tag_head)
                 {
                     open_elements.pop_back();
                     state = after_head;
+                    return false;
+                }
+
+                if (!(token->get_tag_id() == tag_body ||
+                        token->get_tag_id() == tag_html ||
+                        token->get_tag_id() == tag_br))
+                {
+                    COUNT_PARSE_ERROR(unexpected_end_tag);
+                    return false;
                 }
+            }
 
-                // Many more cases to implement
+            // Many more cases to implement
 
-                break;
+            open_elements.pop_back();
+            state = after_head;
+            return true;
+        }
+
+        case after_head:
+        {
+            if (is_space_token(token))
+            {
+                insert_character(token);
+                return false;
+            }
+
+            if (token->is_doctype_token())
+            {
+                COUNT_PARSE_ERROR(unexpected_doctype);
+                return false;
             }
 
-            case after_head:
+            if (token->is_start_token())
             {
-                if (token->is_start_token() &&
-                        token->get_tag_name() == L"body")
+                const HTMLTagId tag_id = token->get_tag_id();
+
+                if (tag_id == tag_body)
                 {
                     std::shared_ptr<HTMLElement> body =
                         construct_element_from_token(token);
 
-                    insert_html_element(body);
+                    insert_html_element(body, token.get());
 
                     state = in_body;
+                    return false;
                 }
 
-                // Many more cases to implement
+                if (tag_id == tag_base || tag_id == tag_basefont ||
+                        tag_id == tag_bgsound || tag_id == tag_link ||
+                        tag_id == tag_meta || tag_id == tag_noframes ||
+                        tag_id == tag_script || tag_id == tag_style ||
+                        tag_id == tag_title)
+                {
+                    // These still belong into the head. The sink has seen the
+                    // end of the head already, they stay between it and the
+                    // body there.
+                    COUNT_PARSE_ERROR(head_content_after_head);
 
-                break;
+                    if (events != nullptr)
+                        return process_token_in_mode(in_head, token, document);
+
+                    open_elements.push_back(head_element_pointer);
+                    NOTE_OPEN_ELEMENTS();
+                    process_token_in_mode(in_head, token, document);
+
+                    size_t index = index_in_open_elements(head_element_pointer.get());
+                    if (index != ActiveFormattingList::npos)
+                        open_elements.remove_at(index);
+
+                    return false;
+                }
+
+                if (tag_id == tag_head)
+                {
+                    COUNT_PARSE_ERROR(unexpected_start_tag);
+                    return false;
+                }
             }
 
-            case in_body:
+            else if (token->is_end_token() &&
+                    !(token->get_tag_id() == tag_body ||
+                        token->get_tag_id() == tag_html ||
+                        token->get_tag_id() == tag_br))
             {
-                if (token->is_char_token())
-                {
-                    std::shared_ptr<HTMLElement> char_node =
-                        construct_element_from_token(token);
+                COUNT_PARSE_ERROR(unexpected_end_tag);
+                return false;
+            }
 
-                    reconstruct_active_formatting_elements();
-                    open_elements.back()->add_text(char_node);
-                }
+            // Many more cases to implement
 
-                else if (token->is_end_token())
+            if (limits_enabled)
+                account_for(1, sizeof(HTMLBodyElement));
+
+            insert_html_element(DOMArena::make_element<HTMLBodyElement>(arena));
+            state = in_body;
+            return true;
+        }
+
+        case in_body:
+        {
+            if (token->is_char_token())
+            {
+                if (is_pruning())
+                    return false;
+
+                reconstruct_active_formatting_elements();
+                insert_character(token);
+            }
+
+            else if (token->is_end_token())
+            {
+                if (token->get_tag_id() == tag_body || token->get_tag_id() == tag_html)
                 {
-                    if (token->get_tag_name() == L"body")
+                    // Other elements to check later
+                    if (!is_element_in_scope(tag_body))
                     {
-                        // Other elements to check later
-                        if (is_element_in_scope(L"body"))
-                            state = after_body;
+                        COUNT_PARSE_ERROR(unexpected_end_tag);
+                        return false;
                     }
 
-                    else if (token->get_tag_name() == L"p")
-                    {
-                        // TODO
-                        // Check if stack has element in button scope
-                        // Generate implied end tags
-                        // Check if current node is p node before popping
-                        open_elements.pop_back();
-                    }
+                    // </html> goes on to after after body from there
+                    state = after_body;
+                    return token->get_tag_id() == tag_html;
                 }
 
-                else if (token->is_start_token())
+                else if (token->get_tag_id() == tag_p)
                 {
-                    if (token->get_tag_name() == L"p")
+                    if (!is_element_in_button_scope(tag_p))
                     {
-                        // Other elements to check
-                        if (is_element_in_scope(L"p"))
-                        {
-                            current_node = construct_element_from_token(token);
-                            insert_html_element(current_node);
-                        }
+                        // Act as if we saw <p>
+                        COUNT_PARSE_ERROR(unexpected_end_tag);
+
+                        if (limits_enabled)
+                            account_for(1, sizeof(HTMLParagraphElement));
+
+                        insert_html_element(
+                                DOMArena::make_element<HTMLParagraphElement>(arena));
                     }
+
+                    close_p_element();
+                }
+
+                else
+                    process_end_tag_in_body(token);
+            }
+
+            else if (token->is_start_token())
+            {
+                const HTMLTagId tag_id = token->get_tag_id();
+
+                // Their attributes should go to the open element, which isn't
+                // done yet
+                if (tag_id == tag_html || tag_id == tag_body)
+                {
+                    COUNT_PARSE_ERROR(unexpected_start_tag);
+                    return false;
                 }
 
-                // Many more cases to implement
+                if (tag_id == tag_base || tag_id == tag_basefont ||
+                        tag_id == tag_bgsound || tag_id == tag_link ||
+                        tag_id == tag_meta || tag_id == tag_noframes ||
+                        tag_id == tag_script || tag_id == tag_style ||
+                        tag_id == tag_title)
+                    return process_token_in_mode(in_head, token, document);
 
-                break;
+                if (tag_id == tag_textarea || tag_id == tag_iframe ||
+                        tag_id == tag_noembed)
+                {
+                    parse_generic_text_element(token,
+                            HTMLTokenizer::state_for_start_tag(tag_id));
+                    return false;
+                }
+
+                if (tag_id == tag_xmp)
+                {
+                    if (is_element_in_button_scope(tag_p))
+                        close_p_element();
+
+                    reconstruct_active_formatting_elements();
+                    parse_generic_text_element(token, HTMLTokenizer::rawtext_state);
+                    return false;
+                }
+
+                if (tag_id == tag_plaintext)
+                {
+                    if (is_element_in_button_scope(tag_p))
+                        close_p_element();
+
+                    insert_html_element_for_token(token);
+                    switch_tokenizer_state(HTMLTokenizer::plaintext_state);
+                    return false;
+                }
+
+                process_start_tag_in_body(token);
+            }
+            else if (token->is_doctype_token())
+            {
+                // parse error, ignore the token
+                COUNT_PARSE_ERROR(unexpected_doctype);
+            }
+
+            // Many more cases to implement
+
+            return false;
+        }
+
+        case text:
+        {
+            if (token->is_char_token())
+            {
+                if (!is_pruning())
+                    insert_character(token);
             }
 
-            case after_body:
+            else if (token->is_end_token() || token->is_eof_token())
             {
-                if (token->is_end_token() && token->get_tag_name() == L"html")
-                    state = after_after_body;
+                if (token->is_eof_token())
+                    COUNT_PARSE_ERROR(eof_in_text);
 
-                // Many more cases to implement
-                break;
+                open_elements.pop_back();
+                state = original_state;
+                return token->is_eof_token();
             }
 
-            case after_after_body:
+            return false;
+        }
+
+        case after_body:
+        {
+            if (is_space_token(token))
+                return process_token_in_mode(in_body, token, document);
+
+            if (token->is_end_token() && token->get_tag_id() == tag_html)
             {
-                // Many more cases to implement
-                break;
+                state = after_after_body;
+                return false;
             }
 
+            if (token->is_doctype_token() || token->is_eof_token() ||
+                    (token->is_start_token() && token->get_tag_id() == tag_html))
+                return false;
 
-            default:
-                break;
+            // Anything else goes back into the body
+            COUNT_PARSE_ERROR(content_after_body);
+            state = in_body;
+            return true;
         }
-    }
 
-    return finalize_document(document);
+        case after_after_body:
+        {
+            if (is_space_token(token) || (token->is_start_token() &&
+                        token->get_tag_id() == tag_html))
+                return process_token_in_mode(in_body, token, document);
+
+            if (token->is_doctype_token() || token->is_eof_token())
+                return false;
+
+            COUNT_PARSE_ERROR(content_after_body);
+            state = in_body;
+            return true;
+        }
+
+
+        default:
+            return false;
+    }
 }
 
 Document HTMLParser::finalize_document(const Document &document)
 {
+    flush_text();
+
+    // The event sink gets the end tags of whatever is still open
+    if (events != nullptr)
+        open_elements.resize(0);
+
+    // Nothing more goes into it
+    arena = nullptr;
+
     // https://www.w3.org/TR/2011/WD-html5-20110113/the-end.html#stop-parsing
+    #ifdef PARSER_STATISTICS
+    Document finished = document;
+    finished.set_parser_statistics(statistics);
+
+    return finished;
+    #else
     return document;
+    #endif // PARSER_STATISTICS
 }
 
 std::shared_ptr<HTMLElement> HTMLParser::construct_element_from_token(const std::shared_ptr<HTMLToken> &token)
 {
-    std::shared_ptr<HTMLElement> element = std::make_shared<HTMLElement>();
-
-    if (token->get_tag_name() == L"html")
+    if (token->is_char_token())
     {
-        element->set_title(L"html");
-        return element;
-    }
+        std::shared_ptr<HTMLTextElement> text =
+            DOMArena::make_element<HTMLTextElement>(arena);
+        text->add_char(token->get_char());
 
-    else if (token->get_tag_name() == L"head")
-    {
-        element = std::make_shared<HTMLHeadElement>();
-        return element;
+        return text;
     }
 
-    else if (token->get_tag_name() == L"body")
-    {
-        element = std::make_shared<HTMLBodyElement>();
-        return element;
-    }
+    const std::wstring &tag_name = token->get_tag_name();
+    size_t element_bytes = sizeof(HTMLElement) + tag_name.size() * sizeof(wchar_t);
+    std::shared_ptr<HTMLElement> element;
 
-    else if (token->get_tag_name() == L"p")
-    {
-        element = std::make_shared<HTMLParagraphElement>();
-        return element;
-    }
+    // An event sink only sees the name, so one that was closed already does
+    // for the stack, whatever kind of element it was made as
+    if (events != nullptr && !track_source)
+        element = open_elements.take_spare();
+
+    if (element != nullptr && element.get() == pruned_root)
+        pruned_root = nullptr;
+
+    if (events != nullptr && element == nullptr)
+        element = DOMArena::make_element<HTMLElement>(arena);
 
-    else if (token->is_char_token())
+    if (element != nullptr)
+        HTMLTagRegistry::set_tag(*element, token->get_tag_id(), tag_name);
+    else
+        element = HTMLTagRegistry::create_element(arena, token->get_tag_id(), tag_name);
+
+    if (token->is_start_token())
     {
-        std::shared_ptr<HTMLTextElement> text =
-            std::make_shared<HTMLTextElement>();
-        text->add_char(token->get_char());
+        for (const std::pair<const std::wstring, std::wstring> &attribute :
+                token->get_attributes())
+        {
+            // The sink gets them from the token
+            if (events == nullptr)
+                element->set_attribute(attribute.first, attribute.second);
 
-        return text;
+            // The two strings, at two bytes a character like text
+            element_bytes += 2 * sizeof(DOMString) +
+                (attribute.first.size() + attribute.second.size()) * sizeof(char16_t);
+        }
     }
 
-    else
-        return element;
+    if (limits_enabled)
+        account_for(1, element_bytes);
+
+    // Also covers the elements the adoption agency creates
+    if (track_source)
+        track_source_start(element.get());
+
+    return element;
 }
 
 std::shared_ptr<HTMLElement> HTMLParser::construct_html_element()
 {
-    std::shared_ptr<HTMLElement> element = std::make_shared<HTMLElement>();
+    std::shared_ptr<HTMLElement> element = DOMArena::make_element<HTMLElement>(arena);
     element->set_title(L"html");
 
+    if (limits_enabled)
+        account_for(1, sizeof(HTMLElement));
+
     return element;
 }
 
 std::shared_ptr<HTMLHeadElement> HTMLParser::construct_head_element()
 {
     std::shared_ptr<HTMLHeadElement> element =
-        std::make_shared<HTMLHeadElement>();
+        DOMArena::make_element<HTMLHeadElement>(arena);
+
+    if (limits_enabled)
+        account_for(1, sizeof(HTMLHeadElement));
 
     return element;
 }
 
 std::shared_ptr<HTMLHeadElement> HTMLParser::construct_head_from_token(const std::shared_ptr<HTMLToken> &head_token)
 {
-    std::shared_ptr<HTMLHeadElement> element = std::make_shared<HTMLHeadElement>();
+    std::shared_ptr<HTMLHeadElement> element =
+        DOMArena::make_element<HTMLHeadElement>(arena);
+
+    if (limits_enabled)
+        account_for(1, sizeof(HTMLHeadElement));
 
     return element;
 }
@@ -4,8 +4,17 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <map>
+#include <functional>
 
 #include "HTMLTokenizer.hpp"
+#include "ActiveFormattingList.hpp"
+#include "OpenElementStack.hpp"
+#include "HTMLEventSink.hpp"
+#include "HTMLParserStatistics.hpp"
+#include "HTMLParserLimits.hpp"
+#include "HTMLMetadata.hpp"
 #include "tokens/HTMLToken.hpp"
 #include "../../elements/HTML/HTMLElement.hpp"
 #include "../../elements/HTML/HTMLHeadElement.hpp"
@@ -16,8 +25,155 @@ class HTMLParser
     public:
         HTMLParser();
         Document construct_document_from_string(std::wstring &html);
+
+        // Get ready for another document without giving back any memory.
+        // Settings like set_pipelined stay as they are.
+        void reset();
         std::shared_ptr<HTMLElement> construct_element_from_token(const std::shared_ptr<HTMLToken> &token);
 
+        // Run the tokenizer on its own thread, feeding the tree builder
+        // through a lock-free ring. Only used for documents of at least
+        // pipeline_minimum_length characters on machines with more than one
+        // core, otherwise the thread costs more than it saves.
+        void set_pipelined(bool pipelined_mode);
+        static const size_t pipeline_minimum_length = 64 * 1024;
+
+        // Resumable parsing: feed() input as it arrives and call run() as
+        // often as the caller likes. run() returns once the budget is used
+        // up, the input runs dry or the document is done, and picks up
+        // where it left off next time.
+        struct run_budget
+        {
+            // 0 means no limit
+            size_t max_tokens;
+            // zero means no limit, checked every few tokens
+            std::chrono::microseconds max_time;
+        };
+
+        enum run_status
+        {
+            needs_input,
+            yielded,
+            finished
+        };
+
+        // innerHTML-style parsing of html as the contents of context.
+        // Returns the top level nodes, context itself is left alone.
+        std::vector<std::shared_ptr<HTMLElement>> parse_fragment(
+                const std::wstring &html,
+                const std::shared_ptr<HTMLElement> &context);
+        std::vector<std::shared_ptr<HTMLElement>> parse_fragment(
+                const std::wstring &html, const HTMLElement &context);
+
+        // Incremental reparsing for editors. With source tracking on the
+        // elements remember where they came from, and reparse() applies an
+        // edit of the source by parsing only the contents of the innermost
+        // element around it. When that can't be done safely the edited
+        // source is parsed from scratch. Either way the result is returned,
+        // document itself is updated in place when possible. reparse()
+        // tracks the source of what it parses even with tracking off, and
+        // leaves the setting as it was.
+        struct text_edit
+        {
+            size_t offset;
+            size_t deleted_length;
+            std::wstring inserted_text;
+        };
+
+        void set_source_tracking(bool tracking);
+        Document reparse(const std::wstring &html, Document &document,
+                const text_edit &edit);
+
+        void feed(const std::wstring &html);
+        void finish();
+        run_status run(const run_budget &budget);
+        Document take_document();
+
+        // Leaves parts of the document out while it's built. The filter sees
+        // the start tag of every element the tree builder inserts. Neither a
+        // pruned element nor anything inside it ends up in the DOM, and the
+        // text of pruned raw text elements (script, style, title...) is
+        // skipped without being tokenized. What was opened inside a pruned
+        // element stays out even where misnested end tags would move it out
+        // of it in the full tree, the copies of formatting elements the tree
+        // builder makes elsewhere go through the filter again.
+        enum filter_action
+        {
+            keep_element,
+            prune_element
+        };
+
+        typedef std::function<filter_action (const std::wstring &tag_name,
+                const std::map<std::wstring, std::wstring> &attributes)>
+            element_filter;
+
+        void set_element_filter(const element_filter &element_filter);
+
+        // Head-only parsing for link previews and indexing. Tokenizing stops
+        // as soon as the tree builder leaves the head, and what the head
+        // held comes back instead of a DOM.
+        HTMLMetadata parse_metadata(const std::wstring &html);
+
+        // The same for the resumable API: run() reports finished once the
+        // head is done, whoever feeds the parser can stop the transfer then
+        // (see Loader::streamFileFromURL). take_metadata() replaces
+        // take_document().
+        void set_head_only(bool head_only_mode);
+        HTMLMetadata take_metadata();
+
+        // Sends the document to sink instead of building a DOM, nullptr to
+        // build one again. The tree construction rules are the same, see
+        // HTMLEventSink for where the events differ from the tree. Made for
+        // the resumable API, finish() and run() close whatever is still
+        // open once the input ends. HTMLEventParser wraps it all up.
+        void set_event_sink(HTMLEventSink *sink);
+
+        // Keeps inert parts of the document as source while it's built,
+        // their elements are only made when someone asks for them with
+        // HTMLElement::get_content(). Pages that ship big template libraries
+        // parse faster and take less memory that way.
+        //
+        // Only elements opened in body whose end tag is in the input are
+        // deferred. Their contents are parsed later as a fragment in the
+        // element, so whatever those leave open ends with it. That's what
+        // the spec does for templates, for the other two it makes a
+        // difference only when the contents are broken markup. Nothing is
+        // deferred with the pipelined tokenizer or source tracking.
+        enum deferral_flag
+        {
+            defer_templates = 1 << 0,
+            // A browser running scripts doesn't show them
+            defer_noscript = 1 << 1,
+            // Elements with the hidden attribute that only their own end tag
+            // closes, not p, li, headings and such
+            defer_hidden = 1 << 2
+        };
+
+        void set_deferred_parsing(unsigned deferral_flags);
+
+        // Bounds what one document can cost, see HTMLParserLimits. The
+        // checks are made as the tree is built, and what the last document
+        // ran into comes back from get_limits_hit() as limit_flag bits.
+        void set_limits(const HTMLParserLimits &parser_limits);
+        unsigned get_limits_hit() const;
+
+        // Element groups of the tree construction rules. The parser itself
+        // uses the ones taking IDs, the others look the name up first.
+        static bool is_formatting_tag(HTMLTagId tag_id);
+        static bool is_special_tag(HTMLTagId tag_id);
+        static bool is_void_tag(HTMLTagId tag_id);
+        static bool is_heading_tag(HTMLTagId tag_id);
+        static bool closes_p_element(HTMLTagId tag_id);
+        static bool is_implied_end_tag(HTMLTagId tag_id);
+        static bool is_scope_boundary_tag(HTMLTagId tag_id);
+        static bool is_formatting_tag(const std::wstring &tag_name);
+        static bool is_special_tag(const std::wstring &tag_name);
+        static bool is_void_tag(const std::wstring &tag_name);
+        static bool is_heading_tag(const std::wstring &tag_name);
+        static bool closes_p_element(const std::wstring &tag_name);
+        static bool is_implied_end_tag(const std::wstring &tag_name);
+        static bool is_scope_boundary_tag(const std::wstring &tag_name);
+
     protected:
         std::shared_ptr<HTMLElement> construct_html_element();
         std::shared_ptr<HTMLHeadElement> construct_head_element();
@@ -25,15 +181,67 @@ class HTMLParser
             construct_head_from_token(const std::shared_ptr<HTMLToken>
                     &head_token);
         HTMLTokenizer tokenizer;
-        std::vector<std::shared_ptr<HTMLElement>> open_elements;
+        OpenElementStack open_elements;
         std::shared_ptr<HTMLHeadElement> head_element_pointer;
         Document finalize_document(const Document &document);
         void reconstruct_active_formatting_elements();
         void add_element_to_formatting_list(const std::shared_ptr<HTMLElement>
-                &element);
-        std::list<std::shared_ptr<HTMLElement>> active_formatting_elements;
-        bool is_element_in_scope(const std::wstring &element_title);
-        void insert_html_element(const std::shared_ptr<HTMLElement> &element);
+                &element, const std::shared_ptr<HTMLToken> &token);
+        ActiveFormattingList active_formatting_elements;
+        bool is_element_in_scope(HTMLTagId tag_id);
+        bool is_element_in_scope(const HTMLElement *element);
+        bool is_element_in_button_scope(HTMLTagId tag_id);
+        bool is_element_in_list_item_scope(HTMLTagId tag_id);
+        bool is_element_in_specific_scope(HTMLTagId tag_id,
+                const HTMLElement *element, bool button_scope,
+                bool list_item_scope);
+        // The token is only for the attributes an event sink gets
+        void insert_html_element(const std::shared_ptr<HTMLElement> &element,
+                const HTMLToken *token = nullptr);
+        std::shared_ptr<HTMLElement> insert_html_element_for_token(
+                const std::shared_ptr<HTMLToken> &token);
+        size_t index_in_open_elements(const HTMLElement *element) const;
+        void pop_open_elements_until(HTMLTagId tag_id);
+        void generate_implied_end_tags(HTMLTagId exception = tag_unknown);
+        void close_p_element();
+        bool run_adoption_agency(const std::shared_ptr<HTMLToken> &token);
+        void process_any_other_end_tag(const std::shared_ptr<HTMLToken> &token);
+        void process_start_tag_in_body(const std::shared_ptr<HTMLToken> &token);
+        void process_end_tag_in_body(const std::shared_ptr<HTMLToken> &token);
+        void close_list_item_for(HTMLTagId tag_id);
+        void reset_insertion_mode();
+        bool is_pruning();
+        bool is_pruned_by_filter(const std::shared_ptr<HTMLToken> &token);
+        bool is_past_head() const;
+        bool process_token_fast(const std::shared_ptr<HTMLToken> &token);
+        bool is_deferrable(const std::shared_ptr<HTMLToken> &token) const;
+        void take_deferred_content();
+
+        void track_source_start(HTMLElement *element);
+        void begin_tracked_token(size_t start, size_t end);
+        void end_tracked_token(const std::shared_ptr<HTMLToken> &token);
+        bool opens_cleanly() const;
+        bool formatting_list_settled() const;
+        bool parse_clean_fragment(const std::wstring &html, size_t base_offset,
+                const HTMLElement *context, const std::shared_ptr<HTMLElement> &root);
+        std::shared_ptr<HTMLElement> find_reparse_context(const Document &document,
+                const text_edit &edit, long long &content_start) const;
+        static void make_source_offsets_relative(HTMLElement *root,
+                long long root_start);
+
+        bool construct_document_pipelined(const std::wstring &html, Document &document);
+        // The tokenizer thread of construct_document_pipelined, stopped and
+        // joined however that returns
+        class tokenizer_pipeline;
+        void switch_tokenizer_state(HTMLTokenizer::tokenizer_state new_state);
+        void reset_tree_construction();
+        void insert_character(const std::shared_ptr<HTMLToken> &token);
+        void flush_text();
+        void account_for(size_t nodes, size_t bytes);
+        void parse_generic_text_element(const std::shared_ptr<HTMLToken> &token,
+                HTMLTokenizer::tokenizer_state tokenizer_state);
+
+        static bool is_space_token(const std::shared_ptr<HTMLToken> &token);
 
         enum insertion_mode
         {
@@ -62,7 +270,70 @@ class HTMLParser
             after_after_frameset
         };
 
+        static_assert(after_after_frameset + 1 ==
+                HTMLParserStatistics::insertion_mode_count,
+                "HTMLParserStatistics needs a slot for every insertion mode");
+
+        bool process_token(const std::shared_ptr<HTMLToken> &token, Document &document);
+        bool process_token_in_mode(insertion_mode mode,
+                const std::shared_ptr<HTMLToken> &token, Document &document);
+
         insertion_mode state;
+        insertion_mode original_state;
+
+        // Only set while parsing a fragment
+        const HTMLElement *fragment_context;
+
+        void begin_resumable_document();
+
+        std::wstring pending_input;
+        size_t pending_position;
+        bool input_finished;
+        bool resumable_in_progress;
+        bool head_only;
+        Document resumable_document;
+
+        bool pipelined;
+        bool pipeline_running;
+        bool pipeline_failed;
+        HTMLTokenizer::tokenizer_state predicted_tokenizer_state;
+
+        // Where the elements of the document being built go, nullptr
+        // between documents
+        DOMArena *arena;
+
+        // Only counted into when compiled with PARSER_STATISTICS, the
+        // layout of the class is the same either way
+        HTMLParserStatistics statistics;
+
+        HTMLParserLimits limits;
+        bool limits_enabled;
+        unsigned limits_hit;
+        size_t node_count;
+        size_t dom_bytes;
+        // A limit ended the document early, the rest of the input is ignored
+        bool input_cut_off;
+
+        HTMLEventSink *events;
+
+        // Text not in the DOM yet, see insert_character
+        std::wstring pending_text;
+        HTMLElement *pending_text_parent;
+
+        unsigned deferral;
+        // Opened last, the tokenizer is skipping its contents
+        HTMLElement *deferred_element;
+
+        element_filter filter;
+        const HTMLElement *pruned_root;
+        size_t pruned_depth;
+
+        bool track_source;
+        size_t token_start;
+        size_t token_end;
+        size_t tracked_stack_size;
+        HTMLElement *tracked_current;
+        HTMLElement *tracked_parent;
 };
 
 #endif // HTMLPARSER_HPP
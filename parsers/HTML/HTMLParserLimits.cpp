@@ -0,0 +1,26 @@
+#include "HTMLParserLimits.hpp"
+
+HTMLParserLimits::HTMLParserLimits()
+{
+    max_depth = 0;
+    max_nodes = 0;
+    max_attributes = 0;
+    max_text_length = 0;
+    max_comment_length = 0;
+    max_dom_bytes = 0;
+}
+
+HTMLParserLimits HTMLParserLimits::for_untrusted_input()
+{
+    HTMLParserLimits limits;
+
+    // The depth Blink stops nesting at
+    limits.max_depth = 512;
+    limits.max_nodes = 4 * 1024 * 1024;
+    limits.max_attributes = 1024;
+    limits.max_text_length = 16 * 1024 * 1024;
+    limits.max_comment_length = 1024 * 1024;
+    limits.max_dom_bytes = 1024 * 1024 * 1024;
+
+    return limits;
+}
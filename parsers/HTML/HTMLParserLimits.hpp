@@ -0,0 +1,47 @@
+#ifndef HTMLPARSERLIMITS_HPP
+#define HTMLPARSERLIMITS_HPP
+
+#include <cstddef>
+
+// Caps on what a single document can make the parser build, for input
+// nobody vouches for. 0 means no limit, which is what the constructor sets.
+// See HTMLParser::set_limits.
+struct HTMLParserLimits
+{
+    HTMLParserLimits();
+    // Generous for real pages, tight enough that a hostile one can't take
+    // more than a bounded amount of memory and time
+    static HTMLParserLimits for_untrusted_input();
+
+    // How deep the open elements can nest, html included. The element
+    // that goes past it is still added, but the rest of the input is
+    // ignored as if the document ended there. The tree construction rules
+    // take time in proportion to the depth, this bounds that too.
+    size_t max_depth;
+    // Elements and text nodes. Once there are this many the document ends
+    // like it does at max_depth.
+    size_t max_nodes;
+    // Attributes of a tag past this many are dropped, in source order
+    size_t max_attributes;
+    // A text node stops growing at this many characters, the rest of its
+    // text is dropped
+    size_t max_text_length;
+    // The same for comments, in the tokenizer
+    size_t max_comment_length;
+    // Estimated memory of the elements, text and attributes built so far.
+    // Reaching it ends the document too.
+    size_t max_dom_bytes;
+
+    // Which limits a document ran into, see HTMLParser::get_limits_hit
+    enum limit_flag
+    {
+        depth_limited = 1 << 0,
+        nodes_limited = 1 << 1,
+        attributes_limited = 1 << 2,
+        text_limited = 1 << 3,
+        comment_limited = 1 << 4,
+        dom_bytes_limited = 1 << 5
+    };
+};
+
+#endif // HTMLPARSERLIMITS_HPP
@@ -0,0 +1,39 @@
+#include <vector>
+
+#include "HTMLParserPool.hpp"
+
+static thread_local std::vector<std::unique_ptr<HTMLParser>> idle_parsers;
+
+std::shared_ptr<HTMLParser> HTMLParserPool::acquire()
+{
+    HTMLParser *parser = nullptr;
+
+    if (idle_parsers.empty())
+        parser = new HTMLParser();
+    else
+    {
+        parser = idle_parsers.back().release();
+        idle_parsers.pop_back();
+    }
+
+    return std::shared_ptr<HTMLParser>(parser, &HTMLParserPool::release);
+}
+
+void HTMLParserPool::release(HTMLParser *parser)
+{
+    if (idle_parsers.size() >= max_idle_parsers)
+    {
+        delete parser;
+        return;
+    }
+
+    parser->reset();
+    parser->set_pipelined(false);
+    parser->set_source_tracking(false);
+    parser->set_element_filter(nullptr);
+    parser->set_head_only(false);
+    parser->set_limits(HTMLParserLimits());
+    parser->set_deferred_parsing(0);
+    parser->set_event_sink(nullptr);
+    idle_parsers.emplace_back(parser);
+}
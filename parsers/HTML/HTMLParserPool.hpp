@@ -0,0 +1,25 @@
+#ifndef HTMLPARSERPOOL_HPP
+#define HTMLPARSERPOOL_HPP
+
+#include <memory>
+
+#include "HTMLParser.hpp"
+
+// Parsers ready for use, one pool per thread. A parser that has been through
+// a few documents has all its buffers at the right size already, so handing
+// it on to the next document saves most of the allocations of a new one.
+class HTMLParserPool
+{
+    public:
+        // The parser goes back to the pool of the thread that drops the
+        // last copy of the pointer, reset and with the default settings
+        static std::shared_ptr<HTMLParser> acquire();
+
+        // Parsers beyond this many are freed instead of kept
+        static const size_t max_idle_parsers = 4;
+
+    private:
+        static void release(HTMLParser *parser);
+};
+
+#endif // HTMLPARSERPOOL_HPP
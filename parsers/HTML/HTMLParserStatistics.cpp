@@ -0,0 +1,33 @@
+#include "HTMLParserStatistics.hpp"
+
+const char *const HTMLParserStatistics::insertion_mode_names[insertion_mode_count] = {
+    "initial", "before html", "before head", "in head", "in head noscript",
+    "after head", "in body", "text", "in table", "in table text",
+    "in caption", "in column group", "in table body", "in row", "in cell",
+    "in select", "in select in table", "in foreign content", "after body",
+    "in frameset", "after frameset", "after after body",
+    "after after frameset"
+};
+
+const char *const HTMLParserStatistics::parse_error_names[parse_error_type_count] = {
+    "unexpected DOCTYPE", "unexpected start tag", "unexpected end tag",
+    "end tag for a node other than the current one",
+    "misnested formatting element", "nested heading",
+    "head content after head", "content after body", "end of file in text"
+};
+
+HTMLParserStatistics::HTMLParserStatistics()
+{
+    for (size_t i = 0; i < insertion_mode_count; i++)
+    {
+        tokens_per_mode[i] = 0;
+        time_per_mode[i] = std::chrono::nanoseconds::zero();
+    }
+
+    for (size_t i = 0; i < parse_error_type_count; i++)
+        parse_errors[i] = 0;
+
+    reprocessed_tokens = 0;
+    max_open_elements = 0;
+    max_formatting_elements = 0;
+}
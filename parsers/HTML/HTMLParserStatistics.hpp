@@ -0,0 +1,46 @@
+#ifndef HTMLPARSERSTATISTICS_HPP
+#define HTMLPARSERSTATISTICS_HPP
+
+#include <cstddef>
+#include <chrono>
+
+// Where the tree builder spent its time on a document. Only collected when
+// the parser is compiled with PARSER_STATISTICS, see
+// Document::get_parser_statistics. Defining it or not in code that only uses
+// the parser makes no difference.
+struct HTMLParserStatistics
+{
+    // Indexed like HTMLParser::insertion_mode
+    static const size_t insertion_mode_count = 23;
+    static const char *const insertion_mode_names[insertion_mode_count];
+
+    enum parse_error_type
+    {
+        unexpected_doctype,
+        unexpected_start_tag,
+        unexpected_end_tag,
+        end_tag_not_current_node,
+        misnested_formatting_element,
+        nested_heading,
+        head_content_after_head,
+        content_after_body,
+        eof_in_text,
+        parse_error_type_count
+    };
+
+    static const char *const parse_error_names[parse_error_type_count];
+
+    HTMLParserStatistics();
+
+    // Tokens handled in each mode, including the ones a mode hands on to
+    // the rules of another
+    size_t tokens_per_mode[insertion_mode_count];
+    std::chrono::nanoseconds time_per_mode[insertion_mode_count];
+    // Tokens that had to go through a second mode after a mode switch
+    size_t reprocessed_tokens;
+    size_t parse_errors[parse_error_type_count];
+    size_t max_open_elements;
+    size_t max_formatting_elements;
+};
+
+#endif // HTMLPARSERSTATISTICS_HPP
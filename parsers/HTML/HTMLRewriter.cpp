@@ -0,0 +1,603 @@
+#ifdef CONSOLE
+#include <iostream>
+#endif // CONSOLE
+
+#include "HTMLRewriter.hpp"
+#include "HTMLParser.hpp"
+
+// Start tags that close an open p element in button scope
+static const std::set<std::wstring> p_closing_tags = {
+    L"address", L"article", L"aside", L"blockquote", L"center", L"dd",
+    L"details", L"dialog", L"dir", L"div", L"dl", L"dt", L"fieldset",
+    L"figcaption", L"figure", L"footer", L"form", L"h1", L"h2", L"h3",
+    L"h4", L"h5", L"h6", L"header", L"hgroup", L"hr", L"li", L"listing",
+    L"main", L"menu", L"nav", L"ol", L"p", L"plaintext", L"pre",
+    L"search", L"section", L"summary", L"table", L"ul", L"xmp"
+};
+
+static const std::set<std::wstring> button_scope_boundaries = {
+    L"applet", L"button", L"caption", L"html", L"table", L"td", L"th",
+    L"marquee", L"object", L"template"
+};
+
+static const std::set<std::wstring> table_boundaries = {
+    L"html", L"table", L"template"
+};
+
+static const std::set<std::wstring> no_boundaries;
+
+static const std::set<std::wstring> p_tags = { L"p" };
+static const std::set<std::wstring> li_tags = { L"li" };
+static const std::set<std::wstring> definition_tags = { L"dd", L"dt" };
+static const std::set<std::wstring> cell_tags = { L"td", L"th" };
+static const std::set<std::wstring> row_tags = { L"tr" };
+static const std::set<std::wstring> table_section_tags = {
+    L"tbody", L"thead", L"tfoot"
+};
+static const std::set<std::wstring> head_tags = { L"head" };
+
+const std::wstring &HTMLRewriter::element::get_tag_name() const
+{
+    return tag_name;
+}
+
+const std::map<std::wstring, std::wstring> &HTMLRewriter::element::get_attributes() const
+{
+    return attributes;
+}
+
+bool HTMLRewriter::element::has_attribute(const std::wstring &name) const
+{
+    return attributes.count(name) != 0;
+}
+
+std::wstring HTMLRewriter::element::get_attribute(const std::wstring &name) const
+{
+    std::map<std::wstring, std::wstring>::const_iterator found = attributes.find(name);
+
+    return found == attributes.cend() ? L"" : found->second;
+}
+
+void HTMLRewriter::element::set_attribute(const std::wstring &name,
+        const std::wstring &value)
+{
+    attributes[name] = value;
+    modified = true;
+}
+
+void HTMLRewriter::element::remove_attribute(const std::wstring &name)
+{
+    if (attributes.erase(name) != 0)
+        modified = true;
+}
+
+void HTMLRewriter::element::before(const std::wstring &html)
+{
+    before_html += html;
+}
+
+void HTMLRewriter::element::prepend(const std::wstring &html)
+{
+    prepend_html = html + prepend_html;
+}
+
+void HTMLRewriter::element::append(const std::wstring &html)
+{
+    append_html += html;
+}
+
+void HTMLRewriter::element::after(const std::wstring &html)
+{
+    after_html = html + after_html;
+}
+
+void HTMLRewriter::element::remove()
+{
+    removed = true;
+}
+
+void HTMLRewriter::element::remove_and_keep_content()
+{
+    keep_content = true;
+}
+
+bool HTMLRewriter::element::is_removed() const
+{
+    return removed;
+}
+
+HTMLRewriter::element::element()
+{
+    modified = false;
+    removed = false;
+    keep_content = false;
+}
+
+void HTMLRewriter::element::reset(const std::wstring &tag_name,
+        const std::map<std::wstring, std::wstring> &attributes)
+{
+    this->tag_name = tag_name;
+    this->attributes = attributes;
+    modified = false;
+    removed = false;
+    keep_content = false;
+    before_html.clear();
+    prepend_html.clear();
+    append_html.clear();
+    after_html.clear();
+}
+
+const std::wstring &HTMLRewriter::text_chunk::get_text() const
+{
+    return text;
+}
+
+void HTMLRewriter::text_chunk::replace(const std::wstring &html)
+{
+    text = html;
+}
+
+void HTMLRewriter::text_chunk::remove()
+{
+    removed = true;
+}
+
+bool HTMLRewriter::text_chunk::is_removed() const
+{
+    return removed;
+}
+
+HTMLRewriter::HTMLRewriter(const output_sink &output_function)
+    : sink(output_function)
+{
+    active_text_handlers = 0;
+    position = 0;
+    removed_depth = 0;
+    in_plaintext = false;
+}
+
+void HTMLRewriter::on_element(const std::wstring &selector,
+        const element_handler &handler)
+{
+    HTMLSelector element_selector(selector);
+
+    if (!element_selector.is_valid())
+    {
+        #ifdef CONSOLE
+        std::wcerr << L"ERROR: Can't parse selector " << selector << std::endl;
+        #endif // CONSOLE
+        return;
+    }
+
+    element_handlers.emplace_back(element_selector, handler);
+}
+
+void HTMLRewriter::on_text(const std::wstring &selector, const text_handler &handler)
+{
+    HTMLSelector text_selector(selector);
+
+    if (!text_selector.is_valid())
+    {
+        #ifdef CONSOLE
+        std::wcerr << L"ERROR: Can't parse selector " << selector << std::endl;
+        #endif // CONSOLE
+        return;
+    }
+
+    text_handlers.emplace_back(text_selector, handler);
+    text_handler_depths.push_back(0);
+}
+
+void HTMLRewriter::write(const std::wstring &html)
+{
+    // Drop what's been rewritten once it's most of the buffer
+    if (position > 4096 && position * 2 > input.size())
+    {
+        input.erase(0, position);
+        position = 0;
+    }
+
+    input += html;
+    run(false);
+    flush();
+}
+
+void HTMLRewriter::end()
+{
+    run(true);
+
+    while (!open_elements.empty())
+        close_element(0, 0);
+
+    flush();
+
+    tokenizer.reset();
+    input.clear();
+    position = 0;
+    removed_depth = 0;
+    active_text_handlers = 0;
+    raw_text_tag.clear();
+    in_plaintext = false;
+}
+
+void HTMLRewriter::run(bool complete)
+{
+    while (true)
+    {
+        // Text is passed on without being tokenized, up to the next tag
+        if (in_plaintext)
+        {
+            emit_text(position, input.size());
+            position = input.size();
+            return;
+        }
+
+        if (!raw_text_tag.empty())
+        {
+            bool found = false;
+            size_t text_end = HTMLTokenizer::find_raw_text_end(input, position,
+                    raw_text_tag, complete, found);
+
+            emit_text(position, text_end);
+            position = text_end;
+
+            if (!found)
+                return;
+
+            raw_text_tag.clear();
+        }
+
+        else
+        {
+            size_t less_than = input.find(L'<', position);
+            if (less_than == std::wstring::npos)
+                less_than = input.size();
+
+            emit_text(position, less_than);
+            position = less_than;
+
+            if (position == input.size())
+                return;
+        }
+
+        const size_t token_start = position;
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(input,
+                position, complete);
+
+        if (token == nullptr)
+            return;
+
+        if (token->is_start_token())
+            process_start_tag(token, token_start);
+
+        else if (token->is_end_token())
+            process_end_tag(token, token_start);
+
+        // A '<' that doesn't start a tag
+        else if (token->is_char_token())
+            emit_text(token_start, position);
+
+        // Comments, doctypes and unfinished tags at the end of the input
+        else
+        {
+            if (position == token_start)
+                position = input.size();
+
+            write_input(token_start, position);
+        }
+    }
+}
+
+void HTMLRewriter::process_start_tag(const std::shared_ptr<HTMLToken> &token,
+        size_t token_start)
+{
+    const std::wstring &tag_name = token->get_tag_name();
+    const std::map<std::wstring, std::wstring> &attributes = token->get_attributes();
+
+    close_implied_elements(tag_name);
+
+    // Inside svg and math, any element can be self-closing
+    const bool foreign = tag_name == L"svg" || tag_name == L"math" ||
+        (!open_elements.empty() && open_elements.back().foreign);
+    const bool has_content = foreign ? !token->is_self_closing() :
+        !HTMLParser::is_void_tag(tag_name);
+
+    open_element entry;
+    entry.tag_name = tag_name;
+    entry.foreign = foreign;
+    entry.removed = false;
+    entry.drop_end_tag = false;
+
+    bool handled = false;
+
+    // Nothing inside a removed element makes it to the output anyway
+    if (removed_depth == 0)
+    {
+        for (std::pair<HTMLSelector, element_handler> &handler : element_handlers)
+        {
+            if (!handler.first.matches(tag_name, attributes))
+                continue;
+
+            if (!handled)
+                current_element.reset(tag_name, attributes);
+
+            handled = true;
+            handler.second(current_element);
+        }
+
+        if (has_content)
+        {
+            for (size_t i = 0; i < text_handlers.size(); i++)
+            {
+                if (text_handlers[i].first.matches(tag_name, attributes))
+                    entry.text_handlers.push_back(i);
+            }
+        }
+    }
+
+    if (!handled)
+        write_input(token_start, position);
+
+    else
+    {
+        write_html(current_element.before_html);
+
+        if (!current_element.removed)
+        {
+            if (current_element.keep_content)
+                ; // no start tag
+            else if (current_element.modified)
+                write_html(serialize_start_tag(current_element,
+                            token->is_self_closing()));
+            else
+                write_input(token_start, position);
+
+            write_html(current_element.prepend_html);
+        }
+
+        if (has_content)
+        {
+            entry.removed = current_element.removed;
+            entry.drop_end_tag = current_element.keep_content;
+            entry.append_html = current_element.append_html;
+            entry.after_html = current_element.after_html;
+        }
+
+        else
+            write_html(current_element.after_html);
+    }
+
+    if (!has_content)
+        return;
+
+    if (entry.removed)
+        removed_depth++;
+
+    for (size_t handler_index : entry.text_handlers)
+    {
+        if (text_handler_depths[handler_index]++ == 0)
+            active_text_handlers++;
+    }
+
+    open_elements.push_back(std::move(entry));
+
+    if (foreign)
+        return;
+
+    switch (HTMLTokenizer::state_for_start_tag(tag_name))
+    {
+        case HTMLTokenizer::rcdata_state:
+        case HTMLTokenizer::rawtext_state:
+        case HTMLTokenizer::script_data_state:
+            raw_text_tag = tag_name;
+            break;
+        case HTMLTokenizer::plaintext_state:
+            in_plaintext = true;
+            break;
+        default:
+            break;
+    }
+}
+
+void HTMLRewriter::process_end_tag(const std::shared_ptr<HTMLToken> &token,
+        size_t token_start)
+{
+    const std::wstring &tag_name = token->get_tag_name();
+    size_t index = open_elements.size();
+
+    while (index > 0 && open_elements[index - 1].tag_name != tag_name)
+        index--;
+
+    // An end tag without a start tag goes through untouched
+    if (index == 0)
+    {
+        write_input(token_start, position);
+        return;
+    }
+
+    while (open_elements.size() > index)
+        close_element(0, 0);
+
+    close_element(token_start, position);
+}
+
+void HTMLRewriter::close_implied_elements(const std::wstring &tag_name)
+{
+    // A simplified version of what the in body and in table insertion
+    // modes do before inserting an element
+    if (tag_name == L"body")
+        close_open_element(head_tags, no_boundaries, false);
+
+    if (p_closing_tags.count(tag_name) != 0)
+        close_open_element(p_tags, button_scope_boundaries, false);
+
+    if (tag_name == L"li")
+        close_open_element(li_tags, no_boundaries, true);
+
+    else if (tag_name == L"dd" || tag_name == L"dt")
+        close_open_element(definition_tags, no_boundaries, true);
+
+    else if (HTMLParser::is_heading_tag(tag_name))
+    {
+        if (!open_elements.empty() &&
+                HTMLParser::is_heading_tag(open_elements.back().tag_name))
+            close_element(0, 0);
+    }
+
+    else if (tag_name == L"option" || tag_name == L"optgroup")
+    {
+        if (!open_elements.empty() && open_elements.back().tag_name == L"option")
+            close_element(0, 0);
+
+        if (tag_name == L"optgroup" && !open_elements.empty() &&
+                open_elements.back().tag_name == L"optgroup")
+            close_element(0, 0);
+    }
+
+    else if (tag_name == L"td" || tag_name == L"th")
+        close_open_element(cell_tags, table_boundaries, false);
+
+    else if (tag_name == L"tr")
+        close_open_element(row_tags, table_boundaries, false);
+
+    else if (table_section_tags.count(tag_name) != 0)
+        close_open_element(table_section_tags, table_boundaries, false);
+}
+
+void HTMLRewriter::close_open_element(const std::set<std::wstring> &targets,
+        const std::set<std::wstring> &boundaries, bool special_boundary)
+{
+    for (size_t index = open_elements.size(); index > 0; index--)
+    {
+        const std::wstring &tag_name = open_elements[index - 1].tag_name;
+
+        if (targets.count(tag_name) != 0)
+        {
+            while (open_elements.size() >= index)
+                close_element(0, 0);
+
+            return;
+        }
+
+        if (boundaries.count(tag_name) != 0)
+            return;
+
+        if (special_boundary && HTMLParser::is_special_tag(tag_name) &&
+                tag_name != L"address" && tag_name != L"div" && tag_name != L"p")
+            return;
+    }
+}
+
+void HTMLRewriter::close_element(size_t end_tag_start, size_t end_tag_end)
+{
+    // end_tag_start == end_tag_end for elements closed without an end tag
+    open_element entry = std::move(open_elements.back());
+    open_elements.pop_back();
+
+    for (size_t handler_index : entry.text_handlers)
+    {
+        if (--text_handler_depths[handler_index] == 0)
+            active_text_handlers--;
+    }
+
+    if (entry.removed)
+        removed_depth--;
+
+    else
+    {
+        write_html(entry.append_html);
+
+        if (!entry.drop_end_tag)
+            write_input(end_tag_start, end_tag_end);
+    }
+
+    write_html(entry.after_html);
+
+    // The end tag of a raw text element is found before it's tokenized,
+    // an implied one means the input ended inside the element
+    if (entry.tag_name == raw_text_tag)
+        raw_text_tag.clear();
+}
+
+void HTMLRewriter::emit_text(size_t start, size_t end)
+{
+    if (start == end || removed_depth > 0)
+        return;
+
+    if (active_text_handlers == 0)
+    {
+        write_input(start, end);
+        return;
+    }
+
+    current_text.text.assign(input, start, end - start);
+    current_text.removed = false;
+
+    for (size_t i = 0; i < text_handlers.size() && !current_text.removed; i++)
+    {
+        if (text_handler_depths[i] != 0)
+            text_handlers[i].second(current_text);
+    }
+
+    if (!current_text.removed)
+        write_html(current_text.text);
+}
+
+void HTMLRewriter::write_input(size_t start, size_t end)
+{
+    if (removed_depth == 0)
+        output.append(input, start, end - start);
+}
+
+void HTMLRewriter::write_html(const std::wstring &html)
+{
+    if (removed_depth == 0)
+        output += html;
+}
+
+void HTMLRewriter::flush()
+{
+    if (output.empty())
+        return;
+
+    sink(output);
+    output.clear();
+}
+
+std::wstring HTMLRewriter::serialize_start_tag(const element &start_tag,
+        bool self_closing)
+{
+    // Attributes come out in name order, the token doesn't keep the
+    // original one
+    std::wstring serialized = L"<" + start_tag.tag_name;
+
+    for (const std::pair<const std::wstring, std::wstring> &attribute :
+            start_tag.attributes)
+    {
+        serialized += L' ';
+        serialized += attribute.first;
+
+        if (attribute.second.empty())
+            continue;
+
+        serialized += L"=\"";
+
+        for (wchar_t next_char : attribute.second)
+        {
+            if (next_char == L'&')
+                serialized += L"&amp;";
+            else if (next_char == L'"')
+                serialized += L"&quot;";
+            else
+                serialized += next_char;
+        }
+
+        serialized += L'"';
+    }
+
+    if (self_closing)
+        serialized += L" /";
+
+    serialized += L'>';
+    return serialized;
+}
@@ -0,0 +1,156 @@
+#ifndef HTMLREWRITER_HPP
+#define HTMLREWRITER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <functional>
+
+#include "HTMLTokenizer.hpp"
+#include "HTMLSelector.hpp"
+#include "tokens/HTMLToken.hpp"
+
+// Rewrites HTML as it streams through, without a DOM: handlers registered
+// for selectors can change or drop the attributes of matching start tags,
+// remove elements, insert markup around them and replace the text inside
+// them. Everything no handler touches is copied from the input as it is.
+//
+// Only the tags are tokenized. Which element a piece of text or an end tag
+// belongs to comes from a stack of open elements that knows about void
+// elements, raw text elements and the usual implied end tags (p, li, dd,
+// dt, option, table parts), but not about the adoption agency or foster
+// parenting. Output is handed to the sink at the end of every write(), and
+// apart from the open elements only an unfinished tag is held back.
+class HTMLRewriter
+{
+    public:
+        class element
+        {
+            public:
+                const std::wstring &get_tag_name() const;
+                const std::map<std::wstring, std::wstring> &get_attributes() const;
+                bool has_attribute(const std::wstring &name) const;
+                std::wstring get_attribute(const std::wstring &name) const;
+                void set_attribute(const std::wstring &name, const std::wstring &value);
+                void remove_attribute(const std::wstring &name);
+
+                // Markup inserted as is, before the start tag, after it,
+                // before the end tag and after the end tag
+                void before(const std::wstring &html);
+                void prepend(const std::wstring &html);
+                void append(const std::wstring &html);
+                void after(const std::wstring &html);
+
+                // The element and everything in it
+                void remove();
+                // Just the start and end tags
+                void remove_and_keep_content();
+                bool is_removed() const;
+
+            private:
+                friend class HTMLRewriter;
+
+                element();
+                void reset(const std::wstring &tag_name,
+                        const std::map<std::wstring, std::wstring> &attributes);
+
+                std::wstring tag_name;
+                std::map<std::wstring, std::wstring> attributes;
+                bool modified;
+                bool removed;
+                bool keep_content;
+                std::wstring before_html;
+                std::wstring prepend_html;
+                std::wstring append_html;
+                std::wstring after_html;
+        };
+
+        // Text as it appears in the source, character references and all.
+        // A run of text can come in several chunks, and text handlers see
+        // the text anywhere inside a matching element.
+        class text_chunk
+        {
+            public:
+                const std::wstring &get_text() const;
+                // Markup inserted as is in place of the text
+                void replace(const std::wstring &html);
+                void remove();
+                bool is_removed() const;
+
+            private:
+                friend class HTMLRewriter;
+
+                std::wstring text;
+                bool removed;
+        };
+
+        typedef std::function<void (element &)> element_handler;
+        typedef std::function<void (text_chunk &)> text_handler;
+        typedef std::function<void (const std::wstring &chunk)> output_sink;
+
+        explicit HTMLRewriter(const output_sink &output_function);
+
+        // Handlers run in the order they were added. Selectors that don't
+        // parse are ignored, see HTMLSelector for what's understood.
+        void on_element(const std::wstring &selector, const element_handler &handler);
+        void on_text(const std::wstring &selector, const text_handler &handler);
+
+        void write(const std::wstring &html);
+        // Flushes what's left and gets ready for the next document, the
+        // handlers stay
+        void end();
+
+    private:
+        struct open_element
+        {
+            std::wstring tag_name;
+            bool foreign;
+            bool removed;
+            bool drop_end_tag;
+            std::wstring append_html;
+            std::wstring after_html;
+            std::vector<size_t> text_handlers;
+        };
+
+        void run(bool complete);
+        void process_start_tag(const std::shared_ptr<HTMLToken> &token,
+                size_t token_start);
+        void process_end_tag(const std::shared_ptr<HTMLToken> &token,
+                size_t token_start);
+        void close_implied_elements(const std::wstring &tag_name);
+        void close_open_element(const std::set<std::wstring> &targets,
+                const std::set<std::wstring> &boundaries, bool special_boundary);
+        void close_element(size_t end_tag_start, size_t end_tag_end);
+        void emit_text(size_t start, size_t end);
+        void write_input(size_t start, size_t end);
+        void write_html(const std::wstring &html);
+        void flush();
+        static std::wstring serialize_start_tag(const element &start_tag,
+                bool self_closing);
+
+        output_sink sink;
+        std::vector<std::pair<HTMLSelector, element_handler>> element_handlers;
+        std::vector<std::pair<HTMLSelector, text_handler>> text_handlers;
+        // Per text handler, how many open elements it applies to
+        std::vector<size_t> text_handler_depths;
+        size_t active_text_handlers;
+
+        HTMLTokenizer tokenizer;
+        std::wstring input;
+        size_t position;
+        std::wstring output;
+
+        std::vector<open_element> open_elements;
+        // Open elements that were removed, nothing is written while inside one
+        size_t removed_depth;
+        // Set while inside script, style, title, textarea and the like
+        std::wstring raw_text_tag;
+        bool in_plaintext;
+
+        element current_element;
+        text_chunk current_text;
+};
+
+#endif // HTMLREWRITER_HPP
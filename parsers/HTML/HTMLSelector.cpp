@@ -0,0 +1,277 @@
+#include "HTMLSelector.hpp"
+
+static bool is_space(wchar_t next_char)
+{
+    return next_char == L' ' || next_char == L'\t' || next_char == L'\n' ||
+        next_char == L'\r' || next_char == L'\f';
+}
+
+static bool is_name_char(wchar_t next_char)
+{
+    return (next_char >= L'a' && next_char <= L'z') ||
+        (next_char >= L'A' && next_char <= L'Z') ||
+        (next_char >= L'0' && next_char <= L'9') ||
+        next_char == L'-' || next_char == L'_' || next_char >= 0x80;
+}
+
+static wchar_t to_ascii_lower(wchar_t next_char)
+{
+    if (next_char >= L'A' && next_char <= L'Z')
+        return next_char + (L'a' - L'A');
+
+    return next_char;
+}
+
+static void skip_spaces(const std::wstring &text, size_t &position)
+{
+    while (position < text.size() && is_space(text[position]))
+        position++;
+}
+
+static bool read_name(const std::wstring &text, size_t &position,
+        std::wstring &name, bool lowercase)
+{
+    name.clear();
+
+    while (position < text.size() && is_name_char(text[position]))
+    {
+        name += lowercase ? to_ascii_lower(text[position]) : text[position];
+        position++;
+    }
+
+    return !name.empty();
+}
+
+HTMLSelector::HTMLSelector()
+{
+    valid = false;
+}
+
+HTMLSelector::HTMLSelector(const std::wstring &selector_text)
+{
+    valid = parse(selector_text);
+
+    if (!valid)
+        selectors.clear();
+}
+
+bool HTMLSelector::is_valid() const
+{
+    return valid;
+}
+
+bool HTMLSelector::parse(const std::wstring &selector_text)
+{
+    size_t position = 0;
+
+    while (true)
+    {
+        skip_spaces(selector_text, position);
+
+        compound_selector selector;
+        bool empty = true;
+
+        if (position < selector_text.size() && selector_text[position] == L'*')
+        {
+            position++;
+            empty = false;
+        }
+
+        else if (read_name(selector_text, position, selector.tag_name, true))
+            empty = false;
+
+        while (position < selector_text.size())
+        {
+            const wchar_t next_char = selector_text[position];
+            condition attribute_condition;
+
+            if (next_char == L'#' || next_char == L'.')
+            {
+                position++;
+                attribute_condition.attribute_name = next_char == L'#' ? L"id" : L"class";
+                attribute_condition.type = next_char == L'#' ? equals : includes;
+
+                if (!read_name(selector_text, position, attribute_condition.value, false))
+                    return false;
+            }
+
+            else if (next_char == L'[')
+            {
+                position++;
+                skip_spaces(selector_text, position);
+
+                if (!read_name(selector_text, position,
+                            attribute_condition.attribute_name, true))
+                    return false;
+
+                skip_spaces(selector_text, position);
+                attribute_condition.type = exists;
+
+                if (position < selector_text.size() && selector_text[position] != L']')
+                {
+                    switch (selector_text[position])
+                    {
+                        case L'=':
+                            attribute_condition.type = equals;
+                            break;
+                        case L'~':
+                            attribute_condition.type = includes;
+                            break;
+                        case L'^':
+                            attribute_condition.type = begins_with;
+                            break;
+                        case L'$':
+                            attribute_condition.type = ends_with;
+                            break;
+                        case L'*':
+                            attribute_condition.type = contains;
+                            break;
+                        default:
+                            return false;
+                    }
+
+                    if (attribute_condition.type != equals)
+                    {
+                        position++;
+
+                        if (position >= selector_text.size() ||
+                                selector_text[position] != L'=')
+                            return false;
+                    }
+
+                    position++;
+                    skip_spaces(selector_text, position);
+
+                    if (position < selector_text.size() &&
+                            (selector_text[position] == L'"' ||
+                             selector_text[position] == L'\''))
+                    {
+                        const wchar_t quote = selector_text[position];
+                        size_t value_end = selector_text.find(quote, position + 1);
+
+                        if (value_end == std::wstring::npos)
+                            return false;
+
+                        attribute_condition.value = selector_text.substr(
+                                position + 1, value_end - position - 1);
+                        position = value_end + 1;
+                    }
+
+                    else if (!read_name(selector_text, position,
+                                attribute_condition.value, false))
+                        return false;
+
+                    skip_spaces(selector_text, position);
+                }
+
+                if (position >= selector_text.size() || selector_text[position] != L']')
+                    return false;
+
+                position++;
+            }
+
+            else
+                break;
+
+            selector.conditions.push_back(attribute_condition);
+            empty = false;
+        }
+
+        if (empty)
+            return false;
+
+        selectors.push_back(selector);
+        skip_spaces(selector_text, position);
+
+        if (position == selector_text.size())
+            return true;
+
+        if (selector_text[position] != L',')
+            return false;
+
+        position++;
+    }
+}
+
+bool HTMLSelector::matches_condition(const condition &attribute_condition,
+        const std::map<std::wstring, std::wstring> &attributes)
+{
+    std::map<std::wstring, std::wstring>::const_iterator found =
+        attributes.find(attribute_condition.attribute_name);
+
+    if (found == attributes.cend())
+        return false;
+
+    const std::wstring &value = found->second;
+    const std::wstring &expected = attribute_condition.value;
+
+    switch (attribute_condition.type)
+    {
+        case exists:
+            return true;
+
+        case equals:
+            return value == expected;
+
+        case includes:
+        {
+            // One of the whitespace separated words
+            size_t position = 0;
+
+            while (position < value.size())
+            {
+                while (position < value.size() && is_space(value[position]))
+                    position++;
+
+                size_t word_start = position;
+                while (position < value.size() && !is_space(value[position]))
+                    position++;
+
+                if (position > word_start &&
+                        value.compare(word_start, position - word_start, expected) == 0)
+                    return true;
+            }
+
+            return false;
+        }
+
+        case begins_with:
+            return !expected.empty() && value.compare(0, expected.size(), expected) == 0;
+
+        case ends_with:
+            return !expected.empty() && value.size() >= expected.size() &&
+                value.compare(value.size() - expected.size(), expected.size(),
+                        expected) == 0;
+
+        case contains:
+            return !expected.empty() && value.find(expected) != std::wstring::npos;
+    }
+
+    return false;
+}
+
+bool HTMLSelector::matches(const std::wstring &tag_name,
+        const std::map<std::wstring, std::wstring> &attributes) const
+{
+    for (const compound_selector &selector : selectors)
+    {
+        if (!selector.tag_name.empty() && selector.tag_name != tag_name)
+            continue;
+
+        bool all_match = true;
+
+        for (const condition &attribute_condition : selector.conditions)
+        {
+            if (!matches_condition(attribute_condition, attributes))
+            {
+                all_match = false;
+                break;
+            }
+        }
+
+        if (all_match)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,56 @@
+#ifndef HTMLSELECTOR_HPP
+#define HTMLSELECTOR_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+
+// The selectors HTMLRewriter matches start tags with: a type selector or
+// '*' followed by any number of #id, .class and [attribute] conditions,
+// where attribute values can be compared with =, ~=, ^=, $= and *=.
+// Selector lists match when any of their selectors does. Combinators
+// aren't supported, they need more of the tree than a rewriter keeps.
+class HTMLSelector
+{
+    public:
+        HTMLSelector();
+        explicit HTMLSelector(const std::wstring &selector_text);
+
+        bool is_valid() const;
+        bool matches(const std::wstring &tag_name,
+                const std::map<std::wstring, std::wstring> &attributes) const;
+
+    private:
+        enum match_type
+        {
+            exists,
+            equals,
+            includes,
+            begins_with,
+            ends_with,
+            contains
+        };
+
+        struct condition
+        {
+            std::wstring attribute_name;
+            match_type type;
+            std::wstring value;
+        };
+
+        struct compound_selector
+        {
+            // Empty for '*'
+            std::wstring tag_name;
+            std::vector<condition> conditions;
+        };
+
+        bool parse(const std::wstring &selector_text);
+        static bool matches_condition(const condition &attribute_condition,
+                const std::map<std::wstring, std::wstring> &attributes);
+
+        std::vector<compound_selector> selectors;
+        bool valid;
+};
+
+#endif // HTMLSELECTOR_HPP
@@ -0,0 +1,370 @@
+#include <algorithm>
+
+#include "HTMLTextExtractor.hpp"
+#include "../../elements/HTML/HTMLTagRegistry.hpp"
+
+enum text_flag
+{
+    hidden_text = 1 << 0,
+    // Starts on a line of its own
+    block_text = 1 << 1,
+    preformatted_text = 1 << 2
+};
+
+// What each tag means for the text, by HTMLTagId
+struct text_flag_table
+{
+    unsigned char flags[tag_count];
+
+    text_flag_table()
+    {
+        std::fill(flags, flags + tag_count, 0);
+
+        for (HTMLTagId tag_id : {tag_title, tag_script, tag_style,
+                tag_template, tag_noframes, tag_noembed, tag_iframe})
+            flags[tag_id] |= hidden_text;
+
+        for (HTMLTagId tag_id : {tag_address, tag_article, tag_aside,
+                tag_blockquote, tag_br, tag_caption, tag_center, tag_dd,
+                tag_details, tag_dialog, tag_dir, tag_div, tag_dl, tag_dt,
+                tag_fieldset, tag_figcaption, tag_figure, tag_footer,
+                tag_form, tag_h1, tag_h2, tag_h3, tag_h4, tag_h5, tag_h6,
+                tag_header, tag_hgroup, tag_hr, tag_li, tag_listing,
+                tag_main, tag_menu, tag_nav, tag_ol, tag_p, tag_plaintext,
+                tag_pre, tag_search, tag_section, tag_summary, tag_table,
+                tag_tbody, tag_td, tag_tfoot, tag_th, tag_thead, tag_tr,
+                tag_ul, tag_xmp})
+            flags[tag_id] |= block_text;
+
+        for (HTMLTagId tag_id : {tag_pre, tag_listing, tag_plaintext,
+                tag_textarea})
+            flags[tag_id] |= preformatted_text;
+    }
+};
+
+static const text_flag_table text_flags;
+
+static bool is_space(wchar_t next_char)
+{
+    return next_char == L' ' || next_char == L'\t' || next_char == L'\n' ||
+        next_char == L'\r' || next_char == L'\f';
+}
+
+HTMLTextExtractor::HTMLTextExtractor(std::string &output_buffer)
+    : output(output_buffer)
+{
+    output_start = output.size();
+    position = 0;
+    skipped_raw_text = nullptr;
+    hidden_depth = 0;
+    hidden_tag = tag_unknown;
+    pre_depth = 0;
+    pending_space = false;
+    pending_break = false;
+    skip_newline = false;
+    high_surrogate = 0;
+}
+
+void HTMLTextExtractor::extract(const std::wstring &html, std::string &output)
+{
+    HTMLTextExtractor extractor(output);
+
+    extractor.feed(html);
+    extractor.finish();
+}
+
+void HTMLTextExtractor::feed(const std::wstring &html)
+{
+    // Drop what's been read once it's most of the buffer
+    if (position > 4096 && position * 2 > input.size())
+    {
+        input.erase(0, position);
+        position = 0;
+    }
+
+    input += html;
+    run(false);
+}
+
+void HTMLTextExtractor::finish()
+{
+    run(true);
+
+    // A lone half of a surrogate pair
+    if (high_surrogate != 0)
+        put_code_point(0xFFFD);
+
+    tokenizer.reset();
+    input.clear();
+    position = 0;
+    skipped_raw_text = nullptr;
+    hidden_depth = 0;
+    pre_depth = 0;
+    pending_space = false;
+    pending_break = true;
+    skip_newline = false;
+    high_surrogate = 0;
+}
+
+void HTMLTextExtractor::run(bool complete)
+{
+    while (position < input.size())
+    {
+        if (skipped_raw_text != nullptr)
+        {
+            bool found = false;
+            position = HTMLTokenizer::find_raw_text_end(input, position,
+                    *skipped_raw_text, complete, found);
+
+            if (!found)
+                return;
+
+            // The end tag is read in the data state
+            skipped_raw_text = nullptr;
+        }
+
+        // Text up to the next tag or character reference is what the
+        // tokenizer would return one character at a time anyway. The second
+        // half of a surrogate pair from a reference comes from it though.
+        else if (tokenizer.get_state() == HTMLTokenizer::data_state &&
+                high_surrogate == 0)
+        {
+            size_t text_end = input.find_first_of(L"<&", position);
+            if (text_end == std::wstring::npos)
+                text_end = input.size();
+
+            if (hidden_depth == 0)
+            {
+                for (size_t i = position; i < text_end; i++)
+                    put_text(input[i]);
+            }
+
+            position = text_end;
+
+            if (position == input.size())
+                return;
+        }
+
+        std::shared_ptr<HTMLToken> token = tokenizer.next_token(input,
+                position, complete);
+
+        if (token == nullptr)
+            return;
+
+        if (token->is_char_token())
+        {
+            if (hidden_depth == 0)
+                put_text(token->get_char());
+        }
+
+        else if (token->is_start_token())
+            start_tag(*token);
+
+        else if (token->is_end_token())
+            end_tag(*token);
+
+        // Comments and doctypes aren't text, the end of the file has no
+        // input after it
+        else if (token->is_eof_token())
+            return;
+    }
+}
+
+void HTMLTextExtractor::start_tag(const HTMLToken &token)
+{
+    const HTMLTagId tag_id = token.get_tag_id();
+    const bool has_content =
+        !HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::void_tag);
+
+    // Another p or li closes the one that's open
+    if (hidden_depth == 1 && is_hidden_tag(token) &&
+            HTMLTagRegistry::has_flag(tag_id, HTMLTagRegistry::implied_end))
+        hidden_depth = 0;
+
+    skip_newline = false;
+
+    if (hidden_depth > 0)
+    {
+        if (has_content && is_hidden_tag(token))
+            hidden_depth++;
+    }
+
+    else if (has_content && ((text_flags.flags[tag_id] & hidden_text) != 0 ||
+                is_hidden(token)))
+    {
+        hidden_depth = 1;
+        hidden_tag = tag_id;
+
+        if (tag_id == tag_unknown)
+            hidden_tag_name = token.get_tag_name();
+    }
+
+    else
+    {
+        if (has_content && (text_flags.flags[tag_id] & preformatted_text) != 0)
+        {
+            pre_depth++;
+            skip_newline = true;
+        }
+
+        if ((text_flags.flags[tag_id] & block_text) != 0)
+            pending_break = true;
+    }
+
+    // Switch states like the tree builder would, so that markup inside
+    // scripts and the like isn't taken for tags. Text nobody sees isn't
+    // tokenized at all.
+    HTMLTokenizer::tokenizer_state text_state =
+        HTMLTokenizer::state_for_start_tag(tag_id);
+
+    if (text_state == HTMLTokenizer::data_state)
+        return;
+
+    if (hidden_depth > 0 && text_state != HTMLTokenizer::plaintext_state)
+        skipped_raw_text = &HTMLTagRegistry::name(tag_id);
+    else
+        tokenizer.switch_to(text_state);
+}
+
+void HTMLTextExtractor::end_tag(const HTMLToken &token)
+{
+    const HTMLTagId tag_id = token.get_tag_id();
+
+    skip_newline = false;
+
+    if (hidden_depth > 0)
+    {
+        if (is_hidden_tag(token))
+            hidden_depth--;
+
+        return;
+    }
+
+    if (pre_depth > 0 && (text_flags.flags[tag_id] & preformatted_text) != 0)
+        pre_depth--;
+
+    if ((text_flags.flags[tag_id] & block_text) != 0)
+        pending_break = true;
+}
+
+bool HTMLTextExtractor::is_hidden_tag(const HTMLToken &token) const
+{
+    return token.get_tag_id() == hidden_tag &&
+        (hidden_tag != tag_unknown || token.get_tag_name() == hidden_tag_name);
+}
+
+bool HTMLTextExtractor::is_hidden(const HTMLToken &token)
+{
+    for (const std::pair<const std::wstring, std::wstring> &attribute :
+            token.get_attributes())
+    {
+        if (attribute.first == L"hidden")
+            return true;
+
+        if (attribute.first == L"aria-hidden" && attribute.second == L"true")
+            return true;
+
+        // Only the plain inline style, stylesheets aren't looked at
+        if (attribute.first == L"style" &&
+                (attribute.second.find(L"display:none") != std::wstring::npos ||
+                    attribute.second.find(L"display: none") != std::wstring::npos))
+            return true;
+    }
+
+    return false;
+}
+
+void HTMLTextExtractor::put_text(wchar_t next_char)
+{
+    // The tree builder drops these outside raw text
+    if (next_char == L'\0')
+        return;
+
+    if (skip_newline)
+    {
+        skip_newline = false;
+
+        if (next_char == L'\n')
+            return;
+    }
+
+    if (is_space(next_char) && pre_depth == 0)
+    {
+        pending_space = true;
+        return;
+    }
+
+    // Separators only go between pieces of text, never at the start
+    if (output.size() > output_start)
+    {
+        if (pending_break)
+            output += '\n';
+        else if (pending_space)
+            output += ' ';
+    }
+
+    pending_break = false;
+    pending_space = false;
+    put_char(next_char);
+}
+
+void HTMLTextExtractor::put_char(wchar_t next_char)
+{
+    if (sizeof(wchar_t) == 2 && next_char >= 0xD800 && next_char <= 0xDFFF)
+    {
+        if (next_char <= 0xDBFF)
+        {
+            if (high_surrogate != 0)
+                put_code_point(0xFFFD);
+
+            high_surrogate = next_char;
+            return;
+        }
+
+        if (high_surrogate == 0)
+        {
+            put_code_point(0xFFFD);
+            return;
+        }
+
+        put_code_point(0x10000 + ((high_surrogate - 0xD800) << 10) +
+                (next_char - 0xDC00));
+        high_surrogate = 0;
+        return;
+    }
+
+    if (high_surrogate != 0)
+    {
+        put_code_point(0xFFFD);
+        high_surrogate = 0;
+    }
+
+    put_code_point(static_cast<char32_t>(next_char));
+}
+
+void HTMLTextExtractor::put_code_point(char32_t code_point)
+{
+    if (code_point < 0x80)
+        output += static_cast<char>(code_point);
+
+    else if (code_point < 0x800)
+    {
+        output += static_cast<char>(0xC0 | (code_point >> 6));
+        output += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+
+    else if (code_point < 0x10000)
+    {
+        output += static_cast<char>(0xE0 | (code_point >> 12));
+        output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+
+    else
+    {
+        output += static_cast<char>(0xF0 | (code_point >> 18));
+        output += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
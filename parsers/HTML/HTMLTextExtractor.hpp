@@ -0,0 +1,74 @@
+#ifndef HTMLTEXTEXTRACTOR_HPP
+#define HTMLTEXTEXTRACTOR_HPP
+
+#include <string>
+
+#include "HTMLTokenizer.hpp"
+#include "tokens/HTMLToken.hpp"
+#include "../../elements/HTML/HTMLTagId.hpp"
+
+// Turns HTML into plain text for indexing, straight from the tokenizer
+// without a tree builder or DOM. Only text a reader would see is kept:
+// nothing from titles, scripts, styles, templates or elements marked
+// hidden. Whitespace is collapsed like a browser does outside <pre>, and
+// blocks and <br>s become line breaks.
+//
+// What each tag means for the text is looked up by its HTMLTagId, and text
+// without tags or character references in it is copied without being
+// tokenized, so nothing is allocated per element or per character. Without
+// a tree builder, a hidden element ends at its own end tag, or for p, li
+// and the like at the next start tag of the same kind.
+//
+// Keep the extractor around between documents, its buffers are reused.
+class HTMLTextExtractor
+{
+    public:
+        // The text is appended to output as UTF-8
+        explicit HTMLTextExtractor(std::string &output_buffer);
+        HTMLTextExtractor(const HTMLTextExtractor &) = delete;
+        HTMLTextExtractor &operator=(const HTMLTextExtractor &) = delete;
+
+        static void extract(const std::wstring &html, std::string &output);
+
+        // Streaming input, the text of a piece is appended as soon as its
+        // tags are complete. finish() ends the document, the text of the
+        // next one starts on a line of its own.
+        void feed(const std::wstring &html);
+        void finish();
+
+    private:
+        void run(bool complete);
+        void start_tag(const HTMLToken &token);
+        void end_tag(const HTMLToken &token);
+        bool is_hidden_tag(const HTMLToken &token) const;
+        static bool is_hidden(const HTMLToken &token);
+
+        void put_text(wchar_t next_char);
+        void put_char(wchar_t next_char);
+        void put_code_point(char32_t code_point);
+
+        std::string &output;
+        size_t output_start;
+
+        HTMLTokenizer tokenizer;
+        std::wstring input;
+        size_t position;
+        // The end tag to skip the text of a hidden raw text element up to
+        const std::wstring *skipped_raw_text;
+
+        // Elements of the outermost hidden one's kind open inside it,
+        // itself included
+        size_t hidden_depth;
+        HTMLTagId hidden_tag;
+        std::wstring hidden_tag_name;
+        size_t pre_depth;
+
+        bool pending_space;
+        bool pending_break;
+        // A newline right after <pre>, <listing> or <textarea> isn't text
+        bool skip_newline;
+        // First half of a surrogate pair where wchar_t is UTF-16
+        wchar_t high_surrogate;
+};
+
+#endif // HTMLTEXTEXTRACTOR_HPP
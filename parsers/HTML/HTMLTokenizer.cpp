@@ -3,12 +3,14 @@
 #include <set>
 
 #include "HTMLTokenizer.hpp"
+#include "HTMLCharacterReferences.hpp"
 #include "tokens/StartToken.hpp"
 #include "tokens/EndToken.hpp"
 #include "tokens/DoctypeToken.hpp"
 #include "tokens/CommentToken.hpp"
 #include "tokens/CharacterToken.hpp"
 #include "tokens/EOFToken.hpp"
+#include "../../elements/HTML/HTMLTagRegistry.hpp"
 
 int get_wstring_iposition(std::wstring long_str, std::wstring substr);
 
@@ -18,7 +20,115 @@ std::set<wchar_t> space_chars = {'\u0009', '\u000A', '\u000C', '\u0020'};
 
 HTMLTokenizer::HTMLTokenizer()
 {
-    //ctor
+    current_state = data_state;
+    skip_text = false;
+    skip_subtree = false;
+    subtree_skipped = false;
+    pending_low_surrogate = 0;
+    incomplete_token = false;
+    input_complete = true;
+    retry_length = 0;
+    pushed_position = 0;
+    recycle_tokens = true;
+    blank_token = std::make_shared<HTMLToken>();
+    max_attributes = 0;
+    max_comment_length = 0;
+}
+
+void HTMLTokenizer::reset()
+{
+    // Ready for the next document. The buffers and the tokens kept for
+    // reuse stay around, so a warmed up tokenizer hardly allocates.
+    current_state = data_state;
+    last_start_tag_name.clear();
+    skip_text = false;
+    skip_subtree = false;
+    subtree_skipped = false;
+    pending_low_surrogate = 0;
+    incomplete_token = false;
+    input_complete = true;
+    retry_length = 0;
+    pushed_input.clear();
+    pushed_position = 0;
+    skipped_subtree.clear();
+}
+
+void HTMLTokenizer::set_limits(const HTMLParserLimits &limits)
+{
+    max_attributes = limits.max_attributes;
+    max_comment_length = limits.max_comment_length;
+}
+
+void HTMLTokenizer::set_token_recycling(bool recycling)
+{
+    recycle_tokens = recycling;
+
+    if (!recycling)
+    {
+        char_token = nullptr;
+        start_token = nullptr;
+        end_token = nullptr;
+    }
+}
+
+std::shared_ptr<HTMLToken> HTMLTokenizer::make_char_token(wchar_t token_char)
+{
+    // Most tokens are dropped by the tree builder before it asks for the
+    // next one. If nobody else holds on to the last token of a kind, it's
+    // filled in again instead of allocating a new one.
+    if (!recycle_tokens)
+        return std::make_shared<CharacterToken>(token_char);
+
+    if (char_token.use_count() == 1)
+        char_token->set_char(token_char);
+    else
+        char_token = std::make_shared<CharacterToken>(token_char);
+
+    return char_token;
+}
+
+std::shared_ptr<HTMLToken> HTMLTokenizer::make_start_token(wchar_t first_char)
+{
+    // The active formatting elements keep their start tags, those aren't
+    // reused until the list lets go of them
+    if (!recycle_tokens)
+    {
+        std::shared_ptr<StartToken> token = std::make_shared<StartToken>(first_char);
+        token->set_max_attributes(max_attributes);
+
+        return token;
+    }
+
+    if (start_token.use_count() == 1)
+        start_token->reset(first_char);
+    else
+        start_token = std::make_shared<StartToken>(first_char);
+
+    start_token->set_max_attributes(max_attributes);
+
+    return start_token;
+}
+
+std::shared_ptr<HTMLToken> HTMLTokenizer::make_comment_token()
+{
+    // Nothing keeps comments yet, so they aren't worth recycling
+    std::shared_ptr<CommentToken> token = std::make_shared<CommentToken>();
+    token->set_max_length(max_comment_length);
+
+    return token;
+}
+
+std::shared_ptr<HTMLToken> HTMLTokenizer::make_end_token()
+{
+    if (!recycle_tokens)
+        return std::make_shared<EndToken>();
+
+    if (end_token.use_count() == 1)
+        end_token->reset();
+    else
+        end_token = std::make_shared<EndToken>();
+
+    return end_token;
 }
 
 // TODO: Check HTML requirements more strictly
@@ -68,7 +178,15 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
 
 std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::wstring &html_string, HTMLTokenizer::tokenizer_state &state, std::wstring::const_iterator &it)
 {
-    std::shared_ptr<HTMLToken> token = std::make_shared<HTMLToken>();
+    std::shared_ptr<HTMLToken> token = blank_token;
+    incomplete_token = false;
+
+    if (pending_low_surrogate != 0)
+    {
+        token = make_char_token(pending_low_surrogate);
+        pending_low_surrogate = 0;
+        return token;
+    }
 
     // Can't use range-based loop, because we need to
     // be able to look forwards/go backwards
@@ -80,7 +198,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             case data_state:
             {
                 if (next_char == '&')
-                    state = character_reference_state;
+                    return make_character_reference_token(html_string, it);
                 else if (next_char == '<')
                     state = tag_open_state;
                 else if (it > html_string.cend())
@@ -91,7 +209,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
-                    token = std::make_shared<CharacterToken>(next_char);
+                    token = make_char_token(next_char);
                     it++;
                     return token;
                 }
@@ -101,12 +219,12 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             case rcdata_state:
             {
                 if (next_char == '&')
-                    state = character_reference_state;
+                    return make_character_reference_token(html_string, it);
                 else if (next_char == '<')
                     state = rcdata_less_than_sign_state;
                 else if (next_char == '\u0000')
                 {
-                    token = std::make_shared<CharacterToken>('\uFFFD');
+                    token = make_char_token('\uFFFD');
                     it++;
                     return token;
                 }
@@ -118,7 +236,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
-                    token = std::make_shared<CharacterToken>(next_char);
+                    token = make_char_token(next_char);
                     it++;
                     return token;
                 }
@@ -131,7 +249,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                     state = rawtext_less_than_sign_state;
                 else if (next_char == '\u0000')
                 {
-                    token = std::make_shared<CharacterToken>('\uFFFD');
+                    token = make_char_token('\uFFFD');
                     it++;
                     return token;
                 }
@@ -143,7 +261,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
-                    token = std::make_shared<CharacterToken>(next_char);
+                    token = make_char_token(next_char);
                     it++;
                     return token;
                 }
@@ -152,11 +270,32 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             }
             case script_data_state:
             {
+                // Escaped script data ("<!--" inside scripts) is not
+                // handled yet, it's tokenized like the unescaped form
+                if (next_char == '<')
+                    state = script_data_less_than_sign_state;
+                else if (next_char == '\u0000')
+                {
+                    token = make_char_token(L'\uFFFD');
+                    it++;
+                    return token;
+                }
+                else
+                {
+                    token = make_char_token(next_char);
+                    it++;
+                    return token;
+                }
 
+                break;
             }
             case plaintext_state:
             {
-                break;
+                // There is no way out of the plaintext state
+                token = make_char_token(
+                        next_char == '\u0000' ? L'\uFFFD' : next_char);
+                it++;
+                return token;
             }
             case tag_open_state:
             {
@@ -166,7 +305,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                     state = end_tag_open_state;
                 else if (isalpha(next_char))
                 {
-                    token = std::make_shared<StartToken>(next_char);
+                    token = make_start_token(next_char);
                     state = tag_name_state;
                 }
                 else if (next_char == '?')
@@ -183,7 +322,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
-                    token = std::make_shared<CharacterToken>('\u003C');
+                    token = make_char_token('\u003C');
                     //it++;
                     state = data_state;
                     return token;
@@ -195,7 +334,8 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             {
                 if(isalpha(next_char))
                 {
-                    token = std::make_shared<EndToken>(next_char);
+                    token = make_end_token();
+                    token->add_char_to_tag_name(next_char);
                     state = tag_name_state;
                 }
                 else if (next_char == '>')
@@ -208,7 +348,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
-                    token = std::make_shared<CommentToken>();
+                    token = make_comment_token();
                     it--;
                     state = bogus_comment_state;
                 }
@@ -243,40 +383,49 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 break;
             }
             case rcdata_less_than_sign_state:
+            case rawtext_less_than_sign_state:
+            case script_data_less_than_sign_state:
             {
+                // The end tag open and end tag name states only decide
+                // whether this is the appropriate end tag, so look ahead
+                // for it instead of buffering the name
+                tokenizer_state text_state = rcdata_state;
+                if (state == rawtext_less_than_sign_state)
+                    text_state = rawtext_state;
+                else if (state == script_data_less_than_sign_state)
+                    text_state = script_data_state;
 
-            }
-            case rcdata_end_tag_open_state:
-            {
+                std::wstring::const_iterator name_end =
+                    match_appropriate_end_tag(html_string, it);
 
-            }
-            case rcdata_end_tag_name_state:
-            {
+                if (incomplete_token)
+                    return token;
 
-            }
-            case rawtext_less_than_sign_state:
-            {
+                if (name_end == html_string.cend())
+                {
+                    // Not our end tag, the '<' was just text
+                    token = make_char_token('\u003C');
+                    state = text_state;
+                    return token;
+                }
 
-            }
-            case rawtext_end_tag_open_state:
-            {
+                token = make_end_token();
+                token->set_tag_name(last_start_tag_name);
+                state = tag_name_state;
 
+                // The for loop steps onto the character after the name
+                it = name_end - 1;
+                break;
             }
+            case rcdata_end_tag_open_state:
+            case rcdata_end_tag_name_state:
+            case rawtext_end_tag_open_state:
             case rawtext_end_tag_name_state:
-            {
-
-            }
-            case script_data_less_than_sign_state:
-            {
-
-            }
             case script_data_end_tag_open_state:
-            {
-
-            }
             case script_data_end_tag_name_state:
             {
-
+                // Handled by the look ahead in the less-than sign states
+                break;
             }
             case script_data_escape_start_state:
             {
@@ -346,6 +495,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
+                    token->process_current_attribute();
                     state = attribute_name_state;
                     token->add_to_current_attribute_name(next_char);
                 }
@@ -379,7 +529,9 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                     state = before_attribute_value_state;
                 else if (next_char == '>')
                 {
+                    token->process_current_attribute();
                     state = data_state;
+                    it++;
                     return token;
                 }
                 else if (it > html_string.cend())
@@ -390,6 +542,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 }
                 else
                 {
+                    token->process_current_attribute();
                     it--;
                     state = attribute_name_state;
                 }
@@ -405,16 +558,21 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 else if (next_char == '\'')
                     state = attribute_value_single_quoted_state;
                 else if (next_char == '&')
+                {
+                    // Reconsumed as the start of a character reference
                     state = attribute_value_unquoted_state;
+                    it--;
+                }
                 else if (next_char == '>')
                 {
+                    token->process_current_attribute();
                     state = data_state;
                     it++;
                     return token;
                 }
                 else
                 {
-                    token->add_to_current_attribute_name(next_char);
+                    token->add_to_current_attribute_value(next_char);
                     state = attribute_value_unquoted_state;
                 }
 
@@ -425,7 +583,10 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 if (next_char == '"')
                     state = after_attribute_value_quoted_state;
                 else if (next_char == '&')
-                    state = character_reference_state;
+                {
+                    if (!consume_attribute_character_reference(html_string, it, token))
+                        return token;
+                }
                 else if (next_char == '\u0000')
                     token->add_to_current_attribute_value('\uFFFD');
                 else if (it > html_string.cend())
@@ -444,7 +605,10 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 if (next_char == '\'')
                     state = after_attribute_value_quoted_state;
                 else if (next_char == '&')
-                    state = character_reference_state;
+                {
+                    if (!consume_attribute_character_reference(html_string, it, token))
+                        return token;
+                }
                 else if (next_char == '\u0000')
                     token->add_to_current_attribute_value('\uFFFD');
                 else if (it > html_string.cend())
@@ -463,9 +627,13 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 if (space_chars.count(next_char) != 0)
                     state = before_attribute_name_state;
                 else if (next_char == '&')
-                    state = character_reference_state;
+                {
+                    if (!consume_attribute_character_reference(html_string, it, token))
+                        return token;
+                }
                 else if (next_char == '>')
                 {
+                    token->process_current_attribute();
                     state = data_state;
                     it++;
                     return token;
@@ -510,6 +678,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             {
                 if (next_char == '>')
                 {
+                    token->process_current_attribute();
                     state = data_state;
                     token->set_self_closing(true);
                     it++;
@@ -544,7 +713,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                     return token;
                 }
                 else if (next_char == '\u0000')
-                    token->add_char_to_data('\uFFFD');
+                    token->add_char_to_data(L'\uFFFD');
                 else
                     token->add_char_to_data(next_char);
 
@@ -552,15 +721,24 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             }
             case markup_declaration_open_state:
             {
-                if (std::wstring(it, it + 2) == L"--")
+                size_t remaining = html_string.cend() - it;
+
+                if (remaining < 7 && !input_complete)
+                {
+                    // Can't tell "--", "doctype" and "[CDATA[" apart yet
+                    incomplete_token = true;
+                    return token;
+                }
+
+                if (std::wstring(it, it + std::min<size_t>(remaining, 2)) == L"--")
                 {
                     it += 1;
-                    token = std::make_shared<CommentToken>();
+                    token = make_comment_token();
                     state = comment_start_state;
                     break;
                 }
 
-                std::wstring next_seven_chars(it, it + 7);
+                std::wstring next_seven_chars(it, it + std::min<size_t>(remaining, 7));
 
                 if (get_wstring_iposition(next_seven_chars, L"doctype") == 0)
                 {
@@ -577,7 +755,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                     break;
                 }
 
-                token = std::make_shared<CommentToken>();
+                token = make_comment_token();
                 state = bogus_comment_state;
                 it--;
 
@@ -637,7 +815,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
                 else if (next_char == '-')
                     state = comment_end_dash_state;
                 else if (next_char == '\u0000')
-                    token->add_char_to_data('\uFFFD');
+                    token->add_char_to_data(L'\uFFFD');
                 else if (it > html_string.cend())
                 {
                     token = std::make_shared<EOFToken>();
@@ -787,7 +965,7 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             case doctype_state:
             {
                 if (space_chars.count(next_char) != 0)
-                    state = doctype_name_state;
+                    state = before_doctype_name_state;
                 else if (next_char == '>')
                 {
                     state = before_doctype_name_state;
@@ -951,978 +1129,640 @@ std::shared_ptr<HTMLToken> HTMLTokenizer::create_token_from_string(const std::ws
             {
 
             }
-            case character_reference_state:
+            // The character reference states are never entered, references
+            // are read by looking ahead from the '&', see
+            // consume_character_reference
+            default:
             {
-
+                break;
             }
-            case named_character_reference_state:
-            {
+        }
+    }
 
-            }
-            case ambiguous_ampersand_state:
-            {
+    // Only get here if the input ends in the middle of a token
+    incomplete_token = true;
+    return token;
+}
 
-            }
-            case numeric_character_reference_state:
-            {
+void HTMLTokenizer::create_tokens_from_chars(const char next_char, const bool end_of_file, std::function<void (std::shared_ptr<HTMLToken>)> emitToken)
+{
+    // Push mode, fed one byte at a time (see Loader::loadFileFromURL).
+    // emitToken may call switch_to, it applies to the next token.
+    if (!end_of_file)
+        pushed_input.push_back(static_cast<unsigned char>(next_char));
 
-            }
-            case hexadecimal_character_reference_start_state:
-            {
+    while (std::shared_ptr<HTMLToken> token =
+            next_token(pushed_input, pushed_position, end_of_file))
+        emitToken(token);
 
-            }
-            case decimal_character_reference_start_state:
-            {
+    if (end_of_file)
+    {
+        emitToken(std::make_shared<EOFToken>());
+        pushed_input.clear();
+        pushed_position = 0;
+    }
 
-            }
-            case hexadecimal_character_reference_state:
-            {
+    else if (pushed_position > 4096 && pushed_position * 2 > pushed_input.size())
+    {
+        pushed_input.erase(0, pushed_position);
+        pushed_position = 0;
+    }
+}
 
-            }
-            case decimal_character_reference_state:
-            {
+std::shared_ptr<HTMLToken> HTMLTokenizer::next_token(const std::wstring &html_string, std::wstring::const_iterator &it)
+{
+    if (skip_text)
+        skip_to_appropriate_end_tag(html_string, it);
 
-            }
-            case numeric_character_reference_end_state:
-            {
+    if (skip_subtree)
+    {
+        skip_to_subtree_end(html_string, it);
 
-            }
-            default:
-            {
-                break;
-            }
-        }
+        // Where the contents end can't be told before more input comes in
+        if (incomplete_token)
+            return blank_token;
     }
 
-    // Shouldn't get here
+    std::shared_ptr<HTMLToken> token =
+        create_token_from_string(html_string, current_state, it);
+
+    // Needed to find the appropriate end tag in the text states
+    if (token->is_start_token() && !incomplete_token)
+        last_start_tag_name = token->get_tag_name();
+
     return token;
 }
 
-void HTMLTokenizer::create_tokens_from_chars(const char next_char, const bool EOF, std::function<void (std::shared_ptr<HTMLToken>)> emitToken)
+std::shared_ptr<HTMLToken> HTMLTokenizer::next_token(const std::wstring &html_string, size_t &position, bool complete)
 {
-    std::shared_ptr<HTMLToken> token = std::make_shared<HTMLToken>();
-    HTMLTokenizer::tokenizer_state state = this->current_state;
+    if (position >= html_string.size() && pending_low_surrogate == 0)
+        return nullptr;
+
+    // After running out of input, wait until the buffer has grown enough
+    // that a long token (comments, big text runs) isn't rescanned from its
+    // start every time a few more characters come in
+    if (!complete && html_string.size() - position < retry_length)
+        return nullptr;
+
+    tokenizer_state saved_state = current_state;
+    std::wstring::const_iterator it = html_string.cbegin() + position;
+
+    input_complete = complete;
+    std::shared_ptr<HTMLToken> token = next_token(html_string, it);
+    input_complete = true;
 
-    switch (state)
+    if (incomplete_token && !complete)
     {
-        case data_state:
-        {
-            if (next_char == '&')
-                state = character_reference_state;
-            else if (next_char == '<')
-                state = tag_open_state;
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token = std::make_shared<CharacterToken>(next_char);
-                it++;
-                return token;
-            }
+        // Throw the partial token away, it gets rescanned with more input
+        current_state = saved_state;
+        retry_length = 2 * (html_string.size() - position);
+        return nullptr;
+    }
 
-            break;
-        }
-        case rcdata_state:
-        {
-            if (next_char == '&')
-                state = character_reference_state;
-            else if (next_char == '<')
-                state = rcdata_less_than_sign_state;
-            else if (next_char == '\u0000')
-            {
-                token = std::make_shared<CharacterToken>('\uFFFD');
-                it++;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token = std::make_shared<CharacterToken>(next_char);
-                it++;
-                return token;
-            }
+    retry_length = 0;
+    position = it - html_string.cbegin();
+    return token;
+}
 
-            break;
-        }
-        case rawtext_state:
-        {
-            if (next_char == '<')
-                state = rawtext_less_than_sign_state;
-            else if (next_char == '\u0000')
-            {
-                token = std::make_shared<CharacterToken>('\uFFFD');
-                it++;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token = std::make_shared<CharacterToken>(next_char);
-                it++;
-                return token;
-            }
+void HTMLTokenizer::switch_to(tokenizer_state state)
+{
+    current_state = state;
+}
 
-            break;
-        }
-        case script_data_state:
+// wchar_t only has 16 bits on Windows, characters beyond the BMP take two
+// units there. Returns the number of units.
+static size_t to_wchar_units(char32_t code_point, wchar_t units[2])
+{
+    if (sizeof(wchar_t) == 2 && code_point > 0xFFFF)
+    {
+        code_point -= 0x10000;
+        units[0] = static_cast<wchar_t>(0xD800 + (code_point >> 10));
+        units[1] = static_cast<wchar_t>(0xDC00 + (code_point & 0x3FF));
+        return 2;
+    }
+
+    units[0] = static_cast<wchar_t>(code_point);
+    return 1;
+}
+
+static bool is_ascii_alphanumeric(wchar_t next_char)
+{
+    return (next_char >= '0' && next_char <= '9') ||
+        (next_char >= 'a' && next_char <= 'z') ||
+        (next_char >= 'A' && next_char <= 'Z');
+}
+
+static int digit_value(wchar_t next_char, bool hexadecimal)
+{
+    if (next_char >= '0' && next_char <= '9')
+        return next_char - '0';
+
+    if (hexadecimal && next_char >= 'a' && next_char <= 'f')
+        return next_char - 'a' + 10;
+
+    if (hexadecimal && next_char >= 'A' && next_char <= 'F')
+        return next_char - 'A' + 10;
+
+    return -1;
+}
+
+bool HTMLTokenizer::consume_character_reference(const std::wstring &html_string,
+        std::wstring::const_iterator &it, bool in_attribute, char32_t &code_point)
+{
+    // https://html.spec.whatwg.org/multipage/parsing.html#character-reference-state
+    // it points at the '&'. If a reference follows, it's moved past it.
+    // Sets incomplete_token if the input ends before that's clear.
+    std::wstring::const_iterator next = it + 1;
+
+    if (next == html_string.cend())
+    {
+        incomplete_token = !input_complete;
+        return false;
+    }
+
+    if (*next == '#')
+    {
+        next++;
+
+        const bool hexadecimal = next != html_string.cend() &&
+            (*next == 'x' || *next == 'X');
+        if (hexadecimal)
+            next++;
+
+        const std::wstring::const_iterator digits = next;
+        char32_t value = 0;
+
+        for (; next != html_string.cend(); next++)
         {
+            int digit = digit_value(*next, hexadecimal);
+            if (digit < 0)
+                break;
 
+            // Anything this big ends up as U+FFFD anyway
+            if (value <= 0x10FFFF)
+                value = value * (hexadecimal ? 16 : 10) + digit;
         }
-        case plaintext_state:
+
+        if (next == html_string.cend() && !input_complete)
         {
-            break;
+            incomplete_token = true;
+            return false;
         }
-        case tag_open_state:
-        {
-            if (next_char == '!')
-                state = markup_declaration_open_state;
-            else if (next_char == '/')
-                state = end_tag_open_state;
-            else if (isalpha(next_char))
-            {
-                token = std::make_shared<StartToken>(next_char);
-                state = tag_name_state;
-            }
-            else if (next_char == '?')
-            {
 
-                state = bogus_comment_state;
-            }
-            else if (EOF)
-            {
+        // "&#" without digits is just text
+        if (next == digits)
+            return false;
 
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token = std::make_shared<CharacterToken>('\u003C');
-                //it++;
-                state = data_state;
-                return token;
-            }
+        if (next != html_string.cend() && *next == ';')
+            next++;
 
-            break;
-        }
-        case end_tag_open_state:
-        {
-            if(isalpha(next_char))
-            {
-                token = std::make_shared<EndToken>(next_char);
-                state = tag_name_state;
-            }
-            else if (next_char == '>')
-                state = data_state;
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token = std::make_shared<CommentToken>();
-                it--;
-                state = bogus_comment_state;
-            }
+        code_point = HTMLCharacterReferences::fix_numeric_reference(value);
+        it = next;
+        return true;
+    }
 
-            break;
-        }
-        case tag_name_state:
-        {
-            if (space_chars.count(next_char) != 0)
-                state = before_attribute_name_state;
-            else if (next_char == '/')
-                state = self_closing_start_tag_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (isalpha(next_char))
-                token->add_char_to_tag_name(next_char);
-            else if (next_char == '\u0000')
-                token->add_char_to_tag_name('\uFFFD');
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-                token->add_char_to_tag_name(next_char);
+    std::wstring::const_iterator name_end = next;
 
-            break;
-        }
-        case rcdata_less_than_sign_state:
-        {
+    while (name_end != html_string.cend() &&
+            static_cast<size_t>(name_end - next) < HTMLCharacterReferences::longest_name &&
+            is_ascii_alphanumeric(*name_end))
+        name_end++;
 
-        }
-        case rcdata_end_tag_open_state:
-        {
+    if (name_end == html_string.cend() && !input_complete)
+    {
+        incomplete_token = true;
+        return false;
+    }
 
-        }
-        case rcdata_end_tag_name_state:
-        {
+    const std::wstring name(next, name_end);
 
-        }
-        case rawtext_less_than_sign_state:
-        {
+    if (name_end != html_string.cend() && *name_end == ';')
+    {
+        code_point = HTMLCharacterReferences::find(name);
 
-        }
-        case rawtext_end_tag_open_state:
+        if (code_point != 0)
         {
-
+            it = name_end + 1;
+            return true;
         }
-        case rawtext_end_tag_name_state:
-        {
+    }
 
-        }
-        case script_data_less_than_sign_state:
-        {
+    // Without the ';' only the legacy names count, the longest that fits
+    for (size_t length = name.size(); length > 0; length--)
+    {
+        const std::wstring prefix = name.substr(0, length);
 
-        }
-        case script_data_end_tag_open_state:
-        {
+        if (!HTMLCharacterReferences::allows_missing_semicolon(prefix))
+            continue;
 
-        }
-        case script_data_end_tag_name_state:
-        {
+        // Query strings like "?a=1&copy=2" in attributes stay as they are
+        const std::wstring::const_iterator after = next + length;
+        if (in_attribute && after != html_string.cend() &&
+                (*after == '=' || is_ascii_alphanumeric(*after)))
+            return false;
 
-        }
-        case script_data_escape_start_state:
-        {
+        code_point = HTMLCharacterReferences::find(prefix);
+        it = after;
+        return true;
+    }
 
-        }
-        case script_data_escape_start_dash_state:
-        {
+    return false;
+}
 
-        }
-        case script_data_escaped_state:
-        {
+std::shared_ptr<HTMLToken> HTMLTokenizer::make_character_reference_token(
+        const std::wstring &html_string, std::wstring::const_iterator &it)
+{
+    // it points at the '&' and is left after what the token stands for
+    char32_t code_point = 0;
 
-        }
-        case script_data_escaped_dash_state:
-        {
+    if (!consume_character_reference(html_string, it, false, code_point))
+    {
+        if (incomplete_token)
+            return blank_token;
 
-        }
-        case script_data_escaped_dash_dash_state:
-        {
+        it++;
+        return make_char_token(L'&');
+    }
 
-        }
-        case script_data_escaped_less_than_sign_state:
-        {
+    wchar_t units[2];
 
-        }
-        case script_data_escaped_end_tag_open_state:
-        {
+    // The second half of a surrogate pair is the next token
+    if (to_wchar_units(code_point, units) == 2)
+        pending_low_surrogate = units[1];
 
-        }
-        case script_data_escaped_end_tag_name_state:
-        {
+    return make_char_token(units[0]);
+}
 
-        }
-        case script_data_double_escape_start_state:
-        {
+bool HTMLTokenizer::consume_attribute_character_reference(
+        const std::wstring &html_string, std::wstring::const_iterator &it,
+        const std::shared_ptr<HTMLToken> &token)
+{
+    // Returns false if the input ends before the reference does
+    char32_t code_point = 0;
 
-        }
-        case script_data_double_escaped_state:
-        {
+    if (!consume_character_reference(html_string, it, true, code_point))
+    {
+        if (incomplete_token)
+            return false;
 
-        }
-        case script_data_double_escaped_dash_state:
-        {
+        token->add_to_current_attribute_value(L'&');
+        return true;
+    }
 
-        }
-        case script_data_double_escaped_dash_dash_state:
-        {
+    wchar_t units[2];
+    const size_t unit_count = to_wchar_units(code_point, units);
 
-        }
-        case script_data_double_escaped_less_than_sign_state:
-        {
+    for (size_t i = 0; i < unit_count; i++)
+        token->add_to_current_attribute_value(units[i]);
 
-        }
-        case script_data_double_escape_end_state:
-        {
-            break;
-        }
-        case before_attribute_name_state:
-        {
-            // End tokens should never have attributes
-            if (space_chars.count(next_char) != 0)
-                break;
-            else if (next_char == '/' || next_char == '>' || EOF)
-            {
-                it--;
-                state = after_attribute_name_state;
-            }
-            else
-            {
-                state = attribute_name_state;
-                token->add_to_current_attribute_name(next_char);
-            }
+    // The for loop steps onto the character after the reference
+    it--;
+    return true;
+}
 
-            break;
+void HTMLTokenizer::skip_text_content()
+{
+    skip_text = true;
+}
 
-        }
-        case attribute_name_state:
-        {
-            if (space_chars.count(next_char) != 0 || next_char == '/' || next_char == '>' || EOF)
-            {
-                it--;
-                state = after_attribute_name_state;
-            }
-            else if (next_char == '=')
-                state = before_attribute_value_state;
-            else if (isalpha(next_char))
-                token->add_to_current_attribute_name(next_char);
-            else
-                token->add_to_current_attribute_name(next_char);
+void HTMLTokenizer::skip_to_appropriate_end_tag(const std::wstring &html_string, std::wstring::const_iterator &it)
+{
+    if (current_state != rcdata_state && current_state != rawtext_state &&
+            current_state != script_data_state)
+    {
+        skip_text = false;
+        return;
+    }
 
-            break;
-        }
-        case after_attribute_name_state:
-        {
-            if (space_chars.count(next_char) != 0)
-                break;
-            else if (next_char == '/')
-                state = self_closing_start_tag_state;
-            else if (next_char == '=')
-                state = before_attribute_value_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                it--;
-                state = attribute_name_state;
-            }
+    while (it != html_string.cend())
+    {
+        std::wstring::const_iterator less_than =
+            std::find(it, html_string.cend(), L'<');
 
-            break;
-        }
-        case before_attribute_value_state:
+        // Everything so far is text, keep skipping when more comes in
+        if (less_than == html_string.cend())
         {
-            if (space_chars.count(next_char) != 0)
-                break;
-            else if (next_char == '"')
-                state = attribute_value_double_quoted_state;
-            else if (next_char == '\'')
-                state = attribute_value_single_quoted_state;
-            else if (next_char == '&')
-                state = attribute_value_unquoted_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else
-            {
-                token->add_to_current_attribute_name(next_char);
-                state = attribute_value_unquoted_state;
-            }
-
-            break;
+            it = less_than;
+            return;
         }
-        case attribute_value_double_quoted_state:
-        {
-            if (next_char == '"')
-                state = after_attribute_value_quoted_state;
-            else if (next_char == '&')
-                state = character_reference_state;
-            else if (next_char == '\u0000')
-                token->add_to_current_attribute_value('\uFFFD');
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-                token->add_to_current_attribute_value(next_char);
 
-            break;
-        }
-        case attribute_value_single_quoted_state:
-        {
-            if (next_char == '\'')
-                state = after_attribute_value_quoted_state;
-            else if (next_char == '&')
-                state = character_reference_state;
-            else if (next_char == '\u0000')
-                token->add_to_current_attribute_value('\uFFFD');
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-                token->add_to_current_attribute_value(next_char);
+        incomplete_token = false;
+        std::wstring::const_iterator name_end =
+            match_appropriate_end_tag(html_string, less_than + 1);
 
-            break;
-        }
-        case attribute_value_unquoted_state:
+        // Tokenize from the '<' on, also when it's too early to tell
+        if (name_end != html_string.cend() || incomplete_token)
         {
-            if (space_chars.count(next_char) != 0)
-                state = before_attribute_name_state;
-            else if (next_char == '&')
-                state = character_reference_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (next_char == '\u0000')
-                token->add_to_current_attribute_value('\uFFFD');
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-                token->add_to_current_attribute_value(next_char);
-
-            break;
+            skip_text = incomplete_token;
+            it = less_than;
+            return;
         }
-        case after_attribute_value_quoted_state:
-        {
-            token->process_current_attribute();
 
-            if (space_chars.count(next_char) != 0)
-                state = before_attribute_name_state;
-            else if (next_char == '/')
-                state = self_closing_start_tag_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
+        it = less_than + 1;
+    }
+}
 
-            break;
-        }
-        case self_closing_start_tag_state:
-        {
-            if (next_char == '>')
-            {
-                state = data_state;
-                token->set_self_closing(true);
-                it++;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                it--;
-                state = before_attribute_name_state;
-            }
+void HTMLTokenizer::skip_subtree_content()
+{
+    skip_subtree = true;
+}
 
-            break;
-        }
-        case bogus_comment_state:
-        {
-            if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else if (next_char == '\u0000')
-                token->add_char_to_data('\uFFFD');
-            else
-                token->add_char_to_data(next_char);
+bool HTMLTokenizer::take_skipped_subtree(std::wstring &source)
+{
+    if (!subtree_skipped)
+        return false;
 
-            break;
-        }
-        case markup_declaration_open_state:
-        {
-            if (std::wstring(it, it + 2) == L"--")
-            {
-                it += 1;
-                token = std::make_shared<CommentToken>();
-                state = comment_start_state;
-                break;
-            }
+    source.swap(skipped_subtree);
+    skipped_subtree.clear();
+    subtree_skipped = false;
+    return true;
+}
 
-            std::wstring next_seven_chars(it, it + 7);
+void HTMLTokenizer::skip_to_subtree_end(const std::wstring &html_string, std::wstring::const_iterator &it)
+{
+    bool found;
+    const size_t end = find_subtree_end(html_string, it - html_string.cbegin(),
+            last_start_tag_name, found);
+
+    // Wait for the rest, the end tag may still come
+    incomplete_token = !found && !input_complete;
+    if (incomplete_token)
+        return;
+
+    skip_subtree = false;
+    if (!found)
+        return;
+
+    skipped_subtree.assign(it, html_string.cbegin() + end);
+    subtree_skipped = true;
+    it = html_string.cbegin() + end;
+}
 
-            if (get_wstring_iposition(next_seven_chars, L"doctype") == 0)
-            {
-                // 6, not 7, because for loop increments one extra step
-                it += 6;
-                state = doctype_state;
-                break;
-            }
+HTMLTokenizer::tokenizer_state HTMLTokenizer::get_state() const
+{
+    return current_state;
+}
 
-            if (get_wstring_iposition(next_seven_chars, L"[CDATA[") == 0)
-            {
+HTMLTokenizer::tokenizer_state HTMLTokenizer::state_for_start_tag(const std::wstring &tag_name)
+{
+    return state_for_start_tag(HTMLTagRegistry::lookup(tag_name));
+}
 
-                state = bogus_comment_state;
-                break;
-            }
+HTMLTokenizer::tokenizer_state HTMLTokenizer::state_for_start_tag(HTMLTagId tag_id)
+{
+    // The state the tree builder switches the tokenizer to after inserting
+    // an element for this start tag. Scripting is always off, so noscript
+    // content is parsed as markup.
+    switch (HTMLTagRegistry::info(tag_id).text)
+    {
+        case HTMLTagRegistry::rcdata_text:
+            return rcdata_state;
+        case HTMLTagRegistry::rawtext_text:
+            return rawtext_state;
+        case HTMLTagRegistry::script_text:
+            return script_data_state;
+        case HTMLTagRegistry::plaintext_text:
+            return plaintext_state;
+        case HTMLTagRegistry::normal_text:
+            break;
+    }
 
-            token = std::make_shared<CommentToken>();
-            state = bogus_comment_state;
-            it--;
+    return data_state;
+}
 
-            break;
-        }
-        case comment_start_state:
-        {
-            if (next_char == '-')
-                state = comment_start_dash_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else
-            {
-                //token->add_char_to_data(next_char);
-                it--;
-                state = comment_state;
-            }
+size_t HTMLTokenizer::find_raw_text_end(const std::wstring &html_string,
+        size_t position, const std::wstring &tag_name, bool complete, bool &found)
+{
+    // The text ends at "</" followed by the element's own name, compared
+    // case-insensitively, and a space, '/' or '>'
+    const size_t match_length = tag_name.size() + 2;
+    size_t search_start = position;
+    found = false;
 
-            break;
-        }
-        case comment_start_dash_state:
-        {
-            if (next_char == '-')
-                state = comment_end_state;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token->add_char_to_data('-');
-                it--;
-                state = comment_state;
-            }
+    while (true)
+    {
+        size_t less_than = html_string.find(L'<', search_start);
+        if (less_than == std::wstring::npos)
+            return html_string.size();
 
-            break;
-        }
-        case comment_state:
-        {
-            if (next_char == '<')
-            {
-                token->add_char_to_data(next_char);
-                state = comment_less_than_sign_state;
-            }
-            else if (next_char == '-')
-                state = comment_end_dash_state;
-            else if (next_char == '\u0000')
-                token->add_char_to_data('\uFFFD');
-            else if (EOF)
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-                token->add_char_to_data(next_char);
+        bool matches = true;
+        size_t i = 0;
 
-            break;
-        }
-        case comment_less_than_sign_state:
+        for (; i < match_length && less_than + 1 + i < html_string.size(); i++)
         {
-            if (next_char == '!')
-            {
-                token->add_char_to_data(next_char);
-                state = comment_less_than_sign_bang_state;
-            }
-            else if (next_char == '<')
-                token->add_char_to_data(next_char);
-            else
-            {
-                state = comment_state;
-                it--;
-            }
+            wchar_t next_char = html_string[less_than + 1 + i];
 
-            break;
-        }
-        case comment_less_than_sign_bang_state:
-        {
-            if (next_char == '-')
-                state = comment_less_than_sign_bang_dash_state;
+            if (i == 0)
+                matches = next_char == L'/';
+            else if (i <= tag_name.size())
+                matches = (next_char >= L'A' && next_char <= L'Z' ?
+                        next_char + (L'a' - L'A') : next_char) == tag_name[i - 1];
             else
-            {
-                state = comment_state;
-                it--;
-            }
+                matches = next_char == L' ' || next_char == L'\t' ||
+                    next_char == L'\n' || next_char == L'\f' ||
+                    next_char == L'\r' || next_char == L'/' || next_char == L'>';
 
-            break;
+            if (!matches)
+                break;
         }
-        case comment_less_than_sign_bang_dash_state:
-        {
-            if (next_char == '-')
-                state = comment_less_than_sign_bang_dash_dash_state;
-            else
-            {
-                state = comment_end_dash_state;
-                it--;
-            }
 
-            break;
-        }
-        case comment_less_than_sign_bang_dash_dash_state:
+        if (matches && i == match_length)
         {
-            if (next_char == '>' || it > html_string.cend())
-            {
-                state = comment_end_state;
-                it--;
-            }
-            else
-            {
-                state = comment_end_state;
-                it--;
-            }
-
-            break;
+            found = true;
+            return less_than;
         }
-        case comment_end_dash_state:
-        {
-            if (next_char == '-')
-                state = comment_end_state;
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token->add_char_to_data('-');
-                state = comment_state;
-                it--;
-            }
 
-            break;
-        }
-        case comment_end_state:
-        {
-            if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (next_char == '!')
-                state = comment_end_bang_state;
-            else if (next_char == '-')
-                token->add_char_to_data('-');
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token->add_char_to_data('-');
-                token->add_char_to_data('-');
-                state = comment_state;
-                it--;
-            }
+        // Too close to the end of the input to tell yet
+        if (matches)
+            return complete ? html_string.size() : less_than;
 
-            break;
-        }
-        case comment_end_bang_state:
-        {
-            if (next_char == '-')
-            {
-                token->add_char_to_data('-');
-                token->add_char_to_data('-');
-                token->add_char_to_data('!');
-                state = comment_end_dash_state;
-            }
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                token->add_char_to_data('-');
-                token->add_char_to_data('-');
-                token->add_char_to_data('!');
-                state = comment_state;
-                it--;
-            }
+        search_start = less_than + 1;
+    }
+}
 
-            break;
-        }
-        case doctype_state:
-        {
-            if (space_chars.count(next_char) != 0)
-                state = doctype_name_state;
-            else if (next_char == '>')
-            {
-                state = before_doctype_name_state;
-                it--;
-            }
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                state = before_doctype_name_state;
-                it--;
-            }
+// Reads a tag name that starts at position the way the tokenizer does,
+// lower case. Returns where it ends.
+static size_t read_tag_name(const std::wstring &html_string, size_t position,
+        std::wstring &tag_name)
+{
+    tag_name.clear();
 
-            break;
-        }
-        case before_doctype_name_state:
-        {
-            if (space_chars.count(next_char) != 0)
-                break;
+    for (; position < html_string.size(); position++)
+    {
+        wchar_t next_char = html_string[position];
 
-            token = std::make_shared<DoctypeToken>();
+        if (next_char == L' ' || next_char == L'\t' || next_char == L'\n' ||
+                next_char == L'\f' || next_char == L'\r' || next_char == L'/' ||
+                next_char == L'>')
+            break;
 
-            if (next_char == '>')
-            {
-                state = data_state;
-                token->set_quirks_required(true);
-                it++;
-                return token;
-            }
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                wchar_t out_char = towlower(next_char);
-                if (next_char == '\u0000')
-                    out_char = '\uFFFD';
+        tag_name.push_back(next_char >= L'A' && next_char <= L'Z' ?
+                next_char + (L'a' - L'A') : next_char);
+    }
 
-                token->add_char_to_tag_name(out_char);
-                state = doctype_name_state;
-                break;
-            }
+    return position;
+}
 
-            break;
-        }
-        case doctype_name_state:
-        {
-            if (space_chars.count(next_char) != 0)
-            {
-                state = after_doctype_name_state;
-                token->set_is_name_set(true);
-            }
-            else if (next_char == '>')
-            {
-                state = data_state;
-                token->set_is_name_set(true);
-                it++;
-                return token;
-            }
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-            else
-            {
-                wchar_t out_char = towlower(next_char);
-                if (next_char == '\u0000')
-                    out_char = '\uFFFD';
+// The '>' that ends a tag, past any in quoted attribute values
+static size_t find_tag_end(const std::wstring &html_string, size_t position)
+{
+    wchar_t quote = L'\0';
+    bool after_equals = false;
 
-                token->add_char_to_tag_name(out_char);
-                break;
-            }
+    for (; position < html_string.size(); position++)
+    {
+        wchar_t next_char = html_string[position];
 
-            break;
-        }
-        case after_doctype_name_state:
+        if (quote != L'\0')
         {
-            if (space_chars.count(next_char) != 0)
-                break;
-            else if (next_char == '>')
-            {
-                state = data_state;
-                it++;
-                return token;
-            }
-            else if (it > html_string.cend())
-            {
-                token = std::make_shared<EOFToken>();
-                it++;
-                return token;
-            }
-
-            break;
+            if (next_char == quote)
+                quote = L'\0';
         }
-        case after_doctype_public_keyword_state:
-        {
 
-        }
-        case before_doctype_public_identifier_state:
-        {
+        else if (next_char == L'>')
+            return position;
 
-        }
-        case doctype_public_identifier_double_quoted_state:
+        else if ((next_char == L'"' || next_char == L'\'') && after_equals)
         {
-
+            quote = next_char;
+            after_equals = false;
         }
-        case doctype_public_identifier_single_quoted_state:
-        {
 
-        }
-        case after_doctype_public_identifier_state:
-        {
+        else if (next_char == L'=')
+            after_equals = true;
 
-        }
-        case between_doctype_public_and_system_identifiers_state:
-        {
+        else if (next_char != L' ' && next_char != L'\t' && next_char != L'\n' &&
+                next_char != L'\f' && next_char != L'\r')
+            after_equals = false;
+    }
 
-        }
-        case after_doctype_system_keyword_state:
-        {
+    return std::wstring::npos;
+}
 
-        }
-        case before_doctype_system_identifier_state:
-        {
+size_t HTMLTokenizer::find_subtree_end(const std::wstring &html_string,
+        size_t position, const std::wstring &tag_name, bool &found)
+{
+    // Start tags of the same name nest, the end tag that balances them is
+    // the one. Anything that never ends returns not found.
+    size_t depth = 0;
+    std::wstring name;
+    found = false;
 
-        }
-        case doctype_system_identifier_double_quoted_state:
-        {
+    while (true)
+    {
+        const size_t less_than = html_string.find(L'<', position);
+        if (less_than == std::wstring::npos || less_than + 1 >= html_string.size())
+            return html_string.size();
 
-        }
-        case doctype_system_identifier_single_quoted_state:
-        {
+        const wchar_t next_char = html_string[less_than + 1];
+        size_t skip_to = std::wstring::npos;
+        position = less_than + 1;
 
-        }
-        case after_doctype_system_identifier_state:
+        if (html_string.compare(less_than, 4, L"<!--") == 0)
         {
+            // Also finds the ends of "<!-->" and "<!--->"
+            skip_to = html_string.find(L"-->", less_than + 2);
+            if (skip_to == std::wstring::npos)
+                return html_string.size();
 
+            position = skip_to + 3;
         }
-        case bogus_doctype_state:
-        {
 
-        }
-        case cdata_section_state:
+        else if (next_char == L'!' || next_char == L'?')
         {
+            // Doctypes and bogus comments, CDATA sections among them
+            skip_to = html_string.find(L'>', position);
+            if (skip_to == std::wstring::npos)
+                return html_string.size();
 
+            position = skip_to + 1;
         }
-        case cdata_section_bracket_state:
-        {
 
-        }
-        case cdata_section_end_state:
+        else if (next_char == L'/')
         {
+            const size_t name_end = read_tag_name(html_string, less_than + 2, name);
+            if (name_end >= html_string.size())
+                return html_string.size();
 
-        }
-        case character_reference_state:
-        {
+            if (name == tag_name)
+            {
+                if (depth == 0)
+                {
+                    found = true;
+                    return less_than;
+                }
 
+                depth--;
+            }
         }
-        case named_character_reference_state:
-        {
 
-        }
-        case ambiguous_ampersand_state:
+        else if ((next_char >= L'a' && next_char <= L'z') ||
+                (next_char >= L'A' && next_char <= L'Z'))
         {
+            const size_t name_end = read_tag_name(html_string, less_than + 1, name);
+            skip_to = find_tag_end(html_string, name_end);
+            if (skip_to == std::wstring::npos)
+                return html_string.size();
 
-        }
-        case numeric_character_reference_state:
-        {
+            position = skip_to + 1;
 
-        }
-        case hexadecimal_character_reference_start_state:
-        {
+            const tokenizer_state text_state = state_for_start_tag(name);
 
-        }
-        case decimal_character_reference_start_state:
-        {
+            if (name == tag_name)
+                depth++;
 
-        }
-        case hexadecimal_character_reference_state:
-        {
+            else if (text_state == plaintext_state)
+                return html_string.size();
 
-        }
-        case decimal_character_reference_state:
-        {
+            else if (text_state != data_state)
+            {
+                bool text_found;
+                position = find_raw_text_end(html_string, position, name, true,
+                        text_found);
 
+                if (!text_found)
+                    return html_string.size();
+            }
         }
-        case numeric_character_reference_end_state:
-        {
+    }
+}
 
-        }
-        default:
+std::wstring::const_iterator HTMLTokenizer::match_appropriate_end_tag(const std::wstring &html_string, std::wstring::const_iterator it)
+{
+    // it points just past a '<', returns the end of the tag name if
+    // "/name" follows, where name is the last start tag's name.
+    // Sets incomplete_token if the input ends before that's clear.
+    if (it == html_string.cend() || *it != '/' || last_start_tag_name.empty())
+    {
+        incomplete_token = it == html_string.cend() && !input_complete;
+        return html_string.cend();
+    }
+
+    it++;
+
+    for (wchar_t name_char : last_start_tag_name)
+    {
+        if (it == html_string.cend())
         {
-            break;
+            incomplete_token = !input_complete;
+            return html_string.cend();
         }
+
+        if (static_cast<wchar_t>(towlower(*it)) != name_char)
+            return html_string.cend();
+        it++;
     }
 
-    // Shouldn't get here
-    return token;
+    if (it == html_string.cend())
+    {
+        incomplete_token = !input_complete;
+        return html_string.cend();
+    }
+
+    if (!(space_chars.count(*it) != 0 || *it == '/' || *it == '>'))
+        return html_string.cend();
+
+    return it;
 }
 
 std::vector<std::shared_ptr<HTMLToken>> HTMLTokenizer::tokenize_string(const std::wstring &html_string)
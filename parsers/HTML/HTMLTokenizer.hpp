@@ -7,8 +7,12 @@
 #include <vector>
 #include <functional>
 
+#include "HTMLParserLimits.hpp"
 #include "tokens/HTMLToken.hpp"
 
+class StartToken;
+class EndToken;
+
 class HTMLTokenizer
 {
     public:
@@ -106,9 +110,60 @@ class HTMLTokenizer
 
         std::shared_ptr<HTMLToken> create_token_from_string(const std::wstring &html_string, tokenizer_state &state, std::wstring::const_iterator &it);
         std::shared_ptr<HTMLToken> create_token_from_string(const std::wstring &html_string);
-        void create_tokens_from_chars(const char next_char, const bool EOF, std::function<void (std::shared_ptr<HTMLToken>)> emitToken);
+        void create_tokens_from_chars(const char next_char, const bool end_of_file, std::function<void (std::shared_ptr<HTMLToken>)> emitToken);
         std::vector<std::shared_ptr<HTMLToken>> tokenize_string(const std::wstring &html_string);
 
+        // Pull one token at a time, the tree builder can switch
+        // the state between tokens
+        std::shared_ptr<HTMLToken> next_token(const std::wstring &html_string, std::wstring::const_iterator &it);
+        // Streaming version for input that arrives in pieces. Returns
+        // nullptr instead of a partial token when html_string ends in the
+        // middle of one and complete is false, position is left alone then.
+        std::shared_ptr<HTMLToken> next_token(const std::wstring &html_string, size_t &position, bool complete);
+        void switch_to(tokenizer_state state);
+        tokenizer_state get_state() const;
+        void reset();
+
+        // In the rcdata, rawtext and script data states, jump straight to
+        // the appropriate end tag instead of returning the text in between
+        // as character tokens
+        void skip_text_content();
+
+        // In the data state, jump straight to the end tag that closes the
+        // element whose start tag came last, keeping what was skipped as
+        // source for take_skipped_subtree(). Contents that are never closed
+        // are tokenized as usual. See HTMLParser::set_deferred_parsing.
+        void skip_subtree_content();
+        bool take_skipped_subtree(std::wstring &source);
+
+        // On by default. A token handed out is filled in again for a later
+        // token once the caller lets go of it, so callers that keep tokens
+        // around have to keep the shared_ptr, and the tokenizer must not
+        // run on another thread than the one dropping them.
+        void set_token_recycling(bool recycling);
+
+        // Only max_attributes and max_comment_length matter here. Tokens
+        // that lost something to them say so with is_truncated().
+        void set_limits(const HTMLParserLimits &limits);
+
+        static tokenizer_state state_for_start_tag(const std::wstring &tag_name);
+        static tokenizer_state state_for_start_tag(HTMLTagId tag_id);
+
+        // For callers that skip over the text of raw text elements (see
+        // state_for_start_tag) themselves: where the text starting at
+        // position ends. found is false when html_string holds no end tag
+        // for tag_name (yet), the result is then as far as the text is
+        // known to go.
+        static size_t find_raw_text_end(const std::wstring &html_string,
+                size_t position, const std::wstring &tag_name, bool complete,
+                bool &found);
+
+        // The same for the markup contents of tag_name: where the end tag
+        // that closes the element starts. Only tags are looked at, comments
+        // and raw text are stepped over so the tags in them don't count.
+        static size_t find_subtree_end(const std::wstring &html_string,
+                size_t position, const std::wstring &tag_name, bool &found);
+
     private:
         static bool contains_doctype(const std::wstring &html_string);
         static bool contains_root_element(const std::wstring &html_string);
@@ -116,8 +171,47 @@ class HTMLTokenizer
         static bool contains_root_close(const std::wstring &html_string);
         static bool contains_root_open_before_close(const std::wstring &html_string);
         static bool doctype_before_root(const std::wstring &html_string);
+        std::wstring::const_iterator match_appropriate_end_tag(const std::wstring &html_string, std::wstring::const_iterator it);
+        void skip_to_appropriate_end_tag(const std::wstring &html_string, std::wstring::const_iterator &it);
+        void skip_to_subtree_end(const std::wstring &html_string, std::wstring::const_iterator &it);
+        bool consume_character_reference(const std::wstring &html_string,
+                std::wstring::const_iterator &it, bool in_attribute,
+                char32_t &code_point);
+        std::shared_ptr<HTMLToken> make_character_reference_token(
+                const std::wstring &html_string, std::wstring::const_iterator &it);
+        bool consume_attribute_character_reference(const std::wstring &html_string,
+                std::wstring::const_iterator &it,
+                const std::shared_ptr<HTMLToken> &token);
+        std::shared_ptr<HTMLToken> make_char_token(wchar_t token_char);
+        std::shared_ptr<HTMLToken> make_start_token(wchar_t first_char);
+        std::shared_ptr<HTMLToken> make_end_token();
+        std::shared_ptr<HTMLToken> make_comment_token();
 
         tokenizer_state current_state;
+        std::wstring last_start_tag_name;
+        bool skip_text;
+        bool skip_subtree;
+        bool subtree_skipped;
+        std::wstring skipped_subtree;
+        // Second half of a character reference beyond the BMP
+        wchar_t pending_low_surrogate;
+
+        // Streaming state
+        bool incomplete_token;
+        bool input_complete;
+        size_t retry_length;
+        std::wstring pushed_input;
+        size_t pushed_position;
+
+        // Tokens kept for reuse, see set_token_recycling
+        bool recycle_tokens;
+        std::shared_ptr<HTMLToken> blank_token;
+        std::shared_ptr<HTMLToken> char_token;
+        std::shared_ptr<StartToken> start_token;
+        std::shared_ptr<EndToken> end_token;
+
+        size_t max_attributes;
+        size_t max_comment_length;
 };
 
 #endif // HTMLTOKENIZER_HPP
@@ -0,0 +1,94 @@
+#include <algorithm>
+
+#include "OpenElementStack.hpp"
+#include "HTMLEventSink.hpp"
+#include "tokens/HTMLToken.hpp"
+
+// The attributes of the implied elements
+static const HTMLEventSink::attribute_map no_attributes;
+
+OpenElementStack::OpenElementStack()
+{
+    std::fill(tag_counts, tag_counts + tag_count, 0u);
+    events = nullptr;
+}
+
+void OpenElementStack::push_back(const std::shared_ptr<HTMLElement> &element,
+        const HTMLToken *token)
+{
+    tag_counts[element->get_tag_id()]++;
+    elements.push_back(element);
+
+    if (events != nullptr)
+    {
+        events->flush_text();
+        events->start_tag(element->get_title(),
+                token != nullptr ? token->get_attributes() : no_attributes);
+    }
+}
+
+void OpenElementStack::pop_back()
+{
+    tag_counts[elements.back()->get_tag_id()]--;
+
+    if (events != nullptr)
+    {
+        events->flush_text();
+        events->end_tag(elements.back()->get_title());
+
+        // Not when the formatting elements, the document or the parser
+        // still have it
+        if (elements.back().use_count() == 1 &&
+                !elements.back()->is_source_tracked())
+            spare_elements.push_back(std::move(elements.back()));
+    }
+
+    elements.pop_back();
+}
+
+void OpenElementStack::resize(size_t size)
+{
+    while (elements.size() > size)
+        pop_back();
+}
+
+void OpenElementStack::clear()
+{
+    // Keeps the capacity for the next document
+    elements.clear();
+    std::fill(tag_counts, tag_counts + tag_count, 0u);
+}
+
+void OpenElementStack::insert_at(size_t index, const std::shared_ptr<HTMLElement> &element)
+{
+    tag_counts[element->get_tag_id()]++;
+    elements.insert(elements.begin() + index, element);
+}
+
+void OpenElementStack::remove_at(size_t index)
+{
+    tag_counts[elements[index]->get_tag_id()]--;
+    elements.erase(elements.begin() + index);
+}
+
+void OpenElementStack::replace_at(size_t index, const std::shared_ptr<HTMLElement> &element)
+{
+    elements[index] = element;
+}
+
+void OpenElementStack::set_event_sink(HTMLEventSink *sink)
+{
+    events = sink;
+    spare_elements.clear();
+}
+
+std::shared_ptr<HTMLElement> OpenElementStack::take_spare()
+{
+    if (spare_elements.empty())
+        return nullptr;
+
+    std::shared_ptr<HTMLElement> spare = std::move(spare_elements.back());
+    spare_elements.pop_back();
+
+    return spare;
+}
@@ -0,0 +1,91 @@
+#ifndef OPENELEMENTSTACK_HPP
+#define OPENELEMENTSTACK_HPP
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+#include "../../elements/HTML/HTMLTagId.hpp"
+#include "../../elements/HTML/HTMLElement.hpp"
+
+class HTMLEventSink;
+class HTMLToken;
+
+/*
+ * The stack of open elements, see
+ * https://html.spec.whatwg.org/multipage/parsing.html#the-stack-of-open-elements
+ *
+ * Used like the vector it wraps, but every change goes through here so the
+ * number of open elements per tag ID stays known. Asking whether an element
+ * is in scope mostly asks for one that isn't open at all (a </p> without a
+ * <p>, a <div> closing a <p>), and that answer no longer needs a walk down
+ * a stack that misnested formatting elements can make thousands deep.
+ *
+ * With an event sink, pushing and popping are what the sink sees as start
+ * and end tags, with the attributes of the token pushed along. The tree
+ * builder doesn't insert, remove or replace in the middle of the stack
+ * then, and the elements nothing else holds on to are kept when they are
+ * popped, for take_spare() to hand out again.
+ */
+class OpenElementStack
+{
+    public:
+        OpenElementStack();
+        void push_back(const std::shared_ptr<HTMLElement> &element,
+                const HTMLToken *token = nullptr);
+        void pop_back();
+        // Only ever shrinks the stack
+        void resize(size_t size);
+        void clear();
+
+        void insert_at(size_t index, const std::shared_ptr<HTMLElement> &element);
+        void remove_at(size_t index);
+        // For clones, which have the same tag as the element they replace
+        void replace_at(size_t index, const std::shared_ptr<HTMLElement> &element);
+
+        void set_event_sink(HTMLEventSink *sink);
+        // An element popped with an event sink, or nullptr
+        std::shared_ptr<HTMLElement> take_spare();
+
+        bool empty() const;
+        size_t size() const;
+        const std::shared_ptr<HTMLElement> &back() const;
+        const std::shared_ptr<HTMLElement> &operator[](size_t index) const;
+
+        // Open elements with the tag, all elements of unknown tags for
+        // tag_unknown
+        unsigned count_of(HTMLTagId tag_id) const;
+
+    private:
+        std::vector<std::shared_ptr<HTMLElement>> elements;
+        std::vector<std::shared_ptr<HTMLElement>> spare_elements;
+        unsigned tag_counts[tag_count];
+        HTMLEventSink *events;
+};
+
+inline bool OpenElementStack::empty() const
+{
+    return elements.empty();
+}
+
+inline size_t OpenElementStack::size() const
+{
+    return elements.size();
+}
+
+inline const std::shared_ptr<HTMLElement> &OpenElementStack::back() const
+{
+    return elements.back();
+}
+
+inline const std::shared_ptr<HTMLElement> &OpenElementStack::operator[](size_t index) const
+{
+    return elements[index];
+}
+
+inline unsigned OpenElementStack::count_of(HTMLTagId tag_id) const
+{
+    return tag_counts[tag_id];
+}
+
+#endif // OPENELEMENTSTACK_HPP
@@ -0,0 +1,98 @@
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+/*
+ * Lock-free ring buffer for exactly one producer and one consumer thread.
+ * Capacity has to be a power of two. Each side keeps a cached copy of the
+ * other side's index, so the shared cache lines are only touched when the
+ * ring looks full (producer) or empty (consumer).
+ */
+template <typename T, size_t Capacity>
+class SPSCRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+            "SPSCRing capacity must be a power of two");
+
+    public:
+        SPSCRing() : head(0), tail(0), cached_head(0), cached_tail(0) {}
+
+        // Producer side
+        bool try_push(T &&value)
+        {
+            size_t current_tail = tail.load(std::memory_order_relaxed);
+
+            if (current_tail - cached_head == Capacity)
+            {
+                cached_head = head.load(std::memory_order_acquire);
+
+                if (current_tail - cached_head == Capacity)
+                    return false;
+            }
+
+            slots[current_tail & (Capacity - 1)] = std::move(value);
+            tail.store(current_tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        void push(T value)
+        {
+            for (unsigned int spins = 0; !try_push(std::move(value)); spins++)
+                back_off(spins);
+        }
+
+        // Consumer side
+        bool try_pop(T &value)
+        {
+            size_t current_head = head.load(std::memory_order_relaxed);
+
+            if (current_head == cached_tail)
+            {
+                cached_tail = tail.load(std::memory_order_acquire);
+
+                if (current_head == cached_tail)
+                    return false;
+            }
+
+            T &slot = slots[current_head & (Capacity - 1)];
+            value = std::move(slot);
+            slot = T();
+            head.store(current_head + 1, std::memory_order_release);
+            return true;
+        }
+
+        T pop()
+        {
+            T value;
+
+            for (unsigned int spins = 0; !try_pop(value); spins++)
+                back_off(spins);
+
+            return value;
+        }
+
+    private:
+        static void back_off(unsigned int spins)
+        {
+            // The other side is usually just a few tokens behind,
+            // so spin a little before giving the core away
+            if (spins >= 64)
+                std::this_thread::yield();
+        }
+
+        // Written by the consumer, read by the producer
+        alignas(64) std::atomic<size_t> head;
+        // Written by the producer, read by the consumer
+        alignas(64) std::atomic<size_t> tail;
+        // Producer-only copy of head
+        alignas(64) size_t cached_head;
+        // Consumer-only copy of tail
+        alignas(64) size_t cached_tail;
+        alignas(64) T slots[Capacity];
+};
+
+#endif // SPSCRING_HPP
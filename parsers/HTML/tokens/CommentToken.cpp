@@ -2,7 +2,9 @@
 
 CommentToken::CommentToken()
 {
-    data = "";
+    data = L"";
+    length_limit = 0;
+    truncated = false;
 }
 
 bool CommentToken::is_comment_token() const
@@ -10,17 +12,33 @@ bool CommentToken::is_comment_token() const
     return true;
 }
 
-std::string CommentToken::get_data() const
+const std::wstring &CommentToken::get_data() const
 {
     return data;
 }
 
-void CommentToken::add_char_to_data(char next_char)
+void CommentToken::add_char_to_data(wchar_t next_char)
 {
+    if (length_limit != 0 && data.size() >= length_limit)
+    {
+        truncated = true;
+        return;
+    }
+
     data.push_back(next_char);
 }
 
-void CommentToken::set_data(std::string data_string)
+void CommentToken::set_data(const std::wstring &data_string)
 {
     data = data_string;
 }
+
+void CommentToken::set_max_length(size_t max_length)
+{
+    length_limit = max_length;
+}
+
+bool CommentToken::is_truncated() const
+{
+    return truncated;
+}
@@ -9,12 +9,17 @@ class CommentToken : public HTMLToken
     public:
         CommentToken();
         bool is_comment_token() const;
-        std::string get_data() const;
-        void add_char_to_data(char next_char);
-        void set_data(std::string data_string);
+        const std::wstring &get_data() const;
+        void add_char_to_data(wchar_t next_char);
+        void set_data(const std::wstring &data_string);
+        // Characters past max_length are dropped, 0 for no limit
+        void set_max_length(size_t max_length);
+        bool is_truncated() const;
 
     protected:
-        std::string data;
+        std::wstring data;
+        size_t length_limit;
+        bool truncated;
 };
 
 #endif // COMMENTTOKEN_HPP
@@ -14,6 +14,13 @@ EndToken::EndToken(wchar_t token_name)
     tag_name = tolower(token_name);
 }
 
+void EndToken::reset()
+{
+    self_closing = false;
+    tag_name.clear();
+    tag_id_known = false;
+}
+
 bool EndToken::is_self_closing() const
 {
     return self_closing;
@@ -24,11 +31,11 @@ void EndToken::set_self_closing(bool closing)
     self_closing = closing;
 }
 
-std::map<std::string, std::string> EndToken::get_attributes() const
+const std::map<std::wstring, std::wstring> &EndToken::get_attributes() const
 {
     std::wcerr << "PARSE ERROR: Attempt to access attributes " <<
         " in end token" << std::endl;
-    return {};
+    return HTMLToken::get_attributes();
 }
 
 void EndToken::add_to_current_attribute_name(wchar_t next_char)
@@ -53,7 +60,7 @@ std::wstring EndToken::get_attribute_value(std::wstring attribute_name) const
 {
     std::wcerr << "PARSE ERROR: Attempt to access attribute " <<
         attribute_name << " in end token" << std::endl;
-    return NULL;
+    return L"";
 }
 
 void EndToken::process_current_attribute()
@@ -12,9 +12,11 @@ class EndToken : public HTMLToken
     public:
         EndToken();
         EndToken(wchar_t token_name);
+        // Makes the token as good as new, but keeps the buffers
+        void reset();
         bool is_self_closing() const;
         void set_self_closing(bool closing);
-        std::map<std::string, std::string> get_attributes() const;
+        const std::map<std::wstring, std::wstring> &get_attributes() const;
         void add_to_current_attribute_name(wchar_t next_char);
         void add_to_current_attribute_value(wchar_t next_char);
         std::wstring get_attribute_value(std::wstring attribute_name) const;
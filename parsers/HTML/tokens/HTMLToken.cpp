@@ -1,21 +1,53 @@
 #include "HTMLToken.hpp"
+#include "../../../elements/HTML/HTMLTagRegistry.hpp"
+
+HTMLToken::HTMLToken()
+{
+    tag_id_known = false;
+    tag_id = tag_unknown;
+}
 
 HTMLToken::~HTMLToken()
 {
     //dtor
 }
 
-std::wstring HTMLToken::get_tag_name() const
+const std::map<std::wstring, std::wstring> &HTMLToken::get_attributes() const
+{
+    static const std::map<std::wstring, std::wstring> no_attributes;
+    return no_attributes;
+}
+
+const std::wstring &HTMLToken::get_data() const
+{
+    static const std::wstring no_data;
+    return no_data;
+}
+
+const std::wstring &HTMLToken::get_tag_name() const
 {
     return tag_name;
 }
 
+HTMLTagId HTMLToken::get_tag_id() const
+{
+    if (!tag_id_known)
+    {
+        tag_id = HTMLTagRegistry::lookup(tag_name);
+        tag_id_known = true;
+    }
+
+    return tag_id;
+}
+
 void HTMLToken::add_char_to_tag_name(wchar_t next_char)
 {
     tag_name.push_back(tolower(next_char));
+    tag_id_known = false;
 }
 
-void HTMLToken::set_tag_name(std::wstring name)
+void HTMLToken::set_tag_name(const std::wstring &name)
 {
     tag_name = name;
+    tag_id_known = false;
 }
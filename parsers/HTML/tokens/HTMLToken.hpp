@@ -4,14 +4,19 @@
 #include <string>
 #include <map>
 
+#include "../../../elements/HTML/HTMLTagId.hpp"
+
 class HTMLToken
 {
     public:
         // General HTMLToken properties
+        HTMLToken();
         virtual ~HTMLToken();
-        std::wstring get_tag_name() const;
-        void add_char_to_tag_name(char next_char);
-        void set_tag_name(std::string name);
+        const std::wstring &get_tag_name() const;
+        // Looked up once the tag name is complete, then kept with the token
+        HTMLTagId get_tag_id() const;
+        void add_char_to_tag_name(wchar_t next_char);
+        void set_tag_name(const std::wstring &name);
 
         // Doctype Token functions
         virtual bool is_doctype_token() const { return false; }
@@ -29,21 +34,20 @@ class HTMLToken
         // Start and End Token functions
         virtual bool is_self_closing() const { return false; }
         virtual void set_self_closing(bool closing) {}
-        virtual std::map<std::string, std::string> get_attributes() const
-            { return {}; }
-        virtual void add_to_current_attribute_name(char next_char) {}
-        virtual void add_to_current_attribute_value(char next_char) {}
-        virtual std::string get_attribute_value(std::string attribute_name)
-            const { return NULL; }
-        virtual bool contains_attribute(std::string attribute_name) const
+        virtual const std::map<std::wstring, std::wstring> &get_attributes() const;
+        virtual void add_to_current_attribute_name(wchar_t next_char) {}
+        virtual void add_to_current_attribute_value(wchar_t next_char) {}
+        virtual std::wstring get_attribute_value(std::wstring attribute_name)
+            const { return L""; }
+        virtual bool contains_attribute(std::wstring attribute_name) const
             { return false; }
         virtual void process_current_attribute() {}
 
         // Comment Token functions
         virtual bool is_comment_token() const { return false; }
-        virtual std::string get_data() const { return NULL; }
-        virtual void add_char_to_data(char next_char) {}
-        virtual void set_data(std::string data_string) {}
+        virtual const std::wstring &get_data() const;
+        virtual void add_char_to_data(wchar_t next_char) {}
+        virtual void set_data(const std::wstring &data_string) {}
 
         // Character Token functions
         virtual bool is_char_token() const { return false; }
@@ -53,8 +57,16 @@ class HTMLToken
         // End-of-File Token functions
         virtual bool is_eof_token() const { return false; }
 
+        // Set when the tokenizer dropped attributes or comment data to stay
+        // within its limits (see HTMLTokenizer::set_limits)
+        virtual bool is_truncated() const { return false; }
+
     protected:
         std::wstring tag_name;
+        // Whether tag_id is for the tag name as it is, cleared on every
+        // change to it
+        mutable bool tag_id_known;
+        mutable HTMLTagId tag_id;
 };
 
 #endif // HTMLTOKEN_HPP
@@ -5,6 +5,8 @@
 StartToken::StartToken()
 {
     self_closing = false;
+    attribute_limit = 0;
+    truncated = false;
     attributes = {};
     tag_name = L"";
     current_attribute_name = L"";
@@ -14,12 +16,26 @@ StartToken::StartToken()
 StartToken::StartToken(wchar_t token_name)
 {
     self_closing = false;
+    attribute_limit = 0;
+    truncated = false;
     attributes = {};
     tag_name = tolower(token_name);
     current_attribute_name = L"";
     current_attribute_value = L"";
 }
 
+void StartToken::reset(wchar_t token_name)
+{
+    self_closing = false;
+    truncated = false;
+    attributes.clear();
+    tag_name.clear();
+    tag_name.push_back(tolower(token_name));
+    tag_id_known = false;
+    current_attribute_name.clear();
+    current_attribute_value.clear();
+}
+
 bool StartToken::is_self_closing() const
 {
     return self_closing;
@@ -30,7 +46,7 @@ void StartToken::set_self_closing(bool closing)
     self_closing = closing;
 }
 
-std::map<std::wstring, std::wstring> StartToken::get_attributes() const
+const std::map<std::wstring, std::wstring> &StartToken::get_attributes() const
 {
     return attributes;
 }
@@ -43,7 +59,8 @@ void StartToken::add_to_current_attribute_name(wchar_t next_char)
 
 void StartToken::add_to_current_attribute_value(wchar_t next_char)
 {
-    current_attribute_value.push_back(tolower(next_char));
+    // Only attribute names are case-insensitive, values keep their case
+    current_attribute_value.push_back(next_char);
 }
 
 bool StartToken::contains_attribute(std::wstring attribute_name) const
@@ -70,16 +87,31 @@ std::wstring StartToken::get_attribute_value(std::wstring attribute_name) const
 
 void StartToken::process_current_attribute()
 {
-    if (contains_attribute(current_attribute_name))
-        return;
-
-    attributes.insert({current_attribute_name, current_attribute_value});
+    // Duplicate attributes are a parse error, the first one wins
+    if (!current_attribute_name.empty() &&
+            !contains_attribute(current_attribute_name))
+    {
+        if (attribute_limit != 0 && attributes.size() >= attribute_limit)
+            truncated = true;
+        else
+            attributes.insert({current_attribute_name, current_attribute_value});
+    }
 
-    current_attribute_name = L"";
-    current_attribute_value = L"";
+    current_attribute_name.clear();
+    current_attribute_value.clear();
 }
 
 bool StartToken::is_start_token() const
 {
     return true;
 }
+
+void StartToken::set_max_attributes(size_t max_attributes)
+{
+    attribute_limit = max_attributes;
+}
+
+bool StartToken::is_truncated() const
+{
+    return truncated;
+}
@@ -12,18 +12,25 @@ class StartToken : public HTMLToken
     public:
         StartToken();
         StartToken(wchar_t token_name);
+        // Makes the token as good as new, but keeps the buffers
+        void reset(wchar_t token_name);
         bool is_self_closing() const;
         void set_self_closing(bool closing);
-        std::map<std::string, std::string> get_attributes() const;
+        const std::map<std::wstring, std::wstring> &get_attributes() const;
         void add_to_current_attribute_name(wchar_t next_char);
         void add_to_current_attribute_value(wchar_t next_char);
         std::wstring get_attribute_value(std::wstring attribute_name) const;
         bool contains_attribute(std::wstring attribute_name) const;
         void process_current_attribute();
         bool is_start_token() const;
+        // 0 for no limit, survives reset()
+        void set_max_attributes(size_t max_attributes);
+        bool is_truncated() const;
 
     private:
         bool self_closing;
+        size_t attribute_limit;
+        bool truncated;
         std::map<std::wstring, std::wstring> attributes;
         std::wstring current_attribute_name;
         std::wstring current_attribute_value;
@@ -0,0 +1,464 @@
+#include <cwctype>
+
+#include "URL.hpp"
+
+static const wchar_t hex_digits[] = L"0123456789ABCDEF";
+
+static void append_percent_encoded(std::wstring &output, unsigned char byte)
+{
+    output += L'%';
+    output += hex_digits[byte >> 4];
+    output += hex_digits[byte & 0x0F];
+}
+
+static std::wstring percent_encode(const std::wstring &part)
+{
+    // Only what browsers encode too, existing escapes are left alone
+    std::wstring encoded;
+    encoded.reserve(part.size());
+
+    for (size_t i = 0; i < part.size(); i++)
+    {
+        char32_t code_point = part[i];
+
+        if (code_point > 0x20 && code_point < 0x7F && code_point != L'"' &&
+                code_point != L'<' && code_point != L'>' && code_point != L'`')
+        {
+            encoded += part[i];
+            continue;
+        }
+
+        // wchar_t is UTF-16 on Windows
+        if (sizeof(wchar_t) == 2 && code_point >= 0xD800 && code_point <= 0xDBFF &&
+                i + 1 < part.size() && part[i + 1] >= 0xDC00 && part[i + 1] <= 0xDFFF)
+        {
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                (part[i + 1] - 0xDC00);
+            i++;
+        }
+
+        if (code_point < 0x80)
+            append_percent_encoded(encoded, static_cast<unsigned char>(code_point));
+
+        else if (code_point < 0x800)
+        {
+            append_percent_encoded(encoded, 0xC0 | (code_point >> 6));
+            append_percent_encoded(encoded, 0x80 | (code_point & 0x3F));
+        }
+
+        else if (code_point < 0x10000)
+        {
+            append_percent_encoded(encoded, 0xE0 | (code_point >> 12));
+            append_percent_encoded(encoded, 0x80 | ((code_point >> 6) & 0x3F));
+            append_percent_encoded(encoded, 0x80 | (code_point & 0x3F));
+        }
+
+        else
+        {
+            append_percent_encoded(encoded, 0xF0 | (code_point >> 18));
+            append_percent_encoded(encoded, 0x80 | ((code_point >> 12) & 0x3F));
+            append_percent_encoded(encoded, 0x80 | ((code_point >> 6) & 0x3F));
+            append_percent_encoded(encoded, 0x80 | (code_point & 0x3F));
+        }
+    }
+
+    return encoded;
+}
+
+URL::URL()
+{
+    valid = false;
+    has_authority = false;
+    has_query = false;
+    has_fragment = false;
+}
+
+URL::URL(const std::wstring &url_string) : URL()
+{
+    std::wstring input = clean_input(url_string);
+    std::wstring scheme_name;
+    std::wstring rest;
+
+    if (!split_scheme(input, scheme_name, rest))
+        return;
+
+    const bool special = is_special_scheme(scheme_name);
+
+    // "http:example.com" and "http:/example.com" still name a host
+    if (special && scheme_name != L"file")
+    {
+        size_t slashes = rest.find_first_not_of(L"/\\");
+        rest = L"//" + rest.substr(slashes == std::wstring::npos ? rest.size() : slashes);
+    }
+
+    parts url_parts;
+    split_reference(rest, special, url_parts);
+    url_parts.scheme = scheme_name;
+    url_parts.path = remove_dot_segments(url_parts.path);
+
+    set_parts(url_parts);
+}
+
+URL::URL(const std::wstring &reference, const URL &base) : URL()
+{
+    // https://www.rfc-editor.org/rfc/rfc3986#section-5.2.2
+    std::wstring input = clean_input(reference);
+    std::wstring scheme_name;
+    std::wstring rest;
+
+    if (!base.valid)
+    {
+        *this = URL(input);
+        return;
+    }
+
+    if (split_scheme(input, scheme_name, rest))
+    {
+        // "http:page" on an http page is relative, for compatibility
+        if (!(scheme_name == base.scheme && is_special_scheme(scheme_name) &&
+                (rest.empty() || (rest[0] != L'/' && rest[0] != L'\\'))))
+        {
+            *this = URL(input);
+            return;
+        }
+
+        input = rest;
+    }
+
+    const bool special = is_special_scheme(base.scheme);
+
+    parts relative;
+    split_reference(input, special, relative);
+
+    // Only fragments can be resolved against "mailto:x" or "data:..."
+    if (!base.has_authority && (base.path.empty() || base.path[0] != L'/') &&
+            !(input.empty() || input[0] == L'#'))
+        return;
+
+    parts target;
+    target.scheme = base.scheme;
+    target.has_authority = base.has_authority;
+    target.authority = base.userinfo.empty() ? base.host : base.userinfo + L"@" + base.host;
+    if (!base.port.empty())
+        target.authority += L":" + base.port;
+    target.has_query = relative.has_query;
+    target.query = relative.query;
+    target.has_fragment = relative.has_fragment;
+    target.fragment = relative.fragment;
+
+    if (relative.has_authority)
+    {
+        target.authority = relative.authority;
+        target.path = remove_dot_segments(relative.path);
+    }
+
+    else if (relative.path.empty())
+    {
+        target.path = base.path;
+
+        if (!relative.has_query)
+        {
+            target.has_query = base.has_query;
+            target.query = base.query;
+        }
+    }
+
+    else if (relative.path[0] == L'/')
+        target.path = remove_dot_segments(relative.path);
+
+    else
+    {
+        parts base_parts;
+        base_parts.has_authority = base.has_authority;
+        base_parts.path = base.path;
+        target.path = remove_dot_segments(merge_paths(base_parts, relative.path));
+    }
+
+    set_parts(target);
+}
+
+std::wstring URL::clean_input(const std::wstring &input)
+{
+    // Leading and trailing C0 controls and spaces go, tabs and newlines
+    // anywhere in between too
+    size_t start = 0;
+    size_t end = input.size();
+
+    while (start < end && input[start] <= 0x20)
+        start++;
+    while (end > start && input[end - 1] <= 0x20)
+        end--;
+
+    std::wstring cleaned;
+    cleaned.reserve(end - start);
+
+    for (size_t i = start; i < end; i++)
+    {
+        if (input[i] != L'\t' && input[i] != L'\n' && input[i] != L'\r')
+            cleaned += input[i];
+    }
+
+    return cleaned;
+}
+
+bool URL::split_scheme(const std::wstring &input, std::wstring &scheme_name,
+        std::wstring &rest)
+{
+    if (input.empty() || !((input[0] >= L'a' && input[0] <= L'z') ||
+            (input[0] >= L'A' && input[0] <= L'Z')))
+        return false;
+
+    for (size_t i = 1; i < input.size(); i++)
+    {
+        const wchar_t next_char = input[i];
+
+        if (next_char == L':')
+        {
+            scheme_name.clear();
+            for (size_t j = 0; j < i; j++)
+                scheme_name += static_cast<wchar_t>(std::towlower(input[j]));
+
+            rest = input.substr(i + 1);
+            return true;
+        }
+
+        if (!((next_char >= L'a' && next_char <= L'z') ||
+                (next_char >= L'A' && next_char <= L'Z') ||
+                (next_char >= L'0' && next_char <= L'9') ||
+                next_char == L'+' || next_char == L'-' || next_char == L'.'))
+            return false;
+    }
+
+    return false;
+}
+
+void URL::split_reference(const std::wstring &input, bool special, parts &reference)
+{
+    reference.has_authority = false;
+    reference.has_query = false;
+    reference.has_fragment = false;
+
+    size_t fragment_start = input.find(L'#');
+    if (fragment_start != std::wstring::npos)
+    {
+        reference.has_fragment = true;
+        reference.fragment = input.substr(fragment_start + 1);
+    }
+
+    std::wstring rest = input.substr(0, fragment_start);
+
+    size_t query_start = rest.find(L'?');
+    if (query_start != std::wstring::npos)
+    {
+        reference.has_query = true;
+        reference.query = rest.substr(query_start + 1);
+        rest.resize(query_start);
+    }
+
+    if (special)
+    {
+        for (wchar_t &next_char : rest)
+        {
+            if (next_char == L'\\')
+                next_char = L'/';
+        }
+    }
+
+    if (rest.compare(0, 2, L"//") == 0)
+    {
+        size_t path_start = rest.find(L'/', 2);
+        if (path_start == std::wstring::npos)
+            path_start = rest.size();
+
+        reference.has_authority = true;
+        reference.authority = rest.substr(2, path_start - 2);
+        rest.erase(0, path_start);
+    }
+
+    reference.path = rest;
+}
+
+std::wstring URL::merge_paths(const parts &base, const std::wstring &path)
+{
+    // https://www.rfc-editor.org/rfc/rfc3986#section-5.2.3
+    if (base.has_authority && base.path.empty())
+        return L"/" + path;
+
+    size_t last_slash = base.path.rfind(L'/');
+    if (last_slash == std::wstring::npos)
+        return path;
+
+    return base.path.substr(0, last_slash + 1) + path;
+}
+
+std::wstring URL::remove_dot_segments(const std::wstring &path)
+{
+    // https://www.rfc-editor.org/rfc/rfc3986#section-5.2.4, done segment by
+    // segment on an output that only ever shrinks at its end
+    std::wstring output;
+    output.reserve(path.size());
+    size_t position = 0;
+
+    while (position < path.size())
+    {
+        size_t segment_end = path.find(L'/', position + 1);
+        if (segment_end == std::wstring::npos)
+            segment_end = path.size();
+
+        // The segment including its leading '/', if any
+        const std::wstring segment = path.substr(position, segment_end - position);
+        const bool last = segment_end == path.size();
+
+        if (segment == L"/." || segment == L"." || segment == L"/.." ||
+                segment == L"..")
+        {
+            if (segment == L"/.." || segment == L"..")
+            {
+                size_t last_slash = output.rfind(L'/');
+                output.resize(last_slash == std::wstring::npos ? 0 : last_slash);
+            }
+
+            // "a/b/.." is "a/", not "a"
+            if (last && segment[0] == L'/')
+                output += L'/';
+        }
+
+        else
+            output += segment;
+
+        position = segment_end;
+    }
+
+    return output;
+}
+
+bool URL::is_special_scheme(const std::wstring &scheme_name)
+{
+    return scheme_name == L"http" || scheme_name == L"https" ||
+        scheme_name == L"ftp" || scheme_name == L"ws" ||
+        scheme_name == L"wss" || scheme_name == L"file";
+}
+
+void URL::set_parts(const parts &url_parts)
+{
+    scheme = url_parts.scheme;
+    has_authority = url_parts.has_authority;
+    userinfo.clear();
+    host.clear();
+    port.clear();
+
+    if (has_authority)
+    {
+        std::wstring authority = url_parts.authority;
+
+        size_t at = authority.rfind(L'@');
+        if (at != std::wstring::npos)
+        {
+            userinfo = authority.substr(0, at);
+            authority.erase(0, at + 1);
+        }
+
+        // Careful with IPv6 addresses, "[::1]:8080"
+        size_t colon = authority.rfind(L':');
+        if (colon != std::wstring::npos &&
+                authority.find(L']', colon) == std::wstring::npos)
+        {
+            port = authority.substr(colon + 1);
+            authority.resize(colon);
+        }
+
+        host = authority;
+
+        if (is_special_scheme(scheme))
+        {
+            for (wchar_t &next_char : host)
+                next_char = static_cast<wchar_t>(std::towlower(next_char));
+        }
+
+        if ((scheme == L"http" && port == L"80") ||
+                (scheme == L"https" && port == L"443") ||
+                (scheme == L"ftp" && port == L"21") ||
+                (scheme == L"ws" && port == L"80") ||
+                (scheme == L"wss" && port == L"443"))
+            port.clear();
+    }
+
+    path = percent_encode(url_parts.path);
+    if (is_special_scheme(scheme) && path.empty())
+        path = L"/";
+
+    has_query = url_parts.has_query;
+    query = percent_encode(url_parts.query);
+    has_fragment = url_parts.has_fragment;
+    fragment = percent_encode(url_parts.fragment);
+
+    valid = !is_special_scheme(scheme) || scheme == L"file" ||
+        (has_authority && !host.empty());
+}
+
+bool URL::is_valid() const
+{
+    return valid;
+}
+
+const std::wstring &URL::get_scheme() const
+{
+    return scheme;
+}
+
+const std::wstring &URL::get_host() const
+{
+    return host;
+}
+
+const std::wstring &URL::get_path() const
+{
+    return path;
+}
+
+const std::wstring &URL::get_query() const
+{
+    return query;
+}
+
+const std::wstring &URL::get_fragment() const
+{
+    return fragment;
+}
+
+void URL::clear_fragment()
+{
+    has_fragment = false;
+    fragment.clear();
+}
+
+std::wstring URL::to_string() const
+{
+    if (!valid)
+        return L"";
+
+    std::wstring url_string = scheme + L":";
+
+    if (has_authority)
+    {
+        url_string += L"//";
+
+        if (!userinfo.empty())
+            url_string += userinfo + L"@";
+
+        url_string += host;
+
+        if (!port.empty())
+            url_string += L":" + port;
+    }
+
+    url_string += path;
+
+    if (has_query)
+        url_string += L"?" + query;
+
+    if (has_fragment)
+        url_string += L"#" + fragment;
+
+    return url_string;
+}
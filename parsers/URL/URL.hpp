@@ -0,0 +1,65 @@
+#ifndef URL_HPP
+#define URL_HPP
+
+#include <string>
+
+// Splits URLs into their parts and resolves relative references the way
+// browsers do: RFC 3986 resolution plus the fix-ups of
+// https://url.spec.whatwg.org/ that matter in practice (backslashes,
+// stray whitespace, default ports, case). Host names aren't IDNA-mapped.
+class URL
+{
+    public:
+        URL();
+        // An absolute URL, see is_valid()
+        explicit URL(const std::wstring &url_string);
+        // reference resolved against base
+        URL(const std::wstring &reference, const URL &base);
+
+        bool is_valid() const;
+        const std::wstring &get_scheme() const;
+        const std::wstring &get_host() const;
+        const std::wstring &get_path() const;
+        const std::wstring &get_query() const;
+        const std::wstring &get_fragment() const;
+        void clear_fragment();
+
+        std::wstring to_string() const;
+
+    protected:
+        struct parts
+        {
+            std::wstring scheme;
+            bool has_authority;
+            std::wstring authority;
+            std::wstring path;
+            bool has_query;
+            std::wstring query;
+            bool has_fragment;
+            std::wstring fragment;
+        };
+
+        static std::wstring clean_input(const std::wstring &input);
+        static bool split_scheme(const std::wstring &input, std::wstring &scheme,
+                std::wstring &rest);
+        static void split_reference(const std::wstring &input, bool special,
+                parts &reference);
+        static std::wstring remove_dot_segments(const std::wstring &path);
+        static std::wstring merge_paths(const parts &base, const std::wstring &path);
+        static bool is_special_scheme(const std::wstring &scheme);
+        void set_parts(const parts &url_parts);
+
+        bool valid;
+        std::wstring scheme;
+        bool has_authority;
+        std::wstring userinfo;
+        std::wstring host;
+        std::wstring port;
+        std::wstring path;
+        bool has_query;
+        std::wstring query;
+        bool has_fragment;
+        std::wstring fragment;
+};
+
+#endif // URL_HPP
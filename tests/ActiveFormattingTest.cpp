@@ -0,0 +1,95 @@
+#include <cassert>
+#include <chrono>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "TreeWriter.hpp"
+
+// Misnested formatting elements: the adoption agency, the Noah's Ark clause
+// and how long thousands of unclosed ones take
+
+static std::wstring parse_body(std::wstring html)
+{
+    std::wstring tree = parse_tree(html);
+    size_t start = tree.find(L"<body>");
+    size_t end = tree.rfind(L"</body>");
+
+    return tree.substr(start + 6, end - start - 6);
+}
+
+static void test_adoption_agency()
+{
+    assert(parse_body(L"<b>1<p>2</b>3</p>") ==
+        L"<b>\"1\"</b><p><b>\"2\"</b>\"3\"</p>");
+    assert(parse_body(L"<a>1<div>2<a>3</a></div></a>") ==
+        L"<a>\"1\"</a><div><a>\"2\"</a><a>\"3\"</a></div>");
+    assert(parse_body(L"<p><b><i>x</p>y") ==
+        L"<p><b><i>\"x\"</i></b></p><b><i>\"y\"</i></b>");
+    assert(parse_body(L"<em><p>a<em>b</p>c</em>") ==
+        L"<em><p>\"a\"<em>\"b\"</em></p><em>\"c\"</em></em>");
+}
+
+static void test_noahs_ark()
+{
+    // The fourth identical <b> pushes out the first, three get reopened
+    assert(parse_body(L"<p><b><b><b><b>x</p>y") ==
+        L"<p><b><b><b><b>\"x\"</b></b></b></b></p><b><b><b>\"y\"</b></b></b>");
+
+    // Attributes make elements different
+    assert(parse_body(L"<p><b class=x><b class=x><b><b class=x><b class=x>x</p>y") ==
+        L"<p><b><b><b><b><b>\"x\"</b></b></b></b></b></p><b><b><b><b>\"y\"</b></b></b></b>");
+
+    // Elements after a marker don't count against the ones before it
+    assert(parse_body(L"<p><b><b><b><object><b><b><b><b>x</object></p>y") ==
+        L"<p><b><b><b><object><b><b><b><b>\"x\"</b></b></b></b></object></b></b></b></p>"
+        L"<b><b><b>\"y\"</b></b></b>");
+}
+
+static double best_parse_time(const std::wstring &piece, size_t repeat)
+{
+    std::wstring html;
+
+    for (size_t i = 0; i < repeat; i++)
+        html += piece;
+
+    double best = 0;
+
+    for (int run = 0; run < 3; run++)
+    {
+        HTMLParser parser;
+        auto start = std::chrono::steady_clock::now();
+        Document document = parser.construct_document_from_string(html);
+        std::chrono::duration<double> taken = std::chrono::steady_clock::now() - start;
+
+        if (run == 0 || taken.count() < best)
+            best = taken.count();
+    }
+
+    return best;
+}
+
+static void test_unclosed_formatting_stays_linear()
+{
+    // Every <b> stays open, so the stack gets as deep as the document is
+    // long. Four times the input has to take about four times as long,
+    // quadratic would be sixteen.
+    const wchar_t *pieces[] = {L"<b>x</p>", L"<b><div>", L"<font color=red>x</p>",
+        L"<b id=i>x"};
+
+    for (const wchar_t *piece : pieces)
+    {
+        double small = best_parse_time(piece, 4000);
+        double large = best_parse_time(piece, 16000);
+
+        assert(large < small * 10 + 0.01);
+    }
+}
+
+int main()
+{
+    test_adoption_agency();
+    test_noahs_ark();
+    test_unclosed_formatting_stays_linear();
+
+    return 0;
+}
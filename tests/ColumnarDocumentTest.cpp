@@ -0,0 +1,126 @@
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "../document/ColumnarDocument.hpp"
+
+// The columnar copy has to hold the same tree as the document it's made from
+
+static Document parse(std::wstring html)
+{
+    HTMLParser parser;
+
+    return parser.construct_document_from_string(html);
+}
+
+// Node by node in document order, which is the numbering of the copy
+static void assert_same_tree(const ColumnarDocument &columns, const HTMLElement &root,
+        ColumnarDocument::node_index first)
+{
+    std::vector<const HTMLElement *> nodes;
+
+    for (const HTMLElement *node : root.preorder())
+        nodes.push_back(node);
+
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const HTMLElement *element = nodes[i];
+        const ColumnarDocument::node_index node = first + i;
+        const ColumnarElement view = columns.get_element(node);
+
+        assert(view.get_index() == node);
+
+        if (element->is_text_node())
+        {
+            assert(columns.get_kind(node) == ColumnarDocument::text_node);
+            assert(columns.get_text(node) == element->get_text().to_wstring());
+            assert(columns.get_text_length(node) == columns.get_text(node).size());
+            assert(view.get_text_length() == element->get_text_length());
+            continue;
+        }
+
+        assert(columns.get_kind(node) == ColumnarDocument::element_node);
+        assert(columns.get_tag_id(node) == element->get_tag_id());
+        assert(columns.get_title(node) == element->get_title());
+        assert(view.get_attributes() == element->get_attributes());
+        assert(view.get_id() == element->get_id().to_wstring());
+
+        // The subtree is the range up to its end
+        size_t subtree_size = 0;
+
+        for (const HTMLElement *descendant : element->preorder())
+        {
+            (void) descendant;
+            subtree_size++;
+        }
+
+        assert(columns.get_subtree_end(node) == node + subtree_size);
+
+        size_t child_count = 0;
+
+        for (const HTMLElement *child : element->children())
+        {
+            (void) child;
+            child_count++;
+        }
+
+        assert(view.get_children().size() == child_count);
+
+        for (const ColumnarElement &child : view.get_children())
+            assert(child.get_parent() == view);
+    }
+}
+
+static void test_document_copy()
+{
+    Document document = parse(L"<!DOCTYPE html><title>T</title>"
+            L"<div id=main class='a b'><p>one<b>two</b></p><custom-tag x=1>three</custom-tag>"
+            L"<ul><li>café<li>\U0001F600</ul></div>");
+    ColumnarDocument columns(document);
+
+    assert(columns.get_root().get_title() == L"html");
+    assert(columns.get_parent(0) == ColumnarDocument::no_node);
+    assert_same_tree(columns, *document.get_elements().front(), 0);
+
+    // Tags outside HTMLTags.def keep their names
+    for (ColumnarDocument::node_index node = 0; node < columns.get_node_count(); node++)
+    {
+        if (columns.get_kind(node) == ColumnarDocument::element_node &&
+                columns.get_tag_id(node) == tag_unknown)
+        {
+            assert(columns.get_title(node) == L"custom-tag");
+            assert(columns.get_attribute(node, L"x") == L"1");
+            assert(!columns.has_attribute(node, L"y"));
+        }
+    }
+}
+
+static void test_subtree_copy()
+{
+    Document document = parse(L"<div id=a><p>x</p></div><div id=b><i>y</i>z</div>");
+    std::shared_ptr<HTMLElement> second = document.get_element_by_id(L"b");
+    ColumnarDocument columns(*second);
+
+    assert(columns.get_node_count() == 4);
+    assert(columns.get_root().get_attribute(L"id") == L"b");
+    assert(columns.get_next_sibling(0) == ColumnarDocument::no_node);
+    assert_same_tree(columns, *second, 0);
+}
+
+static void test_empty_copy()
+{
+    ColumnarDocument columns;
+
+    assert(columns.get_node_count() == 0);
+    assert(columns.get_root().is_null());
+}
+
+int main()
+{
+    test_document_copy();
+    test_subtree_copy();
+    test_empty_copy();
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <cassert>
+#include <chrono>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "../document/DOMArena.hpp"
+
+// Elements in arenas, elements made on their own and the handles to both
+
+static std::shared_ptr<HTMLElement> make_standalone(const std::wstring &title)
+{
+    std::shared_ptr<HTMLElement> element = std::make_shared<HTMLElement>();
+    element->set_title(title);
+
+    return element;
+}
+
+static void test_handles_keep_the_document()
+{
+    std::shared_ptr<HTMLElement> paragraph;
+
+    {
+        HTMLParser parser;
+        std::wstring html = L"<p id=p>x</p>";
+        Document document = parser.construct_document_from_string(html);
+
+        paragraph = document.get_element_by_id(L"p");
+    }
+
+    // The arena is still there, and so is the rest of the tree
+    assert(paragraph->get_title() == L"p");
+    assert(paragraph->get_first_child()->get_text().to_wstring() == L"x");
+    assert(paragraph->get_parent()->get_title() == L"body");
+    assert(paragraph->get_first_child()->get_handle()->get_parent() == paragraph.get());
+}
+
+static void test_standalone_handles()
+{
+    std::shared_ptr<HTMLElement> list = make_standalone(L"ul");
+    std::shared_ptr<HTMLElement> item = make_standalone(L"li");
+
+    // Nothing to share before it's added somewhere
+    assert(item->get_handle() == nullptr);
+
+    list->add_child(item);
+
+    assert(item->get_handle() == item);
+    assert(list->get_children().size() == 1);
+
+    // Still held by whoever held it once it's out again
+    list->remove_child(item.get());
+
+    assert(item->get_handle() == item);
+    assert(list->get_children().empty());
+}
+
+static double time_get_children(size_t child_count)
+{
+    std::shared_ptr<HTMLElement> list = make_standalone(L"ul");
+
+    for (size_t i = 0; i < child_count; i++)
+        list->add_child(make_standalone(L"li"));
+
+    auto start = std::chrono::steady_clock::now();
+    assert(list->get_children().size() == child_count);
+    std::chrono::duration<double> taken = std::chrono::steady_clock::now() - start;
+
+    return taken.count();
+}
+
+static void test_standalone_handles_are_constant_time()
+{
+    // A handle used to be found among all the children of the parent, so
+    // the handles to all children took the square of their number
+    double best_small = 0;
+    double best_large = 0;
+
+    for (int run = 0; run < 3; run++)
+    {
+        double small = time_get_children(5000);
+        double large = time_get_children(20000);
+
+        if (run == 0 || small < best_small)
+            best_small = small;
+        if (run == 0 || large < best_large)
+            best_large = large;
+    }
+
+    assert(best_large < best_small * 10 + 0.01);
+}
+
+static void test_moved_into_arena()
+{
+    HTMLParser parser;
+    std::wstring html = L"<div id=d></div>";
+    Document document = parser.construct_document_from_string(html);
+    std::shared_ptr<HTMLElement> div = document.get_element_by_id(L"d");
+
+    std::shared_ptr<HTMLElement> list = make_standalone(L"ul");
+    std::shared_ptr<HTMLElement> item = make_standalone(L"li");
+    list->add_child(item);
+
+    size_t element_count = document.get_arena()->get_element_count();
+    div->add_child(list);
+
+    // Taken in rather than made again, and handles now share the arena
+    assert(document.get_arena()->get_element_count() == element_count);
+    assert(div->get_first_child() == list.get());
+    assert(list->get_first_child() == item.get());
+    assert(item->get_handle().get() == item.get());
+    assert(div->get_children()[0] == list);
+}
+
+static void test_elements_from_another_document()
+{
+    HTMLParser parser;
+    std::wstring first_html = L"<div id=a></div>";
+    std::wstring second_html = L"<p id=b>x</p>";
+    Document first = parser.construct_document_from_string(first_html);
+    Document second = parser.construct_document_from_string(second_html);
+
+    std::shared_ptr<HTMLElement> div = first.get_element_by_id(L"a");
+    std::shared_ptr<HTMLElement> paragraph = second.get_element_by_id(L"b");
+    div->add_child(paragraph);
+
+    // The paragraph stays in its own arena, held by the div
+    assert(paragraph->get_parent() == div.get());
+    assert(paragraph->get_handle() != nullptr);
+    assert(div->get_children().size() == 1);
+    assert(first.get_element_by_id(L"b") == nullptr);
+}
+
+int main()
+{
+    test_handles_keep_the_document();
+    test_standalone_handles();
+    test_standalone_handles_are_constant_time();
+    test_moved_into_arena();
+    test_elements_from_another_document();
+
+    return 0;
+}
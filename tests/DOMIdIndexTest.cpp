@@ -0,0 +1,166 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+
+// Document::get_element_by_id while the tree changes under it
+
+static Document parse(std::wstring html)
+{
+    HTMLParser parser;
+
+    return parser.construct_document_from_string(html);
+}
+
+static void test_parsed_ids()
+{
+    Document document = parse(L"<div id=a><p id=b>x</p></div><p id=a>y<span id=c></span>");
+
+    assert(document.get_element_by_id(L"a")->get_tag_id() == tag_div);
+    assert(document.get_element_by_id(L"b")->get_tag_id() == tag_p);
+    assert(document.get_element_by_id(L"c")->get_tag_id() == tag_span);
+    assert(document.get_element_by_id(L"d") == nullptr);
+    assert(document.get_element_by_id(L"") == nullptr);
+}
+
+static void test_removed_and_added_again()
+{
+    Document document = parse(L"<div id=a><p id=b>x</p></div><p id=a>y");
+    std::shared_ptr<HTMLElement> div = document.get_element_by_id(L"a");
+    std::shared_ptr<HTMLElement> body = div->get_parent()->get_handle();
+
+    // Everything under a detached element goes with it, the next element
+    // with the same id takes over
+    body->remove_child(div.get());
+
+    assert(document.get_element_by_id(L"b") == nullptr);
+    assert(document.get_element_by_id(L"a")->get_tag_id() == tag_p);
+
+    // Now after the other one in tree order
+    body->add_child(div);
+
+    assert(document.get_element_by_id(L"b")->get_parent() == div.get());
+    assert(document.get_element_by_id(L"a")->get_tag_id() == tag_p);
+
+    std::vector<std::shared_ptr<HTMLElement>> children = body->take_children();
+
+    assert(document.get_element_by_id(L"a") == nullptr);
+    assert(document.get_element_by_id(L"b") == nullptr);
+
+    for (const std::shared_ptr<HTMLElement> &child : children)
+        body->add_child(child);
+
+    assert(document.get_element_by_id(L"a")->get_tag_id() == tag_p);
+    assert(document.get_element_by_id(L"b") != nullptr);
+}
+
+static void test_id_changes()
+{
+    Document document = parse(L"<div id=a></div><p id=b>");
+    std::shared_ptr<HTMLElement> div = document.get_element_by_id(L"a");
+    std::shared_ptr<HTMLElement> paragraph = document.get_element_by_id(L"b");
+
+    div->set_attribute(L"id", L"c");
+
+    assert(document.get_element_by_id(L"a") == nullptr);
+    assert(document.get_element_by_id(L"c") == div);
+
+    // Earlier in tree order than the one that had it
+    div->set_attribute(L"id", L"b");
+
+    assert(document.get_element_by_id(L"b") == div);
+    assert(document.get_element_by_id(L"c") == nullptr);
+
+    div->set_attribute(L"id", L"");
+
+    assert(document.get_element_by_id(L"b") == paragraph);
+}
+
+static void test_detached_elements()
+{
+    Document document = parse(L"<div id=a></div>");
+    std::shared_ptr<HTMLElement> div = document.get_element_by_id(L"a");
+    std::shared_ptr<HTMLElement> body = div->get_parent()->get_handle();
+
+    // Made on its own, with a child, and only found once in the tree
+    std::shared_ptr<HTMLElement> section = std::make_shared<HTMLElement>();
+    std::shared_ptr<HTMLElement> span = std::make_shared<HTMLElement>();
+    section->set_title(L"section");
+    span->set_title(L"span");
+    span->set_attribute(L"id", L"s");
+    section->add_child(span);
+
+    assert(document.get_element_by_id(L"s") == nullptr);
+
+    body->add_child(section);
+
+    assert(document.get_element_by_id(L"s").get() == span.get());
+
+    // Changing the id of a detached element leaves the index alone
+    body->remove_child(section.get());
+    span->set_attribute(L"id", L"t");
+
+    assert(document.get_element_by_id(L"s") == nullptr);
+    assert(document.get_element_by_id(L"t") == nullptr);
+
+    div->add_child(section);
+
+    assert(document.get_element_by_id(L"t").get() == span.get());
+}
+
+static void test_moves_within_tree()
+{
+    Document document = parse(L"<div id=a><p id=b>x</p></div><p id=a>y");
+    std::shared_ptr<HTMLElement> div = document.get_element_by_id(L"a");
+    std::shared_ptr<HTMLElement> paragraph = div->get_next_sibling()->get_handle();
+    std::shared_ptr<HTMLElement> body = div->get_parent()->get_handle();
+
+    // Still in the index, only the order changes
+    body->add_child(div);
+
+    assert(document.get_element_by_id(L"a") == paragraph);
+    assert(document.get_element_by_id(L"b")->get_parent() == div.get());
+
+    paragraph->add_child(div);
+
+    assert(document.get_element_by_id(L"a") == paragraph);
+
+    body->add_child(paragraph);
+    body->add_child(div);
+
+    assert(document.get_element_by_id(L"a") == paragraph);
+
+    div->add_child(paragraph);
+
+    assert(document.get_element_by_id(L"a") == div);
+
+    // Into another document it's gone from this one, and the other one
+    // doesn't know it either
+    Document other = parse(L"<section id=c>");
+    std::shared_ptr<HTMLElement> section = other.get_element_by_id(L"c");
+
+    section->add_child(div);
+
+    assert(document.get_element_by_id(L"a") == nullptr);
+    assert(document.get_element_by_id(L"b") == nullptr);
+    assert(other.get_element_by_id(L"a") == nullptr);
+
+    // The adoption agency moves the furthest blocks and their children
+    document = parse(L"<b>1<div id=d><p id=e>2<i id=f>3</b>4</i></div>");
+
+    assert(document.get_element_by_id(L"d")->get_parent()->get_tag_id() == tag_body);
+    assert(document.get_element_by_id(L"e")->get_parent() ==
+            document.get_element_by_id(L"d").get());
+    assert(document.get_element_by_id(L"f")->get_parent()->get_tag_id() == tag_b);
+}
+
+int main()
+{
+    test_parsed_ids();
+    test_removed_and_added_again();
+    test_id_changes();
+    test_detached_elements();
+    test_moves_within_tree();
+
+    return 0;
+}
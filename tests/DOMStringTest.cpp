@@ -0,0 +1,107 @@
+#include <cassert>
+#include <string>
+#include <utility>
+
+#include "../document/DOMString.hpp"
+
+// How DOMString stores what it's given, and that it gives it all back
+
+static void test_latin1_and_utf16()
+{
+    DOMString ascii(L"class");
+    DOMString latin1(L"café ÿ");
+    DOMString wide(L"café Ā");
+
+    assert(!ascii.is_wide() && ascii.size() == 5);
+    assert(!latin1.is_wide() && latin1.size() == 6);
+    assert(latin1.to_wstring() == L"café ÿ");
+
+    // One character past Latin-1 makes the whole string UTF-16
+    assert(wide.is_wide() && wide.size() == 6);
+    assert(wide.to_wstring() == L"café Ā");
+    assert(wide.view()[3] == 0xE9);
+
+    // Equal whichever way they are stored
+    DOMString narrow_copy(L"abc");
+    DOMString wide_copy(DOMStringView(u"abc", 3));
+
+    assert(wide_copy.is_wide() && !narrow_copy.is_wide());
+    assert(narrow_copy == wide_copy);
+    assert(!(narrow_copy < wide_copy) && !(wide_copy < narrow_copy));
+    assert(DOMString(L"ÿ") < DOMString(L"Ā"));
+}
+
+static void test_surrogate_pairs()
+{
+    // Counted in UTF-16 units like the DOM does
+    DOMString emoji(L"a\U0001F600b");
+
+    assert(emoji.is_wide());
+    assert(emoji.size() == 4);
+    assert(emoji.view()[1] == 0xD83D && emoji.view()[2] == 0xDE00);
+    assert(emoji.to_wstring() == L"a\U0001F600b");
+    assert(emoji.to_utf8() == "a\xF0\x9F\x98\x80" "b");
+    assert(emoji.view() == std::wstring_view(L"a\U0001F600b"));
+
+    // Ordered by unit, so a pair sorts before U+FFFF
+    assert(DOMString(L"\U0001F600") < DOMString(L"￿"));
+}
+
+static void test_inline_and_heap()
+{
+    // 16 bytes go inline: 16 Latin-1 characters or 8 UTF-16 units
+    DOMString short_latin1(L"0123456789abcdef");
+    DOMString long_latin1(L"0123456789abcdefg");
+    DOMString short_wide(L"Ā234567Ĉ");
+    DOMString long_wide(L"Ā2345678ĉ");
+
+    assert(short_latin1.get_heap_bytes() == 0);
+    assert(long_latin1.get_heap_bytes() == 17);
+    assert(short_wide.get_heap_bytes() == 0);
+    assert(long_wide.get_heap_bytes() == 18);
+
+    // Moved from inline and from the heap, the source is left empty
+    DOMString moved_inline(std::move(short_wide));
+    DOMString moved_heap(std::move(long_latin1));
+
+    assert(moved_inline.to_wstring() == L"Ā234567Ĉ");
+    assert(moved_heap.to_wstring() == L"0123456789abcdefg");
+    assert(short_wide.empty() && short_wide.get_heap_bytes() == 0);
+    assert(long_latin1.empty() && long_latin1.get_heap_bytes() == 0);
+
+    // Assigned over one of the other kind
+    moved_inline = std::move(moved_heap);
+    assert(moved_inline.to_wstring() == L"0123456789abcdefg");
+    assert(moved_inline.get_heap_bytes() == 17);
+
+    moved_inline = short_latin1;
+    assert(moved_inline.to_wstring() == L"0123456789abcdef");
+    assert(moved_inline.get_heap_bytes() == 0);
+
+    DOMString &self = moved_inline;
+    moved_inline = self;
+    assert(moved_inline.to_wstring() == L"0123456789abcdef");
+}
+
+static void test_long_strings()
+{
+    // Long enough for the heap, with a wide character at the very end
+    std::wstring text(200000, L'x');
+    text += L'Ā';
+
+    DOMString long_string(text);
+
+    assert(long_string.size() == 200001);
+    assert(long_string.is_wide());
+    assert(long_string.to_wstring() == text);
+}
+
+int main()
+{
+    test_latin1_and_utf16();
+    test_surrogate_pairs();
+    test_inline_and_heap();
+    test_long_strings();
+
+    return 0;
+}
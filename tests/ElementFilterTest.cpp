@@ -0,0 +1,119 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "TreeWriter.hpp"
+
+// Pruned elements and what was opened inside them never show up, whatever
+// the tree builder does with them afterwards
+
+static std::wstring filtered_tree(std::wstring html, const std::wstring &pruned_tag)
+{
+    HTMLParser parser;
+
+    parser.set_element_filter(
+        [&pruned_tag](const std::wstring &tag_name,
+            const std::map<std::wstring, std::wstring> &)
+        {
+            return tag_name == pruned_tag ?
+                HTMLParser::prune_element : HTMLParser::keep_element;
+        });
+
+    return tree_of(parser.construct_document_from_string(html));
+}
+
+static void test_nested()
+{
+    assert(filtered_tree(L"<p>a<nav>b<i>c</i></nav>d", L"nav") ==
+        parse_tree(L"<p>a</p>d"));
+    assert(filtered_tree(L"<p>a<script>if (a<b) x()</script>b", L"script") ==
+        parse_tree(L"<p>ab"));
+    assert(filtered_tree(L"<div id=x><div>a</div></div><p>b", L"div") ==
+        parse_tree(L"<p>b"));
+
+    // Formatting elements reopened after the pruned one are kept
+    assert(filtered_tree(L"<b>a<nav>b<i>c</nav>d</b>", L"nav") ==
+        parse_tree(L"<b>a<i>d</i></b>"));
+}
+
+static void test_misnested_formatting()
+{
+    // The adoption agency neither puts a pruned element back in the tree
+    // nor takes something out of one
+    assert(filtered_tree(L"<b>1<nav>2</b>3</nav>", L"nav") ==
+        parse_tree(L"<b>1</b>"));
+    assert(filtered_tree(L"<i>1<div>2</i>3</div>", L"i") == parse_tree(L"<body>"));
+    assert(filtered_tree(L"<b>1<i>2<div>3</b>4</div>", L"i") ==
+        parse_tree(L"<b>1</b>"));
+    assert(filtered_tree(L"<b>1<span>2<div>3</b>4</div>5", L"span") ==
+        parse_tree(L"<b>1</b>5"));
+
+    // Formatting elements between the two are copied outside it
+    assert(filtered_tree(L"<b>1<i>2<nav>3</b>4</nav>5", L"nav") ==
+        parse_tree(L"<b>1<i>2</i></b><i>5</i>"));
+    assert(filtered_tree(L"<a href=x>1<p>2</a>3</p>", L"p") ==
+        parse_tree(L"<a href=x>1</a>"));
+
+    // Without the pruned element the misnesting is left as it was
+    assert(filtered_tree(L"<b>1<p>2<em>3</em></b>4</p>", L"em") ==
+        parse_tree(L"<b>1<p>2</b>4</p>"));
+}
+
+static void test_copies_go_through_the_filter()
+{
+    // The filter turns down every <b> after the first one, including the
+    // one the adoption agency makes for the paragraph
+    HTMLParser parser;
+    int bold_elements = 0;
+
+    parser.set_element_filter(
+        [&bold_elements](const std::wstring &tag_name,
+            const std::map<std::wstring, std::wstring> &)
+        {
+            if (tag_name != L"b")
+                return HTMLParser::keep_element;
+
+            return bold_elements++ == 0 ?
+                HTMLParser::keep_element : HTMLParser::prune_element;
+        });
+
+    std::wstring html = L"<b>1<p>2</b>3</p>";
+
+    assert(tree_of(parser.construct_document_from_string(html)) ==
+        parse_tree(L"<b>1</b><p>3</p>"));
+    assert(bold_elements == 2);
+}
+
+static void test_every_tag()
+{
+    // Whichever tag goes, it's nowhere in the tree
+    const wchar_t *documents[] = {
+        L"<b>1<i>2<div>3<a href=x>4</b>5<p>6</a>7</i>8</div>9",
+        L"<a>1<b>2<nav>3<i>4<p>5</a>6</b>7</nav>8</i>9",
+        L"<em><s><u><div><span>1</em>2</s>3</u>4</span>5</div>",
+        L"<b><b><b><b><b><b><b><b><b><div>1</b>2</b>3</b>4"
+    };
+    const wchar_t *tags[] = {L"a", L"b", L"i", L"u", L"s", L"em", L"p",
+        L"div", L"nav", L"span"};
+
+    for (const wchar_t *html : documents)
+    {
+        for (const wchar_t *tag : tags)
+        {
+            const std::wstring tree = filtered_tree(html, tag);
+
+            assert(tree.find(L"<" + std::wstring(tag) + L">") == std::wstring::npos);
+            assert(tree.find(L"<body>") != std::wstring::npos);
+        }
+    }
+}
+
+int main()
+{
+    test_nested();
+    test_misnested_formatting();
+    test_every_tag();
+    test_copies_go_through_the_filter();
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "TreeWriter.hpp"
+
+// innerHTML-style parsing, where the context decides how the markup reads
+
+static std::wstring parse_in(const std::wstring &context_name, const std::wstring &html)
+{
+    std::shared_ptr<HTMLElement> context = std::make_shared<HTMLElement>();
+    context->set_title(context_name);
+
+    HTMLParser parser;
+    std::wostringstream output;
+
+    for (const std::shared_ptr<HTMLElement> &node : parser.parse_fragment(html, context))
+    {
+        assert(node->get_parent() == nullptr);
+        write_tree(output, node.get());
+    }
+
+    // The context itself is left alone
+    assert(context->get_first_child() == nullptr);
+
+    return output.str();
+}
+
+static void test_body_contents()
+{
+    assert(parse_in(L"div", L"<p>a<p>b") == L"<p>\"a\"</p><p>\"b\"</p>");
+    assert(parse_in(L"ul", L"<li>a<li>b") == L"<li>\"a\"</li><li>\"b\"</li>");
+    assert(parse_in(L"p", L"x<p>y") == L"\"x\"<p>\"y\"</p>");
+    assert(parse_in(L"div", L"") == L"");
+
+    // The end tag of the context isn't in the fragment, so it closes nothing
+    assert(parse_in(L"div", L"a<b>b</div>c") == L"\"a\"<b>\"bc\"</b>");
+
+    // No document around it to open
+    assert(parse_in(L"div", L"<html><body>x") == L"\"x\"");
+    assert(parse_in(L"div", L"<title>t</title>x") == L"<title>\"t\"</title>\"x\"");
+}
+
+static void test_text_contexts()
+{
+    // The tokenizer starts in the state the context would have put it in
+    assert(parse_in(L"textarea", L"<b>x</b>") == L"\"<b>x</b>\"");
+    assert(parse_in(L"title", L"a&amp;<i>") == L"\"a&<i>\"");
+    assert(parse_in(L"script", L"if (a<b) {}</b>") == L"\"if (a<b) {}</b>\"");
+    assert(parse_in(L"style", L"a>b{}") == L"\"a>b{}\"");
+    assert(parse_in(L"plaintext", L"<b>") == L"\"<b>\"");
+}
+
+static void test_parser_reused()
+{
+    // A fragment leaves nothing behind for the next document
+    HTMLParser parser;
+    std::shared_ptr<HTMLElement> context = std::make_shared<HTMLElement>();
+    context->set_title(L"textarea");
+
+    assert(parser.parse_fragment(L"<b>", context).size() == 1);
+
+    std::wstring html = L"<b>x";
+
+    assert(tree_of(parser.construct_document_from_string(html)) ==
+        L"<html><head></head><body><b>\"x\"</b></body></html>");
+}
+
+int main()
+{
+    test_body_contents();
+    test_text_contexts();
+    test_parser_reused();
+
+    return 0;
+}
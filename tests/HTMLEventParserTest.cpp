@@ -0,0 +1,161 @@
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#include "../parsers/HTML/HTMLEventParser.hpp"
+
+// The events are what the tree builder makes of the document, written out
+// the way ActiveFormattingTest writes trees
+
+struct EventWriter : public HTMLEventHandler
+{
+    std::wostringstream output;
+
+    void doctype(const std::wstring &name)
+    {
+        output << L"<!DOCTYPE " << name << L'>';
+    }
+
+    void start_tag(const std::wstring &tag_name,
+            const std::map<std::wstring, std::wstring> &attributes)
+    {
+        output << L'<' << tag_name;
+
+        for (const std::pair<const std::wstring, std::wstring> &attribute : attributes)
+            output << L' ' << attribute.first << L'=' << attribute.second;
+
+        output << L'>';
+    }
+
+    void end_tag(const std::wstring &tag_name)
+    {
+        output << L"</" << tag_name << L'>';
+    }
+
+    void text(const std::wstring &data)
+    {
+        output << L'"' << data << L'"';
+    }
+
+    void comment(const std::wstring &data)
+    {
+        output << L"<!--" << data << L"-->";
+    }
+
+    void end_document()
+    {
+        output << L'$';
+    }
+};
+
+static std::wstring events_of(const std::wstring &html)
+{
+    EventWriter writer;
+    HTMLEventParser<EventWriter> parser(writer);
+
+    parser.parse(html);
+
+    return writer.output.str();
+}
+
+static void test_implied_tags()
+{
+    assert(events_of(L"x") ==
+        L"<html><head></head><body>\"x\"</body></html>$");
+    assert(events_of(L"<!DOCTYPE html><title>t</title><p>a<p>b<li>c") ==
+        L"<!DOCTYPE html><html><head><title>\"t\"</title></head><body>"
+        L"<p>\"a\"</p><p>\"b\"</p><li>\"c\"</li></body></html>$");
+}
+
+static void test_content_after_html_end_tag()
+{
+    // Goes back into the body like it does in the tree
+    assert(events_of(L"x</html>y") ==
+        L"<html><head></head><body>\"xy\"</body></html>$");
+    assert(events_of(L"<p>x</body></html><p>after") ==
+        L"<html><head></head><body><p>\"x\"</p><p>\"after\"</p></body></html>$");
+}
+
+static void test_comments()
+{
+    // Non-ASCII stays what it was. Like the tree, nothing is implied for
+    // a document that ends before the first element.
+    assert(events_of(L"<!--é中\U0001F600-->") == L"<!--é中\U0001F600-->$");
+
+    // A comment before the head doesn't open the body
+    assert(events_of(L"<html><!--c--><head><title>t</title></head>") ==
+        L"<html><!--c--><head><title>\"t\"</title></head></html>$");
+}
+
+static void test_misnested_formatting()
+{
+    // The <p> is closed with the <b>, where the tree would have moved it
+    // out of the <b>. The text after the </b> ends up in the body and the
+    // </p> finds no paragraph open.
+    assert(events_of(L"<b>1<p>2</b>3</p>") ==
+        L"<html><head></head><body><b>\"1\"<p>\"2\"</p></b>\"3\"<p></p></body></html>$");
+    assert(events_of(L"<a>1<div>2<a>3</a></div></a>") ==
+        L"<html><head></head><body><a>\"1\"<div>\"2\"</div></a><a>\"3\"</a></body></html>$");
+
+    // Reopened after a paragraph closes them
+    assert(events_of(L"<p><b><i>x</p>y") ==
+        L"<html><head></head><body><p><b><i>\"x\"</i></b></p><b><i>\"y\"</i></b>"
+        L"</body></html>$");
+}
+
+static void test_attributes()
+{
+    // From the token, for reopened elements too, implied ones have none
+    assert(events_of(L"<p class=x><b id=y title='a b'>1</p>2") ==
+        L"<html><head></head><body><p class=x><b id=y title=a b>\"1\"</b></p>"
+        L"<b id=y title=a b>\"2\"</b></body></html>$");
+    assert(events_of(L"<body lang=en><div><p>x") ==
+        L"<html><head></head><body lang=en><div><p>\"x\"</p></div></body></html>$");
+}
+
+static void test_long_text()
+{
+    // In pieces of max_text_length, the rest with whatever comes next
+    const size_t length = HTMLEventParser<EventWriter>::max_text_length + 10;
+    const std::wstring text(length, L'x');
+
+    assert(events_of(L"<p>" + text + L"<i>") ==
+        L"<html><head></head><body><p>\"" +
+        text.substr(0, HTMLEventParser<EventWriter>::max_text_length) + L"\"\"" +
+        text.substr(HTMLEventParser<EventWriter>::max_text_length) +
+        L"\"<i></i></p></body></html>$");
+}
+
+static void test_streaming()
+{
+    EventWriter writer;
+    HTMLEventParser<EventWriter> parser(writer);
+
+    parser.feed(L"<p>a");
+    parser.feed(L"b</");
+    parser.feed(L"p>c");
+    parser.finish();
+
+    assert(writer.output.str() ==
+        L"<html><head></head><body><p>\"ab\"</p>\"c\"</body></html>$");
+
+    // The parser can be used again after finish()
+    writer.output.str(L"");
+    parser.parse(L"<i>z");
+
+    assert(writer.output.str() ==
+        L"<html><head></head><body><i>\"z\"</i></body></html>$");
+}
+
+int main()
+{
+    test_implied_tags();
+    test_content_after_html_end_tag();
+    test_comments();
+    test_misnested_formatting();
+    test_attributes();
+    test_long_text();
+    test_streaming();
+
+    return 0;
+}
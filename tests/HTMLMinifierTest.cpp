@@ -0,0 +1,85 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLMinifier.hpp"
+#include "TreeWriter.hpp"
+
+// Smaller markup for the same document
+
+static std::wstring output;
+
+static void collect(const std::wstring &chunk)
+{
+    output += chunk;
+}
+
+static std::wstring minify(const std::wstring &html)
+{
+    HTMLMinifier minifier(collect);
+
+    output.clear();
+    minifier.write(html);
+    minifier.end();
+
+    return output;
+}
+
+static void test_whitespace()
+{
+    assert(minify(L"<div>\n  <p class=\"a\">Hello   <b>world</b> </p>\n  <p>x</p>\n</div>") ==
+        L"<div><p class=a>Hello <b>world</b><p>x</div>");
+    assert(minify(L"<ul>\n <li>a</li>\n <li>b</li>\n</ul>") == L"<ul><li>a<li>b</ul>");
+
+    // Kept where it shows, and in raw text
+    assert(minify(L"<pre>  a\n  b </pre><textarea> x  </textarea>") ==
+        L"<pre>  a\n  b </pre><textarea> x  </textarea>");
+    assert(minify(L"<script> if (a  <  b) {} </script>") ==
+        L"<script> if (a  <  b) {} </script>");
+}
+
+static void test_comments_and_tags()
+{
+    assert(minify(L"a<!-- c -->b<!--[if IE]>x<![endif]-->") == L"ab<!--[if IE]>x<![endif]-->");
+    assert(minify(L"<input type=\"text\" disabled=\"\" value='a b'><a href=\"/x\">y</a>") ==
+        L"<input disabled type=text value=\"a b\"><a href=/x>y</a>");
+
+    // An end tag is only left out when what follows implies it
+    assert(minify(L"<p>a</p><div>b</div><p>c</p>text") == L"<p>a<div>b</div><p>c</p>text");
+}
+
+static void test_same_document()
+{
+    // No tables, the end tags left out there are implied by insertion
+    // modes HTMLParser doesn't have yet
+    const wchar_t *documents[] = {
+        L"<p>a</p><div>b</div><p>c</p>text",
+        L"<ul><li>a</li><li>b <i>c</i></li></ul><p>d</p>",
+        L"<p class=\"x y\" title='\"q\"'>a</p>"
+    };
+
+    for (const wchar_t *html : documents)
+        assert(parse_tree(minify(html), true) == parse_tree(html, true));
+}
+
+static void test_streamed_input()
+{
+    HTMLMinifier minifier(collect);
+
+    output.clear();
+    minifier.write(L"<div>\n  <p>a  ");
+    minifier.write(L"  b</p>  <!-- gone");
+    minifier.write(L" --></div>");
+    minifier.end();
+
+    assert(output == L"<div><p>a b</div>");
+}
+
+int main()
+{
+    test_whitespace();
+    test_comments_and_tags();
+    test_same_document();
+    test_streamed_input();
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParserPool.hpp"
+
+// What a parser was set up with goes away with it when it's back in the pool
+
+static size_t count_nodes(const Document &document)
+{
+    size_t count = 0;
+
+    for (const std::shared_ptr<HTMLElement> &root : document.get_elements())
+    {
+        for (HTMLElement *node : root->preorder())
+        {
+            (void) node;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void test_limits_reset()
+{
+    std::wstring html = L"<div><p>one</p><p>two</p><p>three</p></div>";
+    size_t full_count;
+
+    {
+        std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+        full_count = count_nodes(parser->construct_document_from_string(html));
+    }
+
+    {
+        std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+        HTMLParserLimits limits;
+        limits.max_nodes = 4;
+        parser->set_limits(limits);
+
+        assert(count_nodes(parser->construct_document_from_string(html)) < full_count);
+        assert(parser->get_limits_hit() != 0);
+    }
+
+    std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+
+    assert(count_nodes(parser->construct_document_from_string(html)) == full_count);
+    assert(parser->get_limits_hit() == 0);
+}
+
+static bool has_deferred_content(const Document &document)
+{
+    for (const std::shared_ptr<HTMLElement> &root : document.get_elements())
+    {
+        for (HTMLElement *node : root->preorder())
+        {
+            if (node->has_deferred_content())
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static void test_deferred_parsing_reset()
+{
+    std::wstring html = L"<template><p>inside</p></template><p>outside</p>";
+
+    {
+        std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+        parser->set_deferred_parsing(HTMLParser::defer_templates);
+
+        assert(has_deferred_content(parser->construct_document_from_string(html)));
+    }
+
+    std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+
+    assert(!has_deferred_content(parser->construct_document_from_string(html)));
+}
+
+static void test_source_tracking_reset()
+{
+    std::wstring html = L"<div><p>one</p></div>";
+
+    {
+        std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+        parser->set_source_tracking(true);
+
+        Document document = parser->construct_document_from_string(html);
+        assert(document.get_elements().front()->is_source_tracked());
+    }
+
+    std::shared_ptr<HTMLParser> parser = HTMLParserPool::acquire();
+    Document document = parser->construct_document_from_string(html);
+
+    assert(!document.get_elements().front()->is_source_tracked());
+}
+
+int main()
+{
+    test_limits_reset();
+    test_deferred_parsing_reset();
+    test_source_tracking_reset();
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <cassert>
+#include <string>
+
+#include "TreeWriter.hpp"
+
+// Trees built from small documents, written out as tags and quoted text
+
+static void test_text_before_implied_body()
+{
+    // The space stays in html, before the body the x opens
+    assert(parse_tree(L"</head> x") ==
+        L"<html><head></head>\" \"<body>\"x\"</body></html>");
+    assert(parse_tree(L"<html><head></head>\n\n<p>x") ==
+        L"<html><head></head>\"\n\n\"<body><p>\"x\"</p></body></html>");
+}
+
+static void test_deferred_content()
+{
+    HTMLParser parser;
+    parser.set_deferred_parsing(HTMLParser::defer_templates);
+
+    std::wstring html = L"<template><p>a<b>b</template>c";
+    Document document = parser.construct_document_from_string(html);
+    HTMLElement *template_element = nullptr;
+
+    for (HTMLElement *node : document.get_elements().front()->preorder())
+    {
+        if (node->get_tag_id() == tag_template)
+            template_element = node;
+    }
+
+    assert(template_element != nullptr && template_element->has_deferred_content());
+    assert(template_element->children().begin() == template_element->children().end());
+
+    // Built on first access, and what the contents leave open ends with them
+    std::vector<std::shared_ptr<HTMLElement>> content = template_element->get_content();
+    std::wostringstream output;
+
+    for (const std::shared_ptr<HTMLElement> &child : content)
+        write_tree(output, child.get());
+
+    assert(!template_element->has_deferred_content());
+    assert(output.str() == L"<p>\"a\"<b>\"b\"</b></p>");
+    assert(template_element->get_content().size() == 1);
+}
+
+int main()
+{
+    test_text_before_implied_body();
+    test_deferred_content();
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLRewriter.hpp"
+
+// Streaming rewrites, everything no handler touches comes out as it went in
+
+static std::wstring output;
+
+static void collect(const std::wstring &chunk)
+{
+    output += chunk;
+}
+
+static std::wstring rewrite(HTMLRewriter &rewriter, const std::wstring &html)
+{
+    output.clear();
+    rewriter.write(html);
+    rewriter.end();
+
+    return output;
+}
+
+static void test_attributes()
+{
+    HTMLRewriter rewriter(collect);
+    rewriter.on_element(L"a[href]", [](HTMLRewriter::element &element)
+    {
+        element.set_attribute(L"rel", L"nofollow");
+    });
+
+    assert(rewrite(rewriter, L"<p>x <a href=\"/a\" class=k>link</a> <a>no</a></p>") ==
+        L"<p>x <a class=\"k\" href=\"/a\" rel=\"nofollow\">link</a> <a>no</a></p>");
+
+    // The handlers stay for the next document
+    assert(rewrite(rewriter, L"<a href=b>") == L"<a href=\"b\" rel=\"nofollow\">");
+}
+
+static void test_removing_and_inserting()
+{
+    HTMLRewriter rewriter(collect);
+    rewriter.on_element(L"script", [](HTMLRewriter::element &element)
+    {
+        element.remove();
+    });
+    rewriter.on_element(L"div.ad", [](HTMLRewriter::element &element)
+    {
+        element.remove_and_keep_content();
+    });
+    rewriter.on_element(L"b", [](HTMLRewriter::element &element)
+    {
+        element.before(L"[");
+        element.prepend(L"(");
+        element.append(L")");
+        element.after(L"]");
+    });
+
+    // A raw text element ends at its own end tag only
+    assert(rewrite(rewriter, L"<div>a<script>x</div></script>b</div>") == L"<div>ab</div>");
+    assert(rewrite(rewriter, L"<div class=ad><b>x</b></div><div class='ad other'>y</div>") ==
+        L"[<b>(x)</b>]y");
+}
+
+static void test_text()
+{
+    HTMLRewriter rewriter(collect);
+    rewriter.on_text(L"p", [](HTMLRewriter::text_chunk &text)
+    {
+        if (text.get_text() == L"secret")
+            text.replace(L"***");
+    });
+
+    assert(rewrite(rewriter, L"<p>secret</p><div>secret</div>") ==
+        L"<p>***</p><div>secret</div>");
+}
+
+static void test_streamed_input()
+{
+    HTMLRewriter rewriter(collect);
+    rewriter.on_element(L"img", [](HTMLRewriter::element &element)
+    {
+        element.set_attribute(L"loading", L"lazy");
+    });
+
+    // A tag split across writes, and one inside a comment that isn't one
+    output.clear();
+    rewriter.write(L"<p>a<im");
+    rewriter.write(L"g src=x.png>b</p><!-- <img> -->");
+    rewriter.end();
+
+    assert(output == L"<p>a<img loading=\"lazy\" src=\"x.png\">b</p><!-- <img> -->");
+}
+
+static void test_implied_end_tags()
+{
+    HTMLRewriter rewriter(collect);
+    rewriter.on_element(L"li", [](HTMLRewriter::element &element)
+    {
+        element.after(L"|");
+    });
+
+    // Each <li> ends where the next one starts
+    assert(rewrite(rewriter, L"<ul><li>a<li>b</ul>") == L"<ul><li>a|<li>b|</ul>");
+}
+
+int main()
+{
+    test_attributes();
+    test_removing_and_inserting();
+    test_text();
+    test_streamed_input();
+    test_implied_end_tags();
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "../parsers/HTML/HTMLLinkExtractor.hpp"
+
+// Outgoing links, resolved and listed once in document order
+
+static void test_resolved_against_document()
+{
+    HTMLLinkExtractor extractor;
+    const std::vector<std::wstring> &links = extractor.extract(
+            L"<a href=/a>x</a><a href='b#frag'>y</a>"
+            L"<img src=//cdn.example.com/i.png><a href=/a>again</a><a href=../up>",
+            L"http://example.com/dir/page.html");
+
+    assert((links == std::vector<std::wstring>{
+        L"http://example.com/a", L"http://example.com/dir/b",
+        L"http://cdn.example.com/i.png", L"http://example.com/up"}));
+}
+
+static void test_base_and_other_elements()
+{
+    HTMLLinkExtractor extractor;
+    const std::vector<std::wstring> &links = extractor.extract(
+            L"<base href=http://other.org/base/><a href=c><link href=s.css>"
+            L"<iframe src=f></iframe><form action=?q><area href=map><frame src=fr>",
+            L"http://example.com/");
+
+    assert((links == std::vector<std::wstring>{
+        L"http://other.org/base/c", L"http://other.org/base/s.css",
+        L"http://other.org/base/f", L"http://other.org/base/?q",
+        L"http://other.org/base/map", L"http://other.org/base/fr"}));
+}
+
+static void test_srcset_and_skipped_links()
+{
+    HTMLLinkExtractor extractor;
+    const std::vector<std::wstring> &links = extractor.extract(
+            L"<img srcset='a.png 1x, b.png 2x'><a href='#top'>top</a>"
+            L"<script>'<a href=no>'</script><a href='mailto:a@b.c'>mail</a>",
+            L"https://x.org/p/");
+
+    // Links to the document itself and text inside scripts aren't links
+    assert((links == std::vector<std::wstring>{
+        L"https://x.org/p/a.png", L"https://x.org/p/b.png", L"mailto:a@b.c"}));
+}
+
+static void test_reused_extractor()
+{
+    // Nothing carries over from the document before, not even the base
+    HTMLLinkExtractor extractor;
+    extractor.extract(L"<base href=http://other.org/><a href=a>", L"http://example.com/");
+
+    const std::vector<std::wstring> &links =
+        extractor.extract(L"<a href=a>", L"http://example.com/");
+
+    assert((links == std::vector<std::wstring>{L"http://example.com/a"}));
+}
+
+int main()
+{
+    test_resolved_against_document();
+    test_base_and_other_elements();
+    test_srcset_and_skipped_links();
+    test_reused_extractor();
+
+    return 0;
+}
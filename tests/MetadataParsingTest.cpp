@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cwchar>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+
+// Only the head is parsed, and only as much input as it takes to get
+// through it is read
+
+static const wchar_t *head_source =
+    L"<!DOCTYPE html><html><head><meta charset=utf-8>"
+    L"<title>A &amp; B</title><base href=/docs/><base href=/other/>"
+    L"<link rel=stylesheet href=a.css><script>var x = '<body>';</script>"
+    L"<meta name=description content='About A'><link rel=icon href=b.ico>"
+    L"</head>";
+
+static void check_fields(const HTMLMetadata &metadata)
+{
+    assert(metadata.doctype == L"html");
+    assert(metadata.title == L"A & B");
+    assert(metadata.base_href == L"/docs/");
+
+    assert(metadata.meta.size() == 2);
+    assert(metadata.meta[0].at(L"charset") == L"utf-8");
+    assert(metadata.meta[1].at(L"name") == L"description");
+    assert(metadata.meta[1].at(L"content") == L"About A");
+
+    assert(metadata.links.size() == 2);
+    assert(metadata.links[0].at(L"href") == L"a.css");
+    assert(metadata.links[1].at(L"rel") == L"icon");
+}
+
+static std::wstring long_body()
+{
+    std::wstring body = L"<body><p>text";
+
+    for (int i = 0; i < 2000; i++)
+        body += L"<div><meta name=late><title>not this</title>text</div>";
+
+    return body;
+}
+
+static void test_parse_metadata()
+{
+    // The filter sees the elements the tree builder inserts for start tags,
+    // so it shows where parsing stopped
+    HTMLParser parser;
+    std::vector<std::wstring> inserted;
+
+    parser.set_element_filter(
+        [&inserted](const std::wstring &tag_name,
+            const std::map<std::wstring, std::wstring> &)
+        {
+            inserted.push_back(tag_name);
+            return HTMLParser::keep_element;
+        });
+
+    HTMLMetadata metadata = parser.parse_metadata(head_source + long_body());
+
+    check_fields(metadata);
+    assert(metadata.head_complete);
+    assert(inserted.size() == 8);
+    assert(inserted.back() == L"link");
+
+    // A head cut off in the middle is reported as such
+    metadata = parser.parse_metadata(L"<html><head><title>Cut");
+
+    assert(!metadata.head_complete);
+    assert(metadata.title == L"Cut");
+    assert(metadata.meta.empty());
+
+    // Implied heads end at the first thing that belongs in the body
+    inserted.clear();
+    metadata = parser.parse_metadata(L"<title>t</title><meta name=a><p>x<meta name=b>");
+
+    assert(metadata.head_complete);
+    assert(metadata.title == L"t");
+    assert(metadata.meta.size() == 1);
+
+    // The start tag that ended the head is the last one
+    assert(inserted.size() == 3);
+    assert(inserted.back() == L"p");
+}
+
+static void test_streaming()
+{
+    // Fed in pieces of 4 KB the way Loader::streamFileFromURL hands them
+    // out, the callback tells it to stop once run() is finished
+    const std::wstring html = head_source + long_body();
+    const size_t piece_size = 4096;
+    const HTMLParser::run_budget no_limit = {0, std::chrono::microseconds(0)};
+
+    HTMLParser parser;
+    parser.set_head_only(true);
+
+    size_t pieces = 0;
+    std::function<bool (const wchar_t *, size_t)> callback =
+        [&parser, &pieces, &no_limit](const wchar_t *data, size_t length)
+        {
+            pieces++;
+            parser.feed(std::wstring(data, length));
+
+            return parser.run(no_limit) == HTMLParser::needs_input;
+        };
+
+    for (size_t position = 0; position < html.size(); position += piece_size)
+    {
+        if (!callback(html.data() + position, std::min(piece_size, html.size() - position)))
+            break;
+    }
+
+    assert(pieces == 1);
+    assert(html.size() > 20 * piece_size);
+
+    HTMLMetadata metadata = parser.take_metadata();
+
+    check_fields(metadata);
+    assert(metadata.head_complete);
+
+    // The same one character at a time, and with a head that only ends with
+    // the input
+    parser.set_head_only(true);
+    pieces = 0;
+
+    for (size_t position = 0; position < html.size(); position++)
+    {
+        if (!callback(html.data() + position, 1))
+            break;
+    }
+
+    assert(pieces < wcslen(head_source) + 10);
+    check_fields(parser.take_metadata());
+
+    parser.feed(L"<head><title>t</title>");
+    parser.finish();
+    assert(parser.run(no_limit) == HTMLParser::finished);
+
+    metadata = parser.take_metadata();
+    assert(metadata.title == L"t");
+    assert(!metadata.head_complete);
+}
+
+int main()
+{
+    test_parse_metadata();
+    test_streaming();
+
+    return 0;
+}
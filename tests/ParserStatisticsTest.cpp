@@ -0,0 +1,62 @@
+// Defined here whatever the parser was compiled with, the classes have to
+// look the same to this file as they do to the parser
+#define PARSER_STATISTICS
+
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "../parsers/HTML/HTMLParserStatistics.hpp"
+
+static size_t mode_index(const char *name)
+{
+    for (size_t i = 0; i < HTMLParserStatistics::insertion_mode_count; i++)
+    {
+        if (std::strcmp(HTMLParserStatistics::insertion_mode_names[i], name) == 0)
+            return i;
+    }
+
+    assert(false);
+    return 0;
+}
+
+static void test_counts(const HTMLParserStatistics &statistics)
+{
+    assert(statistics.tokens_per_mode[mode_index("in body")] > 0);
+    assert(statistics.tokens_per_mode[mode_index("text")] > 0);
+    assert(statistics.tokens_per_mode[mode_index("in frameset")] == 0);
+    assert(statistics.reprocessed_tokens > 0);
+    assert(statistics.parse_errors[HTMLParserStatistics::misnested_formatting_element] == 1);
+    assert(statistics.max_open_elements >= 5);
+    assert(statistics.max_formatting_elements == 2);
+}
+
+int main()
+{
+    HTMLParser parser;
+    std::wstring html = L"<title>x</title><p>one <b>two <i>three</b> four</i>";
+    Document document = parser.construct_document_from_string(html);
+    const HTMLParserStatistics *statistics = document.get_parser_statistics();
+
+    // Nothing to look at when the parser was built without them
+    if (statistics == nullptr)
+    {
+        std::wstring other = L"<p>x";
+        assert(parser.construct_document_from_string(other).get_parser_statistics() == nullptr);
+        return 0;
+    }
+
+    test_counts(*statistics);
+
+    // Every document starts from zero, and keeps its own after the next one
+    std::wstring plain = L"<p>x";
+    Document next = parser.construct_document_from_string(plain);
+
+    assert(next.get_parser_statistics()->parse_errors[
+            HTMLParserStatistics::misnested_formatting_element] == 0);
+    assert(next.get_parser_statistics()->max_formatting_elements == 0);
+    test_counts(*document.get_parser_statistics());
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "TreeWriter.hpp"
+
+// The tokenizer on its own thread has to give the tree the serial parse
+// gives, with the state switches it guesses for itself
+
+class PipelinedParser : public HTMLParser
+{
+    public:
+        // Runs the pipeline whatever the size of html and the number of
+        // cores. False when it guessed a switch wrong, and then document
+        // holds nothing worth looking at.
+        bool parse_pipelined(const std::wstring &html, Document &document)
+        {
+            document = Document();
+            arena = document.get_arena();
+
+            const bool done = construct_document_pipelined(html, document);
+            document = finalize_document(document);
+
+            return done;
+        }
+};
+
+static std::wstring pipelined_tree(const std::wstring &html)
+{
+    PipelinedParser parser;
+    Document document;
+
+    assert(parser.parse_pipelined(html, document));
+
+    return tree_of(document, true);
+}
+
+static void test_raw_text_switches()
+{
+    // Every kind of text the tokenizer switches to on its own, with markup
+    // in it that only reads as text after the switch
+    const wchar_t *documents[] = {
+        L"<p>a<script>if (a<b) document.write('<i>')</script>b",
+        L"<style>p > b { color: red }</style><p class=x>text",
+        L"<textarea><b>not bold</b> &amp;</textarea><b>bold</b>",
+        L"<title><i>title</i></title><p>x",
+        L"<xmp><b></xmp><iframe><i></iframe><noembed><u></noembed>",
+        L"<table><script>x<y</script><textarea>y</textarea><tr><td>z</table>",
+        L"<select><script>a<b</script><style>c</style></select>",
+        L"<p>a<plaintext><p>b</plaintext><script>c"
+    };
+
+    for (const wchar_t *html : documents)
+        assert(pipelined_tree(html) == parse_tree(html, true));
+}
+
+static void test_long_document()
+{
+    // More tokens than the ring holds, so both threads wait on each other
+    std::wstring html = L"<!DOCTYPE html><title>Long</title><body>";
+
+    for (int i = 0; i < 2000; i++)
+    {
+        html += L"<div id=d" + std::to_wstring(i) + L"><p>one <b>two<i>three</b>four</i>";
+        html += L"<script>var x = '<p>' + " + std::to_wstring(i) + L";</script>";
+        html += L"<textarea>&lt;" + std::to_wstring(i) + L"</textarea></div>";
+    }
+
+    html += L"<plaintext></body><p>";
+
+    assert(pipelined_tree(html) == parse_tree(html, true));
+}
+
+static void test_limits()
+{
+    // The pipeline stops with the tree builder when a limit cuts it off
+    std::wstring html;
+
+    for (int i = 0; i < 500; i++)
+        html += L"<p>x<script>y</script>";
+
+    HTMLParserLimits limits;
+    limits.max_nodes = 100;
+
+    PipelinedParser pipelined;
+    HTMLParser serial;
+    Document document;
+
+    pipelined.set_limits(limits);
+    serial.set_limits(limits);
+
+    assert(pipelined.parse_pipelined(html, document));
+    assert(tree_of(document) == tree_of(serial.construct_document_from_string(html)));
+    assert(pipelined.get_limits_hit() == serial.get_limits_hit());
+    assert(pipelined.get_limits_hit() != 0);
+}
+
+static void test_public_api()
+{
+    // Long enough for set_pipelined to use the pipeline on more than one
+    // core, the tree is the same either way
+    std::wstring html;
+
+    while (html.size() < HTMLParser::pipeline_minimum_length)
+        html += L"<p>text <a href=x>link</a><script>a<b</script>";
+
+    HTMLParser parser;
+    parser.set_pipelined(true);
+
+    assert(tree_of(parser.construct_document_from_string(html), true) ==
+        parse_tree(html, true));
+}
+
+int main()
+{
+    test_raw_text_switches();
+    test_long_document();
+    test_limits();
+    test_public_api();
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "TreeWriter.hpp"
+
+// Incremental reparsing: whether the edit was applied in place or the
+// source parsed again, the tree is what parsing the edited source gives
+
+// Whether the edit went into document itself
+static bool reparse_matches(std::wstring html, const HTMLParser::text_edit &edit)
+{
+    HTMLParser parser;
+    parser.set_source_tracking(true);
+
+    Document document = parser.construct_document_from_string(html);
+    const HTMLElement *root = document.get_elements().front().get();
+    Document result = parser.reparse(html, document, edit);
+
+    html.replace(edit.offset, edit.deleted_length, edit.inserted_text);
+    assert(tree_of(result) == parse_tree(html));
+
+    return result.get_elements().front().get() == root;
+}
+
+static void test_edits_in_place()
+{
+    const std::wstring html = L"<div><p>hello</p></div><div>b</div>";
+
+    assert(reparse_matches(html, {8, 5, L"bye"}));
+    assert(reparse_matches(html, {8, 0, L"<b>x</b>"}));
+    assert(reparse_matches(html, {13, 0, L"<br>"}));
+    assert(reparse_matches(L"<ul><li>a</li><li>b</li></ul>", {8, 1, L"c"}));
+}
+
+static void test_fallback_to_full_parse()
+{
+    // Each of these changes more than the contents of the paragraph
+    const std::wstring html = L"<div><p>hello</p></div><div>b</div>";
+
+    assert(!reparse_matches(html, {8, 0, L"</div>"}));
+    assert(!reparse_matches(html, {8, 0, L"<b>"}));
+    assert(!reparse_matches(html, {8, 0, L"<div>"}));
+    assert(!reparse_matches(html, {8, 0, L"<!--"}));
+}
+
+static void test_successive_edits()
+{
+    // The source positions stay right for the next edit
+    HTMLParser parser;
+    parser.set_source_tracking(true);
+
+    std::wstring html = L"<div><p>one</p><p>two</p></div>";
+    Document document = parser.construct_document_from_string(html);
+    const HTMLParser::text_edit edits[] = {
+        {8, 3, L"first"}, {20, 3, L"second"}, {8, 0, L"<i>x</i>"}, {5, 0, L"<p>zero</p>"}
+    };
+
+    for (const HTMLParser::text_edit &edit : edits)
+    {
+        document = parser.reparse(html, document, edit);
+        html.replace(edit.offset, edit.deleted_length, edit.inserted_text);
+
+        assert(tree_of(document) == parse_tree(html));
+    }
+}
+
+static bool is_tracked(const Document &document)
+{
+    return document.get_elements().front()->is_source_tracked();
+}
+
+static void test_tracking_setting()
+{
+    // reparse() tracks what it parses, and leaves the setting as it was
+    HTMLParser parser;
+    std::wstring html = L"<div><p>one</p></div>";
+    Document document = parser.construct_document_from_string(html);
+
+    assert(!is_tracked(document));
+
+    document = parser.reparse(html, document, {8, 3, L"two"});
+    html.replace(8, 3, L"two");
+
+    assert(is_tracked(document));
+    assert(!is_tracked(parser.construct_document_from_string(html)));
+
+    parser.set_source_tracking(true);
+    document = parser.reparse(html, document, {8, 3, L"six"});
+
+    assert(is_tracked(document));
+    assert(is_tracked(parser.construct_document_from_string(html)));
+}
+
+int main()
+{
+    test_edits_in_place();
+    test_fallback_to_full_parse();
+    test_successive_edits();
+    test_tracking_setting();
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <cassert>
+#include <chrono>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "TreeWriter.hpp"
+
+// However the input is cut up and however small the budget, feed() and
+// run() have to build the tree a whole parse builds
+
+static const wchar_t *html_source =
+    L"<!DOCTYPE html><html lang=en><head><title>A &amp; B</title>"
+    L"<meta charset=utf-8><style>p > b { color: red }</style>"
+    L"<script>if (a < b && c) document.write('</p>')</script></head>"
+    L"<body class='x y'><!-- a comment --><p>one <b>two <i>three</b> four</i>"
+    L"<a href=\"/x?a=1&amp;b=2\">link</a> café &lt;&#x1F600;&gt;</p>"
+    L"<table><tr><td>cell<td>cell</table><textarea>\n<b>raw</b></textarea>"
+    L"<ul><li>one<li>two</ul><br/><img src=x alt='a b'></body></html>";
+
+struct run_counts
+{
+    size_t yields;
+    size_t runs;
+};
+
+static std::wstring resumable_tree(const std::wstring &html, size_t chunk_size,
+        const HTMLParser::run_budget &budget, run_counts &counts)
+{
+    HTMLParser parser;
+    HTMLParser::run_status status;
+    counts = run_counts{0, 0};
+
+    for (size_t position = 0; position < html.size(); position += chunk_size)
+    {
+        parser.feed(html.substr(position, chunk_size));
+
+        // Everything fed so far is used up before it asks for more
+        while ((status = parser.run(budget)) == HTMLParser::yielded)
+            counts.yields++;
+
+        counts.runs++;
+        assert(status == HTMLParser::needs_input);
+    }
+
+    parser.finish();
+
+    while ((status = parser.run(budget)) == HTMLParser::yielded)
+        counts.yields++;
+
+    assert(status == HTMLParser::finished);
+    assert(parser.run(budget) == HTMLParser::finished);
+
+    return tree_of(parser.take_document(), true);
+}
+
+static void test_chunks_and_budgets()
+{
+    const std::wstring html = html_source;
+    const std::wstring expected = parse_tree(html, true);
+    const size_t chunk_sizes[] = {1, 2, 3, 7, 64, html.size()};
+    const HTMLParser::run_budget budgets[] = {
+        {0, std::chrono::microseconds(0)},
+        {1, std::chrono::microseconds(0)},
+        {3, std::chrono::microseconds(0)},
+        {0, std::chrono::microseconds(1)}
+    };
+
+    for (size_t chunk_size : chunk_sizes)
+    {
+        for (const HTMLParser::run_budget &budget : budgets)
+        {
+            run_counts counts;
+
+            assert(resumable_tree(html, chunk_size, budget, counts) == expected);
+
+            // Without a budget it never yields, with one token a run it
+            // yields for nearly every token
+            if (budget.max_tokens == 0 && budget.max_time.count() == 0)
+                assert(counts.yields == 0);
+            if (budget.max_tokens == 1)
+                assert(counts.yields > 50);
+        }
+    }
+}
+
+static void test_time_budget()
+{
+    // The clock is read every 32 tokens, so a long document yields to a
+    // budget of a microsecond many times
+    std::wstring html;
+
+    for (int i = 0; i < 500; i++)
+        html += L"<div><p>text <b>bold</b></p></div>";
+
+    run_counts counts;
+    HTMLParser::run_budget budget = {0, std::chrono::microseconds(1)};
+
+    assert(resumable_tree(html, html.size(), budget, counts) == parse_tree(html, true));
+    assert(counts.yields > 10);
+}
+
+static void test_status()
+{
+    HTMLParser parser;
+    const HTMLParser::run_budget no_limit = {0, std::chrono::microseconds(0)};
+
+    // Nothing to do before the first feed()
+    assert(parser.run(no_limit) == HTMLParser::finished);
+
+    // A start tag cut in half waits for the rest
+    parser.feed(L"<p>a<b cla");
+    assert(parser.run(no_limit) == HTMLParser::needs_input);
+    assert(parser.run(no_limit) == HTMLParser::needs_input);
+
+    parser.feed(L"ss=x>b");
+    assert(parser.run(no_limit) == HTMLParser::needs_input);
+
+    parser.finish();
+    assert(parser.run(no_limit) == HTMLParser::finished);
+    assert(tree_of(parser.take_document(), true) == parse_tree(L"<p>a<b class=x>b", true));
+
+    // The next feed() starts another document
+    parser.feed(L"<i>x</i>");
+    parser.finish();
+    assert(parser.run(no_limit) == HTMLParser::finished);
+    assert(tree_of(parser.take_document()) == parse_tree(L"<i>x</i>"));
+
+    // As does finish() on its own, for an empty one
+    parser.finish();
+    assert(parser.run(no_limit) == HTMLParser::finished);
+    assert(tree_of(parser.take_document()) == parse_tree(L""));
+}
+
+int main()
+{
+    test_chunks_and_budgets();
+    test_time_budget();
+    test_status();
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLTextExtractor.hpp"
+
+// The text a reader would see, as UTF-8
+
+static std::string text_of(const std::wstring &html)
+{
+    std::string output;
+    HTMLTextExtractor::extract(html, output);
+
+    return output;
+}
+
+static void test_whitespace_and_blocks()
+{
+    assert(text_of(L"<title>T</title><p>Hello   <b>world</b></p><p>again</p>") ==
+        "Hello world\nagain");
+    assert(text_of(L"  lead  ") == "lead");
+    assert(text_of(L"<ul><li>one<li>two</ul>") == "one\ntwo");
+    assert(text_of(L"a<br>b") == "a\nb");
+
+    // Kept as it is inside <pre>, collapsed again after it. The newline
+    // right after the start tag doesn't count.
+    assert(text_of(L"<pre>a  b\n c</pre>x  y") == "a  b\n c\nx y");
+    assert(text_of(L"<pre>\n\na</pre><textarea>\n&lt;b&gt;  x</textarea>") ==
+        "\na\n<b>  x");
+}
+
+static void test_hidden_content()
+{
+    assert(text_of(L"<script>var x</script><style>a{}</style>a<div hidden>no</div>b"
+            L"<span style='display:none'>no</span>c<i aria-hidden=true>no</i>d"
+            L"<template>no</template>e") == "abcde");
+
+    // Everything inside a hidden element, however deep
+    assert(text_of(L"a<div hidden><p>no<b>no</b></p></div>b") == "ab");
+    assert(text_of(L"a<div hidden><div>no</div>no</div>b") == "ab");
+
+    // Up to the next one of the kind for those closed that way
+    assert(text_of(L"<ul><li hidden>no<li>yes</ul>") == "yes");
+
+    // Markup in scripts isn't taken for tags, hidden or not
+    assert(text_of(L"a<div hidden><script>'</div>'</script>no</div>b") == "ab");
+    assert(text_of(L"<xmp><b>x</b></xmp>") == "<b>x</b>");
+
+    // A hidden void element hides nothing after it
+    assert(text_of(L"a<input hidden>b<br hidden>c") == "ab\nc");
+}
+
+static void test_utf8()
+{
+    assert(text_of(L"café 中 \U0001F600 &amp; &lt;") ==
+        "caf\xC3\xA9 \xE4\xB8\xAD \xF0\x9F\x98\x80 & <");
+}
+
+static void test_streamed_input()
+{
+    std::string output = "before:";
+    HTMLTextExtractor extractor(output);
+
+    extractor.feed(L"<p>Hel");
+    extractor.feed(L"lo <scr");
+    extractor.feed(L"ipt>no</scr");
+    extractor.feed(L"ipt>wor&am");
+    extractor.feed(L"p;ld</p>");
+    extractor.finish();
+
+    // Appended after what was there, without a separator in front
+    assert(output == "before:Hello wor&ld");
+
+    // The next document starts on a new line
+    extractor.feed(L"<b>next</b>");
+    extractor.finish();
+
+    assert(output == "before:Hello wor&ld\nnext");
+}
+
+static void test_any_split()
+{
+    // However the input is cut up
+    const std::wstring html = L"<title>t</title><p>a &amp; b<script>x<y</script>"
+        L"<div style='display: none'>no</div>c&#x1F600;<pre>\n d</pre>";
+    std::string whole;
+    HTMLTextExtractor::extract(html, whole);
+
+    assert(whole == "a & bc\xF0\x9F\x98\x80\n d");
+
+    for (size_t piece = 1; piece < 8; piece++)
+    {
+        std::string output;
+        HTMLTextExtractor extractor(output);
+
+        for (size_t position = 0; position < html.size(); position += piece)
+            extractor.feed(html.substr(position, piece));
+
+        extractor.finish();
+        assert(output == whole);
+    }
+}
+
+int main()
+{
+    test_whitespace_and_blocks();
+    test_hidden_content();
+    test_utf8();
+    test_streamed_input();
+    test_any_split();
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "../elements/HTML/HTMLTextElement.hpp"
+#include "../document/DOMArena.hpp"
+
+// Text nodes keep their text in the arena of their document, or in a
+// buffer of their own when they were made on their own
+
+static void test_growing_text()
+{
+    Document document;
+    std::shared_ptr<HTMLTextElement> first =
+        DOMArena::make_element<HTMLTextElement>(document.get_arena());
+    std::shared_ptr<HTMLTextElement> second =
+        DOMArena::make_element<HTMLTextElement>(document.get_arena());
+    std::wstring first_text;
+    std::wstring second_text;
+
+    // Taking turns, so each one moves past the other as it grows
+    for (int i = 0; i < 2000; i++)
+    {
+        first->add_char(L'a' + i % 26);
+        first_text += L'a' + i % 26;
+        second->add_char(std::wstring_view(L"xy"));
+        second_text += L"xy";
+    }
+
+    assert(first->get_text_length() == 2000);
+    assert(first->get_text().to_wstring() == first_text);
+    assert(second->get_text().to_wstring() == second_text);
+    assert(!first->get_text().is_wide());
+}
+
+static void test_switch_to_utf16()
+{
+    Document document;
+    std::shared_ptr<HTMLTextElement> text =
+        DOMArena::make_element<HTMLTextElement>(document.get_arena());
+
+    text->add_char(std::wstring_view(L"café "));
+    assert(!text->get_text().is_wide());
+
+    // What was there already is widened, and pairs count as two units
+    text->add_char(std::wstring_view(L"中\U0001F600"));
+    text->add_char(L'!');
+
+    assert(text->get_text().is_wide());
+    assert(text->get_text_length() == 9);
+    assert(text->get_text().to_wstring() == L"café 中\U0001F600!");
+}
+
+static void test_text_on_its_own()
+{
+    std::shared_ptr<HTMLTextElement> text = std::make_shared<HTMLTextElement>();
+
+    for (int i = 0; i < 100; i++)
+        text->add_char(std::wstring_view(L"abc"));
+
+    text->add_char(std::wstring_view(L"Ā"));
+
+    HTMLTextElement copy(*text);
+
+    assert(text->get_text_length() == 301);
+    assert(copy.get_text().to_wstring() == text->get_text().to_wstring());
+}
+
+static void test_text_outlives_arena()
+{
+    std::shared_ptr<HTMLTextElement> text = std::make_shared<HTMLTextElement>();
+    text->add_char(std::wstring_view(L"kept"));
+
+    {
+        HTMLParser parser;
+        std::wstring html = L"<p id=p></p>";
+        Document document = parser.construct_document_from_string(html);
+        std::shared_ptr<HTMLElement> paragraph = document.get_element_by_id(L"p");
+
+        // Taken in by the document, and given more text there
+        paragraph->add_child(text);
+        text->add_char(std::wstring_view(L" after"));
+        assert(paragraph->get_first_child()->get_text().to_wstring() == L"kept after");
+    }
+
+    // The arena is gone, the text moved out before it went
+    assert(text->get_parent() == nullptr);
+    assert(text->get_text().to_wstring() == L"kept after");
+
+    text->add_char(L'!');
+    assert(text->get_text().to_wstring() == L"kept after!");
+}
+
+static void test_parsed_text()
+{
+    HTMLParser parser;
+    std::wstring html = L"<p id=p>one &amp; two\U0001F600</p>";
+    Document document = parser.construct_document_from_string(html);
+
+    assert(document.get_element_by_id(L"p")->get_first_child()->get_text().to_wstring() ==
+        L"one & two\U0001F600");
+}
+
+int main()
+{
+    test_growing_text();
+    test_switch_to_utf16();
+    test_text_on_its_own();
+    test_text_outlives_arena();
+    test_parsed_text();
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <cassert>
+#include <string>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+#include "../document/TreeWalker.hpp"
+#include "../document/NodeIterator.hpp"
+
+// Each way of walking the tree has to visit the nodes in the order the
+// DOM says, written out here as tag names and #text
+
+static const wchar_t *html_source =
+    L"<div id=r><p>a<b>b</b></p><section><i>c</i></section>d</div>";
+
+static std::wstring name_of(const HTMLElement *node)
+{
+    if (node == nullptr)
+        return L"null";
+    if (node->is_text_node())
+        return L"#" + node->get_text().to_wstring();
+    return node->get_title();
+}
+
+template <typename Range>
+static std::wstring names_of(const Range &range)
+{
+    std::wstring names;
+
+    for (const HTMLElement *node : range)
+        names += name_of(node) + L' ';
+
+    return names;
+}
+
+static std::wstring names_of(TreeWalker &walker, bool forward)
+{
+    std::wstring names;
+
+    while (HTMLElement *node = forward ? walker.next_node() : walker.previous_node())
+        names += name_of(node) + L' ';
+
+    return names;
+}
+
+static NodeFilter::filter_result filter_section(const HTMLElement &node,
+        NodeFilter::filter_result result)
+{
+    return node.get_tag_id() == tag_section ? result : NodeFilter::filter_accept;
+}
+
+static void test_ranges(HTMLElement *root)
+{
+    assert(names_of(root->children()) == L"p section #d ");
+    assert(names_of(root->preorder()) == L"div p #a b #b section i #c #d ");
+    assert(names_of(root->postorder()) == L"#a #b b p #c i section #d div ");
+
+    // Only the subtree, not what comes after it
+    HTMLElement *paragraph = root->get_first_child();
+
+    assert(names_of(paragraph->preorder()) == L"p #a b #b ");
+    assert(names_of(paragraph->postorder()) == L"#a #b b p ");
+    assert(names_of(paragraph->get_first_child()->children()) == L"");
+}
+
+static void test_tree_walker(HTMLElement *root)
+{
+    TreeWalker elements(root, NodeFilter(NodeFilter::show_element));
+
+    assert(names_of(elements, true) == L"p b section i ");
+    assert(name_of(elements.get_current_node()) == L"i");
+    assert(names_of(elements, false) == L"section b p div ");
+
+    // Rejected takes everything under it along, skipped doesn't
+    TreeWalker rejected(root, NodeFilter(NodeFilter::show_all,
+            [](const HTMLElement &node)
+            {
+                return filter_section(node, NodeFilter::filter_reject);
+            }));
+    TreeWalker skipped(root, NodeFilter(NodeFilter::show_all,
+            [](const HTMLElement &node)
+            {
+                return filter_section(node, NodeFilter::filter_skip);
+            }));
+
+    assert(names_of(rejected, true) == L"p #a b #b #d ");
+    assert(names_of(skipped, true) == L"p #a b #b i #c #d ");
+
+    // The children of a skipped node are children of its parent here
+    assert(name_of(skipped.parent_node()) == L"div");
+    assert(name_of(skipped.first_child()) == L"p");
+    assert(name_of(skipped.next_sibling()) == L"i");
+    assert(name_of(skipped.parent_node()) == L"div");
+    assert(name_of(skipped.last_child()) == L"#d");
+    assert(name_of(skipped.previous_sibling()) == L"i");
+    assert(name_of(skipped.first_child()) == L"#c");
+    assert(name_of(skipped.first_child()) == L"null");
+    assert(name_of(skipped.get_current_node()) == L"#c");
+
+    // Never above root
+    TreeWalker walker(root);
+    assert(walker.parent_node() == nullptr);
+    assert(walker.get_current_node() == root);
+}
+
+static void test_node_iterator(HTMLElement *root)
+{
+    // Rejecting only skips the one node
+    NodeIterator iterator(root, NodeFilter(NodeFilter::show_all,
+            [](const HTMLElement &node)
+            {
+                return filter_section(node, NodeFilter::filter_reject);
+            }));
+    std::wstring names;
+
+    while (HTMLElement *node = iterator.next_node())
+        names += name_of(node) + L' ';
+
+    assert(names == L"div p #a b #b i #c #d ");
+    assert(!iterator.get_pointer_before_reference_node());
+
+    names.clear();
+
+    while (HTMLElement *node = iterator.previous_node())
+        names += name_of(node) + L' ';
+
+    assert(names == L"#d #c i #b b #a p div ");
+    assert(iterator.get_pointer_before_reference_node());
+    assert(iterator.get_reference_node() == root);
+
+    NodeIterator texts(root, NodeFilter(NodeFilter::show_text));
+    names.clear();
+
+    while (HTMLElement *node = texts.next_node())
+        names += name_of(node) + L' ';
+
+    assert(names == L"#a #b #c #d ");
+}
+
+int main()
+{
+    HTMLParser parser;
+    std::wstring html = html_source;
+    Document document = parser.construct_document_from_string(html);
+    HTMLElement *root = document.get_element_by_id(L"r").get();
+
+    test_ranges(root);
+    test_tree_walker(root);
+    test_node_iterator(root);
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef TREEWRITER_HPP
+#define TREEWRITER_HPP
+
+#include <sstream>
+#include <string>
+#include <memory>
+
+#include "../parsers/HTML/HTMLParser.hpp"
+
+// Trees written out as tags and quoted text, so a test can compare whole
+// trees as strings
+
+inline void write_tree(std::wostringstream &output, const HTMLElement *element,
+        bool with_attributes = false)
+{
+    if (element->is_text_node())
+    {
+        output << L'"' << element->get_text().to_wstring() << L'"';
+        return;
+    }
+
+    output << L'<' << element->get_title();
+
+    if (with_attributes)
+    {
+        for (const std::pair<const std::wstring, std::wstring> &attribute :
+                element->get_attributes())
+            output << L' ' << attribute.first << L"=\"" << attribute.second << L'"';
+    }
+
+    output << L'>';
+
+    for (const HTMLElement *child : element->children())
+        write_tree(output, child, with_attributes);
+
+    output << L"</" << element->get_title() << L'>';
+}
+
+inline std::wstring tree_of(const Document &document, bool with_attributes = false)
+{
+    std::wostringstream output;
+
+    for (const std::shared_ptr<HTMLElement> &root : document.get_elements())
+        write_tree(output, root.get(), with_attributes);
+
+    return output.str();
+}
+
+inline std::wstring parse_tree(std::wstring html, bool with_attributes = false)
+{
+    HTMLParser parser;
+
+    return tree_of(parser.construct_document_from_string(html), with_attributes);
+}
+
+#endif // TREEWRITER_HPP